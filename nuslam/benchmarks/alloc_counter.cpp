@@ -0,0 +1,55 @@
+#include "alloc_counter.hpp"
+#include <atomic>
+
+namespace
+{
+	std::atomic<std::size_t> allocations(0);
+}
+
+// Eigen allocates matrices with malloc rather than operator new, so count at the malloc
+// level. operator new calls malloc, so C++ allocations are counted as well.
+// These wrap the glibc implementations.
+extern "C"
+{
+	void * __libc_malloc(std::size_t size);
+	void * __libc_calloc(std::size_t num, std::size_t size);
+	void * __libc_realloc(void * p, std::size_t size);
+
+	void * malloc(std::size_t size)
+	{
+		allocations.fetch_add(1, std::memory_order_relaxed);
+		return __libc_malloc(size);
+	}
+
+	void * calloc(std::size_t num, std::size_t size)
+	{
+		allocations.fetch_add(1, std::memory_order_relaxed);
+		return __libc_calloc(num, size);
+	}
+
+	void * realloc(void * p, std::size_t size)
+	{
+		allocations.fetch_add(1, std::memory_order_relaxed);
+		return __libc_realloc(p, size);
+	}
+}
+
+namespace nuslam
+{
+	std::size_t allocation_count()
+	{
+		return allocations.load(std::memory_order_relaxed);
+	}
+
+	AllocationReport::AllocationReport(benchmark::State & state_) : state(state_)
+	{
+		start = allocation_count();
+	}
+
+	AllocationReport::~AllocationReport()
+	{
+		// Averaged over all iterations of the timed loop
+		state.counters["allocs/op"] = benchmark::Counter(static_cast<double>(allocation_count() - start),\
+														 benchmark::Counter::kAvgIterations);
+	}
+}
@@ -0,0 +1,32 @@
+#ifndef ALLOC_COUNTER_INCLUDE_GUARD_HPP
+#define ALLOC_COUNTER_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Heap allocation counting for the benchmarks. Linking alloc_counter.cpp wraps malloc,
+/// so every allocation made by the benchmarked code, including Eigen's, is counted (glibc only).
+#include <benchmark/benchmark.h>
+#include <cstddef>
+
+namespace nuslam
+{
+    /// \brief return the number of heap allocations made by this process so far
+    /// \returns allocation count
+    std::size_t allocation_count();
+
+    /// \brief counts the allocations made while a benchmark runs and reports them as allocs/op
+    class AllocationReport
+    {
+    public:
+        /// \brief start counting allocations for a benchmark
+        /// \param state_: benchmark state to report to
+        AllocationReport(benchmark::State & state_);
+
+        /// \brief add the allocs/op counter to the benchmark state
+        ~AllocationReport();
+
+    private:
+        benchmark::State & state;
+        std::size_t start;
+    };
+}
+
+#endif
@@ -0,0 +1,512 @@
+#include <benchmark/benchmark.h>
+#include "alloc_counter.hpp"
+#include "nuslam/landmarks.hpp"
+#include "nuslam/scan_cloud.hpp"
+#include "nuslam/arena.hpp"
+#include "nuslam/ekf.hpp"
+#include "nuslam/latency.hpp"
+#include "nuslam/model_index.hpp"
+#include "nuslam/grid_map.hpp"
+#include "nuslam/scan_matcher.hpp"
+#include "nuslam/icp.hpp"
+#include "nuslam/cluster_tracker.hpp"
+#include <string>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+using nuslam::Point;
+using nuslam::Landmark;
+using rigid2d::Vector2D;
+
+namespace
+{
+	// Map sizes of interest, from the 12 landmark slots used by slam up to large mapped areas. The full
+	// covariance cost is cubic in map size, nearly half a second per iteration at 500 landmarks, so it stops at 256.
+	void map_sizes(benchmark::internal::Benchmark * b)
+	{
+		for (int n : {12, 50, 100, 256})
+		{
+			b->Arg(n);
+		}
+	}
+
+	// Same as map_sizes, and with a frozen map (localization-only mode), which goes on up to 1000 landmarks
+	void map_sizes_frozen(benchmark::internal::Benchmark * b)
+	{
+		for (int n : {12, 50, 100, 256})
+		{
+			b->Args({n, 0});
+		}
+		for (int n : {12, 50, 100, 256, 500, 1000})
+		{
+			b->Args({n, 1});
+		}
+	}
+
+	// Landmarks on a square grid with 0.5m spacing centred on the origin
+	std::vector<Point> grid_map(const unsigned long int & n)
+	{
+		std::vector<Point> landmarks;
+		int side = std::ceil(std::sqrt(n));
+		for (unsigned long int i = 0; i < n; i++)
+		{
+			double x = 0.5 * (static_cast<int>(i) % side - side / 2) + 0.25;
+			double y = 0.5 * (static_cast<int>(i) / side - side / 2) + 0.25;
+			landmarks.push_back(Point(Vector2D(x, y)));
+		}
+		return landmarks;
+	}
+
+	// EKF at the origin with a known map of n landmarks
+	nuslam::EKF make_ekf(const unsigned long int & n, const bool & frozen)
+	{
+		std::vector<Point> map_state_(n, Point());
+		nuslam::Pose2D xyt_noise_var = nuslam::Pose2D(1e-6, 1e-6, 1e-5);
+		nuslam::RangeBear rb_noise_var_ = nuslam::RangeBear(1e-6, 1e-6);
+		nuslam::EKF ekf(rigid2d::Pose2D(), map_state_, xyt_noise_var, rb_noise_var_, 1.0, 100.0, 1e5);
+		ekf.set_map(grid_map(n));
+		if (frozen)
+		{
+			ekf.freeze_map();
+		}
+		return ekf;
+	}
+
+	// Measurements of the landmarks within 1m of the origin, relative to the robot
+	std::vector<Point> visible_landmarks(const unsigned long int & n)
+	{
+		std::vector<Point> measurements;
+		std::vector<Point> landmarks = grid_map(n);
+		for (auto iter = landmarks.begin(); iter != landmarks.end(); iter++)
+		{
+			if (iter->range_bear.range < 1.0)
+			{
+				measurements.push_back(*iter);
+			}
+		}
+		return measurements;
+	}
+
+	struct Scan
+	// Minimal stand-in for sensor_msgs::LaserScan
+	{
+		double angle_min, angle_max, angle_increment, range_min, range_max;
+		std::vector<double> ranges;
+	};
+
+	// Centres of the cylinders of synthetic_scan
+	std::vector<Vector2D> synthetic_cylinders(const int & num_cylinders)
+	{
+		std::vector<Vector2D> cylinders;
+		for (int k = 0; k < num_cylinders; k++)
+		{
+			double angle = 2.0 * rigid2d::PI * k / num_cylinders;
+			double range = 0.5 + 0.4 * (k % 3);
+			cylinders.push_back(Vector2D(range * cos(angle), range * sin(angle)));
+		}
+		return cylinders;
+	}
+
+	// 360 beam scan from the origin of a 3m square room with cylinders of radius 0.05m, by a sensor
+	// turned by heading (rad)
+	Scan synthetic_scan(const int & num_cylinders, const double & heading = 0.0)
+	{
+		Scan scan;
+		scan.angle_min = 0.0;
+		scan.angle_increment = 2.0 * rigid2d::PI / 360.0;
+		scan.angle_max = scan.angle_min + 359 * scan.angle_increment;
+		scan.range_min = 0.12;
+		scan.range_max = 3.5;
+
+		double radius = 0.05;
+		std::vector<Vector2D> cylinders = synthetic_cylinders(num_cylinders);
+
+		for (int i = 0; i < 360; i++)
+		{
+			double bearing = heading + scan.angle_min + i * scan.angle_increment;
+			Vector2D dir(cos(bearing), sin(bearing));
+			// Walls at x,y = +-1.5
+			double range = std::numeric_limits<double>::infinity();
+			if (std::abs(dir.x) > 1e-9)
+			{
+				range = std::min(range, 1.5 / std::abs(dir.x));
+			}
+			if (std::abs(dir.y) > 1e-9)
+			{
+				range = std::min(range, 1.5 / std::abs(dir.y));
+			}
+			// Nearest ray-circle intersection
+			for (auto iter = cylinders.begin(); iter != cylinders.end(); iter++)
+			{
+				double b = dir.x * iter->x + dir.y * iter->y;
+				double c = iter->x * iter->x + iter->y * iter->y - radius * radius;
+				double disc = b * b - c;
+				if (disc >= 0 && b - std::sqrt(disc) > 0)
+				{
+					range = std::min(range, b - std::sqrt(disc));
+				}
+			}
+			scan.ranges.push_back(std::min(range, scan.range_max));
+		}
+		return scan;
+	}
+
+	// Same processing as scan_callback in landmarks_node.cpp, without ROS messages.
+	// Temporaries live in the arena, which is reset first, and points keeps its storage across calls
+	// If windows is set, only the clusters inside them are fitted, as with roi_ in landmarks_node.cpp
+	void process_scan(const Scan & lsr, const double & threshold_, nuslam::ScanArena & arena,\
+					  nuslam::ScanCloud & points, std::pmr::vector<Landmark> & landmarks,\
+					  const std::vector<nuslam::ScanWindow> * windows = nullptr)
+	{
+		arena.reset();
+		points.clear();
+		points.reserve(lsr.ranges.size());
+		// Kept across calls, like points
+		static std::vector<std::uint8_t> mask;
+		if (windows != nullptr)
+		{
+			nuslam::window_beams(*windows, lsr.angle_min, lsr.angle_increment, lsr.ranges.size(), mask);
+		}
+		double bearing = lsr.angle_min;
+		for (long unsigned int i = 0; i < lsr.ranges.size(); i++)
+		{
+			if (lsr.ranges.at(i) >= lsr.range_min && lsr.ranges.at(i) <= lsr.range_max)
+			{
+				if (windows != nullptr && !mask[i])
+				{
+					bearing += lsr.angle_increment;
+					continue;
+				}
+				points.push_back(Point(nuslam::RangeBear(lsr.ranges.at(i), bearing)));
+				bearing += lsr.angle_increment;
+			}
+		}
+
+		nuslam::ScanCloud clusters(&arena);
+		if (windows != nullptr)
+		{
+			nuslam::cluster_windows(points, threshold_, *windows, clusters);
+		} else {
+			nuslam::cluster_scan(points, threshold_, clusters);
+		}
+		landmarks.clear();
+		nuslam::fit_clusters(clusters, 0.1, landmarks);
+	}
+
+	// 360 beams in a 4 m x 3 m room whose corners are (-1.5, -1) and (2.5, 2), seen from a sensor pose
+	nuslam::ScanCloud room_cloud(const rigid2d::Pose2D & sensor)
+	{
+		nuslam::ScanCloud scan;
+		for (int i = 0; i < 360; i++)
+		{
+			double bearing = i * rigid2d::PI / 180.0;
+			double c = std::cos(sensor.theta + bearing), s = std::sin(sensor.theta + bearing);
+			double range = std::min(std::fabs(c) > 1e-9 ? ((c > 0.0 ? 2.5 : -1.5) - sensor.x) / c : 1e9,\
+									std::fabs(s) > 1e-9 ? ((s > 0.0 ? 2.0 : -1.0) - sensor.y) / s : 1e9);
+			scan.push_back(nuslam::Point(nuslam::RangeBear(range, bearing)));
+		}
+		return scan;
+	}
+}
+
+static void BM_Landmark_FitCircle(benchmark::State & state)
+{
+	// Cluster of state.range(0) points spread over half of a circle of radius 0.1m at (1, 0.5)
+	Landmark cluster(1.0);
+	int num_points = state.range(0);
+	for (int i = 0; i < num_points; i++)
+	{
+		double angle = rigid2d::PI * i / num_points;
+		cluster.evaluate_point(Point(Vector2D(1.0 + 0.1 * cos(angle), 0.5 + 0.1 * sin(angle))));
+	}
+	nuslam::AllocationReport report(state);
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(cluster.fit_circle());
+	}
+}
+BENCHMARK(BM_Landmark_FitCircle)->RangeMultiplier(4)->Range(4, 1024);
+
+static void BM_ScanCloud_FitCircle(benchmark::State & state)
+{
+	// Same cluster as BM_Landmark_FitCircle, fitted straight from the contiguous arrays
+	nuslam::ScanCloud cluster;
+	int num_points = state.range(0);
+	for (int i = 0; i < num_points; i++)
+	{
+		double angle = rigid2d::PI * i / num_points;
+		cluster.push_back(Point(Vector2D(1.0 + 0.1 * cos(angle), 0.5 + 0.1 * sin(angle))));
+	}
+	nuslam::AllocationReport report(state);
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(nuslam::fit_circle(cluster.x.data(), cluster.y.data(), cluster.size()));
+	}
+}
+BENCHMARK(BM_ScanCloud_FitCircle)->RangeMultiplier(4)->Range(4, 1024);
+
+static void BM_EKF_Predict(benchmark::State & state)
+{
+	nuslam::EKF ekf = make_ekf(state.range(0), state.range(1));
+	rigid2d::Twist2D tw(0.0, 0.0, 0.0);
+	nuslam::AllocationReport report(state);
+	for (auto _ : state)
+	{
+		ekf.predict(tw);
+	}
+}
+BENCHMARK(BM_EKF_Predict)->Apply(map_sizes_frozen)->Unit(benchmark::kMicrosecond);
+
+static void BM_EKF_MsrUpdate(benchmark::State & state)
+{
+	nuslam::EKF ekf = make_ekf(state.range(0), state.range(1));
+	std::vector<Point> measurements = visible_landmarks(state.range(0));
+	{
+		nuslam::AllocationReport report(state);
+		for (auto _ : state)
+		{
+			ekf.msr_update(measurements);
+		}
+	}
+	state.counters["measurements"] = measurements.size();
+}
+BENCHMARK(BM_EKF_MsrUpdate)->Apply(map_sizes_frozen)->Unit(benchmark::kMicrosecond);
+
+static void BM_EKF_MahalanobisTest(benchmark::State & state)
+{
+	nuslam::EKF ekf = make_ekf(state.range(0), false);
+	Eigen::VectorXd z(2);
+	z << 0.35, 0.785;
+	nuslam::AllocationReport report(state);
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(ekf.mahalanobis_test(z));
+	}
+}
+BENCHMARK(BM_EKF_MahalanobisTest)->Apply(map_sizes)->Unit(benchmark::kMicrosecond);
+
+static void BM_ScanProcessing(benchmark::State & state)
+{
+	Scan scan = synthetic_scan(state.range(0));
+	nuslam::ScanArena arena;
+	nuslam::ScanCloud points;
+	{
+		// Warm up, so the arena and points have grown to their steady-state size
+		std::pmr::vector<Landmark> landmarks(&arena);
+		process_scan(scan, 0.15, arena, points, landmarks);
+	}
+	unsigned long int num_landmarks = 0;
+	{
+		nuslam::AllocationReport report(state);
+		for (auto _ : state)
+		{
+			std::pmr::vector<Landmark> landmarks(&arena);
+			process_scan(scan, 0.15, arena, points, landmarks);
+			num_landmarks = landmarks.size();
+			benchmark::DoNotOptimize(landmarks.data());
+		}
+	}
+	state.counters["landmarks"] = num_landmarks;
+}
+BENCHMARK(BM_ScanProcessing)->Arg(4)->Arg(8)->Arg(16)->Unit(benchmark::kMicrosecond);
+
+static void BM_ScanProcessing_Windows(benchmark::State & state)
+{
+	Scan scan = synthetic_scan(state.range(0));
+	// Windows of a well-localized robot: 2cm and 0.02rad standard deviations, 3 sigma gate
+	std::vector<nuslam::ScanWindow> windows;
+	std::vector<Vector2D> cylinders = synthetic_cylinders(state.range(0));
+	for (auto iter = cylinders.begin(); iter != cylinders.end(); iter++)
+	{
+		windows.push_back(nuslam::ScanWindow(nuslam::cartesianToPolar(*iter), nuslam::RangeBear(0.02, 0.02), 3.0, 0.1));
+	}
+	nuslam::ScanArena arena;
+	nuslam::ScanCloud points;
+	{
+		std::pmr::vector<Landmark> landmarks(&arena);
+		process_scan(scan, 0.15, arena, points, landmarks, &windows);
+	}
+	unsigned long int num_landmarks = 0;
+	{
+		nuslam::AllocationReport report(state);
+		for (auto _ : state)
+		{
+			std::pmr::vector<Landmark> landmarks(&arena);
+			process_scan(scan, 0.15, arena, points, landmarks, &windows);
+			num_landmarks = landmarks.size();
+			benchmark::DoNotOptimize(landmarks.data());
+		}
+	}
+	state.counters["landmarks"] = num_landmarks;
+}
+BENCHMARK(BM_ScanProcessing_Windows)->Arg(4)->Arg(8)->Arg(16)->Unit(benchmark::kMicrosecond);
+
+// Circle fitting of the clusters of consecutive scans: arg 0 fits each from scratch with fit_clusters,
+// arg 1 with a ClusterTracker while the robot turns back and forth by a fraction of a beam (so the
+// beams hit other Points and each cylinder is refined), arg 2 with a ClusterTracker while the robot is still
+static void BM_ClusterTracker_FitClusters(benchmark::State & state)
+{
+	const double turn = state.range(0) == 1 ? 0.005 : 0.0;
+	nuslam::ScanCloud clusters[2];
+	for (int k = 0; k < 2; k++)
+	{
+		Scan scan = synthetic_scan(8, k * turn);
+		nuslam::ScanCloud points;
+		for (long unsigned int i = 0; i < scan.ranges.size(); i++)
+		{
+			double bearing = scan.angle_min + i * scan.angle_increment;
+			points.push_back(Point(nuslam::RangeBear(scan.ranges.at(i), bearing)));
+		}
+		nuslam::cluster_scan(points, 0.15, clusters[k]);
+	}
+	// Pose of the sensor at each scan in its frame at the other
+	const rigid2d::Transform2D motions[2] = {rigid2d::Transform2D(Vector2D(), -turn),\
+											 rigid2d::Transform2D(Vector2D(), turn)};
+
+	nuslam::ClusterTracker tracker;
+	std::pmr::vector<Landmark> landmarks;
+	std::pmr::vector<nuslam::CircleFit> fits;
+	for (int k = 0; k < 2; k++)
+	{
+		tracker.predict(motions[k]);
+		tracker.fit_clusters(clusters[k], 0.1, landmarks, fits);
+	}
+	int k = 0;
+	{
+		nuslam::AllocationReport report(state);
+		for (auto _ : state)
+		{
+			if (state.range(0) == 0)
+			{
+				nuslam::fit_clusters(clusters[k], 0.1, landmarks, fits);
+			} else {
+				tracker.predict(motions[k]);
+				tracker.fit_clusters(clusters[k], 0.1, landmarks, fits);
+			}
+			benchmark::DoNotOptimize(landmarks.data());
+			k = 1 - k;
+		}
+	}
+	state.counters["clusters"] = clusters[0].num_clusters();
+	state.counters["landmarks"] = landmarks.size();
+	if (state.range(0) > 0)
+	{
+		state.counters["refined"] = tracker.stats().refined;
+		state.counters["reused"] = tracker.stats().reused;
+	}
+}
+BENCHMARK(BM_ClusterTracker_FitClusters)->Arg(0)->Arg(1)->Arg(2);
+
+static void BM_ScopedTimer(benchmark::State & state)
+{
+	// Overhead added to every instrumented stage
+	nuslam::LatencyHistogram hist;
+	nuslam::AllocationReport report(state);
+	for (auto _ : state)
+	{
+		nuslam::ScopedTimer timer(hist);
+	}
+}
+BENCHMARK(BM_ScopedTimer)->ThreadRange(1, 4);
+
+static void BM_ModelIndex_Update(benchmark::State & state)
+{
+	// Gazebo world with the robot last, after range(0) landmarks
+	std::vector<std::string> names = {"ground_plane"};
+	for (int i = 0; i < state.range(0); i++)
+	{
+		names.push_back("cylinder_" + std::to_string(i));
+	}
+	names.push_back("diff_drive");
+	nuslam::ModelIndex index;
+	index.update(names);
+	nuslam::AllocationReport report(state);
+	for (auto _ : state)
+	{
+		// Re-validation of an unchanged list, done on every ModelStates message
+		benchmark::DoNotOptimize(index.update(names));
+	}
+}
+BENCHMARK(BM_ModelIndex_Update)->RangeMultiplier(4)->Range(4, 1024);
+
+static void BM_GridMap_InsertScan(benchmark::State & state)
+{
+	// 360 beams from the centre of a 3 m square room, inserted into an already-mapped grid
+	nuslam::ScanCloud scan;
+	for (int i = 0; i < 360; i++)
+	{
+		double bearing = i * 2.0 * rigid2d::PI / 360.0;
+		double range = 1.5 / std::max(std::fabs(std::cos(bearing)), std::fabs(std::sin(bearing)));
+		scan.push_back(nuslam::Point(nuslam::RangeBear(range, bearing)));
+	}
+	nuslam::GridMap grid;
+	rigid2d::Pose2D sensor(0.0, 0.0, 0.0);
+	grid.insert_scan(sensor, scan);
+	nuslam::AllocationReport report(state);
+	for (auto _ : state)
+	{
+		grid.insert_scan(sensor, scan);
+		grid.clear_dirty();
+	}
+	state.SetItemsProcessed(state.iterations() * scan.size());
+}
+BENCHMARK(BM_GridMap_InsertScan);
+
+static void BM_ScanMatcher_Match(benchmark::State & state)
+{
+	// 360 beams in a 4 m x 3 m room, matched against a map of the room from a guess off by 0.1 m and 0.05 rad
+	nuslam::ScanCloud scan;
+	for (int i = 0; i < 360; i++)
+	{
+		double bearing = i * rigid2d::PI / 180.0;
+		double c = std::cos(bearing), s = std::sin(bearing);
+		double range = std::min(std::fabs(c) > 1e-9 ? (c > 0.0 ? 2.5 : -1.5) / c : 1e9,\
+								std::fabs(s) > 1e-9 ? (s > 0.0 ? 2.0 : -1.0) / s : 1e9);
+		scan.push_back(nuslam::Point(nuslam::RangeBear(range, bearing)));
+	}
+	nuslam::GridMap grid;
+	grid.insert_scan(rigid2d::Pose2D(), scan);
+	nuslam::ScanMatcher matcher(state.range(0) / 100.0, 0.2, 0.01);
+	matcher.set_map(grid);
+	rigid2d::Pose2D guess(0.08, -0.06, 0.05);
+	nuslam::AllocationReport report(state);
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(matcher.match(guess, scan));
+	}
+}
+// Translation window in cm
+BENCHMARK(BM_ScanMatcher_Match)->Arg(10)->Arg(20)->Arg(50);
+
+static void BM_Icp_Align(benchmark::State & state)
+{
+	// Consecutive scans 0.1 m and 0.08 rad apart, aligned from the identity
+	const nuslam::ScanCloud reference = room_cloud(rigid2d::Pose2D());
+	const nuslam::ScanCloud source = room_cloud(rigid2d::Pose2D(0.1, -0.05, 0.08));
+	nuslam::IcpMetric metric = state.range(0) == 0 ? nuslam::IcpMetric::PointToPoint : nuslam::IcpMetric::PointToLine;
+	nuslam::Icp icp(metric, 30, 0.2, 1e-4);
+	icp.set_reference(reference);
+	icp.align(source, rigid2d::Pose2D());
+	nuslam::AllocationReport report(state);
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(icp.align(source, rigid2d::Pose2D()));
+	}
+}
+// 0: point-to-point, 1: point-to-line
+BENCHMARK(BM_Icp_Align)->Arg(0)->Arg(1);
+
+static void BM_Icp_SetReference(benchmark::State & state)
+{
+	const nuslam::ScanCloud reference = room_cloud(rigid2d::Pose2D());
+	nuslam::Icp icp;
+	icp.set_reference(reference);
+	nuslam::AllocationReport report(state);
+	for (auto _ : state)
+	{
+		// k-d tree build and normal estimation, once per keyframe
+		icp.set_reference(reference);
+	}
+}
+BENCHMARK(BM_Icp_SetReference);
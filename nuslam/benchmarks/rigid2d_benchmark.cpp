@@ -0,0 +1,58 @@
+#include <benchmark/benchmark.h>
+#include "alloc_counter.hpp"
+#include "rigid2d/rigid2d.hpp"
+#include "rigid2d/diff_drive.hpp"
+
+using rigid2d::Transform2D;
+using rigid2d::Twist2D;
+using rigid2d::Vector2D;
+
+static void BM_Transform2D_Compose(benchmark::State & state)
+{
+	Transform2D T1(Vector2D(1.0, 2.0), 0.5);
+	Transform2D T2(Vector2D(-0.5, 0.3), -1.2);
+	nuslam::AllocationReport report(state);
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(T1 = T1 * T2);
+	}
+}
+BENCHMARK(BM_Transform2D_Compose);
+
+static void BM_Transform2D_Inverse(benchmark::State & state)
+{
+	Transform2D T(Vector2D(1.0, 2.0), 0.5);
+	nuslam::AllocationReport report(state);
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(T = T.inv());
+	}
+}
+BENCHMARK(BM_Transform2D_Inverse);
+
+static void BM_Transform2D_IntegrateTwist(benchmark::State & state)
+{
+	Transform2D T;
+	// Pure translation (w_z = 0) and general screw motion take different branches
+	Twist2D tw(state.range(0) ? 0.01 : 0.0, 0.02, 0.0);
+	nuslam::AllocationReport report(state);
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(T = T.integrateTwist(tw));
+	}
+}
+BENCHMARK(BM_Transform2D_IntegrateTwist)->Arg(0)->Arg(1);
+
+static void BM_DiffDrive_UpdateOdometry(benchmark::State & state)
+{
+	rigid2d::DiffDrive driver(rigid2d::Pose2D(), 0.16, 0.033);
+	double left = 0.0, right = 0.0;
+	nuslam::AllocationReport report(state);
+	for (auto _ : state)
+	{
+		left += 0.01;
+		right += 0.012;
+		benchmark::DoNotOptimize(driver.updateOdometry(left, right));
+	}
+}
+BENCHMARK(BM_DiffDrive_UpdateOdometry);
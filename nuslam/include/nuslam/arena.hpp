@@ -0,0 +1,72 @@
+#ifndef ARENA_INCLUDE_GUARD_HPP
+#define ARENA_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Library Arena monotonic memory resource for the temporary objects of one scan.
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+namespace nuslam
+{
+    /// \brief monotonic arena for the temporary objects of one scan, for use with std::pmr containers.
+    /// Allocation bumps an offset through one preallocated block and deallocation does nothing;
+    /// reset() makes the whole block available again. Requests which do not fit are served from
+    /// the heap, and the next reset() grows the block to the high-water mark, so once scans stop
+    /// growing, processing one performs no heap allocation. Not thread-safe: use one arena per thread.
+    class ScanArena : public std::pmr::memory_resource
+    {
+    public:
+        /// \brief the default constructor creates an arena with a 64 KiB block
+        ScanArena();
+
+        /// \brief create an arena with a user-specified block size
+        /// \param capacity_: size of the preallocated block (bytes)
+        ScanArena(const std::size_t & capacity_);
+
+        /// \brief free the block and any heap overflow
+        ~ScanArena();
+
+        ScanArena(const ScanArena &) = delete;
+        ScanArena & operator=(const ScanArena &) = delete;
+
+        /// \brief release everything allocated since the last reset. Containers using the arena
+        /// must not be used afterwards.
+        void reset();
+
+        /// \brief return the size of the preallocated block
+        /// \returns capacity (bytes)
+        std::size_t capacity() const;
+
+        /// \brief return the memory handed out since the last reset, including heap overflow
+        /// \returns used memory (bytes)
+        std::size_t used() const;
+
+        /// \brief return the number of requests served from the heap since construction
+        /// \returns overflow count
+        std::size_t overflows() const;
+
+    private:
+        void * do_allocate(std::size_t bytes, std::size_t alignment) override;
+        void do_deallocate(void * p, std::size_t bytes, std::size_t alignment) override;
+        bool do_is_equal(const std::pmr::memory_resource & other) const noexcept override;
+
+        struct Overflow
+        // Heap allocation made when the block was full
+        {
+            void * p;
+            std::size_t bytes, alignment;
+        };
+
+        std::unique_ptr<std::max_align_t[]> block;
+        std::size_t size;
+        // Next free byte of the block
+        std::size_t offset;
+        // Bytes served from the heap since the last reset
+        std::size_t overflow_bytes;
+        std::size_t overflow_count;
+        std::vector<Overflow> overflow;
+    };
+}
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef BAG_DATASET_INCLUDE_GUARD_HPP
+#define BAG_DATASET_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Library BagDataset reading recorded LaserScan, JointState and ModelStates topics into a Dataset.
+/// Depends on rosbag, so it is only built with catkin and is not part of nuslam_core.
+#include <nuslam/replay.hpp>
+#include <string>
+
+namespace nuslam
+{
+    struct BagTopics
+    // Topics, wheel joint names and Gazebo model names to read from a bag
+    {
+        std::string scan;
+        std::string joint_states;
+        std::string model_states;
+        std::string left_wheel_joint;
+        std::string right_wheel_joint;
+        std::string robot_name;
+        std::string landmark_name;
+
+        // \brief constructor for BagTopics with the topic, joint and model names used by the nuturtle simulation
+        BagTopics();
+    };
+
+    /// \brief read the scan, joint state and model state topics of a bag into memory, without a ROS master.
+    /// LaserScan and JointState are stamped with their header stamp, ModelStates (which has no header)
+    /// with the time it was recorded. Wheel angles are looked up by joint name, and JointState messages
+    /// without both wheel joints are skipped. Each stream is sorted by stamp.
+    /// \param filename: path of the bag
+    /// \param topics: topics and model names to read
+    /// \returns recorded streams; ground_truth is empty if the bag has no model states
+    /// \throws rosbag::BagException if the bag cannot be read
+    Dataset read_bag(const std::string & filename, const BagTopics & topics);
+}
+
+#endif
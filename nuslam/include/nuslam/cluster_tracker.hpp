@@ -0,0 +1,107 @@
+#ifndef CLUSTER_TRACKER_INCLUDE_GUARD_HPP
+#define CLUSTER_TRACKER_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Library ClusterTracker association of clusters across scans and warm-started circle fitting.
+#include <rigid2d/rigid2d.hpp>
+#include <nuslam/landmarks.hpp>
+#include <nuslam/scan_cloud.hpp>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+namespace nuslam
+{
+    // Used for the motion of the sensor between scans
+    using rigid2d::Transform2D;
+
+    struct TrackStats
+    // How the clusters of the last scan were fitted
+    {
+        // Fitted from scratch with fit_circle, because they matched no track or refinement failed
+        unsigned long int fitted;
+        // Fitted with a few Gauss-Newton iterations from the circle of their track
+        unsigned long int refined;
+        // Given the circle of their track, since their Points had not moved
+        unsigned long int reused;
+
+        // \brief constructor for TrackStats with no inputs, initializes all to zero
+        TrackStats();
+    };
+
+    /// \brief tracks the clusters of consecutive scans, so that repeated observations of a landmark cost a
+    /// fraction of a new detection. Each cluster of a scan becomes a track holding its Points and circle.
+    /// predict() moves the tracks into the frame of the next scan using the odometry, and each cluster of
+    /// the next scan is associated with the unclaimed track whose centroid is nearest. If its Points are
+    /// those of the track, within a tolerance, the track's circle is reused; otherwise a few Gauss-Newton
+    /// iterations on the geometric distance to the circle start from the track's circle. Clusters without
+    /// a track, and tracks too large to be landmarks (e.g. walls), are fitted with fit_circle. Storage is
+    /// kept across scans, so steady-state tracking does not allocate.
+    class ClusterTracker
+    {
+    public:
+        /// \brief the default constructor associates within 0.1 m, refines with 3 iterations and reuses
+        /// circles of clusters whose Points moved less than 1 mm
+        ClusterTracker();
+
+        /// \brief create a tracker with user-specified settings
+        /// \param max_distance_: distance (m) between centroids beyond which a cluster is not associated with a track
+        /// \param iterations_: number of Gauss-Newton iterations from the circle of a track
+        /// \param tolerance_: distance (m) within which every Point of a cluster must be from that of its
+        /// track for the track's circle to be reused, 0 to always refine
+        /// \throws std::invalid_argument if max_distance_ is not positive, iterations_ is 0 or tolerance_ is negative
+        ClusterTracker(const double & max_distance_, const unsigned int & iterations_, const double & tolerance_);
+
+        /// \brief express the tracks in the frame of the next scan
+        /// \param motion: pose of the sensor at the next scan in its frame at the previous one, e.g. from
+        /// wheel odometry
+        void predict(const Transform2D & motion);
+
+        /// \brief fit a circle to each cluster, associating the clusters with the tracks of the previous
+        /// scan, which are then replaced by the clusters. Same outputs as nuslam::fit_clusters.
+        /// \param clusters: clustered Points returned by cluster_scan or cluster_windows
+        /// \param max_radius: radius above which a cluster is discarded (e.g. walls)
+        /// \param landmarks: cleared, then filled with the centre and radius of each kept cluster
+        /// \param fits: cleared, then filled with the circle fitted to each cluster, in cluster order
+        void fit_clusters(const ScanCloud & clusters, const double & max_radius, std::pmr::vector<Landmark> & landmarks,\
+                          std::pmr::vector<CircleFit> & fits);
+
+        /// \brief remove every track, e.g. after a gap in the scans
+        void clear();
+
+        /// \brief return the number of tracks
+        /// \returns number of clusters of the last scan
+        unsigned long int size() const;
+
+        /// \brief return how the clusters of the last scan were fitted
+        /// \returns counts of fitted, refined and reused clusters
+        const TrackStats & stats() const;
+
+    private:
+        struct Track
+        // One cluster of the last scan
+        {
+            CircleFit fit;
+            // Centroid of the Points
+            double centroid_x, centroid_y;
+            // Points from first up to, but excluding, first + n in points_x and points_y
+            unsigned long int first, n;
+        };
+
+        // Refine a circle with Gauss-Newton iterations on the geometric distance of n Points to it
+        // Returns false if the result is not a finite circle within max_distance of the start
+        bool refine(const double * x, const double * y, const unsigned long int & n, const CircleFit & start,\
+                    CircleFit & fit) const;
+
+        double max_distance;
+        unsigned int iterations;
+        double tolerance;
+        // Tracks and their Points, and the same for the scan being fitted, swapped at the end of fit_clusters
+        std::vector<Track> tracks, next_tracks;
+        std::vector<double> points_x, points_y, next_x, next_y;
+        // Whether each track was associated with a cluster of the scan being fitted
+        std::vector<std::uint8_t> claimed;
+        TrackStats last_stats;
+    };
+}
+
+#endif
@@ -0,0 +1,89 @@
+#ifndef DESKEW_INCLUDE_GUARD_HPP
+#define DESKEW_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Library Deskew motion compensation of LaserScan beams using odometry.
+#include <rigid2d/rigid2d.hpp>
+#include <nuslam/landmarks.hpp>
+#include <deque>
+#include <iterator>  // to use std::prev
+
+namespace nuslam
+{
+    // Used to store odometry and integrate it across a scan
+    using rigid2d::Twist2D;
+    using rigid2d::Transform2D;
+
+    struct TwistSample
+    // Struct to store a body twist (rad/s, m/s) and the time (s) at which it was measured
+    {
+        double stamp;
+        Twist2D twist;
+
+        // \brief constructor for TwistSample with no inputs, initializes to zero
+        TwistSample();
+
+        // \brief constructor for TwistSample with inputs
+        TwistSample(const double & stamp_, const Twist2D & twist_);
+    };
+
+    /// \brief corrects each LaserScan beam for the motion of the robot during the scan, so that
+    /// all Points of one scan are expressed in the sensor frame at the time of the first beam
+    class Deskew
+    {
+    public:
+        /// \brief the default constructor keeps one second of odometry history
+        Deskew();
+
+        /// \brief construct Deskew with user-specified odometry history length
+        /// \param horizon_: seconds of odometry history to keep
+        Deskew(const double & horizon_);
+
+        /// \brief record a body twist, and drop samples older than the history horizon
+        /// \param stamp: time (s) at which the twist was measured
+        /// \param twist: body twist per second (rad/s, m/s), e.g. DiffDrive::wheelsToTwist / dt
+        void add_twist(const double & stamp, const Twist2D & twist);
+
+        /// \brief linearly interpolate the recorded body twist, clamped to the oldest/newest sample
+        /// \param stamp: time (s) at which to evaluate the twist
+        /// \returns interpolated Twist2D, or a zero twist if no odometry has been recorded
+        Twist2D interpolate_twist(const double & stamp) const;
+
+        /// \brief start compensating a new scan
+        /// \param stamp_: acquisition time (s) of the first beam (LaserScan header stamp)
+        /// \param time_increment_: time (s) between consecutive beams (LaserScan time_increment)
+        void start_scan(const double & stamp_, const double & time_increment_);
+
+        /// \brief set the pose of the sensor in the body frame of the recorded twists. Each twist is
+        /// converted to the sensor frame with the adjoint of this pose before it is integrated, so that a
+        /// sensor away from the rotation axis is compensated for its own translation. Identity by default.
+        /// \param T_body_sensor: pose of the sensor in the body frame
+        void set_sensor_pose(const Transform2D & T_body_sensor);
+
+        /// \brief express a Point measured by a beam of the current scan in the sensor frame
+        /// at the first beam. Beams must be passed in increasing index order.
+        /// \param point: Point in the sensor frame at the time its beam was captured
+        /// \param beam_index: index of the beam in LaserScan ranges[]
+        /// \returns motion-compensated Point
+        Point correct_point(const Point & point, const unsigned long int & beam_index);
+
+        /// \brief whether any odometry has been recorded
+        /// \returns true if correct_point will compensate motion
+        bool ready() const;
+
+    private:
+        // Odometry history, oldest first
+        std::deque<TwistSample> history;
+        // Seconds of odometry history to keep
+        double horizon;
+        // First beam time and time between beams of the current scan
+        double scan_stamp, time_increment;
+        // Index of the beam at which T_beam is evaluated
+        unsigned long int beam;
+        // Pose of the sensor at beam relative to the sensor at the first beam
+        Transform2D T_beam;
+        // Pose of the body in the sensor frame, which converts body twists to sensor twists
+        Transform2D T_sensor_body;
+    };
+}
+
+#endif
@@ -5,11 +5,12 @@
 #include <rigid2d/rigid2d.hpp>
 #include <rigid2d/diff_drive.hpp>
 #include <nuslam/landmarks.hpp>
+#include <nuslam/map_file.hpp>
 #include <vector>
 #include <eigen3/Eigen/Dense>
 #include <numeric>
 #include <functional>
-#include <ros/ros.h>
+#include <memory>
 #include <limits>  // set variable to max (inf)
 #include<random>  // to seed common random num gen
 
@@ -91,6 +92,22 @@ namespace nuslam
         MeasurementNoise(const RangeBear & rb_noise_var_);
     };
 
+    // Struct to store the expected measurement of a landmark
+    struct MeasurementPrediction
+    {
+        // Index of the landmark in the map state
+        unsigned long int index;
+
+        // Expected range and bearing of the landmark from the robot
+        RangeBear range_bear;
+
+        // Standard deviation of the range and bearing, from the innovation covariance H * P * H^T + R
+        RangeBear sigma;
+
+        /// \brief constructor for MeasurementPrediction with no inputs, initializes all to zero
+        MeasurementPrediction();
+    };
+
     /// \brief handles model propagation for EKF SLAM
     class EKF
     {
@@ -105,7 +122,7 @@ namespace nuslam
         /// Start with guess of robot state (0,0,0) with zero covariance for robot state, indicating
         /// full confidence in initial state, and infinite covariance for ladmarks state, indicating we
         /// know nothing about them.
-        EKF(const Pose2D & robot_state_, const std::vector<Point> & map_state_,\
+        EKF(const Pose2D & robot_state_, std::vector<Point> map_state_,\
              const Pose2D & xyt_noise_var, const RangeBear & rb_noise_var_,\
              const double & max_range_, double mahalanobis_lower_, double mahalanobis_upper_);
 
@@ -130,6 +147,19 @@ namespace nuslam
         /// \returns vector of Point(s) which have fallen outside of the mahalanobis deadband
         std::vector<double> mahalanobis_test(const Eigen::VectorXd & z);
 
+        /// \brief incorporate a direct measurement of the robot pose, e.g. from scan matching. The measurement
+        /// model is linear (H selects theta, x, y), so the update is exact and also corrects the landmarks
+        /// through their cross-covariance with the robot.
+        /// \param measured: measured robot pose in the map frame
+        /// \param noise_var: variance of the measured x, y and theta
+        void pose_update(const Pose2D & measured, const Pose2D & noise_var);
+
+
+        /// \brief predict the measurement of every landmark seen so far from the current belief, so that a
+        /// detector can restrict its search to where the landmarks should appear. Only the 2*2 blocks of the
+        /// covariance involving the robot and each landmark are read, so this is linear in the map size.
+        /// \param predictions: cleared, then filled with one MeasurementPrediction per seen landmark
+        void predict_measurements(std::vector<MeasurementPrediction> & predictions) const;
 
         /// \brief computes and returns Nearest Semi-Positive Definite Matrix
         // From Higham: "The nearest symmetric positive semidefinite matrix in the
@@ -142,15 +172,56 @@ namespace nuslam
 
         /// \brief return current pose belief
         /// \returns Pose2D
-        Pose2D return_pose();
+        const Pose2D & return_pose() const;
 
         /// \brief return current map state belief
-        /// \returns std::vector<Point>
-        std::vector<Point> return_map();
+        /// \returns std::vector<Point>, valid until the next predict, msr_update or map change
+        const std::vector<Point> & return_map() const;
 
         /// \brief reset internal pose
         void reset_pose(const Pose2D & pose);
 
+        /// \brief save the map (landmark means, covariance and seen counts) along with the
+        /// robot state to a memory-mappable map file
+        /// \param filename: path of the map file, overwritten if it exists
+        /// \throws std::runtime_error if the file cannot be written
+        void save_map(const std::string & filename) const;
+
+        /// \brief replace the map with one loaded from a map file. The landmark means, landmark
+        /// covariance block and seen counts are taken from the file, while the robot pose and its
+        /// covariance are kept, so the EKF localizes against the saved map from its current pose.
+        /// Cross-covariance between robot and landmarks is reset to zero.
+        /// \param map_file: mapped map file
+        /// \throws std::logic_error if the map is frozen
+        void load_map(const MapFile & map_file);
+
+        /// \brief replace the map with one loaded from a map file and switch to localization-only
+        /// mode, as load_map followed by freeze_map would. Only the landmark means and seen counts are
+        /// read; the EKF keeps a reference to the mapped file, whose covariance is only read when the
+        /// map is saved, so loading does not scale with the square of the map size.
+        /// \param map_file: mapped map file
+        /// \throws std::logic_error if the map is frozen
+        void load_frozen_map(const std::shared_ptr<const MapFile> & map_file);
+
+        /// \brief replace the map with known landmark positions (e.g. Gazebo ground truth), which are
+        /// all marked as initialized with zero covariance. The robot pose and its covariance are kept.
+        /// \param landmarks: vector of Point containing landmark x,y coordinates in the map frame
+        /// \throws std::logic_error if the map is frozen
+        void set_map(const std::vector<Point> & landmarks);
+
+        /// \brief switch to localization-only mode: landmark positions are fixed and only the 3*3
+        /// robot covariance is propagated, so predict and the update for each associated measurement
+        /// no longer scale with map size. The landmarks are indexed in a uniform grid of max_range
+        /// cells, and each measurement is only associated with the landmarks within its range (or
+        /// max_range, whichever is larger) plus three standard deviations of the position of the
+        /// predicted pose, with fixed-size matrices and no heap allocation. Measurements which do not
+        /// associate with a known landmark are discarded instead of initializing new landmarks.
+        void freeze_map();
+
+        /// \brief whether the EKF is in localization-only mode
+        /// \returns true after freeze_map
+        bool map_frozen() const;
+
     private:
         Eigen::VectorXd State;
         double max_range;
@@ -162,12 +233,36 @@ namespace nuslam
         unsigned int N; // Number of seen landmarks
         double mahalanobis_lower; // < deadband: old landmark | > deadband: new landmark
         double mahalanobis_upper; // < deadband: old landmark | > deadband: new landmark
+        bool frozen; // localization-only mode
+        Eigen::MatrixXd frozen_cov; // full covariance at the time the map was frozen
+        std::shared_ptr<const MapFile> frozen_map_file; // holds the full covariance instead, after load_frozen_map
+
+        // Index the seen landmarks in the grid below
+        void index_frozen_map();
+
+        // Nearest frozen landmark to a measurement by mahalanobis distance, among those near the
+        // predicted pose. Returns N, with d_star infinite, if there is none.
+        unsigned int associate_frozen(const Eigen::Vector2d & z, double & d_star) const;
+
+        // Measurement update of the robot state and covariance from frozen landmark j
+        void update_frozen(const Eigen::Vector2d & z, const unsigned int & j);
+
+        // Uniform grid over the frozen landmarks, in compressed rows: the landmarks of cell c are
+        // frozen_landmarks[frozen_cells[c]] up to, but excluding, frozen_landmarks[frozen_cells[c + 1]]
+        double cell_size;
+        double grid_min_x, grid_min_y;
+        long int grid_width, grid_height;
+        std::vector<unsigned int> frozen_cells, frozen_landmarks;
     };
 
-    /// \brief create random number generator with common seed
+    /// \brief create random number generator with common seed, one per thread
     /// \returns number generator
     std::mt19937 & get_random();
 
+    /// \brief reseed the calling thread's random number generator, to make EKF runs repeatable
+    /// \param seed: new seed
+    void seed_random(const unsigned int & seed);
+
     /// \brief sample normal distribution
     /// \returns noies vector
     Eigen::VectorXd sampleNormalDistribution(int mtx_dimension);
@@ -177,6 +272,13 @@ namespace nuslam
     // This is used to sample noise for the state update function
     /// \returns noise matrix
     Eigen::VectorXd getMultivarNoise(const Eigen::MatrixXd & noise_mtx);
+
+    /// \brief Jacobian of a landmark's (range, bearing) measurement with respect to the robot's (theta, x, y).
+    /// The Jacobian with respect to the landmark's (x, y) is the negated x and y columns.
+    /// \param x_diff: x-distance from the robot to the landmark
+    /// \param y_diff: y-distance from the robot to the landmark
+    /// \returns 2x3 robot block of the measurement Jacobian
+    Eigen::Matrix<double, 2, 3> msr_jacobian(const double & x_diff, const double & y_diff);
 }
 
 #endif
@@ -0,0 +1,151 @@
+#ifndef GRID_MAP_INCLUDE_GUARD_HPP
+#define GRID_MAP_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Library GridMap sparse, tiled log-odds occupancy grid built from LaserScans.
+#include <rigid2d/rigid2d.hpp>
+#include <rigid2d/diff_drive.hpp>
+#include <nuslam/scan_cloud.hpp>
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+namespace nuslam
+{
+    // Used to place scans in the map
+    using rigid2d::Pose2D;
+    using rigid2d::Vector2D;
+
+    struct GridBounds
+    // Axis-aligned block of cells: the first cell and the number of cells along x and y
+    {
+        std::int32_t min_x, min_y;
+        std::uint32_t width, height;
+
+        // \brief constructor for GridBounds with no inputs, initializes all to zero
+        GridBounds();
+    };
+
+    /// \brief occupancy grid stored as square tiles of TILE_SIZE x TILE_SIZE cells, allocated the first
+    /// time a ray reaches them, so the map grows in any direction without reallocating or copying the
+    /// cells already mapped. Each cell holds its log-odds of occupancy in fixed point (units of 0.01),
+    /// clamped so that it can always be revised. Rays are traced with integer Bresenham steps, and
+    /// tiles touched since the last clear_dirty() are listed so that only those need to be published.
+    class GridMap
+    {
+    public:
+        /// \brief log2 of the number of cells along one side of a tile
+        static constexpr unsigned int TILE_BITS = 5;
+        /// \brief number of cells along one side of a tile
+        static constexpr std::int32_t TILE_SIZE = 1 << TILE_BITS;
+        /// \brief number of cells in a tile
+        static constexpr std::uint32_t TILE_CELLS = TILE_SIZE * TILE_SIZE;
+        /// \brief log-odds of a cell which was never observed
+        static constexpr std::int16_t UNKNOWN = INT16_MIN;
+
+        /// \brief the default constructor creates a 0.05 m grid with hit and miss probabilities of 0.7 and
+        /// 0.4, and cell probabilities clamped to [0.12, 0.97]
+        GridMap();
+
+        /// \brief create a grid with user-specified resolution and update probabilities
+        /// \param resolution_: side of a cell (m)
+        /// \param p_hit: probability that a cell is occupied given that a beam ended in it, above 0.5
+        /// \param p_miss: probability that a cell is occupied given that a beam crossed it, below 0.5
+        /// \param p_min, p_max: bounds on the probability of a cell
+        /// \throws std::invalid_argument if resolution_ is not positive or the probabilities are out of order
+        GridMap(const double & resolution_, const double & p_hit, const double & p_miss,\
+                const double & p_min, const double & p_max);
+
+        /// \brief trace one beam, marking the cells it crosses as free and, if it hit something, the
+        /// cell it ended in as occupied
+        /// \param from: position of the sensor in the map frame (m)
+        /// \param to: end of the beam in the map frame (m)
+        /// \param hit: whether the beam ended on an obstacle, false for beams truncated at the maximum range
+        void insert_ray(const Vector2D & from, const Vector2D & to, const bool & hit);
+
+        /// \brief trace every beam of a scan which hit an obstacle
+        /// \param sensor: pose of the sensor in the map frame
+        /// \param scan: end points of the beams in the sensor frame, e.g. filled from a LaserScan
+        void insert_scan(const Pose2D & sensor, const ScanCloud & scan);
+
+        /// \brief return the log-odds of the cell containing a position
+        /// \param p: position in the map frame (m)
+        /// \returns log-odds (units of 0.01), or UNKNOWN
+        std::int16_t log_odds(const Vector2D & p) const;
+
+        /// \brief return the occupancy of the cell containing a position, as in nav_msgs::OccupancyGrid
+        /// \param p: position in the map frame (m)
+        /// \returns probability of occupancy from 0 to 100, or -1 if unknown
+        std::int8_t occupancy(const Vector2D & p) const;
+
+        /// \brief return the side of a cell
+        /// \returns resolution (m)
+        double resolution() const;
+
+        /// \brief return the number of allocated tiles
+        /// \returns count
+        unsigned long int num_tiles() const;
+
+        /// \brief return the smallest block of whole tiles containing every allocated tile
+        /// \returns bounds (cells), all zero if no tile is allocated
+        GridBounds bounds() const;
+
+        /// \brief write the occupancy of every cell in bounds(), row by row from min_y, as in nav_msgs::OccupancyGrid
+        /// \param data: resized to width * height and overwritten
+        void export_grid(std::vector<std::int8_t> & data) const;
+
+        /// \brief return the tiles updated since the last clear_dirty(), in the order they were first updated
+        /// \returns tile indices, for use with tile_bounds and export_tile
+        const std::vector<std::uint32_t> & dirty_tiles() const;
+
+        /// \brief forget which tiles were updated
+        void clear_dirty();
+
+        /// \brief return the cells covered by a tile
+        /// \param tile: tile index
+        /// \returns bounds (cells)
+        GridBounds tile_bounds(const std::uint32_t & tile) const;
+
+        /// \brief write the occupancy of every cell of a tile, row by row, as in nav_msgs::OccupancyGrid
+        /// \param tile: tile index
+        /// \param data: resized to TILE_CELLS and overwritten
+        void export_tile(const std::uint32_t & tile, std::vector<std::int8_t> & data) const;
+
+    private:
+        struct Tile
+        // TILE_SIZE x TILE_SIZE cells, row by row
+        {
+            std::int32_t tx, ty;
+            std::uint32_t index;
+            bool dirty;
+            std::array<std::int16_t, TILE_CELLS> cells;
+        };
+
+        // Return the tile at tile coordinates, allocating it if create is set
+        Tile * find_tile(const std::int32_t & tx, const std::int32_t & ty, const bool & create);
+        const Tile * find_tile(const std::int32_t & tx, const std::int32_t & ty) const;
+
+        // Trace a beam between two cells. tile caches the last tile updated, across beams.
+        void trace(const std::int32_t & x0, const std::int32_t & y0, const std::int32_t & x1, const std::int32_t & y1,\
+                   const bool & hit, Tile * & tile);
+
+        // Return the cell coordinates of a position
+        std::int32_t cell_coord(const double & v) const;
+
+        // Convert log-odds to occupancy from 0 to 100, or -1 if unknown
+        std::int8_t to_occupancy(const std::int16_t & l) const;
+
+        double res;
+        std::int16_t hit_update, miss_update, min_log_odds, max_log_odds;
+        // Tiles never move once allocated, so growing the map copies no cells
+        std::deque<Tile> tiles;
+        std::unordered_map<std::uint64_t, std::uint32_t> tile_index;
+        std::vector<std::uint32_t> dirty;
+        // Occupancy of every log-odds value from min_log_odds to max_log_odds
+        std::vector<std::int8_t> occupancy_table;
+        std::int32_t min_tx, min_ty, max_tx, max_ty;
+    };
+}
+
+#endif
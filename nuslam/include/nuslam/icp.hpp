@@ -0,0 +1,146 @@
+#ifndef ICP_INCLUDE_GUARD_HPP
+#define ICP_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Library Icp point-to-point and point-to-line scan registration, and KDTree2D nearest-neighbour search.
+#include <rigid2d/rigid2d.hpp>
+#include <rigid2d/diff_drive.hpp>
+#include <nuslam/scan_cloud.hpp>
+#include <cstdint>
+#include <vector>
+
+namespace nuslam
+{
+    // Used for the estimated transform
+    using rigid2d::Pose2D;
+
+    /// \brief 2D k-d tree over a fixed set of points, stored as one array in tree order: each subrange is
+    /// split at its median along its wider axis, and the median is the subrange's node, so the tree needs
+    /// no pointers or per-node allocation.
+    class KDTree2D
+    {
+    public:
+        /// \brief value returned by nearest when no point is close enough
+        static constexpr std::uint32_t npos = static_cast<std::uint32_t>(-1);
+
+        /// \brief the default constructor creates an empty tree
+        KDTree2D();
+
+        /// \brief rebuild the tree over a set of points, reusing its storage
+        /// \param x, y: coordinates of the points
+        /// \throws std::invalid_argument if x and y have different lengths
+        void build(const std::vector<double> & x, const std::vector<double> & y);
+
+        /// \brief find the nearest point to a query
+        /// \param qx, qy: coordinates of the query
+        /// \param max_distance: distance beyond which points are ignored
+        /// \returns index of the nearest point in the arrays given to build, or npos if none is within max_distance
+        std::uint32_t nearest(const double & qx, const double & qy, const double & max_distance) const;
+
+        /// \brief return the number of points
+        /// \returns count
+        std::uint32_t size() const;
+
+    private:
+        struct Node
+        // One point, in tree order
+        {
+            double x, y;
+            // Index of the point in the arrays given to build
+            std::uint32_t id;
+            // Split axis (0 = x, 1 = y)
+            std::uint32_t axis;
+        };
+
+        // Build the subtree of nodes[begin, end)
+        void build(const std::uint32_t & begin, const std::uint32_t & end);
+
+        // Search the subtree of nodes[begin, end), shrinking best_sq and updating best
+        void search(const std::uint32_t & begin, const std::uint32_t & end, const double & qx, const double & qy,\
+                    double & best_sq, std::uint32_t & best) const;
+
+        std::vector<Node> nodes;
+    };
+
+    /// \brief error metric minimized by Icp
+    enum class IcpMetric
+    {
+        // Euclidean distance between corresponding points, solved in closed form
+        PointToPoint,
+        // Distance from each point to the line through its correspondence (Censi, "An ICP variant using a
+        // point-to-line metric"), which converges in far fewer iterations on walls. Reference points whose
+        // line cannot be estimated fall back to point-to-point.
+        PointToLine
+    };
+
+    struct IcpResult
+    // Outcome of one Icp alignment
+    {
+        // Pose of the source scan in the frame of the reference scan
+        Pose2D pose;
+        // Number of iterations performed
+        unsigned int iterations;
+        // Number of correspondences within max_distance at the final pose
+        unsigned long int correspondences;
+        // Root-mean-squared distance between corresponding points at the final pose (m)
+        double rmse;
+        // Whether the update fell below the tolerance before max_iterations
+        bool converged;
+
+        // \brief constructor for IcpResult with no inputs, initializes all to zero
+        IcpResult();
+    };
+
+    /// \brief iterative closest point registration of one laser scan against another. Correspondences
+    /// are found with a KDTree2D over the reference scan, and the transformed source points and residuals
+    /// are computed over separate x and y arrays, in loops the compiler vectorizes. Working buffers are
+    /// kept across calls, so aligning scans of the same size does not allocate.
+    class Icp
+    {
+    public:
+        /// \brief the default constructor uses point-to-line, 30 iterations, 0.2 m correspondences and a 1e-4 tolerance
+        Icp();
+
+        /// \brief create an Icp with user-specified settings
+        /// \param metric_: error metric
+        /// \param max_iterations_: maximum number of iterations
+        /// \param max_distance_: distance beyond which a source point has no correspondence (m)
+        /// \param tolerance_: update (m and rad) below which the alignment has converged
+        /// \throws std::invalid_argument if max_iterations_ is 0, or max_distance_ or tolerance_ is not positive
+        Icp(const IcpMetric & metric_, const unsigned int & max_iterations_, const double & max_distance_,\
+            const double & tolerance_);
+
+        /// \brief copy a scan as the reference, build its k-d tree and estimate its line normals
+        /// \param reference: end points of the reference scan in beam order
+        void set_reference(const ScanCloud & reference);
+
+        /// \brief return the number of reference points
+        /// \returns count
+        unsigned long int reference_size() const;
+
+        /// \brief align a scan to the reference
+        /// \param source: end points of the scan to align
+        /// \param guess: initial pose of the source in the reference frame, e.g. the previous motion
+        /// \returns pose of the source in the reference frame and alignment statistics; the guess, with
+        /// no correspondences, if either scan has fewer than 3 points
+        IcpResult align(const ScanCloud & source, const Pose2D & guess);
+
+    private:
+        // Transform the source by the pose, gather its correspondences into the pair arrays, and return their number
+        unsigned long int associate(const ScanCloud & source, const Pose2D & pose);
+
+        IcpMetric metric;
+        unsigned int max_iterations;
+        double max_distance;
+        double tolerance;
+        // Reference points and the unit normals of the lines through them (0, 0 if unknown)
+        std::vector<double> ref_x, ref_y, normal_x, normal_y;
+        KDTree2D tree;
+        // Transformed source points
+        std::vector<double> moved_x, moved_y;
+        // Corresponding source points, reference points and reference normals, contiguous so that the
+        // residual loops read them sequentially
+        std::vector<double> pair_px, pair_py, pair_qx, pair_qy, pair_nx, pair_ny;
+    };
+}
+
+#endif
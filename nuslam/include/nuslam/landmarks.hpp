@@ -9,7 +9,6 @@
 #include <eigen3/Eigen/Eigenvalues>
 #include <numeric>
 #include <functional>
-#include <ros/ros.h>
 
 namespace nuslam
 {
@@ -48,6 +47,18 @@ namespace nuslam
         Point(const RangeBear & range_bear_);
     };
 
+    struct CircleFit
+    // Circle fitted to a cluster of LaserScan Points
+    {
+        Vector2D centre;
+        double radius;
+        // Root-mean-squared algebraic error of the fit
+        double rms;
+
+        // \brief constructor for CircleFit with no inputs, initializes all to zero
+        CircleFit();
+    };
+
     /// \brief create a Landmark with pose relative to turtlebot3
     class Landmark
     {
@@ -62,9 +73,10 @@ namespace nuslam
         /// \brief construct Landmark object with inputs 
         /// \param radius: radius of detected landmark
         /// \param coords_: cartesian coordinates of detected landmark
-        /// \param points_: vector of Point, each of which is a part of the cluster constituing this landmark
+        /// \param points_: vector of Point, each of which is a part of the cluster constituing this landmark,
+        /// moved into the Landmark
         /// \param threshold: euclidean distance below which to consider two LIDAR points as belonging to one cluster
-        Landmark(const double & radius_, const Point & coords_, const std::vector<Point> points_, const double & threshold_);
+        Landmark(const double & radius_, const Point & coords_, std::vector<Point> points_, const double & threshold_);
 
 
         /// \brief check if a Point belongs to this Landmark, and add it to points if so
@@ -75,16 +87,16 @@ namespace nuslam
         bool evaluate_point(const Point & point_);
 
         /// \brief return the Points that make up this landmark
-        /// \returns vector of Point
-        std::vector<Point> return_points();
+        /// \returns vector of Point, valid until the Landmark is modified
+        const std::vector<Point> & return_points() const;
 
         /// \brief return the centre of the landmark (range, bearing, x, y) through Point struct
         /// \returns Point struct containing x,y coords as well as range,bear measurement
-        Point return_coords();
+        const Point & return_coords() const;
 
         /// \brief return the radius of the landmark
         /// \returns landmark radius
-        double return_radius();
+        double return_radius() const;
 
 
         /// \brief Fit Circle from cluster and set x,y,radius,range,bearing of Landmark
@@ -118,6 +130,27 @@ namespace nuslam
     /// \returns  Vector2D containing cartesian coordinates
     Vector2D polarToCartesian(const RangeBear & range_bear);
 
+    /// \brief fit a circle to n Points with the Hyperaccurate algebraic fit (Al-Sharadqah and Chernov).
+    /// Takes the coordinates as separate contiguous arrays so that the centroid and moment
+    /// computations vectorize.
+    /// \param x: x coordinates of the Points
+    /// \param y: y coordinates of the Points
+    /// \param n: number of Points, at least 3
+    /// \returns centre, radius and fit error of the circle
+    CircleFit fit_circle(const double * x, const double * y, const unsigned long int & n);
+
+    /// \brief group consecutive LaserScan Points into clusters, merge the first and last clusters
+    /// if the scan wraps around, and discard clusters of 3 or fewer Points
+    /// \param points: Points of one LaserScan in beam order
+    /// \param threshold: euclidean distance below which to consider two LIDAR points as belonging to one cluster
+    /// \returns vector of Landmark, each containing the Points of one cluster
+    std::vector<Landmark> cluster_points(const std::vector<Point> & points, const double & threshold);
+
+    /// \brief fit a circle to each cluster and discard clusters whose radius is too large to be a landmark
+    /// \param clusters: vector of Landmark returned by cluster_points, modified in place
+    /// \param max_radius: radius above which a cluster is discarded (e.g. walls)
+    void fit_landmarks(std::vector<Landmark> & clusters, const double & max_radius);
+
 }
 
 #endif
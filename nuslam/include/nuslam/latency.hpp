@@ -0,0 +1,147 @@
+#ifndef LATENCY_INCLUDE_GUARD_HPP
+#define LATENCY_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Library Latency always-on per-stage latency histograms and scoped timers.
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace nuslam
+{
+    /// \brief log-linear (HDR-style) histogram of durations in nanoseconds. Every power of two is split
+    /// into 32 linear sub-buckets, so any recorded value is reported within ~3% of its true value, from
+    /// 1 ns up to ~18 minutes. Recording is wait-free: a few relaxed atomic increments, with no locks
+    /// and no allocation, so it may be called from any thread, including several at once.
+    class LatencyHistogram
+    {
+    public:
+        /// \brief log2 of the number of sub-buckets per power of two
+        static constexpr unsigned int SUB_BUCKET_BITS = 5;
+        /// \brief durations at or above 2^MAX_BITS ns are recorded in the last bucket
+        static constexpr unsigned int MAX_BITS = 40;
+        /// \brief number of buckets
+        static constexpr unsigned int BUCKETS = (MAX_BITS - SUB_BUCKET_BITS + 1) << SUB_BUCKET_BITS;
+
+        /// \brief the default constructor creates an empty histogram
+        LatencyHistogram();
+
+        LatencyHistogram(const LatencyHistogram &) = delete;
+        LatencyHistogram & operator=(const LatencyHistogram &) = delete;
+
+        /// \brief record one duration
+        /// \param ns: duration (ns)
+        void record(const std::uint64_t & ns);
+
+        /// \brief return the number of recorded durations
+        /// \returns count
+        std::uint64_t count() const;
+
+        /// \brief return the p-th percentile of the recorded durations
+        /// \param p: percentile between 0 and 100
+        /// \returns upper bound of the bucket holding the percentile (ns), or 0 if empty
+        std::uint64_t percentile(const double & p) const;
+
+        /// \brief return the mean of the recorded durations
+        /// \returns mean (ns), or 0 if empty
+        double mean() const;
+
+        /// \brief return the largest recorded duration
+        /// \returns max (ns)
+        std::uint64_t max() const;
+
+        /// \brief clear the histogram. Durations recorded concurrently may be partially kept.
+        void reset();
+
+        /// \brief return the bucket a duration falls in
+        /// \param ns: duration (ns)
+        /// \returns bucket index
+        static unsigned int bucket_index(const std::uint64_t & ns);
+
+        /// \brief return the largest duration which falls in a bucket
+        /// \param index: bucket index
+        /// \returns duration (ns)
+        static std::uint64_t bucket_upper(const unsigned int & index);
+
+        /// \brief return the number of durations in a bucket
+        /// \param index: bucket index
+        /// \returns count
+        std::uint64_t bucket_count(const unsigned int & index) const;
+
+    private:
+        std::array<std::atomic<std::uint64_t>, BUCKETS> buckets;
+        std::atomic<std::uint64_t> total;
+        std::atomic<std::uint64_t> sum;
+        std::atomic<std::uint64_t> max_ns;
+    };
+
+    struct LatencySummary
+    // Percentiles (us) of one stage's histogram
+    {
+        std::string stage;
+        std::uint64_t count;
+        double mean, p50, p90, p99, max;
+
+        // \brief constructor for LatencySummary with no inputs, initializes all to zero
+        LatencySummary();
+    };
+
+    /// \brief named latency histograms, one per pipeline stage. Looking up a stage takes a lock, so
+    /// call sites look up their histogram once (e.g. into a function-local static) and then record
+    /// into it lock-free.
+    class LatencyRegistry
+    {
+    public:
+        /// \brief return the histogram of a stage, creating it on first use. The reference stays
+        /// valid for the lifetime of the registry.
+        /// \param stage: stage name, e.g. "ekf.predict"
+        /// \returns histogram
+        LatencyHistogram & histogram(const std::string & stage);
+
+        /// \brief return the percentiles of every stage, sorted by stage name
+        /// \returns one summary per stage
+        std::vector<LatencySummary> summary() const;
+
+        /// \brief clear every histogram
+        void reset();
+
+        /// \brief write the summary and the non-empty buckets of every stage to a text file
+        /// \param filename: path of the file, overwritten if it exists
+        /// \throws std::runtime_error if the file cannot be written
+        void dump(const std::string & filename) const;
+
+    private:
+        mutable std::mutex mutex;
+        std::map<std::string, std::unique_ptr<LatencyHistogram>> histograms;
+    };
+
+    /// \brief return the process-wide registry used by the nuslam nodes and library
+    /// \returns registry
+    LatencyRegistry & latency_registry();
+
+    /// \brief records the time between its construction and destruction into a histogram
+    class ScopedTimer
+    {
+    public:
+        /// \brief start timing
+        /// \param hist_: histogram which receives the duration
+        explicit ScopedTimer(LatencyHistogram & hist_);
+
+        /// \brief stop timing and record the duration
+        ~ScopedTimer();
+
+        ScopedTimer(const ScopedTimer &) = delete;
+        ScopedTimer & operator=(const ScopedTimer &) = delete;
+
+    private:
+        LatencyHistogram & hist;
+        std::chrono::steady_clock::time_point start;
+    };
+}
+
+#endif
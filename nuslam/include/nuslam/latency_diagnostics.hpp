@@ -0,0 +1,49 @@
+#ifndef LATENCY_DIAGNOSTICS_INCLUDE_GUARD_HPP
+#define LATENCY_DIAGNOSTICS_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Conversion of the latency registry to diagnostic_msgs, shared by the nuslam nodes.
+/// Depends on ROS messages, so it is header-only and not part of nuslam_core.
+#include <nuslam/latency.hpp>
+#include <diagnostic_msgs/DiagnosticArray.h>
+#include <ros/time.h>
+#include <string>
+#include <vector>
+
+namespace nuslam
+{
+    /// \brief return a DiagnosticArray with one status per stage of the process-wide latency registry
+    /// \param node_name: prefix of the status names and hardware_id, e.g. "slam"
+    /// \param stamp: header stamp of the array
+    /// \returns statuses whose values are count, mean_us, p50_us, p90_us, p99_us and max_us
+    inline diagnostic_msgs::DiagnosticArray latency_diagnostics(const std::string & node_name, const ros::Time & stamp)
+    {
+        diagnostic_msgs::DiagnosticArray array;
+        array.header.stamp = stamp;
+        std::vector<LatencySummary> summaries = latency_registry().summary();
+        for (auto iter = summaries.begin(); iter != summaries.end(); iter++)
+        {
+            diagnostic_msgs::DiagnosticStatus status;
+            status.level = diagnostic_msgs::DiagnosticStatus::OK;
+            status.name = node_name + ": " + iter->stage + " latency";
+            status.hardware_id = node_name;
+            status.message = "p99 " + std::to_string(iter->p99) + " us";
+            const std::vector<std::pair<std::string, double>> fields = {
+                {"mean_us", iter->mean}, {"p50_us", iter->p50}, {"p90_us", iter->p90},
+                {"p99_us", iter->p99}, {"max_us", iter->max}};
+            diagnostic_msgs::KeyValue kv;
+            kv.key = "count";
+            kv.value = std::to_string(iter->count);
+            status.values.push_back(kv);
+            for (auto field = fields.begin(); field != fields.end(); field++)
+            {
+                kv.key = field->first;
+                kv.value = std::to_string(field->second);
+                status.values.push_back(kv);
+            }
+            array.status.push_back(status);
+        }
+        return array;
+    }
+}
+
+#endif
@@ -0,0 +1,113 @@
+#ifndef MAP_FILE_INCLUDE_GUARD_HPP
+#define MAP_FILE_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Library MapFile persistent storage of EKF SLAM maps in a memory-mappable binary format.
+#include <nuslam/landmarks.hpp>
+#include <eigen3/Eigen/Dense>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace nuslam
+{
+    /// \brief first bytes of every map file
+    constexpr char MAP_FILE_MAGIC[8] = {'N', 'U', 'S', 'L', 'A', 'M', 'M', 'P'};
+
+    /// \brief current map file layout version. Increment whenever the layout changes.
+    constexpr std::uint32_t MAP_FILE_VERSION = 1;
+
+    /// \brief written as-is to detect files saved on a machine with different byte order
+    constexpr std::uint32_t MAP_FILE_BYTE_ORDER = 0x01020304;
+
+    struct MapFileHeader
+    // Fixed-size header at the start of a map file. Its size is a multiple of 8 so that
+    // the arrays which follow it are aligned for double access when the file is mmap'ed:
+    //   double state[3 + 2n]                       EKF State vector (theta, x, y, x1, y1, ... xn, yn)
+    //   double covariance[(3 + 2n) * (3 + 2n)]     EKF covariance matrix, column-major
+    //   int32_t seen_count[n]                      number of measurements incorporated per landmark
+    {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t byte_order;
+        // Number of landmark slots n
+        std::uint32_t map_size;
+        // Number of initialized landmarks (EKF::N)
+        std::uint32_t seen;
+        std::uint64_t reserved;
+    };
+
+    static_assert(sizeof(MapFileHeader) % sizeof(double) == 0, "MapFileHeader breaks double alignment");
+
+    /// \brief read-only, memory-mapped view of a map file. The State vector and covariance are
+    /// accessed directly in the mapped pages without being parsed or copied.
+    class MapFile
+    {
+    public:
+        /// \brief the default constructor creates an empty MapFile with no file mapped
+        MapFile();
+
+        /// \brief map a map file into memory and validate its header and size
+        /// \param filename: path of the map file
+        /// \throws std::runtime_error if the file cannot be mapped or is not a valid map file
+        MapFile(const std::string & filename);
+
+        /// \brief unmaps the file
+        ~MapFile();
+
+        MapFile(const MapFile &) = delete;
+        MapFile & operator=(const MapFile &) = delete;
+
+        /// \brief whether a file is mapped
+        /// \returns true if the accessors below may be used
+        bool is_open() const;
+
+        /// \brief return number of landmark slots n
+        /// \returns n
+        unsigned long int map_size() const;
+
+        /// \brief return number of initialized landmarks
+        /// \returns EKF::N at the time the map was saved
+        unsigned int seen() const;
+
+        /// \brief return the saved EKF State vector
+        /// \returns (3+2n) vector mapped onto the file
+        Eigen::Map<const Eigen::VectorXd> state() const;
+
+        /// \brief return the saved EKF covariance matrix
+        /// \returns (3+2n)*(3+2n) matrix mapped onto the file
+        Eigen::Map<const Eigen::MatrixXd> covariance() const;
+
+        /// \brief return the number of measurements incorporated for landmark j
+        /// \param j: index of landmark
+        /// \returns seen count
+        int seen_count(const unsigned long int & j) const;
+
+    private:
+        // Start and length of the mapping
+        void * data;
+        std::size_t length;
+        // Views into the mapping
+        const MapFileHeader * header;
+        const double * state_data;
+        const double * cov_data;
+        const std::int32_t * seen_data;
+    };
+
+    /// \brief return the size in bytes of a map file with n landmark slots
+    /// \param map_size: number of landmark slots n
+    /// \returns file size in bytes
+    std::size_t map_file_size(const unsigned long int & map_size);
+
+    /// \brief write a map file
+    /// \param filename: path of the map file, overwritten if it exists
+    /// \param state: EKF State vector (3+2n)
+    /// \param cov: EKF covariance matrix (3+2n)*(3+2n)
+    /// \param map_state: landmarks, whose seen_count is stored
+    /// \param seen: number of initialized landmarks
+    /// \throws std::runtime_error if the file cannot be written
+    void write_map_file(const std::string & filename, const Eigen::VectorXd & state,\
+                        const Eigen::MatrixXd & cov, const std::vector<Point> & map_state,\
+                        const unsigned int & seen);
+}
+
+#endif
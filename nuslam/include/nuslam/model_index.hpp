@@ -0,0 +1,74 @@
+#ifndef MODEL_INDEX_INCLUDE_GUARD_HPP
+#define MODEL_INDEX_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Library ModelIndex cached lookup of the robot and landmarks in gazebo_msgs::ModelStates name lists.
+#include <rigid2d/rigid2d.hpp>
+#include <string>
+#include <vector>
+
+namespace nuslam
+{
+    // Used to transform landmark positions
+    using rigid2d::Transform2D;
+    using rigid2d::Vector2D;
+
+    /// \brief index of the robot and of the landmarks (models whose name starts with a prefix) in a
+    /// ModelStates name list. ModelStates arrives at physics rate with the same list nearly every time,
+    /// so the list is only searched again when it changes: update() compares it with the list the
+    /// indices were built from, which is O(number of models) string comparisons and no allocation.
+    class ModelIndex
+    {
+    public:
+        /// \brief value of robot() when the robot is not in the list
+        static constexpr unsigned long int npos = static_cast<unsigned long int>(-1);
+
+        /// \brief the default constructor looks up "diff_drive" and the models starting with "cylinder"
+        ModelIndex();
+
+        /// \brief create an index with user-specified names
+        /// \param robot_name_: name of the robot model
+        /// \param landmark_prefix_: prefix of the landmark model names
+        ModelIndex(const std::string & robot_name_, const std::string & landmark_prefix_);
+
+        /// \brief re-validate the cached indices against a name list, and rebuild them if it changed
+        /// \param names: model names of one ModelStates message
+        /// \returns true if the indices were rebuilt
+        bool update(const std::vector<std::string> & names);
+
+        /// \brief return whether the robot is in the last name list
+        /// \returns true if robot() is valid
+        bool has_robot() const;
+
+        /// \brief return the index of the robot
+        /// \returns index, or npos if the robot is not in the list
+        unsigned long int robot() const;
+
+        /// \brief return the indices of the landmarks, in list order
+        /// \returns indices
+        const std::vector<unsigned long int> & landmarks() const;
+
+        /// \brief return the number of times the indices were rebuilt
+        /// \returns count
+        unsigned long int rebuilds() const;
+
+    private:
+        std::string robot_name;
+        std::string landmark_prefix;
+        unsigned long int robot_index;
+        std::vector<unsigned long int> landmark_indices;
+        // Name list the indices were built from
+        std::vector<std::string> list_names;
+        bool built;
+        unsigned long int rebuild_count;
+    };
+
+    /// \brief apply one transform to a batch of points, writing the results as separate x and y arrays
+    /// \param T: transform, e.g. from the world to the robot frame
+    /// \param x_in, y_in: coordinates of the points
+    /// \param x_out, y_out: resized to the number of points and overwritten with the transformed coordinates
+    /// \throws std::invalid_argument if x_in and y_in have different lengths
+    void transform_points(const Transform2D & T, const std::vector<double> & x_in, const std::vector<double> & y_in,\
+                          std::vector<double> & x_out, std::vector<double> & y_out);
+}
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef PATH_HISTORY_INCLUDE_GUARD_HPP
+#define PATH_HISTORY_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Library PathHistory bounded, decimated history of robot poses for path visualization.
+#include <rigid2d/rigid2d.hpp>
+#include <rigid2d/diff_drive.hpp>
+#include <vector>
+
+namespace nuslam
+{
+    // Used to store robot poses
+    using rigid2d::Pose2D;
+
+    struct PathSample
+    // Robot pose at a point in time
+    {
+        double stamp;
+        Pose2D pose;
+
+        // \brief constructor for PathSample with no inputs, initializes all to zero
+        PathSample();
+
+        // \brief constructor for PathSample with inputs
+        PathSample(const double & stamp_, const Pose2D & pose_);
+    };
+
+    /// \brief fixed-capacity ring buffer of poses, which only keeps a pose once the robot has moved
+    /// or turned far enough from the last kept one. Memory is allocated once at construction and
+    /// adding a pose is O(1), so the history can be fed at sensor rate for arbitrarily long runs;
+    /// when full, the oldest pose is overwritten.
+    class PathHistory
+    {
+    public:
+        /// \brief the default constructor creates a history of 10000 poses which keeps every pose
+        PathHistory();
+
+        /// \brief create a history with user-specified capacity and decimation
+        /// \param capacity_: maximum number of kept poses
+        /// \param min_distance_: distance (m) from the last kept pose above which a pose is kept
+        /// \param min_angle_: heading change (rad) from the last kept pose above which a pose is kept
+        /// \throws std::invalid_argument if capacity_ is 0
+        PathHistory(const unsigned long int & capacity_, const double & min_distance_, const double & min_angle_);
+
+        /// \brief offer a pose to the history. The first pose is always kept; afterwards a pose is kept
+        /// if it is at least min_distance away from, or min_angle turned from, the last kept pose
+        /// (every pose is kept if both are 0)
+        /// \param stamp: time of the pose (s)
+        /// \param pose: robot pose
+        /// \returns true if the pose was kept
+        bool add(const double & stamp, const Pose2D & pose);
+
+        /// \brief return the number of kept poses
+        /// \returns size, at most capacity()
+        unsigned long int size() const;
+
+        /// \brief return the maximum number of kept poses
+        /// \returns capacity
+        unsigned long int capacity() const;
+
+        /// \brief return the number of poses kept since construction or clear(), including those
+        /// since overwritten. The i-th kept pose (from 0) sits in slot i % capacity().
+        /// \returns count
+        unsigned long int total() const;
+
+        /// \brief return a kept pose
+        /// \param i: index from the oldest (0) to the newest (size() - 1) kept pose
+        /// \returns sample
+        /// \throws std::out_of_range if i >= size()
+        const PathSample & at(const unsigned long int & i) const;
+
+        /// \brief return the newest kept pose
+        /// \returns sample
+        /// \throws std::out_of_range if the history is empty
+        const PathSample & back() const;
+
+        /// \brief return the pose at a time, linearly interpolated between the kept poses on either side
+        /// of it, or the oldest/newest kept pose if the time is outside the history. Poses must have been
+        /// added in time order.
+        /// \param stamp: time (s)
+        /// \returns interpolated pose
+        /// \throws std::out_of_range if the history is empty
+        Pose2D interpolate(const double & stamp) const;
+
+        /// \brief remove every kept pose, keeping the storage
+        void clear();
+
+    private:
+        std::vector<PathSample> ring;
+        unsigned long int count;
+        double min_distance;
+        double min_angle;
+    };
+}
+
+#endif
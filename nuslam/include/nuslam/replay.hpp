@@ -0,0 +1,155 @@
+#ifndef REPLAY_INCLUDE_GUARD_HPP
+#define REPLAY_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Library Replay offline landmark detection and EKF SLAM over recorded sensor data.
+#include <rigid2d/rigid2d.hpp>
+#include <rigid2d/diff_drive.hpp>
+#include <nuslam/landmarks.hpp>
+#include <nuslam/ekf.hpp>
+#include <nuslam/trajectory_eval.hpp>
+#include <string>
+#include <vector>
+
+namespace nuslam
+{
+    // Used to store ground truth poses
+    using rigid2d::Pose2D;
+
+    struct ScanRecord
+    // Struct to store the fields of a sensor_msgs::LaserScan used for landmark detection
+    {
+        double stamp;
+        double angle_min, angle_max, angle_increment;
+        double time_increment;
+        double range_min, range_max;
+        std::vector<float> ranges;
+
+        // \brief constructor for ScanRecord with no inputs, initializes all to zero
+        ScanRecord();
+    };
+
+    struct JointRecord
+    // Struct to store left and right wheel angles (rad) from a sensor_msgs::JointState
+    {
+        double stamp;
+        double left, right;
+
+        // \brief constructor for JointRecord with no inputs, initializes all to zero
+        JointRecord();
+
+        // \brief constructor for JointRecord with inputs
+        JointRecord(const double & stamp_, const double & left_, const double & right_);
+    };
+
+    struct GroundTruthRecord
+    // Struct to store robot pose and landmark positions in the world frame from gazebo_msgs::ModelStates
+    {
+        double stamp;
+        Pose2D pose;
+        std::vector<Vector2D> landmarks;
+
+        // \brief constructor for GroundTruthRecord with no inputs, initializes all to zero
+        GroundTruthRecord();
+    };
+
+    struct Dataset
+    // Recorded sensor streams, each in increasing stamp order. Read-only during replay, so one
+    // Dataset may be shared by several replays running in parallel.
+    {
+        std::vector<ScanRecord> scans;
+        std::vector<JointRecord> joints;
+        std::vector<GroundTruthRecord> ground_truth;
+
+        /// \brief return the time spanned by the recorded streams
+        /// \returns duration (s)
+        double duration() const;
+    };
+
+    struct ReplayConfig
+    // Landmark detection and EKF parameters, defaulting to those of landmarks_node and slam
+    {
+        // landmarks_node
+        double threshold;
+        double max_radius;
+        bool deskew;
+        // diff drive robot, and pose of its lidar in the body frame for deskewing
+        double wheel_base, wheel_radius;
+        Pose2D scan_pose;
+        // slam
+        unsigned long int map_size;
+        double max_range;
+        double x_noise, y_noise, theta_noise;
+        double range_noise, bearing_noise;
+        double mahalanobis_lower, mahalanobis_upper;
+
+        // \brief constructor for ReplayConfig with the node defaults
+        ReplayConfig();
+    };
+
+    struct TrajectoryPoint
+    // EKF pose after a measurement update, and the ground truth pose at the same time
+    // expressed in the EKF map frame (the robot's initial pose)
+    {
+        double stamp;
+        Pose2D estimate;
+        Pose2D truth;
+        bool has_truth;
+
+        // \brief constructor for TrajectoryPoint with no inputs, initializes all to zero
+        TrajectoryPoint();
+    };
+
+    struct StageLatency
+    // Wall-clock durations (us) of one stage of the pipeline, one sample per invocation
+    {
+        std::string name;
+        std::vector<double> samples;
+
+        // \brief constructor for StageLatency with a stage name
+        StageLatency(const std::string & name_);
+
+        /// \brief return the p-th percentile of the samples
+        /// \param p: percentile between 0 and 100
+        /// \returns duration (us), or 0 if there are no samples
+        double percentile(const double & p) const;
+
+        /// \brief return the mean of the samples
+        /// \returns duration (us), or 0 if there are no samples
+        double mean() const;
+    };
+
+    struct ReplayResult
+    // Output of a replay
+    {
+        std::vector<TrajectoryPoint> trajectory;
+        std::vector<Point> map;
+        // Landmark positions from ground truth in the EKF map frame
+        std::vector<Vector2D> true_map;
+        // Per-stage latency: clustering (incl. deskew), circle fitting, EKF predict, EKF measurement update
+        StageLatency cluster, fit, predict, update;
+        // Wall-clock duration of the whole replay (s)
+        double wall_time;
+        // RMS position error of the trajectory against ground truth (m)
+        double pose_rmse;
+        // ATE and RPE of the trajectory against ground truth interpolated at each scan
+        TrajectoryErrorSummary trajectory_error;
+        // RMS distance from each mapped landmark to the nearest true landmark (m)
+        double landmark_rmse;
+        // Number of landmarks with at least one incorporated measurement
+        unsigned long int landmarks_mapped;
+
+        // \brief constructor for ReplayResult with no inputs, initializes all to zero
+        ReplayResult();
+    };
+
+    /// \brief run landmark detection and EKF SLAM over a dataset in stamp order, as fast as possible.
+    /// Joint states and scans are handled as in landmarks_node and slam: every scan runs the EKF
+    /// prediction from the latest wheel angles, if new ones arrived since the previous scan, followed
+    /// by the measurement update, and adds a trajectory point.
+    /// \param data: recorded sensor streams
+    /// \param config: landmark detection and EKF parameters
+    /// \returns trajectory, map, per-stage latency and errors against ground truth (if recorded)
+    ReplayResult replay(const Dataset & data, const ReplayConfig & config);
+}
+
+#endif
@@ -0,0 +1,161 @@
+#ifndef SCAN_CLOUD_INCLUDE_GUARD_HPP
+#define SCAN_CLOUD_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Library ScanCloud compact Structure-of-Arrays storage for the Points of one LaserScan and its clusters.
+#include <nuslam/landmarks.hpp>
+#include <nuslam/deskew.hpp>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+namespace nuslam
+{
+    /// \brief the Points of one LaserScan, stored as contiguous x, y, range and bearing arrays
+    /// (32 bytes per beam instead of a Point each), optionally grouped into clusters. Cluster i
+    /// holds the Points from offsets.at(i) up to, but excluding, offsets.at(i + 1). The arrays
+    /// are std::pmr vectors, so a cloud can live in a per-scan ScanArena.
+    class ScanCloud
+    {
+    public:
+        /// \brief the default constructor creates an empty cloud with no clusters, allocated from the heap
+        ScanCloud();
+
+        /// \brief create an empty cloud with no clusters, allocated from a memory resource
+        /// \param resource: memory resource used by the arrays, e.g. a ScanArena, which must outlive the cloud
+        ScanCloud(std::pmr::memory_resource * resource);
+
+        /// \brief reserve storage for n Points
+        /// \param n: number of Points
+        void reserve(const unsigned long int & n);
+
+        /// \brief remove every Point and cluster, keeping the storage
+        void clear();
+
+        /// \brief append a Point after the last one
+        /// \param point: Point whose pose and range_bear are stored
+        void push_back(const Point & point);
+
+        /// \brief return the number of Points
+        /// \returns number of Points
+        unsigned long int size() const;
+
+        /// \brief return the number of clusters
+        /// \returns number of clusters, 0 if the cloud has not been clustered
+        unsigned long int num_clusters() const;
+
+        /// \brief return the Point at an index
+        /// \param i: index of the Point
+        /// \returns Point with pose and range_bear set
+        Point point(const unsigned long int & i) const;
+
+        // Cartesian coordinates (m) of each Point
+        std::pmr::vector<double> x, y;
+        // Polar coordinates (m, rad) of each Point
+        std::pmr::vector<double> range, bearing;
+        // Index of the first Point of each cluster, followed by size()
+        std::pmr::vector<unsigned long int> offsets;
+    };
+
+    struct ScanWindow
+    // Region of a LaserScan in which a known landmark is expected, e.g. from an EKF measurement prediction
+    {
+        // Centre (rad) and half-width (rad) of the bearing interval
+        double bearing, half_width;
+        // Range interval (m)
+        double range_min, range_max;
+
+        // \brief constructor for ScanWindow with no inputs, initializes all to zero (an empty window)
+        ScanWindow();
+
+        // \brief constructor for ScanWindow around a predicted measurement
+        // \param predicted: expected range and bearing of the landmark centre
+        // \param sigma: standard deviation of the expected range and bearing
+        // \param gate: number of standard deviations included on each side
+        // \param margin: distance (m) added around the centre, at least the landmark radius
+        ScanWindow(const RangeBear & predicted, const RangeBear & sigma, const double & gate, const double & margin);
+
+        // \brief check if a bearing falls inside the bearing interval
+        // \param bearing: bearing (rad), with any wrapping
+        // \returns true if the bearing is inside the interval
+        bool covers(const double & bearing) const;
+
+        // \brief check if a Point falls inside the window
+        // \param range, bearing: polar coordinates of the Point
+        // \returns true if both are inside their intervals
+        bool contains(const double & range, const double & bearing) const;
+    };
+
+    /// \brief group consecutive LaserScan Points into clusters, merge the first and last clusters
+    /// if the scan wraps around, and discard clusters of 3 or fewer Points. Same result as
+    /// cluster_points, without copying a Landmark per cluster.
+    /// \param scan: Points of one LaserScan in beam order
+    /// \param threshold: range difference below which to consider two LIDAR points as belonging to one cluster
+    /// \returns Points of the kept clusters, cluster by cluster, with offsets set
+    ScanCloud cluster_scan(const ScanCloud & scan, const double & threshold);
+
+    /// \brief same as cluster_scan, writing into an existing cloud so that its memory resource is used
+    /// \param scan: Points of one LaserScan in beam order
+    /// \param threshold: range difference below which to consider two LIDAR points as belonging to one cluster
+    /// \param clusters: cleared, then filled with the Points of the kept clusters and their offsets
+    void cluster_scan(const ScanCloud & scan, const double & threshold, ScanCloud & clusters);
+
+    /// \brief mark the beams of a LaserScan whose bearing is inside at least one window, whatever their range,
+    /// so that the others can be skipped before they are converted to Points. Only the beams covered by a
+    /// window are visited.
+    /// \param windows: regions in which landmarks are expected
+    /// \param angle_min: bearing of the first beam (rad)
+    /// \param angle_increment: bearing between consecutive beams (rad); every beam is marked if it is not positive
+    /// \param num_beams: number of beams
+    /// \param mask: resized to num_beams, then set to 1 for the beams inside a window and 0 for the others
+    void window_beams(const std::vector<ScanWindow> & windows, const double & angle_min, const double & angle_increment,\
+                      const unsigned long int & num_beams, std::vector<std::uint8_t> & mask);
+
+    /// \brief convert the beams of a LaserScan to Points in beam order. Beams outside [range_min, range_max],
+    /// which includes inf and NaN, are skipped, as are the beams a mask leaves out. The bearing of beam i is
+    /// angle_min + i * angle_increment, so skipped beams do not shift the bearings of the following ones.
+    /// \param ranges: LaserScan ranges (m)
+    /// \param angle_min: bearing of the first beam (rad)
+    /// \param angle_increment: bearing between consecutive beams (rad)
+    /// \param range_min, range_max: valid range interval (m)
+    /// \param mask: if not null, only the beams set to 1 are converted, e.g. from window_beams
+    /// \param deskew: if not null, each Point is motion-compensated with it after start_scan
+    /// \param cloud: cleared, then filled with the Points
+    /// \throws std::invalid_argument if the mask does not have one entry per beam
+    void scan_points(const std::vector<float> & ranges, const double & angle_min, const double & angle_increment,\
+                     const double & range_min, const double & range_max, const std::vector<std::uint8_t> * mask,\
+                     Deskew * deskew, ScanCloud & cloud);
+
+    /// \brief same as cluster_scan, considering only the Points inside at least one window, so that the
+    /// clusters, and the circle fits which follow, only cover the regions where landmarks are expected.
+    /// A Point outside every window ends the current cluster, as do two consecutive Points which no
+    /// window contains both of, so the scan may also be given with only the Points whose bearing is inside
+    /// a window (see window_beams).
+    /// \param scan: Points of one LaserScan in beam order, or only those whose bearing is inside a window
+    /// \param threshold: range difference below which to consider two LIDAR points as belonging to one cluster
+    /// \param windows: regions in which to look for clusters, which may overlap
+    /// \param clusters: cleared, then filled with the Points of the kept clusters and their offsets
+    void cluster_windows(const ScanCloud & scan, const double & threshold, const std::vector<ScanWindow> & windows,\
+                         ScanCloud & clusters);
+
+    /// \brief fit a circle to each cluster and discard clusters whose radius is too large to be a landmark
+    /// \param clusters: clustered Points returned by cluster_scan
+    /// \param max_radius: radius above which a cluster is discarded (e.g. walls)
+    /// \returns vector of Landmark with the centre and radius of each kept cluster, and no Points
+    std::vector<Landmark> fit_clusters(const ScanCloud & clusters, const double & max_radius);
+
+    /// \brief same as fit_clusters, writing into an existing vector so that its memory resource is used
+    /// \param clusters: clustered Points returned by cluster_scan
+    /// \param max_radius: radius above which a cluster is discarded (e.g. walls)
+    /// \param landmarks: cleared, then filled with the centre and radius of each kept cluster
+    void fit_clusters(const ScanCloud & clusters, const double & max_radius, std::pmr::vector<Landmark> & landmarks);
+
+    /// \brief same as fit_clusters, also keeping the circle fitted to every cluster, including discarded ones
+    /// \param clusters: clustered Points returned by cluster_scan
+    /// \param max_radius: radius above which a cluster is discarded (e.g. walls)
+    /// \param landmarks: cleared, then filled with the centre and radius of each kept cluster
+    /// \param fits: cleared, then filled with the circle fitted to each cluster, in cluster order
+    void fit_clusters(const ScanCloud & clusters, const double & max_radius, std::pmr::vector<Landmark> & landmarks,\
+                      std::pmr::vector<CircleFit> & fits);
+}
+
+#endif
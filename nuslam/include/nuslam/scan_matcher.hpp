@@ -0,0 +1,93 @@
+#ifndef SCAN_MATCHER_INCLUDE_GUARD_HPP
+#define SCAN_MATCHER_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Library ScanMatcher branch-and-bound multi-resolution correlative scan-to-map matching.
+#include <rigid2d/rigid2d.hpp>
+#include <rigid2d/diff_drive.hpp>
+#include <nuslam/grid_map.hpp>
+#include <nuslam/scan_cloud.hpp>
+#include <cstdint>
+#include <vector>
+
+namespace nuslam
+{
+    // Used for the searched poses
+    using rigid2d::Pose2D;
+
+    struct ScanMatch
+    // Best pose found by a ScanMatcher
+    {
+        Pose2D pose;
+        // Mean occupancy probability (0 to 1) of the cells the scan's end points fall in at pose
+        double score;
+        // Number of candidates whose score was computed, at any resolution
+        unsigned long int evaluated;
+
+        // \brief constructor for ScanMatch with no inputs, initializes all to zero
+        ScanMatch();
+    };
+
+    /// \brief correlative scan matcher (Olson, "Real-Time Correlative Scan Matching", with Cartographer's
+    /// branch and bound). Finds the pose within a window around a guess whose scan end points fall on the
+    /// most occupied cells of a GridMap. set_map() precomputes one lookup grid per level d, where each cell
+    /// holds the maximum occupancy over the 2^d x 2^d cells it starts, so that the score of a level-d
+    /// candidate bounds the score of the 2^d x 2^d translations it stands for. Candidates are refined
+    /// best-first and any whose bound does not beat the best full-resolution score is pruned, giving the
+    /// same result as the exhaustive search while scoring a small fraction of the translations.
+    class ScanMatcher
+    {
+    public:
+        /// \brief the default constructor searches +-0.2 m and +-0.2 rad in steps of 0.01 rad
+        ScanMatcher();
+
+        /// \brief create a matcher with a user-specified search window
+        /// \param linear_window_: half-width of the translation window along x and y (m)
+        /// \param angular_window_: half-width of the rotation window (rad)
+        /// \param angular_step_: rotation step (rad), about the resolution over the maximum range
+        /// \throws std::invalid_argument if a window is negative or the step is not positive
+        ScanMatcher(const double & linear_window_, const double & angular_window_, const double & angular_step_);
+
+        /// \brief precompute the lookup grids from the current state of a map. Unknown cells score 0.
+        /// \param map: map to match against
+        void set_map(const GridMap & map);
+
+        /// \brief return whether set_map was called with a non-empty map
+        /// \returns true if match can be called
+        bool has_map() const;
+
+        /// \brief find the best pose of a scan within the search window
+        /// \param guess: pose of the sensor in the map frame from which the search starts, e.g. the EKF prediction
+        /// \param scan: end points of the beams in the sensor frame
+        /// \returns best pose and its score, or the guess with a score of 0 if the scan is empty
+        /// \throws std::logic_error if there is no map
+        ScanMatch match(const Pose2D & guess, const ScanCloud & scan) const;
+
+    private:
+        struct Candidate
+        // Translation offset (cells) at one rotation, standing for 2^level x 2^level offsets
+        {
+            std::int32_t x, y;
+            std::uint32_t rotation;
+            std::uint32_t level;
+            std::uint32_t score;
+        };
+
+        // Sum of the level grid over a discretized scan shifted by a candidate offset
+        std::uint32_t score(const Candidate & candidate, const std::vector<std::int32_t> & cells_x,\
+                            const std::vector<std::int32_t> & cells_y, const unsigned long int & n) const;
+
+        // Occupancy of the level grid at a cell, 0 outside the grid
+        std::uint8_t lookup(const std::uint32_t & level, const std::int32_t & cx, const std::int32_t & cy) const;
+
+        double linear_window, angular_window, angular_step;
+        // Number of levels above full resolution, so that 2^depth covers the translation window
+        std::uint32_t depth;
+        // Cells of the map, in cells
+        GridBounds map_bounds;
+        double res;
+        // Level d covers cells from map_bounds.min - (2^d - 1), so that every window overlapping the map is stored
+        std::vector<std::vector<std::uint8_t>> levels;
+    };
+}
+
+#endif
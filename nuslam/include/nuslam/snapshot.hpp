@@ -0,0 +1,73 @@
+#ifndef SNAPSHOT_INCLUDE_GUARD_HPP
+#define SNAPSHOT_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Library Snapshot lock-free exchange of the latest value between two threads.
+#include <atomic>
+#include <cstdint>
+
+namespace nuslam
+{
+    /// \brief wait-free triple buffer which lets one writer thread publish values and one
+    /// reader thread fetch the most recent of them, without either thread ever blocking.
+    /// The writer fills a private back buffer and swaps it with the shared middle buffer;
+    /// the reader swaps its private front buffer with the middle buffer only if it is newer.
+    template <typename T>
+    class Snapshot
+    {
+    public:
+        /// \brief the default constructor creates a Snapshot holding default-constructed values
+        Snapshot() : middle(1), front(0), back(2)
+        {
+        }
+
+        /// \brief construct Snapshot holding an initial value, returned by read() until the first write()
+        /// \param value: initial value
+        Snapshot(const T & value) : middle(1), front(0), back(2)
+        {
+            buffers[0] = value;
+            buffers[1] = value;
+            buffers[2] = value;
+        }
+
+        /// \brief publish a new value. Must only be called from the writer thread
+        /// \param value: value to publish
+        void write(const T & value)
+        {
+            buffers[back] = value;
+            back = middle.exchange(back | fresh, std::memory_order_acq_rel) & index;
+        }
+
+        /// \brief return the most recently published value. Must only be called from the reader thread
+        /// \returns reference to the latest value, valid until the next call to read()
+        const T & read()
+        {
+            if (middle.load(std::memory_order_relaxed) & fresh)
+            {
+                front = middle.exchange(front, std::memory_order_acq_rel) & index;
+            }
+            return buffers[front];
+        }
+
+        /// \brief whether a value has been published since the last read()
+        /// \returns true if read() will return a new value
+        bool updated() const
+        {
+            return middle.load(std::memory_order_relaxed) & fresh;
+        }
+
+    private:
+        // Bit layout of middle: buffer index in the low bits, fresh flag above them
+        static constexpr std::uint8_t index = 0x3;
+        static constexpr std::uint8_t fresh = 0x4;
+
+        T buffers[3];
+        // Shared between threads
+        std::atomic<std::uint8_t> middle;
+        // Owned by the reader
+        std::uint8_t front;
+        // Owned by the writer
+        std::uint8_t back;
+    };
+}
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef SWEEP_INCLUDE_GUARD_HPP
+#define SWEEP_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Library Sweep parallel evaluation of landmark detection and EKF parameters over one dataset.
+#include <nuslam/replay.hpp>
+#include <string>
+#include <vector>
+
+namespace nuslam
+{
+    struct SweepAxis
+    // One swept parameter: its name (as the ReplayConfig field) and the values to try
+    {
+        std::string name;
+        std::vector<double> values;
+
+        // \brief constructor for SweepAxis with inputs
+        SweepAxis(const std::string & name_, const std::vector<double> & values_);
+    };
+
+    struct SweepResult
+    // Errors of one configuration against ground truth
+    {
+        ReplayConfig config;
+        double pose_rmse;
+        double landmark_rmse;
+        unsigned long int landmarks_mapped;
+        // Wall-clock duration of the replay (s)
+        double wall_time;
+        // Ranking score, lower is better
+        double score;
+
+        // \brief constructor for SweepResult with no inputs, initializes all to zero
+        SweepResult();
+    };
+
+    /// \brief set the ReplayConfig field called name
+    /// \param config: configuration to modify
+    /// \param name: one of threshold, max_radius, max_range, x_noise, y_noise, theta_noise,
+    /// range_noise, bearing_noise, mahalanobis_lower, mahalanobis_upper
+    /// \param value: new value
+    /// \throws std::invalid_argument if name is not a sweepable field
+    void set_parameter(ReplayConfig & config, const std::string & name, const double & value);
+
+    /// \brief return the ReplayConfig field called name
+    /// \param config: configuration to read
+    /// \param name: one of the fields accepted by set_parameter
+    /// \returns value of the field
+    /// \throws std::invalid_argument if name is not a sweepable field
+    double get_parameter(const ReplayConfig & config, const std::string & name);
+
+    /// \brief return every combination of the axis values applied to a base configuration
+    /// \param base: values of the parameters which are not swept
+    /// \param axes: swept parameters
+    /// \returns cartesian product of the axes, the last axis varying fastest
+    /// \throws std::invalid_argument if an axis names an unknown parameter or has no values
+    std::vector<ReplayConfig> expand_grid(const ReplayConfig & base, const std::vector<SweepAxis> & axes);
+
+    /// \brief replay a dataset with each configuration, using several threads which share the
+    /// dataset read-only. Each replay reseeds its thread's random number generator with seed, so
+    /// every configuration sees the same process noise regardless of scheduling.
+    /// \param data: recorded sensor streams, with ground truth
+    /// \param configs: configurations to evaluate
+    /// \param threads: number of worker threads, 0 to use one per hardware thread
+    /// \param seed: random seed used for every replay
+    /// \returns one result per configuration, in the order of configs
+    std::vector<SweepResult> sweep(const Dataset & data, const std::vector<ReplayConfig> & configs,\
+                                   const unsigned int & threads, const unsigned int & seed);
+
+    /// \brief score each result as pose_rmse + landmark_weight * landmark_rmse and sort best first.
+    /// Configurations which map no landmarks are ranked last.
+    /// \param results: sweep results, reordered in place
+    /// \param landmark_weight: weight of the landmark error relative to the trajectory error
+    void rank_results(std::vector<SweepResult> & results, const double & landmark_weight);
+}
+
+#endif
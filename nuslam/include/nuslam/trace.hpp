@@ -0,0 +1,76 @@
+#ifndef TRACE_INCLUDE_GUARD_HPP
+#define TRACE_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Library Trace per-message hop times through the SLAM pipeline, keyed by the source sensor stamp.
+#include <nuslam/latency.hpp>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace nuslam
+{
+    struct TraceEvent
+    // A message reaching one hop of the pipeline
+    {
+        // Stamp (s) of the sensor message the event derives from, e.g. LaserScan header stamp
+        double source_stamp;
+        // Hop name, e.g. "scan_received"
+        std::string hop;
+        // Time (s) at which the hop was reached, in the same clock as source_stamp
+        double time;
+
+        // \brief constructor for TraceEvent with no inputs, initializes all to zero
+        TraceEvent();
+
+        // \brief constructor for TraceEvent with inputs
+        TraceEvent(const double & source_stamp_, const std::string & hop_, const double & time_);
+    };
+
+    /// \brief opt-in record of the hop times of recent messages. Keeps the last capacity events in
+    /// a ring buffer, and the age of each hop (time - source_stamp) in the latency registry under
+    /// "trace.<hop>", so end-to-end latency can be attributed to each stage.
+    class TraceLog
+    {
+    public:
+        /// \brief the default constructor creates a disabled TraceLog, for which record() does nothing
+        TraceLog();
+
+        /// \brief enable tracing
+        /// \param capacity_: number of most recent events to keep
+        void start(const unsigned long int & capacity_);
+
+        /// \brief whether tracing is enabled
+        /// \returns true after start()
+        bool enabled() const;
+
+        /// \brief record a hop. Safe to call from several threads; returns immediately if tracing is disabled.
+        /// \param source_stamp: stamp (s) of the sensor message the event derives from
+        /// \param hop: hop name
+        /// \param time: time (s) at which the hop was reached
+        void record(const double & source_stamp, const std::string & hop, const double & time);
+
+        /// \brief return the kept events, oldest first
+        /// \returns events
+        std::vector<TraceEvent> events() const;
+
+        /// \brief write the kept events to a CSV file (source_stamp, hop, time, age_ms)
+        /// \param filename: path of the file, overwritten if it exists
+        /// \throws std::runtime_error if the file cannot be written
+        void dump(const std::string & filename) const;
+
+    private:
+        mutable std::mutex mutex;
+        // Read without the lock, so record() costs nothing while tracing is disabled
+        std::atomic<bool> active;
+        unsigned long int capacity;
+        // Ring buffer, next is the slot written by the next record()
+        std::vector<TraceEvent> ring;
+        unsigned long int next;
+        // Age histogram of each hop
+        std::map<std::string, LatencyHistogram *> ages;
+    };
+}
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef TRAJECTORY_DIAGNOSTICS_INCLUDE_GUARD_HPP
+#define TRAJECTORY_DIAGNOSTICS_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Conversion of trajectory error summaries to diagnostic_msgs.
+/// Depends on ROS messages, so it is header-only and not part of nuslam_core.
+#include <nuslam/trajectory_eval.hpp>
+#include <diagnostic_msgs/DiagnosticStatus.h>
+#include <string>
+#include <vector>
+
+namespace nuslam
+{
+    /// \brief return a DiagnosticStatus with the ATE and RPE of one estimate stream
+    /// \param node_name: prefix of the status name and hardware_id, e.g. "visualizer"
+    /// \param stream: name of the estimate stream, e.g. "slam"
+    /// \param error: trajectory error of the stream
+    /// \returns status whose values are the count, rmse, p50, p90, p99 and max of each error
+    inline diagnostic_msgs::DiagnosticStatus trajectory_diagnostics(const std::string & node_name,\
+                                                                    const std::string & stream,\
+                                                                    const TrajectoryErrorSummary & error)
+    {
+        diagnostic_msgs::DiagnosticStatus status;
+        status.level = diagnostic_msgs::DiagnosticStatus::OK;
+        status.name = node_name + ": " + stream + " trajectory error";
+        status.hardware_id = node_name;
+        status.message = "ATE RMSE " + std::to_string(error.ate_trans.rmse) + " m";
+        const std::vector<std::pair<std::string, const ErrorSummary *>> errors = {
+            {"ate_m", &error.ate_trans}, {"ate_rad", &error.ate_rot},
+            {"rpe_m", &error.rpe_trans}, {"rpe_rad", &error.rpe_rot}};
+        diagnostic_msgs::KeyValue kv;
+        for (auto iter = errors.begin(); iter != errors.end(); iter++)
+        {
+            const ErrorSummary & summary = *iter->second;
+            const std::vector<std::pair<std::string, double>> fields = {
+                {"rmse", summary.rmse}, {"p50", summary.p50}, {"p90", summary.p90},
+                {"p99", summary.p99}, {"max", summary.max}};
+            kv.key = iter->first + "_count";
+            kv.value = std::to_string(summary.count);
+            status.values.push_back(kv);
+            for (auto field = fields.begin(); field != fields.end(); field++)
+            {
+                kv.key = iter->first + "_" + field->first;
+                kv.value = std::to_string(field->second);
+                status.values.push_back(kv);
+            }
+        }
+        return status;
+    }
+}
+
+#endif
@@ -0,0 +1,151 @@
+#ifndef TRAJECTORY_EVAL_INCLUDE_GUARD_HPP
+#define TRAJECTORY_EVAL_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Library TrajectoryEval online absolute and relative trajectory error against ground truth.
+#include <rigid2d/rigid2d.hpp>
+#include <rigid2d/diff_drive.hpp>
+#include <nuslam/latency.hpp>
+#include <nuslam/path_history.hpp>
+#include <deque>
+
+namespace nuslam
+{
+    // Used to align estimates with ground truth
+    using rigid2d::Transform2D;
+
+    struct ErrorSummary
+    // Statistics of one error stream, in the stream's units (m or rad)
+    {
+        unsigned long int count;
+        double rmse, mean, p50, p90, p99, max;
+
+        // \brief constructor for ErrorSummary with no inputs, initializes all to zero
+        ErrorSummary();
+    };
+
+    /// \brief streaming statistics of a non-negative error: exact count, RMSE, mean and max, and
+    /// percentiles within ~3% from a LatencyHistogram of the error in units of 1e-9 (nm or nrad).
+    /// Recording is O(1) with no allocation, and memory does not grow with the number of errors.
+    class ErrorStats
+    {
+    public:
+        /// \brief the default constructor creates empty statistics
+        ErrorStats();
+
+        ErrorStats(const ErrorStats &) = delete;
+        ErrorStats & operator=(const ErrorStats &) = delete;
+
+        /// \brief record one error
+        /// \param error: error (m or rad), negative values are recorded as their magnitude
+        void record(const double & error);
+
+        /// \brief return the number of recorded errors
+        /// \returns count
+        unsigned long int count() const;
+
+        /// \brief return the statistics of the recorded errors
+        /// \returns summary, all zero if empty
+        ErrorSummary summary() const;
+
+        /// \brief clear the statistics
+        void reset();
+
+    private:
+        LatencyHistogram hist;
+        unsigned long int n;
+        double sum, sum_sq, max_error;
+    };
+
+    struct AlignedPose
+    // Estimated pose, and the ground truth pose interpolated at the same time
+    {
+        double stamp;
+        Pose2D estimate;
+        Pose2D truth;
+
+        // \brief constructor for AlignedPose with no inputs, initializes all to zero
+        AlignedPose();
+    };
+
+    struct TrajectoryErrorSummary
+    // Absolute trajectory error (ATE) and relative pose error (RPE) of one estimate stream
+    {
+        // Position and heading error of each estimate
+        ErrorSummary ate_trans, ate_rot;
+        // Position and heading error of the motion over rpe_delta seconds ending at each estimate
+        ErrorSummary rpe_trans, rpe_rot;
+
+        // \brief constructor for TrajectoryErrorSummary with no inputs, initializes all to zero
+        TrajectoryErrorSummary();
+    };
+
+    /// \brief time-aligns an estimated pose stream (e.g. odometry or SLAM) with a ground truth stream
+    /// and accumulates the absolute trajectory error (ATE) and relative pose error (RPE) as poses arrive.
+    /// Each estimate is compared to the ground truth linearly interpolated at its stamp; estimates newer
+    /// than the latest ground truth wait until it catches up. Only truth_window seconds of ground truth
+    /// and rpe_delta seconds of aligned poses are kept, so each pose costs O(1) amortized and memory
+    /// does not grow with the length of the run.
+    class TrajectoryEvaluator
+    {
+    public:
+        /// \brief the default constructor keeps 1 s of ground truth, computes the RPE over 1 s and
+        /// compares the streams in the same frame
+        TrajectoryEvaluator();
+
+        /// \brief create an evaluator with user-specified windows
+        /// \param truth_window_: seconds of ground truth kept for interpolation, and longest time an
+        /// estimate waits for ground truth
+        /// \param rpe_delta_: time (s) over which the relative pose error is computed
+        /// \param align_first_: if true, estimates are expressed in the ground truth frame using the
+        /// first aligned pair, e.g. when the estimate starts at the origin; otherwise both streams are
+        /// assumed to be in the same frame
+        /// \throws std::invalid_argument if truth_window_ or rpe_delta_ is not positive
+        TrajectoryEvaluator(const double & truth_window_, const double & rpe_delta_, const bool & align_first_);
+
+        /// \brief add a ground truth pose, and evaluate the waiting estimates it brackets. Poses older
+        /// than the latest one are ignored.
+        /// \param stamp: time of the pose (s)
+        /// \param pose: ground truth pose
+        void add_truth(const double & stamp, const Pose2D & pose);
+
+        /// \brief add an estimated pose, evaluated now if ground truth brackets its stamp, later if it
+        /// is newer than the latest ground truth, or dropped if it is older than the kept ground truth
+        /// \param stamp: time of the pose (s)
+        /// \param pose: estimated pose
+        void add_estimate(const double & stamp, const Pose2D & pose);
+
+        /// \brief return the number of evaluated estimates
+        /// \returns count
+        unsigned long int count() const;
+
+        /// \brief return the most recently evaluated estimate
+        /// \returns estimate, in the ground truth frame, and interpolated ground truth
+        /// \throws std::out_of_range if no estimate has been evaluated
+        const AlignedPose & latest() const;
+
+        /// \brief return the statistics of every evaluated estimate
+        /// \returns ATE and RPE
+        TrajectoryErrorSummary summary() const;
+
+        /// \brief clear the streams and statistics, and the alignment
+        void reset();
+
+    private:
+        // Interpolate ground truth at a stamp bracketed by the kept samples, and accumulate the errors
+        void evaluate(const PathSample & estimate);
+
+        double truth_window;
+        double rpe_delta;
+        bool align_first;
+        bool aligned;
+        Transform2D T_truth_estimate;
+        std::deque<PathSample> truth;
+        std::deque<PathSample> pending;
+        // Aligned poses of the last rpe_delta seconds, for the RPE
+        std::deque<AlignedPose> recent;
+        unsigned long int evaluated;
+        ErrorStats ate_trans, ate_rot, rpe_trans, rpe_rot;
+    };
+}
+
+#endif
@@ -6,9 +6,15 @@
 ///   map (nuslam::TurtleMap): stores lists of x,y coordinates and radii of landmarks to publish
 ///   frequency (double): frequency of control loop.
 ///   frame_id_ (string): frame with respect to which landmark coordinates are published ("base_scan" here)
+///   world_map (nuslam::TurtleMap): stores lists of x,y coordinates and radii of landmarks in the world frame
+///   world_frame_id_ (string): frame with respect to which world landmark coordinates are published ("map" here)
+///   landmark_radius (double): radius published for every landmark
+///   model_index (nuslam::ModelIndex): cached indices of the robot and landmarks in the ModelStates name list
 ///
 /// PUBLISHES:
 ///   landmarks (nuslam::TurtleMap): publishes TurtleMap message containing landmark coordinates (x,y) and radii
+///   world_landmarks (nuslam::TurtleMap): publishes TurtleMap message containing world landmark coordinates (x,y) and radii,
+///   used as the known map by slam in localization-only mode
 ///
 /// SUBSCRIBES:
 ///   /gazebo/model_states (gazebo_msgs::ModelStates) to read robot and landmark Poses
@@ -31,6 +37,7 @@
 #include <functional>  // To use std::bind
 #include <algorithm>  // to use std::find_if
 #include "nuslam/landmarks.hpp"
+#include "nuslam/model_index.hpp"
 
 #include <tf2/LinearMath/Quaternion.h>
 #include <tf2/LinearMath/Matrix3x3.h>
@@ -39,8 +46,11 @@
 // Global Vars
 bool callback_flag = false;
 nuslam::TurtleMap map;
+nuslam::TurtleMap world_map;
 std::string landmark_name = "cylinder";
 std::string robot_name = "diff_drive";
+double landmark_radius = 0.12;
+nuslam::ModelIndex model_index(robot_name, landmark_name);
 
 
 void gazebo_callback(const gazebo_msgs::ModelStates &model)
@@ -51,54 +61,38 @@ void gazebo_callback(const gazebo_msgs::ModelStates &model)
   /// \param gazebo_msgs::ModelStates, containing the pose of all
   /// models in the environment
 
-  // First, find current Diff Drive Robot Pose
-  auto dd_it = std::find(model.name.begin(), model.name.end(), robot_name);
-  auto dd_index = std::distance(model.name.begin(), dd_it);
-  geometry_msgs::Pose dd_pose = model.pose.at(dd_index);
-
-  // Used to populate TurtleMap msg
-  std::vector<double> radii;
-  std::vector<double> x_pts;
-  std::vector<double> y_pts;
+  // Robot and "cylinder" indices are only searched for again when the model list changes
+  model_index.update(model.name);
+  if (!model_index.has_robot())
+  {
+    return;
+  }
 
-  auto it = model.name.begin();
-  // Find all instances of "cylinder" as the first 8 characters and push back into list of landmarks for TurtleMap
-  while ((it = std::find_if(it, model.name.end(), [](std::string model_name){return !model_name.find(landmark_name); })) < model.name.end())
+  // Current Diff Drive Robot Pose, as the transform from the world to the robot
+  const geometry_msgs::Pose &dd_pose = model.pose.at(model_index.robot());
+  auto roll = 0.0, pitch = 0.0, yaw = 0.0;
+  tf2::Quaternion quat(dd_pose.orientation.x,\
+                       dd_pose.orientation.y,\
+                       dd_pose.orientation.z,\
+                       dd_pose.orientation.w);
+  tf2::Matrix3x3 mat(quat);
+  mat.getRPY(roll, pitch, yaw);
+  rigid2d::Transform2D T_robot_world = rigid2d::Transform2D(rigid2d::Vector2D(dd_pose.position.x, dd_pose.position.y), yaw).inv();
+
+  // Landmark positions in the world frame, reusing the message storage
+  const std::vector<unsigned long int> &landmarks = model_index.landmarks();
+  world_map.x_pts.resize(landmarks.size());
+  world_map.y_pts.resize(landmarks.size());
+  for (unsigned long int i = 0; i < landmarks.size(); i++)
   {
-      // Find pose of landmark relative to Diff Drive Robot and store in map
-      // std::cout << "NAME: " << *it << std::endl;
-      auto index = std::distance(model.name.begin(), it);
-      double x_pos = model.pose.at(index).position.x - dd_pose.position.x;
-      double y_pos = model.pose.at(index).position.y - dd_pose.position.y;
-      rigid2d::Vector2D lnd_pose = rigid2d::Vector2D(x_pos, y_pos);
-      nuslam::Point lnd_pt = nuslam::Point(lnd_pose);
-      // Adjust r,b for rotation
-      auto roll = 0.0, pitch = 0.0, yaw = 0.0;
-      tf2::Quaternion quat(dd_pose.orientation.x,\
-                           dd_pose.orientation.y,\
-                           dd_pose.orientation.z,\
-                           dd_pose.orientation.w);
-      tf2::Matrix3x3 mat(quat);
-      mat.getRPY(roll, pitch, yaw);
-      lnd_pt.range_bear.bearing -= yaw;
-      nuslam::Point adjusted_landmark = nuslam::Point(lnd_pt.range_bear);
-      double radius = 0.12;
-
-      // Populate Vectors
-      radii.push_back(radius);
-      x_pts.push_back(adjusted_landmark.pose.x);
-      y_pts.push_back(adjusted_landmark.pose.y);
-
-      it++;
+    world_map.x_pts[i] = model.pose.at(landmarks[i]).position.x;
+    world_map.y_pts[i] = model.pose.at(landmarks[i]).position.y;
   }
+  world_map.radii.assign(landmarks.size(), landmark_radius);
 
-  // Popoulate TurtleMap msg
-  map.radii.clear();
-  map.radii = radii;
-  map.x_pts.clear();
-  map.x_pts = x_pts;
-  map.y_pts.clear();
-  map.y_pts = y_pts;
+  // Landmark positions relative to Diff Drive Robot, in one pass
+  nuslam::transform_points(T_robot_world, world_map.x_pts, world_map.y_pts, map.x_pts, map.y_pts);
+  map.radii.assign(landmarks.size(), landmark_radius);
 
   callback_flag = true;
 }
@@ -111,6 +105,7 @@ int main(int argc, char** argv)
 
   double frequency = 60.0;
   std::string frame_id_ = "base_scan";
+  std::string world_frame_id_ = "map";
 
   ros::init(argc, argv, "analysis"); // register the node on ROS
   ros::NodeHandle nh; // get a handle to ROS
@@ -118,12 +113,15 @@ int main(int argc, char** argv)
   // Parameters
   nh_.getParam("frequency", frequency);
   nh_.getParam("landmark_frame_id", frame_id_);
+  nh_.getParam("world_frame_id", world_frame_id_);
 
   // Publish TurtleMap data wrt this frame
   map.header.frame_id = frame_id_;
+  world_map.header.frame_id = world_frame_id_;
 
   // Init Publishers
   ros::Publisher landmark_pub = nh_.advertise<nuslam::TurtleMap>("landmarks", 1);
+  ros::Publisher world_landmark_pub = nh_.advertise<nuslam::TurtleMap>("world_landmarks", 1);
 
   // Init ModelState Subscriber
   ros::Subscriber gzb_sub = nh.subscribe("/gazebo/model_states", 1, gazebo_callback);
@@ -139,6 +137,8 @@ int main(int argc, char** argv)
     {
       map.header.stamp = ros::Time::now();
       landmark_pub.publish(map);
+      world_map.header.stamp = map.header.stamp;
+      world_landmark_pub.publish(world_map);
       callback_flag = false;
     }
 
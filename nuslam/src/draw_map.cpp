@@ -6,19 +6,26 @@
 ///   global_map (nuslam::TurtleMap): stores lists of x,y coordinates and radii of landmarks to publish
 ///   frequency (double): frequency of control loop.
 ///   color (string): "gazebo", "scan", or "slam" determines color and size of markers for clarity
+///   batch (bool): if true, publishes every landmark of a map update in one MarkerArray, otherwise one Marker each
+///   markers (visualization_msgs::MarkerArray): reused batch of markers, one per landmark plus deletions
+///   num_drawn (unsigned long): number of landmarks in the last published batch, whose markers are deleted if they vanish
 ///
 /// PUBLISHES:
-///   scan/marker (visualization_msgs::Marker): publishes markers to indicate detected landmark positions
+///   scan/marker (visualization_msgs::Marker): publishes markers to indicate detected landmark positions (batch false)
+///   scan/markers (visualization_msgs::MarkerArray): publishes one marker array per map update (batch true)
 ///
 /// SUBSCRIBES:
 ///   /landmarks_node/landmarks (nuslam::TurtleMap), stores lists of x,y coordinates and radii of detected landmarks
 ///
 /// FUNCTIONS:
 ///   mapCallback (void): callback for /landmarks_node/landmarks subscriber, which stores TurtleMap data for exraction
+///   fill_marker (void): sets the id, position and size of a marker from one landmark
+///   fill_batch (void): fills the marker array from the stored map, deleting markers of vanished landmarks
 
 #include <ros/ros.h>
 #include <std_srvs/Empty.h>
 #include <visualization_msgs/Marker.h>
+#include <visualization_msgs/MarkerArray.h>
 #include <sensor_msgs/LaserScan.h>
 
 #include <math.h>
@@ -30,11 +37,12 @@
 #include "nuslam/TurtleMap.h"
 
 #include <functional>  // To use std::bind
-#include <visualization_msgs/Marker.h>
 
 // GLOBAL VARS
 bool callback_flag = false;
 nuslam::TurtleMap global_map;
+visualization_msgs::MarkerArray markers;
+unsigned long int num_drawn = 0;
 
 void mapCallback(const nuslam::TurtleMap &map)
 {
@@ -47,6 +55,53 @@ void mapCallback(const nuslam::TurtleMap &map)
   callback_flag = true;
 }
 
+void fill_marker(const unsigned long int &i, visualization_msgs::Marker &marker)
+{
+  /// \brief set the id, pose and size of a marker from a landmark of the stored map
+  /// \param i: index of the landmark, used as the marker id so that each landmark keeps its marker
+  /// \param marker: marker whose type, colour and height are already set
+  marker.id = i;
+  // Set the pose of the marker.
+  // This is a 6DOF pose wrt frame/time specified in the header
+  marker.pose.position.x = global_map.x_pts.at(i);
+  marker.pose.position.y = global_map.y_pts.at(i);
+  marker.pose.position.z = marker.scale.z / 2.0; // height
+  marker.pose.orientation.x = 0.0;
+  marker.pose.orientation.y = 0.0;
+  marker.pose.orientation.z = 0.0;
+  marker.pose.orientation.w = 1.0;
+  // Set the scale of the marker -- 1x1x1 here means 1m on a side
+  marker.scale.x = global_map.radii.at(i);
+  marker.scale.y = global_map.radii.at(i);
+  marker.lifetime = ros::Duration(0.5);
+}
+
+void fill_batch(const visualization_msgs::Marker &marker)
+{
+  /// \brief fill the marker array with one marker per landmark of the stored map, followed by a DELETE
+  /// for each landmark of the previous batch which is no longer in the map
+  /// \param marker: marker whose header, type, colour and height are already set
+  unsigned long int num_landmarks = global_map.radii.size();
+  unsigned long int num_deleted = num_drawn > num_landmarks ? num_drawn - num_landmarks : 0;
+  // Resizing keeps the capacity, so the markers keep their storage between updates
+  markers.markers.resize(num_landmarks + num_deleted, marker);
+  for (unsigned long int i = 0; i < num_landmarks; i++)
+  {
+    visualization_msgs::Marker &m = markers.markers[i];
+    m = marker;
+    fill_marker(i, m);
+  }
+  for (unsigned long int i = 0; i < num_deleted; i++)
+  {
+    visualization_msgs::Marker &m = markers.markers[num_landmarks + i];
+    m.header = marker.header;
+    m.ns = marker.ns;
+    m.id = num_landmarks + i;
+    m.action = visualization_msgs::Marker::DELETE;
+  }
+  num_drawn = num_landmarks;
+}
+
 int main(int argc, char** argv)
 /// The Main Function ///
 {
@@ -54,6 +109,7 @@ int main(int argc, char** argv)
   // Vars
   double frequency = 60.0;
   std::string color = "scan";
+  bool batch = true;
 
   ros::init(argc, argv, "draw_map_node"); // register the node on ROS
   ros::NodeHandle nh; // get a handle to ROS
@@ -61,9 +117,17 @@ int main(int argc, char** argv)
   // Parameters
   nh_.getParam("frequency", frequency);
   nh_.getParam("color", color);
+  nh_.getParam("batch", batch);
 
-  // Init Marker Publisher
-  ros::Publisher marker_pub = nh.advertise<visualization_msgs::Marker>("scan/marker", 1);
+  // Init Marker Publishers
+  ros::Publisher marker_pub;
+  ros::Publisher markers_pub;
+  if (batch)
+  {
+    markers_pub = nh.advertise<visualization_msgs::MarkerArray>("scan/markers", 1);
+  } else {
+    marker_pub = nh.advertise<visualization_msgs::Marker>("scan/marker", 1);
+  }
 
   // Init Marker
   visualization_msgs::Marker marker;
@@ -118,27 +182,18 @@ int main(int argc, char** argv)
       marker.header.frame_id = global_map.header.frame_id;
       marker.header.stamp = ros::Time::now();
 
-      // Populate Marker information for each landmark
-      // std::cout << "------------------------------------------" << std::endl;
-      for (long unsigned int i = 0; i < global_map.radii.size(); i++)
+      if (batch)
       {
-        marker.id = i;
-        // Set the pose of the marker.
-        // This is a 6DOF pose wrt frame/time specified in the header
-        marker.pose.position.x = global_map.x_pts.at(i);
-        marker.pose.position.y = global_map.y_pts.at(i);
-        marker.pose.position.z = marker.scale.z / 2.0; // height
-        marker.pose.orientation.x = 0.0;
-        marker.pose.orientation.y = 0.0;
-        marker.pose.orientation.z = 0.0;
-        marker.pose.orientation.w = 1.0;
-        // Set the scale of the marker -- 1x1x1 here means 1m on a side
-        marker.scale.x = global_map.radii.at(i);
-        marker.scale.y = global_map.radii.at(i);
-        marker.lifetime = ros::Duration(0.5);
-        // std::cout << "POS: (" << global_map.x_pts.at(i) << ", " << global_map.y_pts.at(i) << ")" << std::endl;
-        marker_pub.publish(marker);
-
+        // One message per map update
+        fill_batch(marker);
+        markers_pub.publish(markers);
+      } else {
+        // Populate Marker information for each landmark
+        for (long unsigned int i = 0; i < global_map.radii.size(); i++)
+        {
+          fill_marker(i, marker);
+          marker_pub.publish(marker);
+        }
       }
       callback_flag = false;
     }
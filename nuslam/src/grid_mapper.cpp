@@ -0,0 +1,252 @@
+/// \file
+/// \brief Builds a dense occupancy grid from LaserScans placed at the EKF SLAM pose, alongside the landmark map
+///
+/// PARAMETERS:
+///   grid (nuslam::GridMap): tiled log-odds occupancy grid, grown on demand
+///   slam_poses (nuslam::PathHistory): recent robot poses estimated by slam, in the map frame, which are
+///   interpolated to the stamp of each scan. Scans are dropped until a pose is received.
+///   T_base_scan (rigid2d::Transform2D): pose of the lidar in the robot frame, looked up once at startup
+///   scan_cloud (nuslam::ScanCloud): reused end points of the beams of one LaserScan which hit an obstacle
+///   scan_flag (bool): specifies whether a scan was inserted since the last publication
+///   map_frame_id (string): frame of the grid, the frame of slam/odom
+///   body_frame_id (string): robot frame, the child frame of slam/odom
+///   scan_frame_id (string): lidar frame
+///   tf_timeout (double): seconds to wait at startup for the body_frame_id to scan_frame_id transform
+///   resolution (double): side of a grid cell (m)
+///   p_hit, p_miss (double): occupancy probability of a cell a beam ended in or crossed
+///   p_min, p_max (double): bounds on the occupancy probability of a cell
+///   clear_max_range (bool): whether beams beyond range_max clear the cells up to range_max
+///   frequency (double): frequency of control loop, and maximum rate of grid publication
+///   full_period (double): period (s) at which the whole grid is republished, 0 to only publish it when it grows
+///
+/// PUBLISHES:
+///   map (nav_msgs::OccupancyGrid): the whole grid, latched, published when it grows and every full_period
+///   map_updates (map_msgs::OccupancyGridUpdate): one update per tile changed since the last publication
+///
+/// SUBSCRIBES:
+///   /scan (sensor_msgs::LaserScan), beams inserted into the grid from the lidar at the SLAM pose of the scan
+///   slam/odom (nav_msgs::Odometry), robot pose estimated by slam
+///
+/// FUNCTIONS:
+///   odom_callback (void): callback for slam/odom subscriber, which records the SLAM pose
+///   scan_callback (void): callback for /scan subscriber, which traces every beam of the scan into the grid
+///   fill_grid (void): copies the whole grid into an OccupancyGrid message
+///   fill_update (void): copies one tile of the grid into an OccupancyGridUpdate message
+
+#include <ros/ros.h>
+#include <nav_msgs/Odometry.h>
+#include <nav_msgs/OccupancyGrid.h>
+#include <map_msgs/OccupancyGridUpdate.h>
+#include <sensor_msgs/LaserScan.h>
+#include <tf2/LinearMath/Quaternion.h>
+#include <tf2/LinearMath/Matrix3x3.h>
+#include <tf2_ros/buffer.h>
+#include <tf2_ros/transform_listener.h>
+
+#include <math.h>
+#include <string>
+#include <vector>
+
+#include "nuslam/grid_map.hpp"
+#include "nuslam/scan_cloud.hpp"
+#include "nuslam/path_history.hpp"
+#include "rigid2d/diff_drive.hpp"
+
+// GLOBAL VARS
+nuslam::GridMap grid;
+// Every pose is kept, several seconds of slam/odom
+nuslam::PathHistory slam_poses(1000, 0.0, 0.0);
+rigid2d::Transform2D T_base_scan;
+nuslam::ScanCloud scan_cloud;
+bool scan_flag = false;
+bool clear_max_range = true;
+
+void odom_callback(const nav_msgs::Odometry &odom)
+{
+  /// \brief record the SLAM pose at its stamp
+  /// \param nav_msgs::Odometry, pose of the robot in the map frame
+  auto roll = 0.0, pitch = 0.0, yaw = 0.0;
+  tf2::Quaternion quat(odom.pose.pose.orientation.x,\
+                       odom.pose.pose.orientation.y,\
+                       odom.pose.pose.orientation.z,\
+                       odom.pose.pose.orientation.w);
+  tf2::Matrix3x3 mat(quat);
+  mat.getRPY(roll, pitch, yaw);
+  slam_poses.add(odom.header.stamp.toSec(), rigid2d::Pose2D(odom.pose.pose.position.x, odom.pose.pose.position.y, yaw));
+}
+
+void scan_callback(const sensor_msgs::LaserScan &lsr)
+{
+  /// \brief trace every beam of a LaserScan into the grid from the lidar, at the SLAM pose of the scan
+  /// \param sensor_msgs::LaserScan, whose beams that hit an obstacle mark their end cell as occupied
+  if (slam_poses.size() == 0)
+  {
+    return;
+  }
+
+  // Lidar pose in the map frame when the scan was taken
+  const rigid2d::Pose2D base = slam_poses.interpolate(lsr.header.stamp.toSec());
+  const rigid2d::Transform2DS disp = (rigid2d::Transform2D(rigid2d::Vector2D(base.x, base.y), base.theta) * T_base_scan).displacement();
+  const rigid2d::Pose2D scan_pose(disp.x, disp.y, disp.theta);
+
+  scan_cloud.clear();
+  scan_cloud.reserve(lsr.ranges.size());
+  const rigid2d::Vector2D sensor(scan_pose.x, scan_pose.y);
+  for (unsigned long int i = 0; i < lsr.ranges.size(); i++)
+  {
+    double range = lsr.ranges.at(i);
+    double bearing = lsr.angle_min + i * lsr.angle_increment;
+    if (range >= lsr.range_min && range <= lsr.range_max)
+    {
+      scan_cloud.push_back(nuslam::Point(nuslam::RangeBear(range, bearing)));
+    } else if (clear_max_range && range > lsr.range_max) {
+      // Nothing within range_max: the beam is free up to range_max
+      double heading = scan_pose.theta + bearing;
+      rigid2d::Vector2D end(scan_pose.x + lsr.range_max * cos(heading), scan_pose.y + lsr.range_max * sin(heading));
+      grid.insert_ray(sensor, end, false);
+    }
+  }
+  grid.insert_scan(scan_pose, scan_cloud);
+  scan_flag = true;
+}
+
+void fill_grid(nav_msgs::OccupancyGrid &msg)
+{
+  /// \brief copy the whole grid into an OccupancyGrid, reusing its data array
+  /// \param msg: message whose header frame is already set
+  const nuslam::GridBounds bounds = grid.bounds();
+  msg.info.resolution = grid.resolution();
+  msg.info.width = bounds.width;
+  msg.info.height = bounds.height;
+  msg.info.origin.position.x = bounds.min_x * grid.resolution();
+  msg.info.origin.position.y = bounds.min_y * grid.resolution();
+  msg.info.origin.orientation.w = 1.0;
+  grid.export_grid(msg.data);
+}
+
+void fill_update(const std::uint32_t &tile, const nuslam::GridBounds &map_bounds, map_msgs::OccupancyGridUpdate &msg)
+{
+  /// \brief copy one tile into an OccupancyGridUpdate, reusing its data array
+  /// \param tile: index of a dirty tile
+  /// \param map_bounds: bounds of the last published OccupancyGrid, which the update is relative to
+  /// \param msg: message whose header frame is already set
+  const nuslam::GridBounds bounds = grid.tile_bounds(tile);
+  msg.x = bounds.min_x - map_bounds.min_x;
+  msg.y = bounds.min_y - map_bounds.min_y;
+  msg.width = bounds.width;
+  msg.height = bounds.height;
+  grid.export_tile(tile, msg.data);
+}
+
+int main(int argc, char** argv)
+/// The Main Function ///
+{
+  ROS_INFO("STARTING NODE: grid_mapper");
+
+  double frequency = 10.0;
+  std::string map_frame_id_ = "map";
+  std::string body_frame_id_ = "base_footprint";
+  std::string scan_frame_id_ = "base_scan";
+  double tf_timeout_ = 5.0;
+  double resolution_ = 0.05, p_hit_ = 0.7, p_miss_ = 0.4, p_min_ = 0.12, p_max_ = 0.97;
+  double full_period_ = 10.0;
+
+  ros::init(argc, argv, "grid_mapper"); // register the node on ROS
+  ros::NodeHandle nh; // get a handle to ROS
+  ros::NodeHandle nh_("~"); // get a handle to ROS
+  // Parameters
+  nh_.getParam("frequency", frequency);
+  nh_.getParam("map_frame_id", map_frame_id_);
+  nh_.getParam("body_frame_id", body_frame_id_);
+  nh_.getParam("scan_frame_id", scan_frame_id_);
+  nh_.getParam("tf_timeout", tf_timeout_);
+  nh_.getParam("resolution", resolution_);
+  nh_.getParam("p_hit", p_hit_);
+  nh_.getParam("p_miss", p_miss_);
+  nh_.getParam("p_min", p_min_);
+  nh_.getParam("p_max", p_max_);
+  nh_.getParam("clear_max_range", clear_max_range);
+  nh_.getParam("full_period", full_period_);
+
+  try
+  {
+    grid = nuslam::GridMap(resolution_, p_hit_, p_miss_, p_min_, p_max_);
+  } catch (const std::invalid_argument & e)
+  {
+    ROS_ERROR("grid_mapper: %s Using the default grid.", e.what());
+  }
+
+  // The lidar is fixed to the robot, so its pose is only looked up once
+  tf2_ros::Buffer tf_buffer;
+  tf2_ros::TransformListener tf_listener(tf_buffer);
+  try
+  {
+    geometry_msgs::TransformStamped base_scan = tf_buffer.lookupTransform(body_frame_id_, scan_frame_id_, ros::Time(0),\
+                                                                          ros::Duration(tf_timeout_));
+    auto roll = 0.0, pitch = 0.0, yaw = 0.0;
+    tf2::Quaternion quat(base_scan.transform.rotation.x,\
+                         base_scan.transform.rotation.y,\
+                         base_scan.transform.rotation.z,\
+                         base_scan.transform.rotation.w);
+    tf2::Matrix3x3 mat(quat);
+    mat.getRPY(roll, pitch, yaw);
+    T_base_scan = rigid2d::Transform2D(rigid2d::Vector2D(base_scan.transform.translation.x, base_scan.transform.translation.y), yaw);
+  } catch (const tf2::TransformException & e)
+  {
+    ROS_WARN("grid_mapper: %s. Assuming %s is at the origin of %s.", e.what(), scan_frame_id_.c_str(), body_frame_id_.c_str());
+  }
+
+  // Init Publishers: late subscribers get the last full grid, then follow the updates
+  ros::Publisher map_pub = nh_.advertise<nav_msgs::OccupancyGrid>("map", 1, true);
+  ros::Publisher update_pub = nh_.advertise<map_msgs::OccupancyGridUpdate>("map_updates", 100);
+
+  // Init Subscribers
+  ros::Subscriber odom_sub = nh.subscribe("slam/odom", 1, odom_callback);
+  ros::Subscriber lsr_sub = nh.subscribe("/scan", 1, scan_callback);
+
+  nav_msgs::OccupancyGrid map_msg;
+  map_msg.header.frame_id = map_frame_id_;
+  map_msgs::OccupancyGridUpdate update_msg;
+  update_msg.header.frame_id = map_frame_id_;
+  nuslam::GridBounds published;
+  ros::Time last_full = ros::Time(0);
+
+  ros::Rate rate(frequency);
+
+  // Main While
+  while (ros::ok())
+  {
+    ros::spinOnce();
+
+    if (scan_flag)
+    {
+      ros::Time now = ros::Time::now();
+      const nuslam::GridBounds bounds = grid.bounds();
+      bool grown = bounds.min_x != published.min_x || bounds.min_y != published.min_y ||\
+                   bounds.width != published.width || bounds.height != published.height;
+      if (grown || (full_period_ > 0.0 && (now - last_full).toSec() >= full_period_))
+      {
+        // Updates are relative to the published grid, so a grid which grew is sent whole
+        map_msg.header.stamp = now;
+        fill_grid(map_msg);
+        map_pub.publish(map_msg);
+        published = bounds;
+        last_full = now;
+      } else {
+        update_msg.header.stamp = now;
+        const std::vector<std::uint32_t> & dirty = grid.dirty_tiles();
+        for (auto iter = dirty.begin(); iter != dirty.end(); iter++)
+        {
+          fill_update(*iter, published, update_msg);
+          update_pub.publish(update_msg);
+        }
+      }
+      grid.clear_dirty();
+      scan_flag = false;
+    }
+
+    rate.sleep();
+  }
+
+  return 0;
+}
@@ -0,0 +1,227 @@
+/// \file
+/// \brief Estimates the robot's motion by registering consecutive LaserScans with ICP, independently of the wheels
+///
+/// PARAMETERS:
+///   icp (nuslam::Icp): registration of each scan against the keyframe scan
+///   scan_cloud (nuslam::ScanCloud): end points of the latest LaserScan, reused across callbacks
+///   keyframe_pose (rigid2d::Pose2D): pose of the keyframe scan in the odometry frame
+///   motion (rigid2d::Pose2D): pose of the latest scan relative to the keyframe, the guess for the next one
+///   has_keyframe (bool): specifies whether a keyframe was set
+///   keyframe_distance (double): translation (m) from the keyframe after which the latest scan becomes the keyframe
+///   keyframe_angle (double): rotation (rad) from the keyframe after which the latest scan becomes the keyframe
+///   min_correspondences (int): number of correspondences below which a registration is rejected
+///   metric (string): "line" for point-to-line or "point" for point-to-point ICP
+///   max_iterations (int), max_distance (double), tolerance (double): ICP settings, see icp.hpp
+///   odom_frame_id (string): frame of the published odometry
+///   body_frame_id (string): frame of the robot, assumed to coincide with the laser's
+///   odom (nav_msgs::Odometry): published odometry, stamped with the LaserScan it was computed from
+///   diagnostics_period (double): seconds between latency diagnostics, 0 to disable
+///   latency_file (string): if set, the latency histograms are written to this file on shutdown
+///
+/// PUBLISHES:
+///   odom (nav_msgs::Odometry): pose of the robot in the odometry frame, one per registered scan
+///   /diagnostics (diagnostic_msgs::DiagnosticArray): p50/p90/p99/max latency of the scan callback and registration
+///
+/// SUBSCRIBES:
+///   /scan (sensor_msgs::LaserScan), registered against the keyframe scan
+///
+/// FUNCTIONS:
+///   to_transform (rigid2d::Transform2D): converts a pose to a transform
+///   scan_callback (void): callback for /scan subscriber, which registers the scan and updates the odometry
+///   diagnostics_callback (void): timer callback which publishes the latency diagnostics
+
+#include <ros/ros.h>
+#include <nav_msgs/Odometry.h>
+#include <sensor_msgs/LaserScan.h>
+#include <tf2/LinearMath/Quaternion.h>
+#include <tf2_geometry_msgs/tf2_geometry_msgs.h>
+
+#include <math.h>
+#include <string>
+#include <algorithm>  // to use std::max
+
+#include "nuslam/icp.hpp"
+#include "nuslam/scan_cloud.hpp"
+#include "nuslam/latency.hpp"
+#include "nuslam/latency_diagnostics.hpp"
+#include "rigid2d/rigid2d.hpp"
+#include "rigid2d/diff_drive.hpp"
+
+// GLOBAL VARS
+nuslam::Icp icp;
+nuslam::ScanCloud scan_cloud;
+rigid2d::Pose2D keyframe_pose;
+rigid2d::Pose2D motion;
+bool has_keyframe = false;
+double keyframe_distance_ = 0.1;
+double keyframe_angle_ = 0.1;
+int min_correspondences_ = 30;
+nav_msgs::Odometry odom;
+bool callback_flag = false;
+// Latency Instrumentation
+nuslam::LatencyHistogram & scan_latency = nuslam::latency_registry().histogram("icp_odometry.scan");
+nuslam::LatencyHistogram & align_latency = nuslam::latency_registry().histogram("icp_odometry.align");
+ros::Publisher diagnostics_pub;
+
+rigid2d::Transform2D to_transform(const rigid2d::Pose2D &pose)
+{
+  /// \brief convert a pose to the transform from its frame to the robot
+  /// \param rigid2d::Pose2D
+  /// \returns rigid2d::Transform2D
+  return rigid2d::Transform2D(rigid2d::Vector2D(pose.x, pose.y), pose.theta);
+}
+
+void scan_callback(const sensor_msgs::LaserScan &lsr)
+{
+  /// \brief register a LaserScan against the keyframe scan, starting from the previous motion, and
+  /// compose the result with the keyframe pose. The scan becomes the keyframe once the robot has moved
+  /// keyframe_distance_ or turned keyframe_angle_ from it, so that errors do not accumulate while the
+  /// robot is still or moving slowly.
+  /// \param sensor_msgs::LaserScan
+  nuslam::ScopedTimer timer(scan_latency);
+
+  scan_cloud.clear();
+  scan_cloud.reserve(lsr.ranges.size());
+  for (unsigned long int i = 0; i < lsr.ranges.size(); i++)
+  {
+    if (lsr.ranges.at(i) >= lsr.range_min && lsr.ranges.at(i) <= lsr.range_max)
+    {
+      double bearing = lsr.angle_min + i * lsr.angle_increment;
+      scan_cloud.push_back(nuslam::Point(nuslam::RangeBear(lsr.ranges.at(i), bearing)));
+    }
+  }
+
+  if (!has_keyframe)
+  {
+    icp.set_reference(scan_cloud);
+    motion = rigid2d::Pose2D();
+    has_keyframe = true;
+    return;
+  }
+
+  nuslam::IcpResult result;
+  {
+    nuslam::ScopedTimer align_timer(align_latency);
+    result = icp.align(scan_cloud, motion);
+  }
+  if (result.correspondences < static_cast<unsigned long int>(min_correspondences_))
+  {
+    // Keep the last motion, and restart from this scan so the next one can be registered
+    ROS_WARN_THROTTLE(1.0, "icp_odometry: only %lu correspondences, scan not registered", result.correspondences);
+    rigid2d::Transform2DS pose = (to_transform(keyframe_pose) * to_transform(motion)).displacement();
+    keyframe_pose = rigid2d::Pose2D(pose.x, pose.y, pose.theta);
+    motion = rigid2d::Pose2D();
+    icp.set_reference(scan_cloud);
+    return;
+  }
+  motion = result.pose;
+
+  rigid2d::Transform2DS pose = (to_transform(keyframe_pose) * to_transform(motion)).displacement();
+  if (std::hypot(motion.x, motion.y) >= keyframe_distance_ || std::fabs(motion.theta) >= keyframe_angle_)
+  {
+    keyframe_pose = rigid2d::Pose2D(pose.x, pose.y, pose.theta);
+    motion = rigid2d::Pose2D();
+    icp.set_reference(scan_cloud);
+  }
+
+  odom.header.stamp = lsr.header.stamp;
+  odom.pose.pose.position.x = pose.x;
+  odom.pose.pose.position.y = pose.y;
+  odom.pose.pose.position.z = 0.0;
+  tf2::Quaternion q;
+  q.setRPY(0, 0, pose.theta);
+  odom.pose.pose.orientation = tf2::toMsg(q);
+  callback_flag = true;
+}
+
+void diagnostics_callback(const ros::TimerEvent &)
+{
+  /// \brief publishes p50/p90/p99/max latency of each stage since startup on /diagnostics
+  diagnostics_pub.publish(nuslam::latency_diagnostics("icp_odometry", ros::Time::now()));
+}
+
+int main(int argc, char** argv)
+/// The Main Function ///
+{
+  ROS_INFO("STARTING NODE: icp_odometry");
+
+  double frequency = 60.0;
+  std::string metric_ = "line";
+  int max_iterations_ = 30;
+  double max_distance_ = 0.2, tolerance_ = 1e-4;
+  std::string o_fid_ = "odom", b_fid_ = "base_footprint";
+
+  ros::init(argc, argv, "icp_odometry"); // register the node on ROS
+  ros::NodeHandle nh; // get a handle to ROS
+  ros::NodeHandle nh_("~"); // get a handle to ROS
+  // Parameters
+  nh_.getParam("frequency", frequency);
+  nh_.getParam("metric", metric_);
+  nh_.getParam("max_iterations", max_iterations_);
+  nh_.getParam("max_distance", max_distance_);
+  nh_.getParam("tolerance", tolerance_);
+  nh_.getParam("keyframe_distance", keyframe_distance_);
+  nh_.getParam("keyframe_angle", keyframe_angle_);
+  nh_.getParam("min_correspondences", min_correspondences_);
+  nh_.getParam("odom_frame_id", o_fid_);
+  nh_.getParam("body_frame_id", b_fid_);
+  double diagnostics_period_ = 1.0;
+  std::string latency_file_;
+  nh_.getParam("diagnostics_period", diagnostics_period_);
+  nh_.getParam("latency_file", latency_file_);
+
+  try
+  {
+    nuslam::IcpMetric metric = metric_ == "point" ? nuslam::IcpMetric::PointToPoint : nuslam::IcpMetric::PointToLine;
+    icp = nuslam::Icp(metric, std::max(max_iterations_, 0), max_distance_, tolerance_);
+  } catch (const std::invalid_argument & e)
+  {
+    ROS_ERROR("icp_odometry: %s Using the default ICP settings.", e.what());
+  }
+
+  odom.header.frame_id = o_fid_;
+  odom.child_frame_id = b_fid_;
+
+  // Init Publishers
+  ros::Publisher odom_pub = nh_.advertise<nav_msgs::Odometry>("odom", 1);
+
+  // Latency Diagnostics
+  ros::Timer diagnostics_timer;
+  if (diagnostics_period_ > 0.0)
+  {
+    diagnostics_pub = nh.advertise<diagnostic_msgs::DiagnosticArray>("/diagnostics", 1);
+    diagnostics_timer = nh.createTimer(ros::Duration(diagnostics_period_), diagnostics_callback);
+  }
+
+  // Init LaserScan Subscriber
+  ros::Subscriber lsr_sub = nh.subscribe("/scan", 1, scan_callback);
+
+  ros::Rate rate(frequency);
+
+  // Main While
+  while (ros::ok())
+  {
+    ros::spinOnce();
+
+    if (callback_flag)
+    {
+      odom_pub.publish(odom);
+      callback_flag = false;
+    }
+
+    rate.sleep();
+  }
+
+  if (!latency_file_.empty())
+  {
+    try
+    {
+      nuslam::latency_registry().dump(latency_file_);
+    } catch (const std::exception & e)
+    {
+      ROS_ERROR("%s", e.what());
+    }
+  }
+
+  return 0;
+}
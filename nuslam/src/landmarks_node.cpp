@@ -5,34 +5,100 @@
 ///   threshold (double): used to determine whether two points from LaserScan belong to one cluster
 ///   callback_flag (bool): specifies whether to publish landmarks based on callback trigger
 ///   pc (sensor_msgs::PointCloud): contains interpreted pointcloud which is published for debugging purposes
+///   pc2 (sensor_msgs::PointCloud2): packed clustered points (x, y, z, cluster, residual), reusing its buffer across scans
+///   pointcloud_format_ (string): "cloud2" publishes pc2 on pointcloud2, "cloud" publishes pc on pointcloud, "none" neither
+///   scan_cloud (nuslam::ScanCloud): Points of the latest LaserScan in beam order, stored as contiguous arrays
+///   arena (nuslam::ScanArena): holds the clusters and landmarks of the current scan, released at the start of the next
 ///   map (nuslam::TurtleMap): stores lists of x,y coordinates and radii of detected landmarks
 ///   frequency (double): frequency of control loop.
 ///   frame_id_ (string): frame ID of discovered landmarks (in this case, relative to base_scan)
+///   deskew_ (bool): whether to motion-compensate LaserScan beams using wheel odometry before clustering
+///   deskew (nuslam::Deskew): odometry history used to correct each beam for robot motion during the scan
+///   body_frame_id_ (string): robot frame of the odometry, whose pose of frame_id_ is looked up once for deskewing
+///   tf_timeout_ (double): seconds to wait at startup for the body_frame_id_ to frame_id_ transform
+///   driver (rigid2d::DiffDrive): model of the diff drive robot used to estimate the body twist for deskewing
+///   last_js_stamp (ros::Time): stamp of the previous joint state, used to convert twists to velocities
+///   diagnostics_period_ (double): seconds between latency diagnostics, 0 to disable
+///   latency_file_ (string): if set, the latency histograms are written to this file on shutdown
+///   trace_ (bool): whether to record the hop times (scan_received, clusters_ready, landmarks_published) of each scan
+///   trace (nuslam::TraceLog): hop times of the most recent scans, keyed by LaserScan stamp
+///   trace_file_ (string): if set and trace_ is enabled, the hop times are written to this file on shutdown
+///   roi_ (bool): whether to only cluster and fit the beams where slam predicts mapped landmarks
+///   roi_gate_ (double): number of standard deviations of the predicted range and bearing included in each window
+///   roi_margin_ (double): distance (m) around each predicted landmark centre included in its window
+///   roi_bearing_margin_ (double): bearing (rad) added on each side of each window, for the rotation between scans
+///   roi_full_period_ (int): number of scans between full scans, which find the landmarks not yet mapped
+///   roi_timeout_ (double): age (s) of the predictions, relative to the LaserScan, beyond which the scan is processed in full
+///   windows (std::vector<nuslam::ScanWindow>): regions of the scan where landmarks are expected, from the latest predictions
+///   beam_mask (std::vector<uint8_t>): 1 for the beams of the current scan inside a window, reused across scans
+///   predictions_stamp (ros::Time): stamp of the latest predictions
+///   scans_since_full (int): number of scans processed only inside the windows since the last full scan
+///   track_ (bool): whether to associate the clusters of consecutive scans and warm-start their circle fits
+///   tracker (nuslam::ClusterTracker): clusters of the previous scan and their circles
+///   track_distance_ (double): distance (m) between predicted and observed cluster centroids beyond which they are not associated
+///   track_iterations_ (int): number of Gauss-Newton iterations from the circle of an associated cluster
+///   track_tolerance_ (double): distance (m) within which the Points of an associated cluster reuse its circle
+///   last_scan_pose (rigid2d::Pose2D): odometry pose of the robot at the previous scan, assumed to coincide with the laser
 ///
 /// PUBLISHES:
-///   landmarks (nuslam::TurtleMap): publishes TurtleMap message containing landmark coordinates (x,y) and radii
+///   landmarks (nuslam::TurtleMap): publishes TurtleMap message containing landmark coordinates (x,y) and radii,
+///   stamped with the LaserScan they were detected in
 ///   pointcloud (sensor_msgs::PointCloud): publishes PointCloud for visualization in RViz for debugging purposees
+///   (pointcloud_format_ "cloud")
+///   pointcloud2 (sensor_msgs::PointCloud2): publishes the clustered points with their cluster index and distance
+///   to the fitted circle (pointcloud_format_ "cloud2")
+///   /diagnostics (diagnostic_msgs::DiagnosticArray): p50/p90/p99/max latency of the scan, cluster and fit stages
 ///
 /// SUBSCRIBES:
 ///   /scan (sensor_msgs::LaserScan), which contains data with which it is possible to extract range,bearing measurements
+///   /joint_states (sensor_msgs::JointState), which records the ddrive robot's joint states (only if deskew_ or track_ is set)
+///   slam/predictions (nuslam::LandmarkPredictions), expected range and bearing of each mapped landmark (only if roi_ is set)
 ///
 /// FUNCTIONS:
+///   js_callback (void): callback for /joint_states subscriber, which records the body twist used for deskewing
+///   and updates the odometry used for cluster tracking
+///   to_transform (rigid2d::Transform2D): converts a pose to a transform
+///   predictions_callback (void): callback for slam/predictions subscriber, which sets the windows of the next scans
 ///   scan_callback (void): callback for /scan subscriber, which processes LaserScan data and detects landmarks
+///   init_cloud2 (void): sets the fields of pc2 once
+///   pack_cloud2 (void): writes the clustered points of one scan into pc2 in a single pass
+///   diagnostics_callback (void): timer callback which publishes the latency diagnostics
 
 #include <ros/ros.h>
 #include <std_srvs/Empty.h>
 #include <visualization_msgs/Marker.h>
 #include <sensor_msgs/LaserScan.h>
+#include <sensor_msgs/JointState.h>
 #include <sensor_msgs/PointCloud.h>
+#include <sensor_msgs/PointCloud2.h>
+#include <sensor_msgs/PointField.h>
 #include <geometry_msgs/Point32.h>
+#include <tf2/LinearMath/Quaternion.h>
+#include <tf2/LinearMath/Matrix3x3.h>
+#include <tf2_ros/buffer.h>
+#include <tf2_ros/transform_listener.h>
 
 #include <math.h>
+#include <cstdint>
+#include <cstddef>  // to use offsetof
+#include <cstring>  // to use std::memcpy
 #include <string>
 #include <vector>
+#include <memory_resource>
+#include <algorithm>  // to use std::max
 #include <boost/iterator/zip_iterator.hpp>
 
 #include "nuslam/landmarks.hpp"
+#include "nuslam/scan_cloud.hpp"
+#include "nuslam/arena.hpp"
+#include "nuslam/deskew.hpp"
+#include "nuslam/latency.hpp"
+#include "nuslam/latency_diagnostics.hpp"
+#include "nuslam/trace.hpp"
+#include "nuslam/cluster_tracker.hpp"
 #include "nuslam/TurtleMap.h"
+#include "nuslam/LandmarkPredictions.h"
+#include "rigid2d/diff_drive.hpp"
 
 #include <functional>  // To use std::bind
 
@@ -43,120 +109,211 @@ bool callback_flag = false;
 nuslam::TurtleMap map;
 // Create Point Cloud
 sensor_msgs::PointCloud pc;
+sensor_msgs::PointCloud2 pc2;
+std::string pointcloud_format_ = "cloud2";
+// Layout of one pc2 point
+struct CloudPoint
+{
+  float x, y, z;
+  uint32_t cluster;
+  float residual;
+};
+static_assert(sizeof(CloudPoint) == 20, "CloudPoint must be packed");
+// Points of the latest scan, reused across callbacks to keep their storage
+nuslam::ScanCloud scan_cloud;
+// Per-scan temporaries, so that steady-state scan processing does not touch the heap
+nuslam::ScanArena arena;
+// Motion Compensation
+bool deskew_ = false;
+nuslam::Deskew deskew;
+rigid2d::DiffDrive driver;
+ros::Time last_js_stamp;
+// Latency Instrumentation
+nuslam::LatencyHistogram & scan_latency = nuslam::latency_registry().histogram("landmarks.scan");
+nuslam::LatencyHistogram & cluster_latency = nuslam::latency_registry().histogram("landmarks.cluster");
+nuslam::LatencyHistogram & fit_latency = nuslam::latency_registry().histogram("landmarks.fit");
+ros::Publisher diagnostics_pub;
+// Tracing
+nuslam::TraceLog trace;
+// Region of Interest
+bool roi_ = false;
+double roi_gate_ = 3.0;
+double roi_margin_ = 0.1;
+double roi_bearing_margin_ = 0.1;
+int roi_full_period_ = 10;
+double roi_timeout_ = 0.5;
+std::vector<nuslam::ScanWindow> windows;
+std::vector<uint8_t> beam_mask;
+ros::Time predictions_stamp;
+int scans_since_full = 0;
+// Cluster Tracking
+bool track_ = false;
+nuslam::ClusterTracker tracker;
+rigid2d::Pose2D last_scan_pose;
+
+void js_callback(const sensor_msgs::JointState::ConstPtr &js)
+{
+  /// \brief /joint_states subscriber callback. Records the body twist of the robot
+  /// for motion compensation of the LaserScan
+  ///
+  /// \param js (sensor_msgs::JointState): the left and right wheel joint angles
+  rigid2d::WheelVelocities w_vel = driver.updateOdometry(js->position.at(0), js->position.at(1));
+  // Twist over the interval since the last joint state
+  rigid2d::Twist2D Vb = driver.wheelsToTwist(w_vel);
+
+  if (!last_js_stamp.isZero())
+  {
+    double dt = (js->header.stamp - last_js_stamp).toSec();
+    if (dt > 0.0)
+    {
+      // Convert to a velocity, measured at the middle of the interval
+      Vb.reassign(Vb.w_z / dt, Vb.v_x / dt, Vb.v_y / dt);
+      deskew.add_twist(js->header.stamp.toSec() - dt / 2.0, Vb);
+    }
+  }
+  last_js_stamp = js->header.stamp;
+}
 
 
-void scan_callback(const sensor_msgs::LaserScan &lsr)
-{ 
-  /// \brief forms clusters from LaserScan data and fits circles to
-  /// them before assessing whether or not they are landmarks (or walls)
-  /// \param sensor_msgs::LaserScan, which contains data with
-  /// which it is possible to extract range,bearing measurements
-
-  std::vector<nuslam::Landmark> landmarks;
-  // landmarks.clear();
-
-  // Clear Point Cloud
-  pc.points.clear();
-  // Useful LaserScan info: range_min/max, angle_min/max, time/angle_increment, scan_time, ranges[]
+rigid2d::Transform2D to_transform(const rigid2d::Pose2D &pose)
+{
+  /// \brief convert a pose to the transform from its frame to the robot
+  /// \param rigid2d::Pose2D
+  /// \returns rigid2d::Transform2D
+  return rigid2d::Transform2D(rigid2d::Vector2D(pose.x, pose.y), pose.theta);
+}
 
-  // Create New Cluster (points which potentially form a landmark)
-  // Threshold is used to evaluate whether a point belongs in a Cluster
-  nuslam::Landmark cluster(threshold_);
 
-  // Flag to indicate success of cluster expansion
-  bool success = false;
+void predictions_callback(const nuslam::LandmarkPredictions &predictions)
+{
+  /// \brief slam/predictions subscriber callback. Sets one window per mapped landmark around its
+  /// expected range and bearing, widened by roi_gate_ standard deviations and the margins.
+  /// \param predictions (nuslam::LandmarkPredictions): expected range and bearing of each mapped landmark
+  windows.clear();
+  for (unsigned long int i = 0; i < predictions.ranges.size(); i++)
+  {
+    nuslam::RangeBear predicted(predictions.ranges.at(i), predictions.bearings.at(i));
+    nuslam::RangeBear sigma(predictions.range_sigmas.at(i), predictions.bearing_sigmas.at(i));
+    nuslam::ScanWindow window(predicted, sigma, roi_gate_, roi_margin_);
+    window.half_width = std::min(window.half_width + roi_bearing_margin_, rigid2d::PI);
+    windows.push_back(window);
+  }
+  predictions_stamp = predictions.header.stamp;
+}
 
-  // Bearing
-  double bearing = lsr.angle_min;
 
-  // Loop across ranges[]
-  for (long unsigned int i = 0; i < lsr.ranges.size(); i++)
+void init_cloud2(const std::string &frame_id)
+{
+  /// \brief set the header frame and the x, y, z, cluster and residual fields of pc2
+  /// \param frame_id: frame of the clustered points
+  pc2.header.frame_id = frame_id;
+  pc2.height = 1;
+  pc2.is_bigendian = false;
+  pc2.is_dense = true;
+  pc2.point_step = sizeof(CloudPoint);
+  const std::vector<std::pair<std::string, uint8_t>> fields = {
+    {"x", sensor_msgs::PointField::FLOAT32}, {"y", sensor_msgs::PointField::FLOAT32},
+    {"z", sensor_msgs::PointField::FLOAT32}, {"cluster", sensor_msgs::PointField::UINT32},
+    {"residual", sensor_msgs::PointField::FLOAT32}};
+  const std::vector<uint32_t> offsets = {offsetof(CloudPoint, x), offsetof(CloudPoint, y), offsetof(CloudPoint, z),\
+                                         offsetof(CloudPoint, cluster), offsetof(CloudPoint, residual)};
+  pc2.fields.resize(fields.size());
+  for (unsigned long int i = 0; i < fields.size(); i++)
   {
+    pc2.fields.at(i).name = fields.at(i).first;
+    pc2.fields.at(i).offset = offsets.at(i);
+    pc2.fields.at(i).datatype = fields.at(i).second;
+    pc2.fields.at(i).count = 1;
+  }
+}
 
-    if (lsr.ranges.at(i) >= lsr.range_min && lsr.ranges.at(i) <= lsr.range_max)
+void pack_cloud2(const nuslam::ScanCloud &clusters, const std::pmr::vector<nuslam::CircleFit> &fits)
+{
+  /// \brief write every clustered point into pc2, with its cluster index and its distance to the
+  /// circle fitted to its cluster. The buffer is resized in place, so it keeps its capacity.
+  /// \param clusters: clustered points of one scan
+  /// \param fits: circle fitted to each cluster
+  pc2.width = clusters.size();
+  pc2.row_step = pc2.point_step * pc2.width;
+  pc2.data.resize(pc2.row_step);
+  uint8_t *out = pc2.data.data();
+  for (unsigned long int c = 0; c < clusters.num_clusters(); c++)
+  {
+    const nuslam::CircleFit &fit = fits[c];
+    for (unsigned long int i = clusters.offsets[c]; i < clusters.offsets[c + 1]; i++)
     {
+      CloudPoint point;
+      point.x = clusters.x[i];
+      point.y = clusters.y[i];
+      point.z = 0.05;
+      point.cluster = c;
+      point.residual = std::fabs(std::hypot(clusters.x[i] - fit.centre.x, clusters.y[i] - fit.centre.y) - fit.radius);
+      std::memcpy(out, &point, sizeof(CloudPoint));
+      out += sizeof(CloudPoint);
+    }
+  }
+}
 
-      // Wrap Angle
-      if (bearing > lsr.angle_max && lsr.angle_max >= 0)
-      {
-        bearing = lsr.angle_min;
-      } else if ((bearing < lsr.angle_max && lsr.angle_max < 0))
-      {
-        bearing = lsr.angle_min;
-      }
-
-      // bearing = rigid2d::normalize_angle(bearing);
-
-      // Store point's range and bearing
-      nuslam::RangeBear rb(lsr.ranges.at(i), bearing);
-      // Create Point from LaserScan
-      nuslam::Point point(rb);
-      // Evaluate Point to see if it fits within the cluster. If it is the first point, it always fits
-      success = cluster.evaluate_point(point);
-
-      if (!success)
-        // Indicates that cluster has been completed
-      {
-        // Append cluster to vector of landmarks
-        landmarks.push_back(cluster);
-
-        // Re-initialize cluster and add the current point to it
-        cluster = nuslam::Landmark(threshold_);
 
-        // bool is irrelevant here since new cluster has no points yet
-        success = cluster.evaluate_point(point);
+void scan_callback(const sensor_msgs::LaserScan &lsr)
+{ 
+  /// \brief forms clusters from LaserScan data and fits circles to
+  /// them before assessing whether or not they are landmarks (or walls)
+  /// \param sensor_msgs::LaserScan, which contains data with
+  /// which it is possible to extract range,bearing measurements
+  nuslam::ScopedTimer scan_timer(scan_latency);
+  trace.record(lsr.header.stamp.toSec(), "scan_received", ros::Time::now().toSec());
 
-      }
+  // Nothing from the previous scan is still in use
+  arena.reset();
 
-      // Bias angle by minimum scan angle
-      bearing += lsr.angle_increment;
+  // Useful LaserScan info: range_min/max, angle_min/max, time/angle_increment, scan_time, ranges[]
 
-    }
+  // Region of Interest: only the beams where mapped landmarks are expected, with a full scan every
+  // roi_full_period_ scans to find new landmarks, and whenever the predictions are missing or stale
+  bool windowed = roi_ && !windows.empty() && scans_since_full + 1 < roi_full_period_ &&\
+                  (lsr.header.stamp - predictions_stamp).toSec() <= roi_timeout_;
+  if (windowed)
+  {
+    nuslam::window_beams(windows, lsr.angle_min, lsr.angle_increment, lsr.ranges.size(), beam_mask);
+    scans_since_full++;
+  } else {
+    scans_since_full = 0;
   }
 
-  // Next, we check first and last clusters to see if they can be merged
-  nuslam::Landmark first_cluster = landmarks.at(0);
-  nuslam::Landmark last_cluster = landmarks.back();
-
+  // Motion Compensation: express every beam in the sensor frame at the first beam
+  bool compensate = deskew_ && deskew.ready();
+  if (compensate)
+  {
+    deskew.start_scan(lsr.header.stamp.toSec(), lsr.time_increment);
+  }
 
-  // Now, since vectors allow pop_back to delete last element, we will compare
-  // the first Point of first_cluster to last Point of last_cluster.
-  // Then, if they are to be merged, we merge them into first_cluster and pop last_cluster
-  success = last_cluster.evaluate_point(first_cluster.points.back());
+  // Points of this scan in beam order, each at the bearing of its beam index
+  nuslam::scan_points(lsr.ranges, lsr.angle_min, lsr.angle_increment, lsr.range_min, lsr.range_max,\
+                      windowed ? &beam_mask : nullptr, compensate ? &deskew : nullptr, scan_cloud);
 
-  if (success)
+  // Form clusters (points which potentially form a landmark)
+  // Threshold is used to evaluate whether a point belongs in a Cluster
+  nuslam::ScanCloud clusters(&arena);
   {
-    // Insert Points of last_cluster into first_cluster
-    landmarks.at(0).points.insert(landmarks.at(0).points.end(),
-                                  landmarks.back().points.begin(),
-                                  landmarks.back().points.end());
-    // Pop last_cluster from landmarks
-    landmarks.pop_back();
+    nuslam::ScopedTimer cluster_timer(cluster_latency);
+    if (windowed)
+    {
+      nuslam::cluster_windows(scan_cloud, threshold_, windows, clusters);
+    } else {
+      nuslam::cluster_scan(scan_cloud, threshold_, clusters);
+    }
   }
 
-  // Next, we eliminate all clusters with less than 3 points in them
-  // std::vector<Landmark>::iterator iter = landmarks.begin();
-  for (auto iter = landmarks.begin(); iter != landmarks.end();)
+  // Populate Point Cloud
+  if (pointcloud_format_ == "cloud")
   {
-    // Check if cluster contains less than 3 points
-    if (iter->points.size() <= 3)
+    pc.points.resize(clusters.size());
+    for (long unsigned int i = 0; i < clusters.size(); i++)
     {
-      // Erase this element from the vector
-      // This will  erase the current element from the
-      // vector and have the next loop's iter point at what would have
-      // been the next element
-      iter = landmarks.erase(iter);
-    } else {
-       // Populate Point Cloud
-       for (auto pt_iter = iter->points.begin(); pt_iter < iter->points.end(); pt_iter++)
-       {
-        geometry_msgs::Point32 p32;
-        p32.z = 0.05;
-        p32.x = pt_iter->pose.x;
-        p32.y = pt_iter->pose.y;
-        pc.points.push_back(p32);
-       }
-       iter++;
+      pc.points.at(i).x = clusters.x[i];
+      pc.points.at(i).y = clusters.y[i];
+      pc.points.at(i).z = 0.05;
     }
   }
 
@@ -181,62 +338,65 @@ void scan_callback(const sensor_msgs::LaserScan &lsr)
   //   }
   // }
 
-  // Finally, we perform circle detection for each cluster
-  for (auto iter = landmarks.begin(); iter < landmarks.end(); iter++)
+  // Finally, we perform circle detection for each cluster and filter by radius
+  std::pmr::vector<nuslam::Landmark> landmarks(&arena);
+  std::pmr::vector<nuslam::CircleFit> fits(&arena);
   {
-    iter->fit_circle();
-    // ROS_INFO("FITTING CIRCLE");
-    // std::cout << "RADIUS: " << iter->return_radius() << std::endl;
-  }
-
-  // Now filter by radius
-  for (auto iter = landmarks.begin(); iter < landmarks.end();)
-  {
-
-    if (iter->return_radius() > 0.1)
-      // If the cluster is not a circle
+    nuslam::ScopedTimer fit_timer(fit_latency);
+    if (track_)
     {
-        // Erase this element from the vector
-        // This will  erase the current element from the
-        // vector and have the next loop's iter point at what would have
-        // been the next element
-        iter = landmarks.erase(iter);
+      // Move the clusters of the previous scan by the odometry since then, so that each cluster of
+      // this scan can start from the circle of the same landmark
+      const rigid2d::Pose2D &pose = driver.get_pose();
+      tracker.predict(to_transform(last_scan_pose).inv() * to_transform(pose));
+      last_scan_pose = pose;
+      tracker.fit_clusters(clusters, 0.1, landmarks, fits);
     } else {
-       iter++;
+      nuslam::fit_clusters(clusters, 0.1, landmarks, fits);
     }
   }
+  if (pointcloud_format_ == "cloud2")
+  {
+    pack_cloud2(clusters, fits);
+  }
+  trace.record(lsr.header.stamp.toSec(), "clusters_ready", ros::Time::now().toSec());
 
-  // Now, return landmarks radii x, and y positions each in a separate vector
-  std::vector<double> radii;
-  std::vector<double> x_pts;
-  std::vector<double> y_pts;
+  // Now, populate landmarks radii x, and y positions each in a separate vector.
+  // Filled in place, so the message keeps its capacity from one scan to the next
+  map.radii.clear();
+  map.x_pts.clear();
+  map.y_pts.clear();
 
   // iter = landmarks.begin();
   int c = 0;
   for (auto iter = landmarks.begin(); iter != landmarks.end(); iter++)
   {
-    radii.push_back(iter->return_radius());
+    map.radii.push_back(iter->return_radius());
     // std::cout << "RADIUS: " << iter->return_radius() << std::endl;
-    x_pts.push_back(iter->return_coords().pose.x);
-    y_pts.push_back(iter->return_coords().pose.y);
+    map.x_pts.push_back(iter->return_coords().pose.x);
+    map.y_pts.push_back(iter->return_coords().pose.y);
     // std::cout << "POS: (" << iter->return_coords().pose.x << ", " << iter->return_coords().pose.y << ")" << std::endl;
     c++;
   }
 
   // ROS_INFO("FOUND %d CLUSTERS", c);
 
-  // Now, populate
-  map.radii.clear();
-  map.radii = radii;
-  map.x_pts.clear();
-  map.x_pts = x_pts;
-  map.y_pts.clear();
-  map.y_pts = y_pts;
+  // Keep the sensor stamp so that downstream latency can be measured and compensated
+  map.header.stamp = lsr.header.stamp;
+  pc.header.stamp = lsr.header.stamp;
+  pc2.header.stamp = lsr.header.stamp;
 
   callback_flag = true;
 }
 
 
+void diagnostics_callback(const ros::TimerEvent &)
+{
+  /// \brief publishes p50/p90/p99/max latency of each stage since startup on /diagnostics
+  diagnostics_pub.publish(nuslam::latency_diagnostics("landmarks", ros::Time::now()));
+}
+
+
 int main(int argc, char** argv)
 /// The Main Function ///
 {
@@ -244,6 +404,8 @@ int main(int argc, char** argv)
 
   double frequency = 60.0;
   std::string frame_id_ = "base_scan";
+  std::string body_frame_id_ = "base_footprint";
+  double tf_timeout_ = 5.0;
 
   ros::init(argc, argv, "landmarks"); // register the node on ROS
   ros::NodeHandle nh; // get a handle to ROS
@@ -252,6 +414,42 @@ int main(int argc, char** argv)
   nh_.getParam("threshold", threshold_);
   nh_.getParam("frequency", frequency);
   nh_.getParam("landmark_frame_id", frame_id_);
+  nh_.getParam("deskew", deskew_);
+  nh_.getParam("body_frame_id", body_frame_id_);
+  nh_.getParam("tf_timeout", tf_timeout_);
+  double diagnostics_period_ = 1.0;
+  std::string latency_file_;
+  nh_.getParam("diagnostics_period", diagnostics_period_);
+  nh_.getParam("latency_file", latency_file_);
+  bool trace_ = false;
+  int trace_capacity_ = 10000;
+  std::string trace_file_;
+  nh_.getParam("trace", trace_);
+  nh_.getParam("trace_capacity", trace_capacity_);
+  nh_.getParam("trace_file", trace_file_);
+  if (trace_)
+  {
+    trace.start(std::max(trace_capacity_, 1));
+  }
+  nh_.getParam("roi", roi_);
+  nh_.getParam("roi_gate", roi_gate_);
+  nh_.getParam("roi_margin", roi_margin_);
+  nh_.getParam("roi_bearing_margin", roi_bearing_margin_);
+  nh_.getParam("roi_full_period", roi_full_period_);
+  nh_.getParam("roi_timeout", roi_timeout_);
+  double track_distance_ = 0.1, track_tolerance_ = 1e-3;
+  int track_iterations_ = 3;
+  nh_.getParam("track", track_);
+  nh_.getParam("track_distance", track_distance_);
+  nh_.getParam("track_iterations", track_iterations_);
+  nh_.getParam("track_tolerance", track_tolerance_);
+  try
+  {
+    tracker = nuslam::ClusterTracker(track_distance_, std::max(track_iterations_, 0), track_tolerance_);
+  } catch (const std::invalid_argument & e)
+  {
+    ROS_ERROR("landmarks: %s Using the default tracking settings.", e.what());
+  }
 
   // Publish TurtleMap data wrt this frame
   map.header.frame_id = frame_id_;
@@ -259,11 +457,70 @@ int main(int argc, char** argv)
   // Init Publishers
   ros::Publisher landmark_pub = nh_.advertise<nuslam::TurtleMap>("landmarks", 1);
 
-  ros::Publisher pointcloud_pub = nh_.advertise<sensor_msgs::PointCloud>("pointcloud", 1);
+  nh_.getParam("pointcloud_format", pointcloud_format_);
+  ros::Publisher pointcloud_pub;
+  if (pointcloud_format_ == "cloud")
+  {
+    pointcloud_pub = nh_.advertise<sensor_msgs::PointCloud>("pointcloud", 1);
+  } else if (pointcloud_format_ == "cloud2")
+  {
+    pointcloud_pub = nh_.advertise<sensor_msgs::PointCloud2>("pointcloud2", 1);
+    init_cloud2(frame_id_);
+  }
+
+  // Latency Diagnostics
+  ros::Timer diagnostics_timer;
+  if (diagnostics_period_ > 0.0)
+  {
+    diagnostics_pub = nh.advertise<diagnostic_msgs::DiagnosticArray>("/diagnostics", 1);
+    diagnostics_timer = nh.createTimer(ros::Duration(diagnostics_period_), diagnostics_callback);
+  }
 
   // Init LaserScan Subscriber
   ros::Subscriber lsr_sub = nh.subscribe("/scan", 1, scan_callback);
 
+  // Init Predictions Subscriber for region of interest processing
+  ros::Subscriber predictions_sub;
+  if (roi_)
+  {
+    predictions_sub = nh.subscribe("slam/predictions", 1, predictions_callback);
+  }
+
+  // Init JointState Subscriber for motion compensation and cluster tracking
+  ros::Subscriber js_sub;
+  if (deskew_ || track_)
+  {
+    float wbase_ = 0.16, wrad_ = 0.033;
+    nh.getParam("/wheel_base", wbase_);
+    nh.getParam("/wheel_radius", wrad_);
+    driver.set_static(wbase_, wrad_);
+    js_sub = nh.subscribe("joint_states", 10, js_callback);
+  }
+
+  // Odometry is a body twist, so deskewing needs the lidar pose on the robot, which is fixed
+  if (deskew_)
+  {
+    tf2_ros::Buffer tf_buffer;
+    tf2_ros::TransformListener tf_listener(tf_buffer);
+    try
+    {
+      geometry_msgs::TransformStamped body_scan = tf_buffer.lookupTransform(body_frame_id_, frame_id_, ros::Time(0),\
+                                                                            ros::Duration(tf_timeout_));
+      auto roll = 0.0, pitch = 0.0, yaw = 0.0;
+      tf2::Quaternion quat(body_scan.transform.rotation.x,\
+                           body_scan.transform.rotation.y,\
+                           body_scan.transform.rotation.z,\
+                           body_scan.transform.rotation.w);
+      tf2::Matrix3x3 mat(quat);
+      mat.getRPY(roll, pitch, yaw);
+      deskew.set_sensor_pose(rigid2d::Transform2D(rigid2d::Vector2D(body_scan.transform.translation.x,\
+                                                                    body_scan.transform.translation.y), yaw));
+    } catch (const tf2::TransformException & e)
+    {
+      ROS_WARN("landmarks: %s. Deskewing as if %s is at the origin of %s.", e.what(), frame_id_.c_str(), body_frame_id_.c_str());
+    }
+  }
+
   ros::Rate rate(frequency);
 
   // Main While
@@ -273,16 +530,42 @@ int main(int argc, char** argv)
 
     if (callback_flag)
     {
-      map.header.stamp = ros::Time::now();
       landmark_pub.publish(map);
-      pc.header.stamp = ros::Time::now();
-      pc.header.frame_id = frame_id_;
-      pointcloud_pub.publish(pc);
+      trace.record(map.header.stamp.toSec(), "landmarks_published", ros::Time::now().toSec());
+      if (pointcloud_format_ == "cloud")
+      {
+        pc.header.frame_id = frame_id_;
+        pointcloud_pub.publish(pc);
+      } else if (pointcloud_format_ == "cloud2")
+      {
+        pointcloud_pub.publish(pc2);
+      }
       callback_flag = false;
     }
 
     rate.sleep();
   }
 
+  if (!latency_file_.empty())
+  {
+    try
+    {
+      nuslam::latency_registry().dump(latency_file_);
+    } catch (const std::exception & e)
+    {
+      ROS_ERROR("%s", e.what());
+    }
+  }
+  if (trace_ && !trace_file_.empty())
+  {
+    try
+    {
+      trace.dump(trace_file_);
+    } catch (const std::exception & e)
+    {
+      ROS_ERROR("%s", e.what());
+    }
+  }
+
   return 0;
 }
\ No newline at end of file
@@ -0,0 +1,95 @@
+#include "nuslam/arena.hpp"
+#include <new>
+
+namespace nuslam
+{
+	// Blocks are allocated in units of max_align_t, so the first byte is suitably aligned for any type
+	static std::size_t block_units(const std::size_t & bytes)
+	{
+		return (bytes + sizeof(std::max_align_t) - 1) / sizeof(std::max_align_t);
+	}
+
+	ScanArena::ScanArena() : ScanArena(64 * 1024)
+	{
+	}
+
+	ScanArena::ScanArena(const std::size_t & capacity_)
+	{
+		size = block_units(capacity_) * sizeof(std::max_align_t);
+		block.reset(new std::max_align_t[block_units(capacity_)]);
+		offset = 0;
+		overflow_bytes = 0;
+		overflow_count = 0;
+	}
+
+	ScanArena::~ScanArena()
+	{
+		for (auto iter = overflow.begin(); iter != overflow.end(); iter++)
+		{
+			::operator delete(iter->p, iter->bytes, std::align_val_t(iter->alignment));
+		}
+	}
+
+	void ScanArena::reset()
+	{
+		for (auto iter = overflow.begin(); iter != overflow.end(); iter++)
+		{
+			::operator delete(iter->p, iter->bytes, std::align_val_t(iter->alignment));
+		}
+		overflow.clear();
+
+		// Grow to the high-water mark, with headroom for alignment padding, so the next scan of
+		// the same size fits in the block
+		if (overflow_bytes > 0)
+		{
+			std::size_t units = block_units(2 * (offset + overflow_bytes));
+			block.reset(new std::max_align_t[units]);
+			size = units * sizeof(std::max_align_t);
+		}
+		offset = 0;
+		overflow_bytes = 0;
+	}
+
+	std::size_t ScanArena::capacity() const
+	{
+		return size;
+	}
+
+	std::size_t ScanArena::used() const
+	{
+		return offset + overflow_bytes;
+	}
+
+	std::size_t ScanArena::overflows() const
+	{
+		return overflow_count;
+	}
+
+	void * ScanArena::do_allocate(std::size_t bytes, std::size_t alignment)
+	{
+		void * p = reinterpret_cast<char *>(block.get()) + offset;
+		std::size_t space = size - offset;
+		if (std::align(alignment, bytes, p, space) != nullptr)
+		{
+			offset = size - space + bytes;
+			return p;
+		}
+
+		// Block is full
+		p = ::operator new(bytes, std::align_val_t(alignment));
+		overflow.push_back(Overflow{p, bytes, alignment});
+		overflow_bytes += bytes;
+		overflow_count++;
+		return p;
+	}
+
+	void ScanArena::do_deallocate(void *, std::size_t, std::size_t)
+	{
+		// Memory is only reclaimed by reset()
+	}
+
+	bool ScanArena::do_is_equal(const std::pmr::memory_resource & other) const noexcept
+	{
+		return this == &other;
+	}
+}
@@ -0,0 +1,128 @@
+#include "nuslam/bag_dataset.hpp"
+#include "nuslam/model_index.hpp"
+#include <rosbag/bag.h>
+#include <rosbag/view.h>
+#include <sensor_msgs/LaserScan.h>
+#include <sensor_msgs/JointState.h>
+#include <gazebo_msgs/ModelStates.h>
+#include <tf2/LinearMath/Quaternion.h>
+#include <tf2/LinearMath/Matrix3x3.h>
+#include <algorithm>  // to use std::stable_sort
+#include <vector>
+
+namespace nuslam
+{
+	// Yaw (rad) of an orientation
+	static double yaw_from_quaternion(const geometry_msgs::Quaternion & q)
+	{
+		auto roll = 0.0, pitch = 0.0, yaw = 0.0;
+		tf2::Quaternion quat(q.x, q.y, q.z, q.w);
+		tf2::Matrix3x3 mat(quat);
+		mat.getRPY(roll, pitch, yaw);
+		return yaw;
+	}
+
+	// BagTopics
+	BagTopics::BagTopics()
+	{
+		scan = "/scan";
+		joint_states = "/joint_states";
+		model_states = "/gazebo/model_states";
+		left_wheel_joint = "left_wheel_axle";
+		right_wheel_joint = "right_wheel_axle";
+		robot_name = "diff_drive";
+		landmark_name = "cylinder";
+	}
+
+	// Helper Functions
+	Dataset read_bag(const std::string & filename, const BagTopics & topics)
+	{
+		Dataset data;
+		ModelIndex model_index(topics.robot_name, topics.landmark_name);
+
+		rosbag::Bag bag;
+		bag.open(filename, rosbag::bagmode::Read);
+		rosbag::View view(bag, rosbag::TopicQuery(std::vector<std::string>{topics.scan, topics.joint_states,\
+																			 topics.model_states}));
+
+		for (const rosbag::MessageInstance & m : view)
+		{
+			if (m.getTopic() == topics.scan)
+			{
+				sensor_msgs::LaserScan::ConstPtr lsr = m.instantiate<sensor_msgs::LaserScan>();
+				if (lsr == nullptr)
+				{
+					continue;
+				}
+				ScanRecord scan;
+				scan.stamp = lsr->header.stamp.toSec();
+				scan.angle_min = lsr->angle_min;
+				scan.angle_max = lsr->angle_max;
+				scan.angle_increment = lsr->angle_increment;
+				scan.time_increment = lsr->time_increment;
+				scan.range_min = lsr->range_min;
+				scan.range_max = lsr->range_max;
+				scan.ranges = lsr->ranges;
+				data.scans.push_back(scan);
+			} else if (m.getTopic() == topics.joint_states)
+			{
+				sensor_msgs::JointState::ConstPtr js = m.instantiate<sensor_msgs::JointState>();
+				if (js == nullptr)
+				{
+					continue;
+				}
+
+				// Joint order is up to the publisher
+				unsigned long int left = js->name.size(), right = js->name.size();
+				for (unsigned long int i = 0; i < js->name.size(); i++)
+				{
+					if (js->name.at(i) == topics.left_wheel_joint)
+					{
+						left = i;
+					} else if (js->name.at(i) == topics.right_wheel_joint) {
+						right = i;
+					}
+				}
+				if (left >= js->position.size() || right >= js->position.size())
+				{
+					continue;
+				}
+				data.joints.push_back(JointRecord(js->header.stamp.toSec(), js->position.at(left), js->position.at(right)));
+			} else if (m.getTopic() == topics.model_states)
+			{
+				gazebo_msgs::ModelStates::ConstPtr model = m.instantiate<gazebo_msgs::ModelStates>();
+				if (model == nullptr)
+				{
+					continue;
+				}
+				model_index.update(model->name);
+				if (!model_index.has_robot())
+				{
+					continue;
+				}
+				const geometry_msgs::Pose & dd_pose = model->pose.at(model_index.robot());
+
+				// ModelStates has no header, so use the time at which it was recorded
+				GroundTruthRecord truth;
+				truth.stamp = m.getTime().toSec();
+				truth.pose = Pose2D(dd_pose.position.x, dd_pose.position.y, yaw_from_quaternion(dd_pose.orientation));
+				const std::vector<unsigned long int> & landmarks = model_index.landmarks();
+				truth.landmarks.reserve(landmarks.size());
+				for (auto iter = landmarks.begin(); iter != landmarks.end(); iter++)
+				{
+					truth.landmarks.push_back(Vector2D(model->pose.at(*iter).position.x, model->pose.at(*iter).position.y));
+				}
+				data.ground_truth.push_back(truth);
+			}
+		}
+		bag.close();
+
+		// Bags are ordered by receipt time; the replay merges streams by stamp
+		auto by_stamp = [](const auto & a, const auto & b) { return a.stamp < b.stamp; };
+		std::stable_sort(data.scans.begin(), data.scans.end(), by_stamp);
+		std::stable_sort(data.joints.begin(), data.joints.end(), by_stamp);
+		std::stable_sort(data.ground_truth.begin(), data.ground_truth.end(), by_stamp);
+
+		return data;
+	}
+}
@@ -0,0 +1,240 @@
+#include "nuslam/cluster_tracker.hpp"
+#include <cmath>
+#include <stdexcept>
+#include <eigen3/Eigen/Dense>
+
+namespace nuslam
+{
+	// TrackStats
+	TrackStats::TrackStats()
+	{
+		fitted = 0;
+		refined = 0;
+		reused = 0;
+	}
+
+	// ClusterTracker
+	ClusterTracker::ClusterTracker() : ClusterTracker(0.1, 3, 1e-3)
+	{
+	}
+
+	ClusterTracker::ClusterTracker(const double & max_distance_, const unsigned int & iterations_, const double & tolerance_)
+	{
+		if (!(max_distance_ > 0.0) || iterations_ == 0 || !(tolerance_ >= 0.0))
+		{
+			throw std::invalid_argument("ClusterTracker distance and iterations must be positive and the tolerance must not be negative.");
+		}
+		max_distance = max_distance_;
+		iterations = iterations_;
+		tolerance = tolerance_;
+	}
+
+	void ClusterTracker::predict(const Transform2D & motion)
+	{
+		// A Point p in the previous frame is inv(motion)(p) in the next one
+		const rigid2d::Transform2DS inv = motion.inv().displacement();
+		const double c = std::cos(inv.theta), s = std::sin(inv.theta);
+
+		double * px = points_x.data();
+		double * py = points_y.data();
+		for (unsigned long int i = 0; i < points_x.size(); i++)
+		{
+			const double x = px[i];
+			px[i] = c * x - s * py[i] + inv.x;
+			py[i] = s * x + c * py[i] + inv.y;
+		}
+
+		for (auto & track : tracks)
+		{
+			const double x = track.centroid_x;
+			track.centroid_x = c * x - s * track.centroid_y + inv.x;
+			track.centroid_y = s * x + c * track.centroid_y + inv.y;
+			const double cx = track.fit.centre.x;
+			track.fit.centre.x = c * cx - s * track.fit.centre.y + inv.x;
+			track.fit.centre.y = s * cx + c * track.fit.centre.y + inv.y;
+		}
+	}
+
+	void ClusterTracker::fit_clusters(const ScanCloud & clusters, const double & max_radius,\
+									  std::pmr::vector<Landmark> & landmarks, std::pmr::vector<CircleFit> & fits)
+	{
+		const unsigned long int num_clusters = clusters.num_clusters();
+		landmarks.clear();
+		landmarks.reserve(num_clusters);
+		fits.clear();
+		fits.reserve(num_clusters);
+		last_stats = TrackStats();
+
+		next_tracks.clear();
+		next_x.clear();
+		next_y.clear();
+		claimed.assign(tracks.size(), 0);
+		const double max_sq = max_distance * max_distance;
+		const double tolerance_sq = tolerance * tolerance;
+
+		for (unsigned long int c = 0; c < num_clusters; c++)
+		{
+			const unsigned long int first = clusters.offsets.at(c);
+			const unsigned long int n = clusters.offsets.at(c + 1) - first;
+			const double * x = clusters.x.data() + first;
+			const double * y = clusters.y.data() + first;
+
+			Track track;
+			track.centroid_x = 0.0;
+			track.centroid_y = 0.0;
+			for (unsigned long int i = 0; i < n; i++)
+			{
+				track.centroid_x += x[i];
+				track.centroid_y += y[i];
+			}
+			track.centroid_x /= n;
+			track.centroid_y /= n;
+			track.first = next_x.size();
+			track.n = n;
+
+			// Nearest unclaimed track of the previous scan
+			unsigned long int match = tracks.size();
+			double best_sq = max_sq;
+			for (unsigned long int t = 0; t < tracks.size(); t++)
+			{
+				const double d_sq = std::pow(tracks[t].centroid_x - track.centroid_x, 2) +\
+									std::pow(tracks[t].centroid_y - track.centroid_y, 2);
+				if (!claimed[t] && d_sq < best_sq)
+				{
+					best_sq = d_sq;
+					match = t;
+				}
+			}
+
+			bool done = false;
+			if (match < tracks.size())
+			{
+				claimed[match] = 1;
+				const Track & previous = tracks[match];
+
+				// Same Points as the track: its circle still fits them
+				bool same = previous.n == n;
+				const double * px = points_x.data() + previous.first;
+				const double * py = points_y.data() + previous.first;
+				for (unsigned long int i = 0; same && i < n; i++)
+				{
+					same = std::pow(px[i] - x[i], 2) + std::pow(py[i] - y[i], 2) <= tolerance_sq;
+				}
+
+				if (same)
+				{
+					track.fit = previous.fit;
+					last_stats.reused++;
+					done = true;
+				} else if (!(previous.fit.radius > max_radius) && refine(x, y, n, previous.fit, track.fit)) {
+					last_stats.refined++;
+					done = true;
+				}
+			}
+			if (!done)
+			{
+				track.fit = fit_circle(x, y, n);
+				last_stats.fitted++;
+			}
+
+			fits.push_back(track.fit);
+			if (!(track.fit.radius > max_radius))
+			{
+				landmarks.push_back(Landmark(track.fit.radius, Point(track.fit.centre), std::vector<Point>(), 0.05));
+			}
+			next_x.insert(next_x.end(), x, x + n);
+			next_y.insert(next_y.end(), y, y + n);
+			next_tracks.push_back(track);
+		}
+
+		tracks.swap(next_tracks);
+		points_x.swap(next_x);
+		points_y.swap(next_y);
+	}
+
+	void ClusterTracker::clear()
+	{
+		tracks.clear();
+		points_x.clear();
+		points_y.clear();
+	}
+
+	unsigned long int ClusterTracker::size() const
+	{
+		return tracks.size();
+	}
+
+	const TrackStats & ClusterTracker::stats() const
+	{
+		return last_stats;
+	}
+
+	bool ClusterTracker::refine(const double * x, const double * y, const unsigned long int & n, const CircleFit & start,\
+								CircleFit & fit) const
+	{
+		if (n < 3)
+		{
+			return false;
+		}
+
+		// Gauss-Newton on the geometric residuals |p - c| - R over (cx, cy, R), with Jacobian rows
+		// (-ux, -uy, -1) for the unit vector u from the centre to each Point. The normal equations are
+		// accumulated as scalars, since a warm start converges in a few cheap iterations.
+		double cx = start.centre.x, cy = start.centre.y, R = start.radius;
+		for (unsigned int k = 0; k < iterations; k++)
+		{
+			double sxx = 0.0, sxy = 0.0, syy = 0.0, sx = 0.0, sy = 0.0;
+			double bx = 0.0, by = 0.0, br = 0.0;
+			for (unsigned long int i = 0; i < n; i++)
+			{
+				const double dx = x[i] - cx;
+				const double dy = y[i] - cy;
+				const double d = std::sqrt(dx * dx + dy * dy);
+				const double ux = d > 0.0 ? dx / d : 0.0;
+				const double uy = d > 0.0 ? dy / d : 0.0;
+				const double r = d - R;
+				sxx += ux * ux;
+				sxy += ux * uy;
+				syy += uy * uy;
+				sx += ux;
+				sy += uy;
+				bx += ux * r;
+				by += uy * r;
+				br += r;
+			}
+			Eigen::Matrix3d A;
+			A << sxx, sxy, sx,
+				 sxy, syy, sy,
+				 sx, sy, static_cast<double>(n);
+			const Eigen::Vector3d delta = A.ldlt().solve(Eigen::Vector3d(bx, by, br));
+			if (!delta.allFinite())
+			{
+				return false;
+			}
+			cx += delta(0);
+			cy += delta(1);
+			R += delta(2);
+			if (delta.cwiseAbs().maxCoeff() < 1e-9)
+			{
+				break;
+			}
+		}
+
+		if (!std::isfinite(R) || !(R > 0.0) ||\
+			!(std::hypot(cx - start.centre.x, cy - start.centre.y) < max_distance))
+		{
+			return false;
+		}
+
+		// Same error measure as fit_circle, so that the two are interchangeable downstream
+		double sum_sq = 0.0;
+		for (unsigned long int i = 0; i < n; i++)
+		{
+			sum_sq += std::pow(std::pow(x[i] - cx, 2) + std::pow(y[i] - cy, 2) - R * R, 2);
+		}
+		fit.centre = Vector2D(cx, cy);
+		fit.radius = R;
+		fit.rms = std::sqrt(sum_sq / n);
+		return true;
+	}
+}
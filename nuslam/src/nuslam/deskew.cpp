@@ -0,0 +1,130 @@
+#include "nuslam/deskew.hpp"
+
+namespace nuslam
+{
+	using rigid2d::Twist2D;
+	using rigid2d::Transform2D;
+
+	// TwistSample
+	TwistSample::TwistSample()
+	{
+		stamp = 0;
+		twist = Twist2D();
+	}
+
+	TwistSample::TwistSample(const double & stamp_, const Twist2D & twist_)
+	{
+		stamp = stamp_;
+		twist = twist_;
+	}
+
+	// Deskew
+	Deskew::Deskew()
+	{
+		horizon = 1.0;
+		scan_stamp = 0;
+		time_increment = 0;
+		beam = 0;
+		T_beam = Transform2D();
+		T_sensor_body = Transform2D();
+	}
+
+	Deskew::Deskew(const double & horizon_)
+	{
+		horizon = horizon_;
+		scan_stamp = 0;
+		time_increment = 0;
+		beam = 0;
+		T_beam = Transform2D();
+		T_sensor_body = Transform2D();
+	}
+
+	void Deskew::add_twist(const double & stamp, const Twist2D & twist)
+	{
+		// Out-of-order samples would break the interpolation below
+		if (!history.empty() && stamp <= history.back().stamp)
+		{
+			return;
+		}
+
+		history.push_back(TwistSample(stamp, twist));
+
+		// Keep at least two samples so we can still interpolate after a gap in odometry
+		while (history.size() > 2 && history.front().stamp < stamp - horizon)
+		{
+			history.pop_front();
+		}
+	}
+
+	Twist2D Deskew::interpolate_twist(const double & stamp) const
+	{
+		if (history.empty())
+		{
+			return Twist2D();
+		}
+
+		// Clamp to the ends of the recorded history
+		if (stamp <= history.front().stamp)
+		{
+			return history.front().twist;
+		} else if (stamp >= history.back().stamp)
+		{
+			return history.back().twist;
+		}
+
+		// Find the first sample after stamp. Scans are recent, so search from the back
+		auto after = history.end() - 1;
+		while (std::prev(after)->stamp > stamp)
+		{
+			after--;
+		}
+		auto before = std::prev(after);
+
+		// Linear interpolation between the two samples bracketing stamp
+		double s = (stamp - before->stamp) / (after->stamp - before->stamp);
+		Twist2D tw(before->twist.w_z + s * (after->twist.w_z - before->twist.w_z),\
+				   before->twist.v_x + s * (after->twist.v_x - before->twist.v_x),\
+				   before->twist.v_y + s * (after->twist.v_y - before->twist.v_y));
+		return tw;
+	}
+
+	void Deskew::start_scan(const double & stamp_, const double & time_increment_)
+	{
+		scan_stamp = stamp_;
+		time_increment = time_increment_;
+		beam = 0;
+		T_beam = Transform2D();
+	}
+
+	void Deskew::set_sensor_pose(const Transform2D & T_body_sensor)
+	{
+		T_sensor_body = T_body_sensor.inv();
+	}
+
+	Point Deskew::correct_point(const Point & point, const unsigned long int & beam_index)
+	{
+		if (history.empty() || time_increment <= 0)
+		{
+			return point;
+		}
+
+		// Integrate the interpolated twist one beam at a time up to beam_index
+		// so that T_beam is the sensor pose at this beam relative to the first beam
+		for (; beam < beam_index; beam++)
+		{
+			// Sensor twist, from the body twist through the adjoint of the sensor pose
+			Twist2D tw = interpolate_twist(scan_stamp + (beam + 0.5) * time_increment).convert(T_sensor_body);
+			tw.reassign(tw.w_z * time_increment, tw.v_x * time_increment, tw.v_y * time_increment);
+			T_beam = T_beam.integrateTwist(tw);
+		}
+
+		// Re-express beam point in first beam's frame. This also recomputes range,bearing
+		Point corrected(T_beam(point.pose));
+		return corrected;
+	}
+
+	bool Deskew::ready() const
+	{
+		return !history.empty();
+	}
+}
@@ -1,5 +1,10 @@
 #include "nuslam/ekf.hpp"
+#include "nuslam/latency.hpp"
 #include <exception>
+#include <stdexcept>
+#include <utility>
+#include <algorithm>
+#include <cmath>
 
 namespace nuslam
 {
@@ -169,18 +174,32 @@ namespace nuslam
 		R = rb_vct.asDiagonal();
 	}
 
+	// Measurement Prediction
+	MeasurementPrediction::MeasurementPrediction()
+	{
+		index = 0;
+		range_bear = RangeBear();
+		sigma = RangeBear();
+	}
+
 
 	// Random Sampling Functions
 	std::mt19937 & get_random()
     {
-        // static variables inside a function are created once and persist for the remainder of the program
-        static std::random_device rd{}; 
-        static std::mt19937 mt{rd()};
+        // thread_local variables inside a function are created once per thread and persist for the
+        // remainder of the thread, so EKFs running on different threads never share a generator
+        thread_local std::random_device rd{};
+        thread_local std::mt19937 mt{rd()};
         // we return a reference to the pseudo-random number genrator object. This is always the
-        // same object every time get_random is called
+        // same object every time get_random is called from the same thread
         return mt;
     }
 
+    void seed_random(const unsigned int & seed)
+    {
+        get_random().seed(seed);
+    }
+
     Eigen::VectorXd sampleNormalDistribution(int mtx_dimension)
     {
     	Eigen::VectorXd noise_vect = Eigen::VectorXd::Zero(mtx_dimension);
@@ -206,6 +225,18 @@ namespace nuslam
     	return L * noise_vect;
     }
 
+    Eigen::Matrix<double, 2, 3> msr_jacobian(const double & x_diff, const double & y_diff)
+    {
+    	// range depends on dist = sqrt(q), bearing on atan2(y_diff, x_diff), whose derivatives scale with 1/q
+    	const double squared_diff = x_diff * x_diff + y_diff * y_diff;
+    	const double dist = std::sqrt(squared_diff);
+
+    	Eigen::Matrix<double, 2, 3> h;
+    	h << 0.0, -x_diff / dist, -y_diff / dist,\
+    		 -1.0, y_diff / squared_diff, -x_diff / squared_diff;
+    	return h;
+    }
+
     //EKF
     EKF::EKF()
     {
@@ -219,27 +250,32 @@ namespace nuslam
     	N = 0;
     	mahalanobis_lower = 0;
 		mahalanobis_upper = 0;
+		frozen = false;
     }
 
-    EKF::EKF(const Pose2D & robot_state_, const std::vector<Point> & map_state_,\
+    EKF::EKF(const Pose2D & robot_state_, std::vector<Point> map_state_,\
     		 const Pose2D & xyt_noise_var, const RangeBear & rb_noise_var_,\
     		 const double & max_range_, double mahalanobis_lower_, double mahalanobis_upper_)
     {
     	State = Eigen::VectorXd::Zero(3 + 2 * map_state_.size());
     	max_range = max_range_;
     	robot_state = robot_state_;
-    	map_state = map_state_;
     	cov_mtx = CovarianceMatrix(map_state_);
     	cov_mtx = cov_mtx;
     	proc_noise = ProcessNoise(xyt_noise_var, map_state_.size());
+    	map_state = std::move(map_state_);
     	msr_noise = MeasurementNoise(rb_noise_var_);
     	N = 0;
     	mahalanobis_lower = mahalanobis_lower_;
 		mahalanobis_upper = mahalanobis_upper_;
+		frozen = false;
     }
 
     void EKF::predict(const Twist2D & twist)
     {
+    	static LatencyHistogram & predict_latency = latency_registry().histogram("ekf.predict");
+    	ScopedTimer timer(predict_latency);
+
     	// Angle Wrap Robot Theta
     	robot_state.theta = rigid2d::normalize_angle(robot_state.theta);
     	// First, update the estimate using the forward model
@@ -263,8 +299,9 @@ namespace nuslam
     	belief.theta = rigid2d::normalize_angle(belief.theta);
 
     	// Next, we propagate the uncertainty using the linearized state transition model
-    	// (3+2n)*(3+2n)
-    	Eigen::MatrixXd g = Eigen::MatrixXd::Zero(3 + (2 * map_state.size()), 3 + (2 * map_state.size()));
+    	// (3+2n)*(3+2n), or 3*3 if the map is frozen
+    	const auto dim = cov_mtx.cov_mtx.rows();
+    	Eigen::MatrixXd g = Eigen::MatrixXd::Zero(dim, dim);
     	if (rigid2d::almost_equal(twist.w_z, 0.0))
     	// If dtheta = 0
     	{
@@ -280,7 +317,7 @@ namespace nuslam
     		g(2, 0) = (-twist.v_x / twist.w_z) * sin(robot_state.theta) + (twist.v_x / twist.w_z) * sin(robot_state.theta + twist.w_z);
     	}
 
-    	Eigen::MatrixXd G = Eigen::MatrixXd::Identity(3 + (2 * map_state.size()), 3 + (2 * map_state.size())) + g;
+    	Eigen::MatrixXd G = Eigen::MatrixXd::Identity(dim, dim) + g;
 
     	cov_mtx.cov_mtx = G * cov_mtx.cov_mtx * G.transpose() + proc_noise.Q;
 
@@ -299,7 +336,15 @@ namespace nuslam
     	double x_diff = State(3 + 2*j) - State(1);
     	// y-distance to landmark
     	double y_diff = State(4 + 2*j) - State(2);
-    	double squared_diff = pow(x_diff, 2) + pow(y_diff, 2);
+
+		Eigen::MatrixXd h_left = msr_jacobian(x_diff, y_diff);
+
+		// Landmarks are not part of the estimated state when the map is frozen
+		if (frozen)
+		{
+			return h_left;
+		}
+
     	// Eigen::MatrixXd h(2, 5);
     	// h << 0.0, (-x_diff / sqrt(squared_diff)), (-y_diff / sqrt(squared_diff)), (x_diff / sqrt(squared_diff)), (y_diff / sqrt(squared_diff)),
     	// 	 -1.0, (y_diff / sqrt(squared_diff)), (-x_diff / sqrt(squared_diff)), (-y_diff / sqrt(squared_diff)), (x_diff / sqrt(squared_diff));
@@ -308,13 +353,10 @@ namespace nuslam
 		Eigen::MatrixXd H = Eigen::MatrixXd::Zero(2, 3 + 2 * map_state.size());
 		// H constructed from four Matrices: https://nu-msr.github.io/navigation_site/slam.pdf
 		// NOTE: j starts at 1 in slam.pdf
-		Eigen::MatrixXd h_left(2, 3);
-		h_left << 0.0, (-x_diff / sqrt(squared_diff)), (-y_diff / sqrt(squared_diff)), -1.0, (y_diff / sqrt(squared_diff)), (-x_diff / sqrt(squared_diff));
 
 		Eigen::MatrixXd h_mid_left = Eigen::MatrixXd::Zero(2, 2*j);
 
-		Eigen::MatrixXd h_mid_right(2, 2);
-		h_mid_right << (x_diff / sqrt(squared_diff)), (y_diff / sqrt(squared_diff)), (-y_diff / sqrt(squared_diff)), (x_diff / sqrt(squared_diff));
+		Eigen::MatrixXd h_mid_right = -h_left.rightCols(2);
 
 		Eigen::MatrixXd h_right = Eigen::MatrixXd::Zero(2, 2 * map_state.size() - 2*(j + 1));
 
@@ -332,6 +374,47 @@ namespace nuslam
 
     void EKF::msr_update(const std::vector<Point> & measurements_)
     {
+    	static LatencyHistogram & update_latency = latency_registry().histogram("ekf.msr_update");
+    	static LatencyHistogram & association_latency = latency_registry().histogram("ekf.association");
+    	ScopedTimer timer(update_latency);
+
+    	// Localization-only mode: fixed-size association against the landmarks near the robot
+    	if (frozen)
+    	{
+    		const Eigen::Matrix2d R = msr_noise.R;
+    		const Eigen::Matrix2d L = R.llt().matrixL();
+    		for (auto iter = measurements_.begin(); iter != measurements_.end(); iter++)
+    		{
+    			// Same draws as getMultivarNoise
+    			Eigen::Vector2d sample;
+    			for (int i = 0; i < 2; i++)
+    			{
+    				std::normal_distribution<double> d(0, 1);
+    				sample(i) = d(get_random());
+    			}
+    			Eigen::Vector2d z(iter->range_bear.range, iter->range_bear.bearing);
+    			z += L * sample;
+    			z(1) = rigid2d::normalize_angle(z(1));
+
+    			unsigned int j = N;
+    			double d_star = 0.0;
+    			{
+    				ScopedTimer association_timer(association_latency);
+    				j = associate_frozen(z, d_star);
+    			}
+    			if (j < N && d_star < mahalanobis_lower)
+    			{
+    				update_frozen(z, j);
+    			}
+    		}
+
+    		// Landmarks are fixed, so only the robot state changes
+    		robot_state.theta = rigid2d::normalize_angle(State(0));
+    		robot_state.x = State(1);
+    		robot_state.y = State(2);
+    		return;
+    	}
+
     	// By incorporating one measurement at a time, we improve our state estimate over time
     	// and are thus improving the accuracy of our linearization and getting better EKFSLAM performance
     	for (auto iter = measurements_.begin(); iter != measurements_.end(); iter++)
@@ -349,11 +432,17 @@ namespace nuslam
     		z(1) = rigid2d::normalize_angle(z(1));
     		// std::cout << "z: " << z << std::endl;
 
-    		std::vector<double> d_k = mahalanobis_test(z);
+    		// Data association, timed per measurement
+    		long int d_star_index = 0;
+    		double d_star = 0.0;
+    		{
+    			ScopedTimer association_timer(association_latency);
+	    		std::vector<double> d_k = mahalanobis_test(z);
 
-    		// Find minimum mahalanobis distance d* index of d*
-			auto d_star_index = std::min_element(d_k.begin(), d_k.end()) - d_k.begin();
-			double d_star = d_k.at(d_star_index);
+	    		// Find minimum mahalanobis distance d* index of d*
+				d_star_index = std::min_element(d_k.begin(), d_k.end()) - d_k.begin();
+				d_star = d_k.at(d_star_index);
+			}
 
 			// std::cout << "dstar " << d_star << std::endl;
 
@@ -431,8 +520,11 @@ namespace nuslam
 			    	State(0) = rigid2d::normalize_angle(State(0));
 			 
 			    	// Compute the posterior covariance
-			    	cov_mtx.cov_mtx = (Eigen::MatrixXd::Identity(3 + (2 * map_state.size()), 3 + (2 * map_state.size())) - K * H) * cov_mtx.cov_mtx;
+			    	cov_mtx.cov_mtx = (Eigen::MatrixXd::Identity(K.rows(), K.rows()) - K * H) * cov_mtx.cov_mtx;
 			    	// std::cout << "cov_mtx.cov_mtx: \n" << cov_mtx.cov_mtx << std::endl;
+
+			    	// Record number of measurements incorporated for this landmark
+			    	map_state.at(i).seen_count++;
 				} else {
 					// throw std::invalid_argument("N CANNOT EXCEED MAXIMUM NUMBER OF LANDMARKS");
 					N = map_state.size();
@@ -455,6 +547,86 @@ namespace nuslam
     	}
     }
 
+    unsigned int EKF::associate_frozen(const Eigen::Vector2d & z, double & d_star) const
+    {
+    	d_star = std::numeric_limits<double>::infinity();
+    	unsigned int best = N;
+    	if (frozen_cells.empty())
+    	{
+    		return best;
+    	}
+
+    	// Fixed-size copies of the robot covariance and measurement noise
+    	const Eigen::Matrix3d P = cov_mtx.cov_mtx;
+    	const Eigen::Matrix2d R = msr_noise.R;
+    	const double x = State(1), y = State(2), theta = State(0);
+
+    	// Landmarks farther than this from the predicted pose cannot have produced the measurement
+    	// without a larger pose error than its covariance allows
+    	const double radius = std::max(max_range, z(0)) + 3.0 * std::sqrt(std::max(P(1, 1) + P(2, 2), 0.0));
+    	const double radius_sq = radius * radius;
+    	const long int min_cx = std::max(static_cast<long int>(std::floor((x - radius - grid_min_x) / cell_size)), 0L);
+    	const long int max_cx = std::min(static_cast<long int>(std::floor((x + radius - grid_min_x) / cell_size)), grid_width - 1);
+    	const long int min_cy = std::max(static_cast<long int>(std::floor((y - radius - grid_min_y) / cell_size)), 0L);
+    	const long int max_cy = std::min(static_cast<long int>(std::floor((y + radius - grid_min_y) / cell_size)), grid_height - 1);
+
+    	for (long int cy = min_cy; cy <= max_cy; cy++)
+    	{
+    		for (long int cx = min_cx; cx <= max_cx; cx++)
+    		{
+    			const long int c = cy * grid_width + cx;
+    			for (unsigned int l = frozen_cells[c]; l < frozen_cells[c + 1]; l++)
+    			{
+    				const unsigned int k = frozen_landmarks[l];
+    				const double x_diff = State(3 + 2*k) - x;
+    				const double y_diff = State(4 + 2*k) - y;
+    				const double squared_diff = x_diff * x_diff + y_diff * y_diff;
+    				if (squared_diff > radius_sq || !(squared_diff > 0.0))
+    				{
+    					continue;
+    				}
+    				const double dist = std::sqrt(squared_diff);
+
+    				// Same Jacobian and expected measurement as inv_msr_model and mahalanobis_test
+    				const Eigen::Matrix<double, 2, 3> H = msr_jacobian(x_diff, y_diff);
+    				const Eigen::Matrix2d psi = H * P * H.transpose() + R;
+    				Eigen::Vector2d z_diff(z(0) - dist, z(1) - rigid2d::normalize_angle(rigid2d::normalize_angle(std::atan2(y_diff, x_diff)) - theta));
+    				z_diff(1) = rigid2d::normalize_angle(z_diff(1));
+
+    				const double d = z_diff.dot(psi.inverse() * z_diff);
+    				if (d < d_star)
+    				{
+    					d_star = d;
+    					best = k;
+    				}
+    			}
+    		}
+    	}
+    	return best;
+    }
+
+    void EKF::update_frozen(const Eigen::Vector2d & z, const unsigned int & j)
+    {
+    	const double x_diff = State(3 + 2*j) - State(1);
+    	const double y_diff = State(4 + 2*j) - State(2);
+    	const double dist = std::sqrt(x_diff * x_diff + y_diff * y_diff);
+    	const Eigen::Vector2d z_hat(dist, rigid2d::normalize_angle(rigid2d::normalize_angle(std::atan2(y_diff, x_diff)) - State(0)));
+
+    	const Eigen::Matrix<double, 2, 3> H = msr_jacobian(x_diff, y_diff);
+    	const Eigen::Matrix3d P = cov_mtx.cov_mtx;
+    	const Eigen::Matrix2d R = msr_noise.R;
+    	const Eigen::Matrix<double, 3, 2> K = P * H.transpose() * (H * P * H.transpose() + R).inverse();
+
+    	Eigen::Vector2d z_diff = z - z_hat;
+    	z_diff(1) = rigid2d::normalize_angle(z_diff(1));
+    	State.head<3>() += K * z_diff;
+    	State(0) = rigid2d::normalize_angle(State(0));
+    	cov_mtx.cov_mtx = (Eigen::Matrix3d::Identity() - K * H) * P;
+
+    	// Record number of measurements incorporated for this landmark
+    	map_state.at(j).seen_count++;
+    }
+
     std::vector<double> EKF::mahalanobis_test(const Eigen::VectorXd & z)
     {
     	// steps 10-18 in Probabilistic Robotics, EKFSLAM with Unknown Data Association
@@ -505,17 +677,94 @@ namespace nuslam
     	return d_k;
     }
 
+    void EKF::pose_update(const Pose2D & measured, const Pose2D & noise_var)
+    {
+    	static LatencyHistogram & pose_latency = latency_registry().histogram("ekf.pose_update");
+    	ScopedTimer timer(pose_latency);
+
+    	// robot_state is the latest belief, e.g. after reset_pose
+    	State(0) = robot_state.theta;
+    	State(1) = robot_state.x;
+    	State(2) = robot_state.y;
+
+    	// H = [I 0], so H * P * H^T is the robot block and P * H^T its first three columns
+    	Eigen::Matrix3d R = Eigen::Matrix3d::Zero();
+    	R(0, 0) = noise_var.theta;
+    	R(1, 1) = noise_var.x;
+    	R(2, 2) = noise_var.y;
+    	Eigen::Matrix3d S = cov_mtx.cov_mtx.topLeftCorner(3, 3) + R;
+    	// (2n+3)*3, or 3*3 if the map is frozen
+    	Eigen::MatrixXd K = cov_mtx.cov_mtx.leftCols(3) * S.inverse();
+
+    	Eigen::Vector3d z_diff(rigid2d::normalize_angle(measured.theta - State(0)), measured.x - State(1), measured.y - State(2));
+    	State.head(K.rows()) += K * z_diff;
+    	State(0) = rigid2d::normalize_angle(State(0));
+    	cov_mtx.cov_mtx -= K * cov_mtx.cov_mtx.topRows(3);
+
+    	// Update returnable values (robot and map state)
+    	robot_state.theta = State(0);
+    	robot_state.x = State(1);
+    	robot_state.y = State(2);
+    	for (long unsigned int i = 0; i < map_state.size(); i++)
+    	{
+    		map_state.at(i).pose.x = State(3 + 2*i);
+    		map_state.at(i).pose.y = State(4 + 2*i);
+    	}
+    }
+
+    void EKF::predict_measurements(std::vector<MeasurementPrediction> & predictions) const
+    {
+    	predictions.clear();
+    	predictions.reserve(N);
+
+    	// robot_state is the latest belief, e.g. after reset_pose
+    	const Eigen::Matrix3d P_rr = cov_mtx.cov_mtx.topLeftCorner(3, 3);
+    	for (unsigned long int j = 0; j < N && j < map_state.size(); j++)
+    	{
+    		const double x_diff = map_state.at(j).pose.x - robot_state.x;
+    		const double y_diff = map_state.at(j).pose.y - robot_state.y;
+    		const double squared_diff = x_diff * x_diff + y_diff * y_diff;
+    		if (squared_diff <= 0.0)
+    		{
+    			continue;
+    		}
+
+    		MeasurementPrediction prediction;
+    		prediction.index = j;
+    		prediction.range_bear.range = std::sqrt(squared_diff);
+    		prediction.range_bear.bearing = rigid2d::normalize_angle(std::atan2(y_diff, x_diff) - robot_state.theta);
+
+    		// Jacobian of (range, bearing) with respect to (theta, x, y) and to the landmark's (x, y)
+    		const Eigen::Matrix<double, 2, 3> H_r = msr_jacobian(x_diff, y_diff);
+    		Eigen::Matrix2d S = H_r * P_rr * H_r.transpose() + msr_noise.R;
+
+    		// Landmarks are not part of the estimated state when the map is frozen
+    		if (!frozen)
+    		{
+    			const Eigen::Matrix2d H_m = -H_r.rightCols<2>();
+    			const Eigen::Matrix<double, 3, 2> P_rm = cov_mtx.cov_mtx.block(0, 3 + 2*j, 3, 2);
+    			const Eigen::Matrix2d P_mm = cov_mtx.cov_mtx.block(3 + 2*j, 3 + 2*j, 2, 2);
+    			const Eigen::Matrix2d cross = H_r * P_rm * H_m.transpose();
+    			S += cross + cross.transpose() + H_m * P_mm * H_m.transpose();
+    		}
+
+    		prediction.sigma.range = std::sqrt(std::max(S(0, 0), 0.0));
+    		prediction.sigma.bearing = std::sqrt(std::max(S(1, 1), 0.0));
+    		predictions.push_back(prediction);
+    	}
+    }
+
     // Eigen::MatrixXd EKF::nearestSPD(const Eigen::MatrixXd & mtx)
     // {
 
     // }
 
-    Pose2D EKF::return_pose()
+    const Pose2D & EKF::return_pose() const
     {
     	return robot_state;
     }
 
-    std::vector<Point> EKF::return_map()
+    const std::vector<Point> & EKF::return_map() const
     {
     	return map_state;
     }
@@ -524,4 +773,190 @@ namespace nuslam
     {
     	robot_state = pose;
     }
+
+    void EKF::save_map(const std::string & filename) const
+    {
+    	if (frozen)
+    	{
+    		// Reassemble full covariance from the frozen landmark block and current robot block
+    		Eigen::MatrixXd full_cov = frozen_map_file ? Eigen::MatrixXd(frozen_map_file->covariance()) : frozen_cov;
+    		full_cov.topLeftCorner(3, 3) = cov_mtx.cov_mtx;
+    		full_cov.topRightCorner(3, full_cov.cols() - 3).setZero();
+    		full_cov.bottomLeftCorner(full_cov.rows() - 3, 3).setZero();
+    		write_map_file(filename, State, full_cov, map_state, N);
+    	} else {
+    		write_map_file(filename, State, cov_mtx.cov_mtx, map_state, N);
+    	}
+    }
+
+    void EKF::load_map(const MapFile & map_file)
+    {
+    	if (frozen)
+    	{
+    		throw std::logic_error("Cannot load a map into a frozen EKF.");
+    	}
+
+    	unsigned long int n = map_file.map_size();
+    	unsigned long int dim = 3 + 2 * n;
+
+    	// Robot state and covariance are kept
+    	Eigen::Matrix3d robot_cov = cov_mtx.cov_mtx.topLeftCorner(3, 3);
+
+    	// Landmark means and covariance straight from the mapped file
+    	State = map_file.state();
+    	State(0) = robot_state.theta;
+    	State(1) = robot_state.x;
+    	State(2) = robot_state.y;
+
+    	cov_mtx.cov_mtx = map_file.covariance();
+    	cov_mtx.cov_mtx.topLeftCorner(3, 3) = robot_cov;
+    	cov_mtx.cov_mtx.topRightCorner(3, dim - 3).setZero();
+    	cov_mtx.cov_mtx.bottomLeftCorner(dim - 3, 3).setZero();
+
+    	map_state.assign(n, Point());
+    	for (unsigned long int i = 0; i < n; i++)
+    	{
+    		map_state.at(i).pose.x = State(3 + 2*i);
+    		map_state.at(i).pose.y = State(4 + 2*i);
+    		map_state.at(i).seen_count = map_file.seen_count(i);
+    	}
+
+    	// Process noise must match the (possibly different) map size
+    	proc_noise = ProcessNoise(proc_noise.xyt_noise, n);
+    	N = map_file.seen();
+    }
+
+    void EKF::load_frozen_map(const std::shared_ptr<const MapFile> & map_file)
+    {
+    	if (frozen)
+    	{
+    		throw std::logic_error("Cannot load a map into a frozen EKF.");
+    	}
+
+    	unsigned long int n = map_file->map_size();
+
+    	// Robot state and covariance are kept, landmark means are copied from the mapped file
+    	Eigen::Matrix3d robot_cov = cov_mtx.cov_mtx.topLeftCorner(3, 3);
+    	State = map_file->state();
+    	State(0) = robot_state.theta;
+    	State(1) = robot_state.x;
+    	State(2) = robot_state.y;
+
+    	map_state.assign(n, Point());
+    	for (unsigned long int i = 0; i < n; i++)
+    	{
+    		map_state.at(i).pose.x = State(3 + 2*i);
+    		map_state.at(i).pose.y = State(4 + 2*i);
+    		map_state.at(i).seen_count = map_file->seen_count(i);
+    	}
+    	N = map_file->seen();
+
+    	// Landmark covariance stays in the file until the map is saved
+    	frozen_cov.resize(0, 0);
+    	frozen_map_file = map_file;
+    	cov_mtx.cov_mtx = robot_cov;
+    	proc_noise = ProcessNoise(proc_noise.xyt_noise, 0);
+
+    	index_frozen_map();
+    	frozen = true;
+    }
+
+    void EKF::set_map(const std::vector<Point> & landmarks)
+    {
+    	if (frozen)
+    	{
+    		throw std::logic_error("Cannot set the map of a frozen EKF.");
+    	}
+
+    	unsigned long int n = landmarks.size();
+    	unsigned long int dim = 3 + 2 * n;
+
+    	// Robot state and covariance are kept
+    	Eigen::Matrix3d robot_cov = cov_mtx.cov_mtx.topLeftCorner(3, 3);
+
+    	State = Eigen::VectorXd::Zero(dim);
+    	State(0) = robot_state.theta;
+    	State(1) = robot_state.x;
+    	State(2) = robot_state.y;
+
+    	map_state = landmarks;
+    	for (unsigned long int i = 0; i < n; i++)
+    	{
+    		State(3 + 2*i) = map_state.at(i).pose.x;
+    		State(4 + 2*i) = map_state.at(i).pose.y;
+    	}
+
+    	// Known landmarks have no uncertainty
+    	cov_mtx.cov_mtx = Eigen::MatrixXd::Zero(dim, dim);
+    	cov_mtx.cov_mtx.topLeftCorner(3, 3) = robot_cov;
+
+    	proc_noise = ProcessNoise(proc_noise.xyt_noise, n);
+    	N = n;
+    }
+
+    void EKF::freeze_map()
+    {
+    	if (frozen)
+    	{
+    		return;
+    	}
+
+    	// Only the robot covariance is propagated from now on. Keep landmark block so the map can still be saved.
+    	Eigen::MatrixXd robot_cov = cov_mtx.cov_mtx.topLeftCorner(3, 3);
+    	frozen_cov = std::move(cov_mtx.cov_mtx);
+    	cov_mtx.cov_mtx = robot_cov;
+    	proc_noise = ProcessNoise(proc_noise.xyt_noise, 0);
+
+    	index_frozen_map();
+    	frozen = true;
+    }
+
+    void EKF::index_frozen_map()
+    {
+    	// Index the seen landmarks in a uniform grid, so that association only visits those near the robot
+    	frozen_cells.clear();
+    	frozen_landmarks.clear();
+    	if (N > 0)
+    	{
+    		cell_size = max_range > 0.0 ? max_range : 1.0;
+    		double max_x = State(3), max_y = State(4);
+    		grid_min_x = max_x;
+    		grid_min_y = max_y;
+    		for (unsigned int k = 1; k < N; k++)
+    		{
+    			grid_min_x = std::min(grid_min_x, State(3 + 2*k));
+    			grid_min_y = std::min(grid_min_y, State(4 + 2*k));
+    			max_x = std::max(max_x, State(3 + 2*k));
+    			max_y = std::max(max_y, State(4 + 2*k));
+    		}
+    		grid_width = static_cast<long int>(std::floor((max_x - grid_min_x) / cell_size)) + 1;
+    		grid_height = static_cast<long int>(std::floor((max_y - grid_min_y) / cell_size)) + 1;
+
+    		// Count the landmarks of each cell, turn the counts into offsets, then place the landmarks
+    		std::vector<unsigned int> cell_of(N);
+    		frozen_cells.assign(grid_width * grid_height + 1, 0);
+    		for (unsigned int k = 0; k < N; k++)
+    		{
+    			const long int cx = static_cast<long int>(std::floor((State(3 + 2*k) - grid_min_x) / cell_size));
+    			const long int cy = static_cast<long int>(std::floor((State(4 + 2*k) - grid_min_y) / cell_size));
+    			cell_of[k] = cy * grid_width + cx;
+    			frozen_cells[cell_of[k] + 1]++;
+    		}
+    		for (unsigned long int c = 1; c < frozen_cells.size(); c++)
+    		{
+    			frozen_cells[c] += frozen_cells[c - 1];
+    		}
+    		frozen_landmarks.resize(N);
+    		std::vector<unsigned int> next(frozen_cells.begin(), frozen_cells.end() - 1);
+    		for (unsigned int k = 0; k < N; k++)
+    		{
+    			frozen_landmarks[next[cell_of[k]]++] = k;
+    		}
+    	}
+    }
+
+    bool EKF::map_frozen() const
+    {
+    	return frozen;
+    }
 }
\ No newline at end of file
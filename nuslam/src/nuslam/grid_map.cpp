@@ -0,0 +1,302 @@
+#include "nuslam/grid_map.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace nuslam
+{
+	// Log-odds are stored in units of 1 / LOG_ODDS_SCALE
+	static constexpr double LOG_ODDS_SCALE = 100.0;
+
+	// Fixed-point log-odds of a probability
+	static std::int16_t to_log_odds(const double & p)
+	{
+		return static_cast<std::int16_t>(std::lround(std::log(p / (1.0 - p)) * LOG_ODDS_SCALE));
+	}
+
+	// Key of a tile in the tile index
+	static std::uint64_t tile_key(const std::int32_t & tx, const std::int32_t & ty)
+	{
+		return (static_cast<std::uint64_t>(static_cast<std::uint32_t>(tx)) << 32) | static_cast<std::uint32_t>(ty);
+	}
+
+	// Tile containing a cell coordinate, rounding towards negative infinity
+	static std::int32_t tile_coord(const std::int32_t & c)
+	{
+		return c >= 0 ? c / GridMap::TILE_SIZE : -((-c - 1) / GridMap::TILE_SIZE) - 1;
+	}
+
+	// GridBounds
+	GridBounds::GridBounds()
+	{
+		min_x = 0;
+		min_y = 0;
+		width = 0;
+		height = 0;
+	}
+
+	// GridMap
+	GridMap::GridMap() : GridMap(0.05, 0.7, 0.4, 0.12, 0.97)
+	{
+	}
+
+	GridMap::GridMap(const double & resolution_, const double & p_hit, const double & p_miss,\
+					 const double & p_min, const double & p_max)
+	{
+		if (!(resolution_ > 0.0))
+		{
+			throw std::invalid_argument("GridMap resolution must be positive.");
+		}
+		if (!(0.0 < p_min && p_min < p_miss && p_miss < 0.5 && 0.5 < p_hit && p_hit < p_max && p_max < 1.0))
+		{
+			throw std::invalid_argument("GridMap probabilities must satisfy 0 < p_min < p_miss < 0.5 < p_hit < p_max < 1.");
+		}
+		res = resolution_;
+		hit_update = to_log_odds(p_hit);
+		miss_update = to_log_odds(p_miss);
+		min_log_odds = to_log_odds(p_min);
+		max_log_odds = to_log_odds(p_max);
+
+		occupancy_table.resize(max_log_odds - min_log_odds + 1);
+		for (std::int32_t l = min_log_odds; l <= max_log_odds; l++)
+		{
+			double p = 1.0 / (1.0 + std::exp(-l / LOG_ODDS_SCALE));
+			occupancy_table.at(l - min_log_odds) = static_cast<std::int8_t>(std::lround(p * 100.0));
+		}
+
+		min_tx = 0;
+		min_ty = 0;
+		max_tx = -1;
+		max_ty = -1;
+	}
+
+	void GridMap::insert_ray(const Vector2D & from, const Vector2D & to, const bool & hit)
+	{
+		Tile * tile = nullptr;
+		trace(cell_coord(from.x), cell_coord(from.y), cell_coord(to.x), cell_coord(to.y), hit, tile);
+	}
+
+	void GridMap::insert_scan(const Pose2D & sensor, const ScanCloud & scan)
+	{
+		const double c = std::cos(sensor.theta);
+		const double s = std::sin(sensor.theta);
+		const std::int32_t x0 = cell_coord(sensor.x);
+		const std::int32_t y0 = cell_coord(sensor.y);
+
+		// Consecutive beams mostly cross the same tiles, so the tile cache is kept across them
+		Tile * tile = nullptr;
+		for (unsigned long int i = 0; i < scan.size(); i++)
+		{
+			double x = sensor.x + c * scan.x[i] - s * scan.y[i];
+			double y = sensor.y + s * scan.x[i] + c * scan.y[i];
+			trace(x0, y0, cell_coord(x), cell_coord(y), true, tile);
+		}
+	}
+
+	std::int16_t GridMap::log_odds(const Vector2D & p) const
+	{
+		std::int32_t cx = cell_coord(p.x);
+		std::int32_t cy = cell_coord(p.y);
+		const Tile * tile = find_tile(tile_coord(cx), tile_coord(cy));
+		if (tile == nullptr)
+		{
+			return UNKNOWN;
+		}
+		return tile->cells[((cy & (TILE_SIZE - 1)) << TILE_BITS) | (cx & (TILE_SIZE - 1))];
+	}
+
+	std::int8_t GridMap::occupancy(const Vector2D & p) const
+	{
+		return to_occupancy(log_odds(p));
+	}
+
+	double GridMap::resolution() const
+	{
+		return res;
+	}
+
+	unsigned long int GridMap::num_tiles() const
+	{
+		return tiles.size();
+	}
+
+	GridBounds GridMap::bounds() const
+	{
+		GridBounds result;
+		if (tiles.empty())
+		{
+			return result;
+		}
+		result.min_x = min_tx * TILE_SIZE;
+		result.min_y = min_ty * TILE_SIZE;
+		result.width = static_cast<std::uint32_t>(max_tx - min_tx + 1) * TILE_SIZE;
+		result.height = static_cast<std::uint32_t>(max_ty - min_ty + 1) * TILE_SIZE;
+		return result;
+	}
+
+	void GridMap::export_grid(std::vector<std::int8_t> & data) const
+	{
+		GridBounds b = bounds();
+		data.assign(static_cast<unsigned long int>(b.width) * b.height, -1);
+		for (auto iter = tiles.begin(); iter != tiles.end(); iter++)
+		{
+			unsigned long int origin = static_cast<unsigned long int>(iter->ty * TILE_SIZE - b.min_y) * b.width\
+									   + static_cast<unsigned long int>(iter->tx * TILE_SIZE - b.min_x);
+			for (std::int32_t row = 0; row < TILE_SIZE; row++)
+			{
+				const std::int16_t * cells = iter->cells.data() + row * TILE_SIZE;
+				std::int8_t * out = data.data() + origin + static_cast<unsigned long int>(row) * b.width;
+				for (std::int32_t col = 0; col < TILE_SIZE; col++)
+				{
+					out[col] = to_occupancy(cells[col]);
+				}
+			}
+		}
+	}
+
+	const std::vector<std::uint32_t> & GridMap::dirty_tiles() const
+	{
+		return dirty;
+	}
+
+	void GridMap::clear_dirty()
+	{
+		for (auto iter = dirty.begin(); iter != dirty.end(); iter++)
+		{
+			tiles[*iter].dirty = false;
+		}
+		dirty.clear();
+	}
+
+	GridBounds GridMap::tile_bounds(const std::uint32_t & tile) const
+	{
+		const Tile & t = tiles.at(tile);
+		GridBounds result;
+		result.min_x = t.tx * TILE_SIZE;
+		result.min_y = t.ty * TILE_SIZE;
+		result.width = TILE_SIZE;
+		result.height = TILE_SIZE;
+		return result;
+	}
+
+	void GridMap::export_tile(const std::uint32_t & tile, std::vector<std::int8_t> & data) const
+	{
+		const Tile & t = tiles.at(tile);
+		data.resize(TILE_CELLS);
+		for (std::uint32_t i = 0; i < TILE_CELLS; i++)
+		{
+			data[i] = to_occupancy(t.cells[i]);
+		}
+	}
+
+	GridMap::Tile * GridMap::find_tile(const std::int32_t & tx, const std::int32_t & ty, const bool & create)
+	{
+		auto found = tile_index.find(tile_key(tx, ty));
+		if (found != tile_index.end())
+		{
+			return &tiles[found->second];
+		}
+		if (!create)
+		{
+			return nullptr;
+		}
+
+		Tile tile;
+		tile.tx = tx;
+		tile.ty = ty;
+		tile.index = static_cast<std::uint32_t>(tiles.size());
+		tile.dirty = false;
+		tile.cells.fill(UNKNOWN);
+		tiles.push_back(tile);
+		tile_index.emplace(tile_key(tx, ty), tile.index);
+
+		if (tiles.size() == 1)
+		{
+			min_tx = tx;
+			min_ty = ty;
+			max_tx = tx;
+			max_ty = ty;
+		} else {
+			min_tx = std::min(min_tx, tx);
+			min_ty = std::min(min_ty, ty);
+			max_tx = std::max(max_tx, tx);
+			max_ty = std::max(max_ty, ty);
+		}
+		return &tiles.back();
+	}
+
+	const GridMap::Tile * GridMap::find_tile(const std::int32_t & tx, const std::int32_t & ty) const
+	{
+		auto found = tile_index.find(tile_key(tx, ty));
+		if (found == tile_index.end())
+		{
+			return nullptr;
+		}
+		return &tiles[found->second];
+	}
+
+	void GridMap::trace(const std::int32_t & x0, const std::int32_t & y0, const std::int32_t & x1, const std::int32_t & y1,\
+						const bool & hit, Tile * & tile)
+	{
+		// Bresenham's line algorithm: integer steps only, no per-cell division or rounding
+		const std::int32_t dx = std::abs(x1 - x0);
+		const std::int32_t dy = -std::abs(y1 - y0);
+		const std::int32_t sx = x0 < x1 ? 1 : -1;
+		const std::int32_t sy = y0 < y1 ? 1 : -1;
+		std::int32_t err = dx + dy;
+		std::int32_t x = x0;
+		std::int32_t y = y0;
+
+		while (true)
+		{
+			const bool end = x == x1 && y == y1;
+
+			// Tile lookups only happen when the beam crosses into another tile
+			std::int32_t tx = tile_coord(x);
+			std::int32_t ty = tile_coord(y);
+			if (tile == nullptr || tile->tx != tx || tile->ty != ty)
+			{
+				tile = find_tile(tx, ty, true);
+			}
+
+			std::int16_t & cell = tile->cells[((y & (TILE_SIZE - 1)) << TILE_BITS) | (x & (TILE_SIZE - 1))];
+			std::int32_t l = (cell == UNKNOWN ? 0 : cell) + (end && hit ? hit_update : miss_update);
+			cell = static_cast<std::int16_t>(std::min<std::int32_t>(std::max<std::int32_t>(l, min_log_odds), max_log_odds));
+			if (!tile->dirty)
+			{
+				tile->dirty = true;
+				dirty.push_back(tile->index);
+			}
+
+			if (end)
+			{
+				break;
+			}
+			std::int32_t e2 = 2 * err;
+			if (e2 >= dy)
+			{
+				err += dy;
+				x += sx;
+			}
+			if (e2 <= dx)
+			{
+				err += dx;
+				y += sy;
+			}
+		}
+	}
+
+	std::int32_t GridMap::cell_coord(const double & v) const
+	{
+		return static_cast<std::int32_t>(std::floor(v / res));
+	}
+
+	std::int8_t GridMap::to_occupancy(const std::int16_t & l) const
+	{
+		if (l == UNKNOWN)
+		{
+			return -1;
+		}
+		return occupancy_table[l - min_log_odds];
+	}
+}
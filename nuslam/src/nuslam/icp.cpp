@@ -0,0 +1,319 @@
+#include "nuslam/icp.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <eigen3/Eigen/Dense>
+
+namespace nuslam
+{
+	// KDTree2D
+	KDTree2D::KDTree2D()
+	{
+	}
+
+	void KDTree2D::build(const std::vector<double> & x, const std::vector<double> & y)
+	{
+		if (x.size() != y.size())
+		{
+			throw std::invalid_argument("KDTree2D x and y must have the same length.");
+		}
+		nodes.resize(x.size());
+		for (std::uint32_t i = 0; i < nodes.size(); i++)
+		{
+			nodes[i].x = x[i];
+			nodes[i].y = y[i];
+			nodes[i].id = i;
+			nodes[i].axis = 0;
+		}
+		build(0, static_cast<std::uint32_t>(nodes.size()));
+	}
+
+	std::uint32_t KDTree2D::nearest(const double & qx, const double & qy, const double & max_distance) const
+	{
+		double best_sq = max_distance * max_distance;
+		std::uint32_t best = npos;
+		search(0, static_cast<std::uint32_t>(nodes.size()), qx, qy, best_sq, best);
+		return best == npos ? npos : nodes[best].id;
+	}
+
+	std::uint32_t KDTree2D::size() const
+	{
+		return static_cast<std::uint32_t>(nodes.size());
+	}
+
+	void KDTree2D::build(const std::uint32_t & begin, const std::uint32_t & end)
+	{
+		if (end - begin <= 1)
+		{
+			return;
+		}
+
+		// Split along the wider axis of the subrange
+		double min_x = nodes[begin].x, max_x = min_x, min_y = nodes[begin].y, max_y = min_y;
+		for (std::uint32_t i = begin + 1; i < end; i++)
+		{
+			min_x = std::min(min_x, nodes[i].x);
+			max_x = std::max(max_x, nodes[i].x);
+			min_y = std::min(min_y, nodes[i].y);
+			max_y = std::max(max_y, nodes[i].y);
+		}
+		const std::uint32_t split = (max_y - min_y) > (max_x - min_x) ? 1 : 0;
+
+		const std::uint32_t mid = begin + (end - begin) / 2;
+		std::nth_element(nodes.begin() + begin, nodes.begin() + mid, nodes.begin() + end,\
+						 [&split](const Node & a, const Node & b) { return split == 0 ? a.x < b.x : a.y < b.y; });
+		nodes[mid].axis = split;
+		build(begin, mid);
+		build(mid + 1, end);
+	}
+
+	void KDTree2D::search(const std::uint32_t & begin, const std::uint32_t & end, const double & qx, const double & qy,\
+						  double & best_sq, std::uint32_t & best) const
+	{
+		if (begin >= end)
+		{
+			return;
+		}
+		const std::uint32_t mid = begin + (end - begin) / 2;
+		const Node & node = nodes[mid];
+		const double dx = qx - node.x;
+		const double dy = qy - node.y;
+		const double d_sq = dx * dx + dy * dy;
+		if (d_sq < best_sq)
+		{
+			best_sq = d_sq;
+			best = mid;
+		}
+
+		// Near side first; the far side only if the splitting line is closer than the best point
+		const double diff = node.axis == 0 ? dx : dy;
+		if (diff < 0.0)
+		{
+			search(begin, mid, qx, qy, best_sq, best);
+			if (diff * diff < best_sq)
+			{
+				search(mid + 1, end, qx, qy, best_sq, best);
+			}
+		} else {
+			search(mid + 1, end, qx, qy, best_sq, best);
+			if (diff * diff < best_sq)
+			{
+				search(begin, mid, qx, qy, best_sq, best);
+			}
+		}
+	}
+
+	// IcpResult
+	IcpResult::IcpResult()
+	{
+		pose = Pose2D();
+		iterations = 0;
+		correspondences = 0;
+		rmse = 0.0;
+		converged = false;
+	}
+
+	// Icp
+	Icp::Icp() : Icp(IcpMetric::PointToLine, 30, 0.2, 1e-4)
+	{
+	}
+
+	Icp::Icp(const IcpMetric & metric_, const unsigned int & max_iterations_, const double & max_distance_,\
+			 const double & tolerance_)
+	{
+		if (max_iterations_ == 0 || !(max_distance_ > 0.0) || !(tolerance_ > 0.0))
+		{
+			throw std::invalid_argument("Icp iterations, correspondence distance and tolerance must be positive.");
+		}
+		metric = metric_;
+		max_iterations = max_iterations_;
+		max_distance = max_distance_;
+		tolerance = tolerance_;
+	}
+
+	void Icp::set_reference(const ScanCloud & reference)
+	{
+		const unsigned long int n = reference.size();
+		ref_x.assign(reference.x.begin(), reference.x.end());
+		ref_y.assign(reference.y.begin(), reference.y.end());
+		tree.build(ref_x, ref_y);
+
+		// Line through each point from its neighbours in beam order, if they are on the same surface
+		normal_x.assign(n, 0.0);
+		normal_y.assign(n, 0.0);
+		const double max_sq = max_distance * max_distance;
+		for (unsigned long int i = 0; i < n; i++)
+		{
+			unsigned long int prev = i > 0 ? i - 1 : i;
+			unsigned long int next = i + 1 < n ? i + 1 : i;
+			if (std::pow(ref_x[prev] - ref_x[i], 2) + std::pow(ref_y[prev] - ref_y[i], 2) > max_sq)
+			{
+				prev = i;
+			}
+			if (std::pow(ref_x[next] - ref_x[i], 2) + std::pow(ref_y[next] - ref_y[i], 2) > max_sq)
+			{
+				next = i;
+			}
+			const double tx = ref_x[next] - ref_x[prev];
+			const double ty = ref_y[next] - ref_y[prev];
+			const double norm = std::hypot(tx, ty);
+			if (norm > 0.0)
+			{
+				normal_x[i] = -ty / norm;
+				normal_y[i] = tx / norm;
+			}
+		}
+	}
+
+	unsigned long int Icp::reference_size() const
+	{
+		return ref_x.size();
+	}
+
+	IcpResult Icp::align(const ScanCloud & source, const Pose2D & guess)
+	{
+		IcpResult result;
+		result.pose = guess;
+		if (source.size() < 3 || ref_x.size() < 3)
+		{
+			return result;
+		}
+
+		Pose2D pose = guess;
+		while (result.iterations < max_iterations)
+		{
+			const unsigned long int n = associate(source, pose);
+			if (n < 3)
+			{
+				break;
+			}
+			result.iterations++;
+
+			// Update (theta, x, y) applied to the transformed source: p <- R(dtheta) * p + t
+			double dtheta = 0.0, dx = 0.0, dy = 0.0;
+			if (metric == IcpMetric::PointToPoint)
+			{
+				// Closed form: centroids, then the rotation between the centred point sets
+				double mpx = 0.0, mpy = 0.0, mqx = 0.0, mqy = 0.0;
+				for (unsigned long int i = 0; i < n; i++)
+				{
+					mpx += pair_px[i];
+					mpy += pair_py[i];
+					mqx += pair_qx[i];
+					mqy += pair_qy[i];
+				}
+				mpx /= n;
+				mpy /= n;
+				mqx /= n;
+				mqy /= n;
+				double dot = 0.0, cross = 0.0;
+				for (unsigned long int i = 0; i < n; i++)
+				{
+					const double ax = pair_px[i] - mpx, ay = pair_py[i] - mpy;
+					const double bx = pair_qx[i] - mqx, by = pair_qy[i] - mqy;
+					dot += ax * bx + ay * by;
+					cross += ax * by - ay * bx;
+				}
+				dtheta = std::atan2(cross, dot);
+				dx = mqx - (std::cos(dtheta) * mpx - std::sin(dtheta) * mpy);
+				dy = mqy - (std::sin(dtheta) * mpx + std::cos(dtheta) * mpy);
+			} else {
+				// Gauss-Newton on the distances to the reference lines, linearized in dtheta.
+				// Points without a line contribute their x and y distances instead.
+				Eigen::Matrix3d A = Eigen::Matrix3d::Zero();
+				Eigen::Vector3d b = Eigen::Vector3d::Zero();
+				for (unsigned long int i = 0; i < n; i++)
+				{
+					const double ex = pair_px[i] - pair_qx[i];
+					const double ey = pair_py[i] - pair_qy[i];
+					if (pair_nx[i] != 0.0 || pair_ny[i] != 0.0)
+					{
+						const Eigen::Vector3d J(pair_nx[i], pair_ny[i], pair_ny[i] * pair_px[i] - pair_nx[i] * pair_py[i]);
+						const double r = pair_nx[i] * ex + pair_ny[i] * ey;
+						A += J * J.transpose();
+						b += J * r;
+					} else {
+						const Eigen::Vector3d Jx(1.0, 0.0, -pair_py[i]);
+						const Eigen::Vector3d Jy(0.0, 1.0, pair_px[i]);
+						A += Jx * Jx.transpose() + Jy * Jy.transpose();
+						b += Jx * ex + Jy * ey;
+					}
+				}
+				const Eigen::Vector3d delta = A.ldlt().solve(-b);
+				if (!delta.allFinite())
+				{
+					break;
+				}
+				dx = delta(0);
+				dy = delta(1);
+				dtheta = delta(2);
+			}
+
+			// Compose the update with the current pose
+			const double c = std::cos(dtheta), s = std::sin(dtheta);
+			const double x = c * pose.x - s * pose.y + dx;
+			const double y = s * pose.x + c * pose.y + dy;
+			pose = Pose2D(x, y, rigid2d::normalize_angle(pose.theta + dtheta));
+
+			if (std::hypot(dx, dy) < tolerance && std::fabs(dtheta) < tolerance)
+			{
+				result.converged = true;
+				break;
+			}
+		}
+
+		// Statistics at the final pose
+		result.pose = pose;
+		result.correspondences = associate(source, pose);
+		double sum_sq = 0.0;
+		for (unsigned long int i = 0; i < result.correspondences; i++)
+		{
+			sum_sq += std::pow(pair_px[i] - pair_qx[i], 2) + std::pow(pair_py[i] - pair_qy[i], 2);
+		}
+		result.rmse = result.correspondences > 0 ? std::sqrt(sum_sq / result.correspondences) : 0.0;
+		return result;
+	}
+
+	unsigned long int Icp::associate(const ScanCloud & source, const Pose2D & pose)
+	{
+		const unsigned long int n = source.size();
+		moved_x.resize(n);
+		moved_y.resize(n);
+		pair_px.resize(n);
+		pair_py.resize(n);
+		pair_qx.resize(n);
+		pair_qy.resize(n);
+		pair_nx.resize(n);
+		pair_ny.resize(n);
+
+		// Independent per point, over contiguous arrays
+		const double c = std::cos(pose.theta), s = std::sin(pose.theta);
+		const double * sx = source.x.data();
+		const double * sy = source.y.data();
+		double * mx = moved_x.data();
+		double * my = moved_y.data();
+		for (unsigned long int i = 0; i < n; i++)
+		{
+			mx[i] = c * sx[i] - s * sy[i] + pose.x;
+			my[i] = s * sx[i] + c * sy[i] + pose.y;
+		}
+
+		unsigned long int pairs = 0;
+		for (unsigned long int i = 0; i < n; i++)
+		{
+			const std::uint32_t j = tree.nearest(mx[i], my[i], max_distance);
+			if (j == KDTree2D::npos)
+			{
+				continue;
+			}
+			pair_px[pairs] = mx[i];
+			pair_py[pairs] = my[i];
+			pair_qx[pairs] = ref_x[j];
+			pair_qy[pairs] = ref_y[j];
+			pair_nx[pairs] = normal_x[j];
+			pair_ny[pairs] = normal_y[j];
+			pairs++;
+		}
+		return pairs;
+	}
+}
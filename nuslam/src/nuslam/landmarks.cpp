@@ -1,4 +1,6 @@
 #include "nuslam/landmarks.hpp"
+#include <algorithm>
+#include <utility>
 
 namespace nuslam
 {
@@ -52,6 +54,14 @@ namespace nuslam
 		seen_count = 0;
 	}
 
+	// CircleFit
+	CircleFit::CircleFit()
+	{
+		centre = Vector2D();
+		radius = 0;
+		rms = 0;
+	}
+
 	// Landmark
 	Landmark::Landmark()
 	{
@@ -75,11 +85,11 @@ namespace nuslam
 		threshold = threshold_;
 	}
 
-	Landmark::Landmark(const double & radius_, const Point & coords_, const std::vector<Point> points_, const double & threshold_)
+	Landmark::Landmark(const double & radius_, const Point & coords_, std::vector<Point> points_, const double & threshold_)
 	{
 		radius = radius_;
 		coords = coords_;
-		points = points_;
+		points = std::move(points_);
 		threshold = threshold_;
 	}
 
@@ -113,202 +123,39 @@ namespace nuslam
 
 	}
 
-	std::vector<Point> Landmark::return_points()
+	const std::vector<Point> & Landmark::return_points() const
 	{
 		return points;
 	}
 
-	Point Landmark::return_coords()
+	const Point & Landmark::return_coords() const
 	{
 		return coords;
 	}
 
-	double Landmark::return_radius()
+	double Landmark::return_radius() const
 	{
 		return radius;
 	}
 
 	double Landmark::fit_circle()
 	{
-		auto n = std::size(points);
-		// Step 1: Compute x,y coordinates of the centroid of n data points
-		// (xc1, yc1), ...(xcn, yxcn) --> (mean of x,y coords of points)
-		// TODO: FIGURE OUT HOW TO ACCESS Point::pose::x,y
-		std::vector<rigid2d::Vector2D> poses;
-		poses.reserve(points.size());
-		// Syntax below to insert Point::pose elments of points into poses vector
-		std::transform
-		(
-		    points.begin(), points.end(), std::back_inserter(poses),
-		    [](const Point& p) { return p.pose; }
-		);
-
-		// Syntax below to compute mean
-		float mean_x  = std::accumulate(poses.begin(), poses.end(), 0.0, \
-                            std::bind(std::plus<double>(), std::placeholders::_1,
-                            std::bind(&rigid2d::Vector2D::x, std::placeholders::_2))) / static_cast<double>(n);
-		float mean_y  = std::accumulate(poses.begin(), poses.end(), 0.0, \
-                            std::bind(std::plus<double>(), std::placeholders::_1,
-                            std::bind(&rigid2d::Vector2D::y, std::placeholders::_2))) / static_cast<double>(n);
-		// std::cout << "X MEAN: " << mean_x << std::endl;
-
-	    // Step 2: Shift the coordinates so the centroid is at the origin
-	    std::vector<double> z;
-	    z.reserve(points.size());
-	    for (auto iter = points.begin(); iter != points.end(); iter++)
-		{
-			iter->pose.x -= mean_x;
-			iter->pose.y -= mean_y;
-
-			// Step 3: compute zi = xi^2 + yi^2
-			double zi = pow(iter->pose.x, 2) + pow(iter->pose.y, 2);
-			z.push_back(zi);
-		}
-
-		// Step 4: Compute mean of z
-	    double mean_z = std::accumulate(z.begin(), z.end(), 0.0) / static_cast<double>(n);
-	    // std::cout << "z mean: \n" << mean_z << std::endl;
-
-	    // Step 5: form data matrix from n data points
-	    // Create Matrix typedef
-	    // Dynamic says we don't know matrix size for rows, but columns = 4
-	    typedef Eigen::Matrix<double, Eigen::Dynamic, 4> ClusterMat;
-	    // reserving storage
-	    ClusterMat Z = ClusterMat::Zero(n, 4);
-	    // or use r as counter in the loop
-	    Eigen::Index r = 0;
-	    // range-based for-loop via iterator
-	    // p is automatically of type of whatever's inside the vector points
-		for (auto & p : points)
-		{
-		    Z.row(r) << z.at(r), p.pose.x, p.pose.y, 1.0; // fill matrix one row per iteration, then increment row
-		    r++;
-		}
-		// std::cout << "Z: \n" << Z << std::endl;
-
-		// Step 6: Data Matrix M = (1/n) Z.T Z
-		// auto M = Z.transpose() * Z / static_cast<double>(n);
-
-		// Step 7: Constraint Matrix H for 'Hyperaccurate algebraic fit'
-		ClusterMat H = ClusterMat::Zero(4, 4);
-		H.row(0) << 8.0 * mean_z, 0.0, 0.0, 2.0;
-		H.row(1) << 0.0, 1.0, 0.0, 0.0;
-		H.row(2) << 0.0, 0.0, 1.0, 0.0;
-		H.row(3) << 2.0, 0.0, 0.0, 0.0;
-
-		// Step 8: H Inv
-		ClusterMat H_inv = ClusterMat::Zero(4, 4);
-		H_inv.row(0) << 0.0, 0.0, 0.0, 0.5;
-		H_inv.row(1) << 0.0, 1.0, 0.0, 0.0;
-		H_inv.row(2) << 0.0, 0.0, 1.0, 0.0;
-		H_inv.row(3) << 0.5, 0, 0, - 2.0 * mean_z;
-
-		// Step 9: Singular Value Decomposition of Z
-		// ThinV returns a diagonal vector suitable for constructing
-		// a square sigma matrix
-
-		// Using BDCSVD faster for large matrices
-		Eigen::BDCSVD<ClusterMat> Z_svd(Z,  Eigen::DecompositionOptions::ComputeFullV);
-
-		// Using jacobiSvd (accurate, fast for small matrices)
-		// Eigen::JacobiSVD<ClusterMat> Z_svd(Z,  Eigen::DecompositionOptions::ComputeFullV);
-
-		if (n < 10)
-		{
-			// Using jacobiSvd (accurate, fast for small matrices)
-			Eigen::JacobiSVD<ClusterMat> Z_svd(Z,  Eigen::DecompositionOptions::ComputeFullV);
-		}
-		// If the smallest singular value is <10^-12 then A is the 4th column of V
-		// Note that singular value vector is returned in decreasing order
-		// Initialize A Vector of doubles
-		Eigen::MatrixXd A = Eigen::MatrixXd::Zero(4, 1);
-		// ROS_INFO("COMPARING Z_svd");
-		// ROS_INFO("-------------------------------------");
-		// std::cout << "V DIAG: \n" << Z_svd.singularValues() << std::endl;
-		// std::cout << "n SIZE: " << n << std::endl; 
-		if (Z_svd.singularValues()(3) < 1e-12)
+		std::vector<double> x, y;
+		x.reserve(points.size());
+		y.reserve(points.size());
+		for (auto iter = points.begin(); iter != points.end(); iter++)
 		{
-			// ROS_INFO("LESS THRESH");
-			// Step 10: A is the 4th column of the V matrix
-			A = Z_svd.matrixV().col(3);
-		} else {
-			// ROS_INFO("GTR THRESH");
-			// std::cout << "V DIAG: \n" << Z_svd.singularValues() << std::endl;
-			// Step 11:
-			// Construct sigma matrix (diagonal with singular values)
-			Eigen::MatrixXd S = Z_svd.singularValues().asDiagonal();
-			// std::cout << "S: \n" << S << std::endl;
-
-			// Y Matrix = V * Sigma * V^T
-			// std::cout << "V SIZE: " << Z_svd.matrixV().size() << std::endl;
-			// std::cout << "SIGMA SIZE: " << S.size() << std::endl;
-			Eigen::MatrixXd Y = Z_svd.matrixV() * S * Z_svd.matrixV().transpose();
-			// std::cout << "Y: \n" << Y << std::endl;
-
-			// Q Matrix = Y * H_inv * Y
-			Eigen::MatrixXd Q = Y * H_inv * Y;
-			// std::cout << "Q: \n" << Q << std::endl;
-
-			// Find Eigenvalues and Eigenvectors of Q via constructor
-			Eigen::SelfAdjointEigenSolver<ClusterMat> es(Q);
-			// A_eigvect is the eigenvector corresponding to the smallest positive
-			// eigenvalue of Q
-			// Store min positive eigenvalue
-			int min_pos_counter = 0;
-			bool min_found = false;
-
-			// std::cout << "EIGEINVALUES: \n" << es.eigenvalues() << std::endl;
-
-			while (!min_found)
-			{
-				if (min_pos_counter > 3)
-				{
-					std::cout << "NO MINIMUM EIGENVALUE FOUND GREATER THAN ZERO." << std::endl;
-
-				} else if (es.eigenvalues()(min_pos_counter) > 0)
-				{
-					min_found = true;
-				} else {
-					min_pos_counter++;
-				}
-			}
-			
-			// The eigenvector corresponding to the minimum positive eigenvalue
-			Eigen::MatrixXd A_eigvect = es.eigenvectors().col(min_pos_counter);
-			// std::cout << "A_eigvect: \n" << A_eigvect << std::endl;
-
-			// Solve for A = Y_inv * A_star
-			A = Y.completeOrthogonalDecomposition().solve(A_eigvect);
-			// std::cout << "A: \n" << A << std::endl;
+			x.push_back(iter->pose.x);
+			y.push_back(iter->pose.y);
 		}
 
-		// Step 12: eqn of circle is (x - a)^2 + (y - b)^2 = R^2
-		auto a = -A(1) / (2.0 * A(0));
-		auto b = -A(2) / (2.0 * A(0));
-		auto R = sqrt((pow(A(1), 2) + pow(A(2), 2) - (4.0 * A(0) * A(3))) / (4.0 * pow(A(0), 2)));
-		// std::cout << "A MATRIX: \n" << A << std::endl;
+		CircleFit fit = nuslam::fit_circle(x.data(), y.data(), points.size());
 
-		// std::cout << "a: \n" << a << std::endl;
-		// std::cout << "b: \n" << b << std::endl;
-		// std::cout << "r: \n" << R << std::endl;
-
-		// Step 13: We shifted our coordinate system, so actual centroid is at
-		// a + mean_x, b + mean_y
 		// Store Cluster Parameters (coords(x,y) and radius)
-		coords.pose.x = a + mean_x;
-		coords.pose.y = b + mean_y;
-		radius = R;
+		coords.pose = fit.centre;
+		radius = fit.radius;
 
-		// Step 14: Calculate Root-Mean-Squared-Error of the fit
-		auto sum = 0;
-		for (auto iter = points.begin(); iter != points.end(); iter++)
-		{
-			sum += pow((pow(iter->pose.x - a, 2) + pow(iter->pose.y - b, 2) - pow(R, 2) ), 2);
-		}
-
-		auto rms_err = sqrt(sum / static_cast<double>(n));
-
-		return rms_err;
+		return fit.rms;
 	}
 
 
@@ -397,4 +244,142 @@ namespace nuslam
 
 	}
 
+	CircleFit fit_circle(const double * x, const double * y, const unsigned long int & n)
+	{
+		Eigen::Map<const Eigen::VectorXd> xs(x, n);
+		Eigen::Map<const Eigen::VectorXd> ys(y, n);
+
+		// Step 1: Compute x,y coordinates of the centroid of the n data points
+		double mean_x = xs.mean();
+		double mean_y = ys.mean();
+
+		// Step 2-6: the data matrix Z has one row (zi, xi, yi, 1) per point, where the coordinates
+		// are shifted so the centroid is at the origin and zi = xi^2 + yi^2. Only its 4*4 moment
+		// matrix M = Z^T Z is needed, which is accumulated in one pass without storing Z
+		Eigen::Matrix4d M = Eigen::Matrix4d::Zero();
+		for (unsigned long int i = 0; i < n; i++)
+		{
+			double xi = x[i] - mean_x;
+			double yi = y[i] - mean_y;
+			Eigen::Vector4d row(xi * xi + yi * yi, xi, yi, 1.0);
+			M.noalias() += row * row.transpose();
+		}
+		double mean_z = M(0, 3) / static_cast<double>(n);
+
+		// Step 7-8: Inverse of the constraint matrix H for 'Hyperaccurate algebraic fit'
+		Eigen::Matrix4d H_inv;
+		H_inv << 0.0, 0.0, 0.0, 0.5,
+				 0.0, 1.0, 0.0, 0.0,
+				 0.0, 0.0, 1.0, 0.0,
+				 0.5, 0.0, 0.0, - 2.0 * mean_z;
+
+		// Step 9: the right singular vectors of Z are the eigenvectors of M, and its singular
+		// values the square roots of the eigenvalues of M (returned in increasing order)
+		Eigen::SelfAdjointEigenSolver<Eigen::Matrix4d> M_es(M);
+		const Eigen::Matrix4d & V = M_es.eigenvectors();
+		Eigen::Vector4d sigma = M_es.eigenvalues().cwiseMax(0.0).cwiseSqrt();
+
+		// If the smallest singular value is <10^-12 (or lost in the rounding error of M, as for
+		// points exactly on a circle) then A is the corresponding singular vector (Step 10)
+		Eigen::Vector4d A = V.col(0);
+		if (sigma(0) >= 1e-12 && sigma(0) > 1e-7 * sigma(3))
+		{
+			// Step 11: Y = V * Sigma * V^T, Q = Y * H_inv * Y
+			Eigen::Matrix4d Y = V * sigma.asDiagonal() * V.transpose();
+			Eigen::Matrix4d Q = Y * H_inv * Y;
+
+			// A_star is the eigenvector corresponding to the smallest positive eigenvalue of Q
+			// (eigenvalues are returned in increasing order)
+			Eigen::SelfAdjointEigenSolver<Eigen::Matrix4d> es(Q);
+			int min_pos_counter = 0;
+			while (min_pos_counter < 3 && es.eigenvalues()(min_pos_counter) <= 0)
+			{
+				min_pos_counter++;
+			}
+
+			// A = Y_inv * A_star, where Y_inv = V * Sigma_inv * V^T
+			A = V * sigma.cwiseInverse().asDiagonal() * V.transpose() * es.eigenvectors().col(min_pos_counter);
+		}
+
+		// Step 12: eqn of circle is (x - a)^2 + (y - b)^2 = R^2
+		double a = -A(1) / (2.0 * A(0));
+		double b = -A(2) / (2.0 * A(0));
+		double R = sqrt((pow(A(1), 2) + pow(A(2), 2) - (4.0 * A(0) * A(3))) / (4.0 * pow(A(0), 2)));
+
+		// Step 13: We shifted our coordinate system, so actual centroid is at
+		// a + mean_x, b + mean_y
+		CircleFit fit;
+		fit.centre = Vector2D(a + mean_x, b + mean_y);
+		fit.radius = R;
+
+		// Step 14: Calculate Root-Mean-Squared-Error of the fit
+		fit.rms = sqrt((((xs.array() - mean_x - a).square() + (ys.array() - mean_y - b).square() - R * R).square()).mean());
+
+		return fit;
+	}
+
+	std::vector<Landmark> cluster_points(const std::vector<Point> & points, const double & threshold)
+	{
+		std::vector<Landmark> landmarks;
+
+		if (points.empty())
+		{
+			return landmarks;
+		}
+
+		// Create New Cluster (points which potentially form a landmark)
+		Landmark cluster(threshold);
+
+		for (auto iter = points.begin(); iter != points.end(); iter++)
+		{
+			// Evaluate Point to see if it fits within the cluster. If it is the first point, it always fits
+			if (!cluster.evaluate_point(*iter))
+			{
+				// Cluster has been completed
+				landmarks.push_back(std::move(cluster));
+
+				// Re-initialize cluster and add the current point to it
+				cluster = Landmark(threshold);
+				cluster.evaluate_point(*iter);
+			}
+		}
+		// Last cluster is only completed by the merge check below
+		landmarks.push_back(std::move(cluster));
+
+		// Compare the first Point of the first cluster to the last Point of the last cluster
+		// If they are to be merged, we merge them into first cluster and pop the last one
+		if (landmarks.size() > 1)
+		{
+			// Same test as evaluate_point, without copying the last cluster
+			if (fabs(landmarks.at(0).points.front().range_bear.range - landmarks.back().points.back().range_bear.range) <= threshold)
+			{
+				landmarks.at(0).points.insert(landmarks.at(0).points.end(),
+											  landmarks.back().points.begin(),
+											  landmarks.back().points.end());
+				landmarks.pop_back();
+			}
+		}
+
+		// Eliminate all clusters with 3 or less points in them
+		landmarks.erase(std::remove_if(landmarks.begin(), landmarks.end(),\
+									   [](const Landmark & l) { return l.points.size() <= 3; }),\
+						landmarks.end());
+
+		return landmarks;
+	}
+
+	void fit_landmarks(std::vector<Landmark> & clusters, const double & max_radius)
+	{
+		// Perform circle detection for each cluster
+		for (auto iter = clusters.begin(); iter < clusters.end(); iter++)
+		{
+			iter->fit_circle();
+		}
+
+		// Now filter by radius
+		clusters.erase(std::remove_if(clusters.begin(), clusters.end(),\
+									  [&](const Landmark & l) { return l.return_radius() > max_radius; }),\
+					   clusters.end());
+	}
+
 }
\ No newline at end of file
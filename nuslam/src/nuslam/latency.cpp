@@ -0,0 +1,221 @@
+#include "nuslam/latency.hpp"
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+namespace nuslam
+{
+	// LatencyHistogram
+	LatencyHistogram::LatencyHistogram()
+	{
+		reset();
+	}
+
+	void LatencyHistogram::record(const std::uint64_t & ns)
+	{
+		buckets[bucket_index(ns)].fetch_add(1, std::memory_order_relaxed);
+		total.fetch_add(1, std::memory_order_relaxed);
+		sum.fetch_add(ns, std::memory_order_relaxed);
+		std::uint64_t current = max_ns.load(std::memory_order_relaxed);
+		while (ns > current && !max_ns.compare_exchange_weak(current, ns, std::memory_order_relaxed))
+		{
+		}
+	}
+
+	std::uint64_t LatencyHistogram::count() const
+	{
+		return total.load(std::memory_order_relaxed);
+	}
+
+	std::uint64_t LatencyHistogram::percentile(const double & p) const
+	{
+		// Sum the buckets rather than trusting total, which may be ahead of them during a record()
+		std::uint64_t n = 0;
+		for (unsigned int i = 0; i < BUCKETS; i++)
+		{
+			n += buckets[i].load(std::memory_order_relaxed);
+		}
+		if (n == 0)
+		{
+			return 0;
+		}
+		// Nearest-rank percentile
+		std::uint64_t rank = std::max<std::uint64_t>(1, std::min(std::max(p, 0.0), 100.0) / 100.0 * n + 0.5);
+		std::uint64_t seen = 0;
+		for (unsigned int i = 0; i < BUCKETS; i++)
+		{
+			seen += buckets[i].load(std::memory_order_relaxed);
+			if (seen >= rank)
+			{
+				// Bucket bounds overshoot the largest value actually recorded
+				return std::min(bucket_upper(i), max());
+			}
+		}
+		return max();
+	}
+
+	double LatencyHistogram::mean() const
+	{
+		std::uint64_t n = count();
+		if (n == 0)
+		{
+			return 0.0;
+		}
+		return static_cast<double>(sum.load(std::memory_order_relaxed)) / n;
+	}
+
+	std::uint64_t LatencyHistogram::max() const
+	{
+		return max_ns.load(std::memory_order_relaxed);
+	}
+
+	void LatencyHistogram::reset()
+	{
+		for (unsigned int i = 0; i < BUCKETS; i++)
+		{
+			buckets[i].store(0, std::memory_order_relaxed);
+		}
+		total.store(0, std::memory_order_relaxed);
+		sum.store(0, std::memory_order_relaxed);
+		max_ns.store(0, std::memory_order_relaxed);
+	}
+
+	unsigned int LatencyHistogram::bucket_index(const std::uint64_t & ns)
+	{
+		constexpr std::uint64_t sub_buckets = 1ull << SUB_BUCKET_BITS;
+		if (ns < sub_buckets)
+		{
+			// Exact below 2^SUB_BUCKET_BITS
+			return ns;
+		}
+		if (ns >= (1ull << MAX_BITS))
+		{
+			return BUCKETS - 1;
+		}
+		// Position of the most significant bit selects the power of two, the next SUB_BUCKET_BITS bits the sub-bucket
+		unsigned int msb = 63 - __builtin_clzll(ns);
+		unsigned int shift = msb - SUB_BUCKET_BITS;
+		return ((shift + 1) << SUB_BUCKET_BITS) + ((ns >> shift) - sub_buckets);
+	}
+
+	std::uint64_t LatencyHistogram::bucket_upper(const unsigned int & index)
+	{
+		constexpr std::uint64_t sub_buckets = 1ull << SUB_BUCKET_BITS;
+		if (index < sub_buckets)
+		{
+			return index;
+		}
+		unsigned int shift = (index >> SUB_BUCKET_BITS) - 1;
+		std::uint64_t sub = (index & (sub_buckets - 1)) + sub_buckets;
+		return ((sub + 1) << shift) - 1;
+	}
+
+	std::uint64_t LatencyHistogram::bucket_count(const unsigned int & index) const
+	{
+		return buckets.at(index).load(std::memory_order_relaxed);
+	}
+
+	// LatencySummary
+	LatencySummary::LatencySummary()
+	{
+		count = 0;
+		mean = 0.0;
+		p50 = 0.0;
+		p90 = 0.0;
+		p99 = 0.0;
+		max = 0.0;
+	}
+
+	// LatencyRegistry
+	LatencyHistogram & LatencyRegistry::histogram(const std::string & stage)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		std::unique_ptr<LatencyHistogram> & hist = histograms[stage];
+		if (!hist)
+		{
+			hist.reset(new LatencyHistogram());
+		}
+		return *hist;
+	}
+
+	std::vector<LatencySummary> LatencyRegistry::summary() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		std::vector<LatencySummary> summaries;
+		summaries.reserve(histograms.size());
+		for (auto iter = histograms.begin(); iter != histograms.end(); iter++)
+		{
+			const LatencyHistogram & hist = *iter->second;
+			LatencySummary s;
+			s.stage = iter->first;
+			s.count = hist.count();
+			s.mean = hist.mean() / 1e3;
+			s.p50 = hist.percentile(50.0) / 1e3;
+			s.p90 = hist.percentile(90.0) / 1e3;
+			s.p99 = hist.percentile(99.0) / 1e3;
+			s.max = hist.max() / 1e3;
+			summaries.push_back(s);
+		}
+		return summaries;
+	}
+
+	void LatencyRegistry::reset()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto iter = histograms.begin(); iter != histograms.end(); iter++)
+		{
+			iter->second->reset();
+		}
+	}
+
+	void LatencyRegistry::dump(const std::string & filename) const
+	{
+		std::ofstream out(filename, std::ios::trunc);
+		out << "# stage count mean_us p50_us p90_us p99_us max_us\n";
+		std::vector<LatencySummary> summaries = summary();
+		for (auto iter = summaries.begin(); iter != summaries.end(); iter++)
+		{
+			out << iter->stage << " " << iter->count << " " << iter->mean << " " << iter->p50 << " "\
+				<< iter->p90 << " " << iter->p99 << " " << iter->max << "\n";
+		}
+
+		// Raw buckets, so that histograms from several runs can be merged or replotted
+		out << "# stage bucket_upper_ns count\n";
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto iter = histograms.begin(); iter != histograms.end(); iter++)
+		{
+			for (unsigned int i = 0; i < LatencyHistogram::BUCKETS; i++)
+			{
+				std::uint64_t n = iter->second->bucket_count(i);
+				if (n > 0)
+				{
+					out << iter->first << " " << LatencyHistogram::bucket_upper(i) << " " << n << "\n";
+				}
+			}
+		}
+		out.close();
+		if (!out)
+		{
+			throw std::runtime_error("Unable to write latency file " + filename);
+		}
+	}
+
+	LatencyRegistry & latency_registry()
+	{
+		// Never destroyed, so histograms stay valid for timers running during static destruction
+		static LatencyRegistry * registry = new LatencyRegistry();
+		return *registry;
+	}
+
+	// ScopedTimer
+	ScopedTimer::ScopedTimer(LatencyHistogram & hist_) : hist(hist_)
+	{
+		start = std::chrono::steady_clock::now();
+	}
+
+	ScopedTimer::~ScopedTimer()
+	{
+		auto elapsed = std::chrono::steady_clock::now() - start;
+		hist.record(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+	}
+}
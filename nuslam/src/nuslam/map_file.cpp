@@ -0,0 +1,171 @@
+#include "nuslam/map_file.hpp"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace nuslam
+{
+	// MapFile
+	MapFile::MapFile()
+	{
+		data = nullptr;
+		length = 0;
+		header = nullptr;
+		state_data = nullptr;
+		cov_data = nullptr;
+		seen_data = nullptr;
+	}
+
+	MapFile::MapFile(const std::string & filename) : MapFile()
+	{
+		int fd = open(filename.c_str(), O_RDONLY);
+		if (fd < 0)
+		{
+			throw std::runtime_error("Unable to open map file " + filename);
+		}
+
+		struct stat st;
+		if (fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(MapFileHeader))
+		{
+			close(fd);
+			throw std::runtime_error("Map file " + filename + " is too small to contain a header");
+		}
+
+		length = st.st_size;
+		void * mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+		// The mapping stays valid after the descriptor is closed
+		close(fd);
+		if (mapped == MAP_FAILED)
+		{
+			length = 0;
+			throw std::runtime_error("Unable to mmap map file " + filename);
+		}
+		data = mapped;
+
+		// Validate header before trusting any of the sizes in it
+		const MapFileHeader * hdr = static_cast<const MapFileHeader *>(data);
+		std::string error;
+		if (std::memcmp(hdr->magic, MAP_FILE_MAGIC, sizeof(MAP_FILE_MAGIC)) != 0)
+		{
+			error = "Map file " + filename + " is not a nuslam map";
+		} else if (hdr->byte_order != MAP_FILE_BYTE_ORDER)
+		{
+			error = "Map file " + filename + " was saved with a different byte order";
+		} else if (hdr->version != MAP_FILE_VERSION)
+		{
+			error = "Map file " + filename + " has unsupported version " + std::to_string(hdr->version);
+		} else if (length != map_file_size(hdr->map_size) || hdr->seen > hdr->map_size)
+		{
+			error = "Map file " + filename + " is truncated or corrupt";
+		}
+
+		if (!error.empty())
+		{
+			munmap(data, length);
+			data = nullptr;
+			length = 0;
+			throw std::runtime_error(error);
+		}
+
+		header = hdr;
+		unsigned long int dim = 3 + 2 * header->map_size;
+		const char * bytes = static_cast<const char *>(data);
+		state_data = reinterpret_cast<const double *>(bytes + sizeof(MapFileHeader));
+		cov_data = state_data + dim;
+		seen_data = reinterpret_cast<const std::int32_t *>(cov_data + dim * dim);
+	}
+
+	MapFile::~MapFile()
+	{
+		if (data != nullptr)
+		{
+			munmap(data, length);
+		}
+	}
+
+	bool MapFile::is_open() const
+	{
+		return header != nullptr;
+	}
+
+	unsigned long int MapFile::map_size() const
+	{
+		return header->map_size;
+	}
+
+	unsigned int MapFile::seen() const
+	{
+		return header->seen;
+	}
+
+	Eigen::Map<const Eigen::VectorXd> MapFile::state() const
+	{
+		return Eigen::Map<const Eigen::VectorXd>(state_data, 3 + 2 * header->map_size);
+	}
+
+	Eigen::Map<const Eigen::MatrixXd> MapFile::covariance() const
+	{
+		unsigned long int dim = 3 + 2 * header->map_size;
+		return Eigen::Map<const Eigen::MatrixXd>(cov_data, dim, dim);
+	}
+
+	int MapFile::seen_count(const unsigned long int & j) const
+	{
+		return seen_data[j];
+	}
+
+	// Helper Functions
+	std::size_t map_file_size(const unsigned long int & map_size)
+	{
+		std::size_t dim = 3 + 2 * map_size;
+		return sizeof(MapFileHeader) + sizeof(double) * (dim + dim * dim) + sizeof(std::int32_t) * map_size;
+	}
+
+	void write_map_file(const std::string & filename, const Eigen::VectorXd & state,\
+						const Eigen::MatrixXd & cov, const std::vector<Point> & map_state,\
+						const unsigned int & seen)
+	{
+		unsigned long int dim = 3 + 2 * map_state.size();
+		if (static_cast<unsigned long int>(state.size()) != dim || static_cast<unsigned long int>(cov.rows()) != dim\
+			|| static_cast<unsigned long int>(cov.cols()) != dim)
+		{
+			throw std::invalid_argument("State and covariance dimensions do not match map size.");
+		}
+
+		MapFileHeader hdr;
+		std::memset(&hdr, 0, sizeof(hdr));
+		std::memcpy(hdr.magic, MAP_FILE_MAGIC, sizeof(MAP_FILE_MAGIC));
+		hdr.version = MAP_FILE_VERSION;
+		hdr.byte_order = MAP_FILE_BYTE_ORDER;
+		hdr.map_size = map_state.size();
+		hdr.seen = seen;
+
+		std::vector<std::int32_t> seen_count;
+		seen_count.reserve(map_state.size());
+		for (auto iter = map_state.begin(); iter != map_state.end(); iter++)
+		{
+			seen_count.push_back(iter->seen_count);
+		}
+
+		// Write to a temporary file and rename so a running reader never sees a partial map
+		std::string tmp_filename = filename + ".tmp";
+		std::ofstream out(tmp_filename, std::ios::binary | std::ios::trunc);
+		out.write(reinterpret_cast<const char *>(&hdr), sizeof(hdr));
+		out.write(reinterpret_cast<const char *>(state.data()), sizeof(double) * dim);
+		// Eigen::MatrixXd is column-major and contiguous
+		out.write(reinterpret_cast<const char *>(cov.data()), sizeof(double) * dim * dim);
+		out.write(reinterpret_cast<const char *>(seen_count.data()), sizeof(std::int32_t) * seen_count.size());
+		out.close();
+
+		if (!out || std::rename(tmp_filename.c_str(), filename.c_str()) != 0)
+		{
+			std::remove(tmp_filename.c_str());
+			throw std::runtime_error("Unable to write map file " + filename);
+		}
+	}
+}
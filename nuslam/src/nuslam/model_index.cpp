@@ -0,0 +1,81 @@
+#include "nuslam/model_index.hpp"
+#include <stdexcept>
+
+namespace nuslam
+{
+	// ModelIndex
+	ModelIndex::ModelIndex() : ModelIndex("diff_drive", "cylinder")
+	{
+	}
+
+	ModelIndex::ModelIndex(const std::string & robot_name_, const std::string & landmark_prefix_)
+	{
+		robot_name = robot_name_;
+		landmark_prefix = landmark_prefix_;
+		robot_index = npos;
+		built = false;
+		rebuild_count = 0;
+	}
+
+	bool ModelIndex::update(const std::vector<std::string> & names)
+	{
+		// Same list as last time, so the cached indices still hold
+		if (built && names == list_names)
+		{
+			return false;
+		}
+
+		robot_index = npos;
+		landmark_indices.clear();
+		for (unsigned long int i = 0; i < names.size(); i++)
+		{
+			if (names.at(i) == robot_name)
+			{
+				robot_index = i;
+			} else if (names.at(i).compare(0, landmark_prefix.size(), landmark_prefix) == 0) {
+				landmark_indices.push_back(i);
+			}
+		}
+		list_names = names;
+		built = true;
+		rebuild_count++;
+		return true;
+	}
+
+	bool ModelIndex::has_robot() const
+	{
+		return robot_index != npos;
+	}
+
+	unsigned long int ModelIndex::robot() const
+	{
+		return robot_index;
+	}
+
+	const std::vector<unsigned long int> & ModelIndex::landmarks() const
+	{
+		return landmark_indices;
+	}
+
+	unsigned long int ModelIndex::rebuilds() const
+	{
+		return rebuild_count;
+	}
+
+	void transform_points(const Transform2D & T, const std::vector<double> & x_in, const std::vector<double> & y_in,\
+						  std::vector<double> & x_out, std::vector<double> & y_out)
+	{
+		if (x_in.size() != y_in.size())
+		{
+			throw std::invalid_argument("transform_points x and y must have the same length.");
+		}
+		x_out.resize(x_in.size());
+		y_out.resize(y_in.size());
+		for (unsigned long int i = 0; i < x_in.size(); i++)
+		{
+			Vector2D v = T(Vector2D(x_in[i], y_in[i]));
+			x_out[i] = v.x;
+			y_out[i] = v.y;
+		}
+	}
+}
@@ -0,0 +1,131 @@
+#include "nuslam/path_history.hpp"
+#include <cmath>
+#include <stdexcept>
+
+namespace nuslam
+{
+	// PathSample
+	PathSample::PathSample()
+	{
+		stamp = 0.0;
+		pose = Pose2D();
+	}
+
+	PathSample::PathSample(const double & stamp_, const Pose2D & pose_)
+	{
+		stamp = stamp_;
+		pose = pose_;
+	}
+
+	// PathHistory
+	PathHistory::PathHistory() : PathHistory(10000, 0.0, 0.0)
+	{
+	}
+
+	PathHistory::PathHistory(const unsigned long int & capacity_, const double & min_distance_, const double & min_angle_)
+	{
+		if (capacity_ == 0)
+		{
+			throw std::invalid_argument("PathHistory capacity must be positive.");
+		}
+		ring.resize(capacity_);
+		count = 0;
+		min_distance = min_distance_;
+		min_angle = min_angle_;
+	}
+
+	bool PathHistory::add(const double & stamp, const Pose2D & pose)
+	{
+		if (count > 0 && (min_distance > 0.0 || min_angle > 0.0))
+		{
+			const Pose2D & last = back().pose;
+			double distance = std::hypot(pose.x - last.x, pose.y - last.y);
+			double angle = std::fabs(rigid2d::normalize_angle(pose.theta - last.theta));
+			if (distance < min_distance && angle < min_angle)
+			{
+				return false;
+			}
+		}
+
+		ring[count % ring.size()] = PathSample(stamp, pose);
+		count++;
+		return true;
+	}
+
+	unsigned long int PathHistory::size() const
+	{
+		return count < ring.size() ? count : ring.size();
+	}
+
+	unsigned long int PathHistory::capacity() const
+	{
+		return ring.size();
+	}
+
+	unsigned long int PathHistory::total() const
+	{
+		return count;
+	}
+
+	const PathSample & PathHistory::at(const unsigned long int & i) const
+	{
+		if (i >= size())
+		{
+			throw std::out_of_range("PathHistory index out of range.");
+		}
+		// Oldest kept pose is in slot count % capacity once the ring has wrapped, otherwise in slot 0
+		return ring[(count - size() + i) % ring.size()];
+	}
+
+	const PathSample & PathHistory::back() const
+	{
+		if (count == 0)
+		{
+			throw std::out_of_range("PathHistory is empty.");
+		}
+		return ring[(count - 1) % ring.size()];
+	}
+
+	Pose2D PathHistory::interpolate(const double & stamp) const
+	{
+		if (count == 0)
+		{
+			throw std::out_of_range("PathHistory is empty.");
+		}
+		if (stamp <= at(0).stamp)
+		{
+			return at(0).pose;
+		}
+		if (stamp >= back().stamp)
+		{
+			return back().pose;
+		}
+
+		// Newest kept pose at or before the stamp, by bisection
+		unsigned long int lo = 0, hi = size() - 1;
+		while (hi - lo > 1)
+		{
+			unsigned long int mid = (lo + hi) / 2;
+			if (at(mid).stamp <= stamp)
+			{
+				lo = mid;
+			} else {
+				hi = mid;
+			}
+		}
+
+		const PathSample & before = at(lo);
+		const PathSample & after = at(hi);
+		double s = (stamp - before.stamp) / (after.stamp - before.stamp);
+		Pose2D pose;
+		pose.x = before.pose.x + s * (after.pose.x - before.pose.x);
+		pose.y = before.pose.y + s * (after.pose.y - before.pose.y);
+		pose.theta = rigid2d::normalize_angle(before.pose.theta + s * rigid2d::normalize_angle(after.pose.theta - before.pose.theta));
+		return pose;
+	}
+
+	void PathHistory::clear()
+	{
+		count = 0;
+	}
+}
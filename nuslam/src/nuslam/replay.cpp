@@ -0,0 +1,371 @@
+#include "nuslam/replay.hpp"
+#include <nuslam/arena.hpp>
+#include <nuslam/deskew.hpp>
+#include <nuslam/scan_cloud.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iterator>  // to use std::next
+#include <limits>
+
+namespace nuslam
+{
+	using rigid2d::Twist2D;
+	using rigid2d::Transform2D;
+	using rigid2d::Transform2DS;
+
+	typedef std::chrono::steady_clock Clock;
+
+	// Elapsed time in microseconds
+	static double elapsed_us(const Clock::time_point & start, const Clock::time_point & end)
+	{
+		return std::chrono::duration<double, std::micro>(end - start).count();
+	}
+
+	// ScanRecord
+	ScanRecord::ScanRecord()
+	{
+		stamp = 0.0;
+		angle_min = 0.0;
+		angle_max = 0.0;
+		angle_increment = 0.0;
+		time_increment = 0.0;
+		range_min = 0.0;
+		range_max = 0.0;
+	}
+
+	// JointRecord
+	JointRecord::JointRecord()
+	{
+		stamp = 0.0;
+		left = 0.0;
+		right = 0.0;
+	}
+
+	JointRecord::JointRecord(const double & stamp_, const double & left_, const double & right_)
+	{
+		stamp = stamp_;
+		left = left_;
+		right = right_;
+	}
+
+	// GroundTruthRecord
+	GroundTruthRecord::GroundTruthRecord()
+	{
+		stamp = 0.0;
+	}
+
+	// Dataset
+	double Dataset::duration() const
+	{
+		double start = std::numeric_limits<double>::max();
+		double end = std::numeric_limits<double>::lowest();
+		if (!scans.empty())
+		{
+			start = std::min(start, scans.front().stamp);
+			end = std::max(end, scans.back().stamp);
+		}
+		if (!joints.empty())
+		{
+			start = std::min(start, joints.front().stamp);
+			end = std::max(end, joints.back().stamp);
+		}
+		if (end < start)
+		{
+			return 0.0;
+		}
+		return end - start;
+	}
+
+	// ReplayConfig
+	ReplayConfig::ReplayConfig()
+	{
+		threshold = 0.15;
+		max_radius = 0.1;
+		deskew = false;
+		wheel_base = 0.16;
+		wheel_radius = 0.033;
+		scan_pose = Pose2D();
+		map_size = 12;
+		max_range = 1.0;
+		x_noise = 1e-6;
+		y_noise = 1e-6;
+		theta_noise = 1e-5;
+		range_noise = 1e-10;
+		bearing_noise = 1e-10;
+		mahalanobis_lower = 100.0;
+		mahalanobis_upper = 1e5;
+	}
+
+	// TrajectoryPoint
+	TrajectoryPoint::TrajectoryPoint()
+	{
+		stamp = 0.0;
+		has_truth = false;
+	}
+
+	// StageLatency
+	StageLatency::StageLatency(const std::string & name_)
+	{
+		name = name_;
+	}
+
+	double StageLatency::percentile(const double & p) const
+	{
+		if (samples.empty())
+		{
+			return 0.0;
+		}
+		std::vector<double> sorted = samples;
+		// Nearest-rank percentile
+		double rank = std::ceil(std::min(std::max(p, 0.0), 100.0) / 100.0 * sorted.size());
+		unsigned long int index = std::max(rank, 1.0) - 1;
+		std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+		return sorted.at(index);
+	}
+
+	double StageLatency::mean() const
+	{
+		if (samples.empty())
+		{
+			return 0.0;
+		}
+		double sum = 0.0;
+		for (auto iter = samples.begin(); iter != samples.end(); iter++)
+		{
+			sum += *iter;
+		}
+		return sum / samples.size();
+	}
+
+	// ReplayResult
+	ReplayResult::ReplayResult() : cluster("cluster"), fit("fit"), predict("predict"), update("update")
+	{
+		wall_time = 0.0;
+		pose_rmse = 0.0;
+		landmark_rmse = 0.0;
+		landmarks_mapped = 0;
+	}
+
+	// Helper Functions
+	ReplayResult replay(const Dataset & data, const ReplayConfig & config)
+	{
+		ReplayResult result;
+		result.trajectory.reserve(data.scans.size());
+		result.cluster.samples.reserve(data.scans.size());
+		result.fit.samples.reserve(data.scans.size());
+		result.predict.samples.reserve(data.scans.size());
+		result.update.samples.reserve(data.scans.size());
+
+		const Clock::time_point replay_start = Clock::now();
+
+		// Odometry for motion compensation (landmarks_node)
+		rigid2d::DiffDrive deskew_driver;
+		deskew_driver.set_static(config.wheel_base, config.wheel_radius);
+		Deskew deskew;
+		deskew.set_sensor_pose(Transform2D(Vector2D(config.scan_pose.x, config.scan_pose.y), config.scan_pose.theta));
+		bool have_joint = false;
+		double last_joint_stamp = 0.0;
+
+		// Odometry for the EKF (slam)
+		rigid2d::DiffDrive ekf_driver;
+		ekf_driver.set_static(config.wheel_base, config.wheel_radius);
+		JointRecord latest_joint;
+		bool odom_flag = false;
+
+		std::vector<Point> map_state(config.map_size, Point());
+		Pose2D xyt_noise_var(config.x_noise, config.y_noise, config.theta_noise);
+		RangeBear rb_noise_var(config.range_noise, config.bearing_noise);
+		EKF ekf(ekf_driver.get_pose(), map_state, xyt_noise_var, rb_noise_var, config.max_range,\
+				config.mahalanobis_lower, config.mahalanobis_upper);
+
+		// Ground truth is expressed relative to the first recorded pose, which is the EKF map frame
+		Transform2D T_map_world;
+		if (!data.ground_truth.empty())
+		{
+			const Pose2D & origin = data.ground_truth.front().pose;
+			T_map_world = Transform2D(Vector2D(origin.x, origin.y), origin.theta).inv();
+			const std::vector<Vector2D> & landmarks = data.ground_truth.front().landmarks;
+			for (auto iter = landmarks.begin(); iter != landmarks.end(); iter++)
+			{
+				result.true_map.push_back(T_map_world(*iter));
+			}
+		}
+
+		ScanCloud points;
+		ScanArena arena;
+		std::vector<Point> measurements;
+		auto scan_iter = data.scans.begin();
+		auto joint_iter = data.joints.begin();
+		auto truth_iter = data.ground_truth.begin();
+
+		// Merge the streams in stamp order. Joint states go first when stamps are equal, as the
+		// EKF can only run once it has odometry.
+		while (scan_iter != data.scans.end())
+		{
+			if (joint_iter != data.joints.end() && joint_iter->stamp <= scan_iter->stamp)
+			{
+				// landmarks_node js_callback
+				rigid2d::WheelVelocities w_vel = deskew_driver.updateOdometry(joint_iter->left, joint_iter->right);
+				Twist2D Vb = deskew_driver.wheelsToTwist(w_vel);
+				if (have_joint)
+				{
+					double dt = joint_iter->stamp - last_joint_stamp;
+					if (dt > 0.0)
+					{
+						Vb.reassign(Vb.w_z / dt, Vb.v_x / dt, Vb.v_y / dt);
+						deskew.add_twist(joint_iter->stamp - dt / 2.0, Vb);
+					}
+				}
+				have_joint = true;
+				last_joint_stamp = joint_iter->stamp;
+
+				// slam js_callback
+				latest_joint = *joint_iter;
+				odom_flag = true;
+				joint_iter++;
+				continue;
+			}
+
+			const ScanRecord & scan = *scan_iter;
+
+			// landmarks_node scan_callback
+			Clock::time_point start = Clock::now();
+			arena.reset();
+			bool compensate = config.deskew && deskew.ready();
+			if (compensate)
+			{
+				deskew.start_scan(scan.stamp, scan.time_increment);
+			}
+			scan_points(scan.ranges, scan.angle_min, scan.angle_increment, scan.range_min, scan.range_max, nullptr,\
+						compensate ? &deskew : nullptr, points);
+			ScanCloud clusters(&arena);
+			cluster_scan(points, config.threshold, clusters);
+			Clock::time_point end = Clock::now();
+			result.cluster.samples.push_back(elapsed_us(start, end));
+
+			start = Clock::now();
+			std::pmr::vector<Landmark> landmarks(&arena);
+			fit_clusters(clusters, config.max_radius, landmarks);
+			end = Clock::now();
+			result.fit.samples.push_back(elapsed_us(start, end));
+
+			// slam landmark_callback
+			measurements.clear();
+			for (auto iter = landmarks.begin(); iter != landmarks.end(); iter++)
+			{
+				// As in TurtleMap, only x,y are passed on and range, bearing are recomputed from them
+				measurements.push_back(Point(iter->return_coords().pose));
+			}
+
+			// The prediction only runs on new wheel angles, but every scan is incorporated
+			if (odom_flag)
+			{
+				odom_flag = false;
+				start = Clock::now();
+				rigid2d::WheelVelocities ekf_w_vel = ekf_driver.updateOdometry(latest_joint.left, latest_joint.right);
+				ekf.predict(ekf_driver.wheelsToTwist(ekf_w_vel));
+				end = Clock::now();
+				result.predict.samples.push_back(elapsed_us(start, end));
+			}
+
+			start = Clock::now();
+			ekf.msr_update(measurements);
+			end = Clock::now();
+			result.update.samples.push_back(elapsed_us(start, end));
+
+			TrajectoryPoint traj;
+			traj.stamp = scan.stamp;
+			traj.estimate = ekf.return_pose();
+			// Latest ground truth at or before the scan
+			while (truth_iter != data.ground_truth.end() && std::next(truth_iter) != data.ground_truth.end()\
+				   && std::next(truth_iter)->stamp <= scan.stamp)
+			{
+				truth_iter++;
+			}
+			if (truth_iter != data.ground_truth.end() && truth_iter->stamp <= scan.stamp)
+			{
+				const Pose2D & pose = truth_iter->pose;
+				Transform2D T_map_robot = T_map_world * Transform2D(Vector2D(pose.x, pose.y), pose.theta);
+				Transform2DS disp = T_map_robot.displacement();
+				traj.truth = Pose2D(disp.x, disp.y, disp.theta);
+				traj.has_truth = true;
+			}
+			result.trajectory.push_back(traj);
+			scan_iter++;
+		}
+
+		result.map = ekf.return_map();
+		result.wall_time = std::chrono::duration<double>(Clock::now() - replay_start).count();
+
+		// Trajectory error
+		double pose_sq = 0.0;
+		unsigned long int pose_count = 0;
+		for (auto iter = result.trajectory.begin(); iter != result.trajectory.end(); iter++)
+		{
+			if (iter->has_truth)
+			{
+				double dx = iter->estimate.x - iter->truth.x;
+				double dy = iter->estimate.y - iter->truth.y;
+				pose_sq += dx * dx + dy * dy;
+				pose_count++;
+			}
+		}
+		if (pose_count > 0)
+		{
+			result.pose_rmse = std::sqrt(pose_sq / pose_count);
+		}
+
+		// Time-aligned ATE and RPE. Both streams are in the EKF map frame, and the whole ground truth
+		// is kept so every scan can be interpolated.
+		TrajectoryEvaluator evaluator(data.duration() + 1.0, 1.0, false);
+		auto truth_eval_iter = data.ground_truth.begin();
+		for (auto iter = result.trajectory.begin(); iter != result.trajectory.end(); iter++)
+		{
+			while (truth_eval_iter != data.ground_truth.end() && truth_eval_iter->stamp <= iter->stamp)
+			{
+				const Pose2D & pose = truth_eval_iter->pose;
+				Transform2DS disp = (T_map_world * Transform2D(Vector2D(pose.x, pose.y), pose.theta)).displacement();
+				evaluator.add_truth(truth_eval_iter->stamp, Pose2D(disp.x, disp.y, disp.theta));
+				truth_eval_iter++;
+			}
+			evaluator.add_estimate(iter->stamp, iter->estimate);
+		}
+		// Ground truth after the last scan brackets the waiting estimate
+		if (truth_eval_iter != data.ground_truth.end())
+		{
+			const Pose2D & pose = truth_eval_iter->pose;
+			Transform2DS disp = (T_map_world * Transform2D(Vector2D(pose.x, pose.y), pose.theta)).displacement();
+			evaluator.add_truth(truth_eval_iter->stamp, Pose2D(disp.x, disp.y, disp.theta));
+		}
+		result.trajectory_error = evaluator.summary();
+
+		// Map error against the nearest true landmark
+		double map_sq = 0.0;
+		for (auto iter = result.map.begin(); iter != result.map.end(); iter++)
+		{
+			if (iter->seen_count <= 0)
+			{
+				continue;
+			}
+			result.landmarks_mapped++;
+			double nearest = std::numeric_limits<double>::max();
+			for (auto true_iter = result.true_map.begin(); true_iter != result.true_map.end(); true_iter++)
+			{
+				double dx = iter->pose.x - true_iter->x;
+				double dy = iter->pose.y - true_iter->y;
+				nearest = std::min(nearest, dx * dx + dy * dy);
+			}
+			if (!result.true_map.empty())
+			{
+				map_sq += nearest;
+			}
+		}
+		if (result.landmarks_mapped > 0 && !result.true_map.empty())
+		{
+			result.landmark_rmse = std::sqrt(map_sq / result.landmarks_mapped);
+		}
+
+		return result;
+	}
+}
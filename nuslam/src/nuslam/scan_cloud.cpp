@@ -0,0 +1,377 @@
+#include "nuslam/scan_cloud.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+namespace nuslam
+{
+	// ScanCloud
+	ScanCloud::ScanCloud()
+	{
+	}
+
+	ScanCloud::ScanCloud(std::pmr::memory_resource * resource)
+		: x(resource), y(resource), range(resource), bearing(resource), offsets(resource)
+	{
+	}
+
+	void ScanCloud::reserve(const unsigned long int & n)
+	{
+		x.reserve(n);
+		y.reserve(n);
+		range.reserve(n);
+		bearing.reserve(n);
+	}
+
+	void ScanCloud::clear()
+	{
+		x.clear();
+		y.clear();
+		range.clear();
+		bearing.clear();
+		offsets.clear();
+	}
+
+	void ScanCloud::push_back(const Point & point)
+	{
+		x.push_back(point.pose.x);
+		y.push_back(point.pose.y);
+		range.push_back(point.range_bear.range);
+		bearing.push_back(point.range_bear.bearing);
+	}
+
+	unsigned long int ScanCloud::size() const
+	{
+		return x.size();
+	}
+
+	unsigned long int ScanCloud::num_clusters() const
+	{
+		return offsets.empty() ? 0 : offsets.size() - 1;
+	}
+
+	Point ScanCloud::point(const unsigned long int & i) const
+	{
+		Point p;
+		p.pose = Vector2D(x.at(i), y.at(i));
+		p.range_bear = RangeBear(range.at(i), bearing.at(i));
+		return p;
+	}
+
+	// ScanWindow
+	ScanWindow::ScanWindow()
+	{
+		bearing = 0.0;
+		half_width = 0.0;
+		range_min = 0.0;
+		range_max = 0.0;
+	}
+
+	ScanWindow::ScanWindow(const RangeBear & predicted, const RangeBear & sigma, const double & gate, const double & margin)
+	{
+		bearing = predicted.bearing;
+		// Angle subtended by the margin around the centre, or every bearing if the robot is within the margin
+		double subtended = margin < predicted.range ? std::asin(margin / predicted.range) : rigid2d::PI;
+		half_width = std::min(gate * sigma.bearing + subtended, rigid2d::PI);
+		range_min = std::max(predicted.range - margin - gate * sigma.range, 0.0);
+		range_max = predicted.range + margin + gate * sigma.range;
+	}
+
+	bool ScanWindow::covers(const double & bearing_) const
+	{
+		double diff = bearing_ - bearing;
+		diff -= 2.0 * rigid2d::PI * std::floor(diff / (2.0 * rigid2d::PI) + 0.5);
+		return std::fabs(diff) <= half_width;
+	}
+
+	bool ScanWindow::contains(const double & range, const double & bearing_) const
+	{
+		return range >= range_min && range <= range_max && covers(bearing_);
+	}
+
+	// Copy the Points of each [begin, end) beam range of more than 3 Points into clusters, one cluster per range.
+	// The Points from begin to the end of the scan, if any, wrap around into the first range and follow its Points.
+	static void copy_spans(const ScanCloud & scan, const std::pmr::vector<std::pair<unsigned long int, unsigned long int>> & spans,\
+						   const unsigned long int & begin, ScanCloud & clusters)
+	{
+		const unsigned long int n = scan.size();
+		const bool merge = begin < n;
+		clusters.reserve(n);
+		for (unsigned long int c = 0; c < spans.size(); c++)
+		{
+			unsigned long int size = spans.at(c).second - spans.at(c).first;
+			if (c == 0 && merge)
+			{
+				size += n - begin;
+			}
+			// Eliminate all clusters with 3 or less points in them
+			if (size <= 3)
+			{
+				continue;
+			}
+
+			clusters.x.insert(clusters.x.end(), scan.x.begin() + spans.at(c).first, scan.x.begin() + spans.at(c).second);
+			clusters.y.insert(clusters.y.end(), scan.y.begin() + spans.at(c).first, scan.y.begin() + spans.at(c).second);
+			clusters.range.insert(clusters.range.end(), scan.range.begin() + spans.at(c).first,\
+								  scan.range.begin() + spans.at(c).second);
+			clusters.bearing.insert(clusters.bearing.end(), scan.bearing.begin() + spans.at(c).first,\
+									scan.bearing.begin() + spans.at(c).second);
+			if (c == 0 && merge)
+			{
+				// Points of the last cluster follow those of the first, as in cluster_points
+				clusters.x.insert(clusters.x.end(), scan.x.begin() + begin, scan.x.end());
+				clusters.y.insert(clusters.y.end(), scan.y.begin() + begin, scan.y.end());
+				clusters.range.insert(clusters.range.end(), scan.range.begin() + begin, scan.range.end());
+				clusters.bearing.insert(clusters.bearing.end(), scan.bearing.begin() + begin, scan.bearing.end());
+			}
+			clusters.offsets.push_back(clusters.size());
+		}
+	}
+
+	ScanCloud cluster_scan(const ScanCloud & scan, const double & threshold)
+	{
+		ScanCloud clusters;
+		cluster_scan(scan, threshold, clusters);
+		return clusters;
+	}
+
+	void cluster_scan(const ScanCloud & scan, const double & threshold, ScanCloud & clusters)
+	{
+		clusters.clear();
+		clusters.offsets.push_back(0);
+
+		unsigned long int n = scan.size();
+		if (n == 0)
+		{
+			return;
+		}
+
+		// [begin, end) beam ranges of each cluster. As in Landmark::evaluate_point, points are at
+		// angle increments, so only consecutive ranges need to be compared
+		std::pmr::vector<std::pair<unsigned long int, unsigned long int>> spans(clusters.offsets.get_allocator().resource());
+		unsigned long int begin = 0;
+		for (unsigned long int i = 1; i < n; i++)
+		{
+			if (std::fabs(scan.range[i] - scan.range[i - 1]) > threshold)
+			{
+				spans.push_back(std::make_pair(begin, i));
+				begin = i;
+			}
+		}
+		spans.push_back(std::make_pair(begin, n));
+
+		// If the scan wraps around, the last cluster continues into the first one
+		bool merge = spans.size() > 1 && std::fabs(scan.range.front() - scan.range.back()) <= threshold;
+		if (merge)
+		{
+			spans.pop_back();
+		}
+
+		copy_spans(scan, spans, merge ? begin : n, clusters);
+	}
+
+	void scan_points(const std::vector<float> & ranges, const double & angle_min, const double & angle_increment,\
+					 const double & range_min, const double & range_max, const std::vector<std::uint8_t> * mask,\
+					 Deskew * deskew, ScanCloud & cloud)
+	{
+		if (mask != nullptr && mask->size() != ranges.size())
+		{
+			throw std::invalid_argument("scan_points mask must have one entry per beam.");
+		}
+		cloud.clear();
+		cloud.reserve(ranges.size());
+		for (unsigned long int i = 0; i < ranges.size(); i++)
+		{
+			// Also rejects inf and NaN
+			if (!(ranges[i] >= range_min && ranges[i] <= range_max))
+			{
+				continue;
+			}
+			// Skip the beams outside every window before converting them
+			if (mask != nullptr && !(*mask)[i])
+			{
+				continue;
+			}
+			Point point(RangeBear(ranges[i], angle_min + i * angle_increment));
+			if (deskew != nullptr)
+			{
+				point = deskew->correct_point(point, i);
+			}
+			cloud.push_back(point);
+		}
+	}
+
+	void window_beams(const std::vector<ScanWindow> & windows, const double & angle_min, const double & angle_increment,\
+					  const unsigned long int & num_beams, std::vector<std::uint8_t> & mask)
+	{
+		if (!(angle_increment > 0.0))
+		{
+			mask.assign(num_beams, 1);
+			return;
+		}
+		mask.assign(num_beams, 0);
+		if (num_beams == 0)
+		{
+			return;
+		}
+
+		// Mark the beams from bearing lo to hi (rad, at most one turn after angle_min)
+		const auto mark = [&](const double & lo, const double & hi)
+		{
+			const double first = std::max(std::ceil((lo - angle_min) / angle_increment - 1e-9), 0.0);
+			const double last = std::min(std::floor((hi - angle_min) / angle_increment + 1e-9), num_beams - 1.0);
+			for (double k = first; k <= last; k++)
+			{
+				mask[static_cast<unsigned long int>(k)] = 1;
+			}
+		};
+
+		const double turn = 2.0 * rigid2d::PI;
+		for (auto iter = windows.begin(); iter != windows.end(); iter++)
+		{
+			if (iter->half_width >= rigid2d::PI)
+			{
+				mark(angle_min, angle_min + turn);
+				continue;
+			}
+			// Start of the interval within one turn after angle_min, and the rest from angle_min if it wraps
+			double lo = iter->bearing - iter->half_width;
+			lo -= turn * std::floor((lo - angle_min) / turn);
+			double hi = lo + 2.0 * iter->half_width;
+			mark(lo, std::min(hi, angle_min + turn));
+			if (hi > angle_min + turn)
+			{
+				mark(angle_min, hi - turn);
+			}
+		}
+	}
+
+	void cluster_windows(const ScanCloud & scan, const double & threshold, const std::vector<ScanWindow> & windows,\
+						 ScanCloud & clusters)
+	{
+		clusters.clear();
+		clusters.offsets.push_back(0);
+
+		unsigned long int n = scan.size();
+		if (n == 0 || windows.empty())
+		{
+			return;
+		}
+
+		// Whether some window contains Point i
+		const auto inside = [&scan, &windows](const unsigned long int & i)
+		{
+			for (auto iter = windows.begin(); iter != windows.end(); iter++)
+			{
+				if (iter->contains(scan.range[i], scan.bearing[i]))
+				{
+					return true;
+				}
+			}
+			return false;
+		};
+
+		// Whether some window contains both Points i and j
+		const auto shared = [&scan, &windows](const unsigned long int & i, const unsigned long int & j)
+		{
+			for (auto iter = windows.begin(); iter != windows.end(); iter++)
+			{
+				if (iter->contains(scan.range[i], scan.bearing[i]) && iter->contains(scan.range[j], scan.bearing[j]))
+				{
+					return true;
+				}
+			}
+			return false;
+		};
+
+		// [begin, end) beam ranges of each cluster, as in cluster_scan, each also ended by a Point outside
+		// every window, or by two Points which are in different windows
+		std::pmr::vector<std::pair<unsigned long int, unsigned long int>> spans(clusters.offsets.get_allocator().resource());
+		bool open = false;
+		unsigned long int begin = 0;
+		for (unsigned long int i = 0; i < n; i++)
+		{
+			if (!inside(i))
+			{
+				if (open)
+				{
+					spans.push_back(std::make_pair(begin, i));
+					open = false;
+				}
+			} else if (!open)
+			{
+				begin = i;
+				open = true;
+			} else if (std::fabs(scan.range[i] - scan.range[i - 1]) > threshold || !shared(i - 1, i))
+			{
+				spans.push_back(std::make_pair(begin, i));
+				begin = i;
+			}
+		}
+		if (open)
+		{
+			spans.push_back(std::make_pair(begin, n));
+		}
+
+		// If the scan wraps around inside a window, the last cluster continues into the first one
+		unsigned long int wrap = n;
+		if (spans.size() > 1 && spans.front().first == 0 && spans.back().second == n &&\
+			std::fabs(scan.range.front() - scan.range.back()) <= threshold && shared(n - 1, 0))
+		{
+			wrap = spans.back().first;
+			spans.pop_back();
+		}
+
+		copy_spans(scan, spans, wrap, clusters);
+	}
+
+	// Shared by the fit_clusters overloads, which differ only in the vector type and whether fits are kept
+	template <class LandmarkVector>
+	static void fit_into(const ScanCloud & clusters, const double & max_radius, LandmarkVector & landmarks,\
+						 std::pmr::vector<CircleFit> * fits)
+	{
+		landmarks.clear();
+		landmarks.reserve(clusters.num_clusters());
+		if (fits != nullptr)
+		{
+			fits->clear();
+			fits->reserve(clusters.num_clusters());
+		}
+
+		for (unsigned long int c = 0; c < clusters.num_clusters(); c++)
+		{
+			unsigned long int first = clusters.offsets.at(c);
+			unsigned long int n = clusters.offsets.at(c + 1) - first;
+			CircleFit fit = fit_circle(clusters.x.data() + first, clusters.y.data() + first, n);
+			if (fits != nullptr)
+			{
+				fits->push_back(fit);
+			}
+
+			// Now filter by radius
+			if (!(fit.radius > max_radius))
+			{
+				landmarks.push_back(Landmark(fit.radius, Point(fit.centre), std::vector<Point>(), 0.05));
+			}
+		}
+	}
+
+	std::vector<Landmark> fit_clusters(const ScanCloud & clusters, const double & max_radius)
+	{
+		std::vector<Landmark> landmarks;
+		fit_into(clusters, max_radius, landmarks, nullptr);
+		return landmarks;
+	}
+
+	void fit_clusters(const ScanCloud & clusters, const double & max_radius, std::pmr::vector<Landmark> & landmarks)
+	{
+		fit_into(clusters, max_radius, landmarks, nullptr);
+	}
+
+	void fit_clusters(const ScanCloud & clusters, const double & max_radius, std::pmr::vector<Landmark> & landmarks,\
+					  std::pmr::vector<CircleFit> & fits)
+	{
+		fit_into(clusters, max_radius, landmarks, &fits);
+	}
+}
@@ -0,0 +1,236 @@
+#include "nuslam/scan_matcher.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <stdexcept>
+
+namespace nuslam
+{
+	// ScanMatch
+	ScanMatch::ScanMatch()
+	{
+		pose = Pose2D();
+		score = 0.0;
+		evaluated = 0;
+	}
+
+	// ScanMatcher
+	ScanMatcher::ScanMatcher() : ScanMatcher(0.2, 0.2, 0.01)
+	{
+	}
+
+	ScanMatcher::ScanMatcher(const double & linear_window_, const double & angular_window_, const double & angular_step_)
+	{
+		if (!(linear_window_ >= 0.0) || !(angular_window_ >= 0.0) || !(angular_step_ > 0.0))
+		{
+			throw std::invalid_argument("ScanMatcher windows must not be negative and the angular step must be positive.");
+		}
+		linear_window = linear_window_;
+		angular_window = angular_window_;
+		angular_step = angular_step_;
+		depth = 0;
+		res = 0.0;
+	}
+
+	void ScanMatcher::set_map(const GridMap & map)
+	{
+		map_bounds = map.bounds();
+		res = map.resolution();
+		if (map_bounds.width == 0)
+		{
+			levels.clear();
+			return;
+		}
+
+		// Coarsest level whose cells span the whole translation window
+		const std::int32_t window = static_cast<std::int32_t>(std::ceil(linear_window / res));
+		depth = 0;
+		while ((1 << depth) < 2 * window + 1)
+		{
+			depth++;
+		}
+		levels.resize(depth + 1);
+
+		// Full resolution: occupancy, with unknown cells scoring as free
+		std::vector<std::int8_t> data;
+		map.export_grid(data);
+		levels.at(0).resize(data.size());
+		for (unsigned long int i = 0; i < data.size(); i++)
+		{
+			levels.at(0)[i] = static_cast<std::uint8_t>(std::max<std::int8_t>(data[i], 0));
+		}
+
+		// Level d is the maximum of the four level d-1 cells whose windows tile its own
+		const std::int32_t width = static_cast<std::int32_t>(map_bounds.width);
+		const std::int32_t height = static_cast<std::int32_t>(map_bounds.height);
+		for (std::uint32_t d = 1; d <= depth; d++)
+		{
+			const std::int32_t pad = (1 << d) - 1;
+			const std::int32_t half = 1 << (d - 1);
+			std::vector<std::uint8_t> & level = levels.at(d);
+			level.resize(static_cast<unsigned long int>(width + pad) * (height + pad));
+			for (std::int32_t cy = -pad; cy < height; cy++)
+			{
+				std::uint8_t * row = level.data() + static_cast<unsigned long int>(cy + pad) * (width + pad);
+				for (std::int32_t cx = -pad; cx < width; cx++)
+				{
+					row[cx + pad] = std::max(std::max(lookup(d - 1, cx, cy), lookup(d - 1, cx + half, cy)),\
+											 std::max(lookup(d - 1, cx, cy + half), lookup(d - 1, cx + half, cy + half)));
+				}
+			}
+		}
+	}
+
+	bool ScanMatcher::has_map() const
+	{
+		return !levels.empty();
+	}
+
+	ScanMatch ScanMatcher::match(const Pose2D & guess, const ScanCloud & scan) const
+	{
+		if (!has_map())
+		{
+			throw std::logic_error("ScanMatcher has no map to match against.");
+		}
+		ScanMatch result;
+		result.pose = guess;
+		const unsigned long int n = scan.size();
+		if (n == 0)
+		{
+			return result;
+		}
+
+		const std::int32_t window = static_cast<std::int32_t>(std::ceil(linear_window / res));
+		const std::uint32_t half_rotations = static_cast<std::uint32_t>(std::floor(angular_window / angular_step + 1e-9));
+		const std::uint32_t rotations = 2 * half_rotations + 1;
+
+		// Discretize the scan once per rotation, in cells from the map origin
+		std::vector<std::int32_t> cells_x(rotations * n), cells_y(rotations * n);
+		for (std::uint32_t r = 0; r < rotations; r++)
+		{
+			const double theta = guess.theta + (static_cast<double>(r) - half_rotations) * angular_step;
+			const double c = std::cos(theta);
+			const double s = std::sin(theta);
+			for (unsigned long int i = 0; i < n; i++)
+			{
+				double x = guess.x + c * scan.x[i] - s * scan.y[i];
+				double y = guess.y + s * scan.x[i] + c * scan.y[i];
+				cells_x[r * n + i] = static_cast<std::int32_t>(std::floor(x / res)) - map_bounds.min_x;
+				cells_y[r * n + i] = static_cast<std::int32_t>(std::floor(y / res)) - map_bounds.min_y;
+			}
+		}
+
+		// The guess itself is the result unless a candidate scores strictly better
+		Candidate best;
+		best.x = 0;
+		best.y = 0;
+		best.rotation = half_rotations;
+		best.level = 0;
+		best.score = score(best, cells_x, cells_y, n);
+		result.evaluated = 1;
+
+		// Coarsest candidates, best last so that they are refined first
+		const auto by_score = [](const Candidate & a, const Candidate & b) { return a.score < b.score; };
+		std::vector<Candidate> stack;
+		const std::int32_t top_step = 1 << depth;
+		for (std::uint32_t r = 0; r < rotations; r++)
+		{
+			for (std::int32_t ox = -window; ox <= window; ox += top_step)
+			{
+				for (std::int32_t oy = -window; oy <= window; oy += top_step)
+				{
+					Candidate candidate;
+					candidate.x = ox;
+					candidate.y = oy;
+					candidate.rotation = r;
+					candidate.level = depth;
+					candidate.score = score(candidate, cells_x, cells_y, n);
+					result.evaluated++;
+					stack.push_back(candidate);
+				}
+			}
+		}
+		std::sort(stack.begin(), stack.end(), by_score);
+
+		// Depth-first branch and bound: a candidate's score bounds every offset it stands for
+		while (!stack.empty())
+		{
+			Candidate candidate = stack.back();
+			stack.pop_back();
+			if (candidate.score <= best.score)
+			{
+				continue;
+			}
+			if (candidate.level == 0)
+			{
+				best = candidate;
+				continue;
+			}
+
+			const std::int32_t half = 1 << (candidate.level - 1);
+			std::array<Candidate, 4> children;
+			unsigned int num_children = 0;
+			for (std::int32_t dx = 0; dx <= half; dx += half)
+			{
+				for (std::int32_t dy = 0; dy <= half; dy += half)
+				{
+					Candidate child = candidate;
+					child.x += dx;
+					child.y += dy;
+					child.level--;
+					if (child.x > window || child.y > window)
+					{
+						continue;
+					}
+					child.score = score(child, cells_x, cells_y, n);
+					result.evaluated++;
+					if (child.score > best.score)
+					{
+						// Insertion sort, best last
+						unsigned int i = num_children++;
+						for (; i > 0 && children[i - 1].score > child.score; i--)
+						{
+							children[i] = children[i - 1];
+						}
+						children[i] = child;
+					}
+				}
+			}
+			stack.insert(stack.end(), children.begin(), children.begin() + num_children);
+		}
+
+		result.pose.x = guess.x + best.x * res;
+		result.pose.y = guess.y + best.y * res;
+		result.pose.theta = rigid2d::normalize_angle(guess.theta +\
+							(static_cast<double>(best.rotation) - half_rotations) * angular_step);
+		result.score = best.score / (100.0 * n);
+		return result;
+	}
+
+	std::uint32_t ScanMatcher::score(const Candidate & candidate, const std::vector<std::int32_t> & cells_x,\
+									 const std::vector<std::int32_t> & cells_y, const unsigned long int & n) const
+	{
+		const std::int32_t * xs = cells_x.data() + candidate.rotation * n;
+		const std::int32_t * ys = cells_y.data() + candidate.rotation * n;
+		std::uint32_t sum = 0;
+		for (unsigned long int i = 0; i < n; i++)
+		{
+			sum += lookup(candidate.level, xs[i] + candidate.x, ys[i] + candidate.y);
+		}
+		return sum;
+	}
+
+	std::uint8_t ScanMatcher::lookup(const std::uint32_t & level, const std::int32_t & cx, const std::int32_t & cy) const
+	{
+		const std::int32_t pad = (1 << level) - 1;
+		const std::int32_t width = static_cast<std::int32_t>(map_bounds.width) + pad;
+		const std::int32_t height = static_cast<std::int32_t>(map_bounds.height) + pad;
+		const std::int32_t ix = cx + pad;
+		const std::int32_t iy = cy + pad;
+		if (ix < 0 || iy < 0 || ix >= width || iy >= height)
+		{
+			return 0;
+		}
+		return levels[level][static_cast<unsigned long int>(iy) * width + ix];
+	}
+}
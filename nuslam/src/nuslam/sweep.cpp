@@ -0,0 +1,160 @@
+#include "nuslam/sweep.hpp"
+#include <nuslam/ekf.hpp>
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+
+namespace nuslam
+{
+	// SweepAxis
+	SweepAxis::SweepAxis(const std::string & name_, const std::vector<double> & values_)
+	{
+		name = name_;
+		values = values_;
+	}
+
+	// SweepResult
+	SweepResult::SweepResult()
+	{
+		pose_rmse = 0.0;
+		landmark_rmse = 0.0;
+		landmarks_mapped = 0;
+		wall_time = 0.0;
+		score = 0.0;
+	}
+
+	// Field of config called name
+	static double & parameter(ReplayConfig & config, const std::string & name)
+	{
+		if (name == "threshold")
+		{
+			return config.threshold;
+		} else if (name == "max_radius")
+		{
+			return config.max_radius;
+		} else if (name == "max_range")
+		{
+			return config.max_range;
+		} else if (name == "x_noise")
+		{
+			return config.x_noise;
+		} else if (name == "y_noise")
+		{
+			return config.y_noise;
+		} else if (name == "theta_noise")
+		{
+			return config.theta_noise;
+		} else if (name == "range_noise")
+		{
+			return config.range_noise;
+		} else if (name == "bearing_noise")
+		{
+			return config.bearing_noise;
+		} else if (name == "mahalanobis_lower")
+		{
+			return config.mahalanobis_lower;
+		} else if (name == "mahalanobis_upper")
+		{
+			return config.mahalanobis_upper;
+		}
+		throw std::invalid_argument("Unknown sweep parameter " + name);
+	}
+
+	// Helper Functions
+	void set_parameter(ReplayConfig & config, const std::string & name, const double & value)
+	{
+		parameter(config, name) = value;
+	}
+
+	double get_parameter(const ReplayConfig & config, const std::string & name)
+	{
+		ReplayConfig copy = config;
+		return parameter(copy, name);
+	}
+
+	std::vector<ReplayConfig> expand_grid(const ReplayConfig & base, const std::vector<SweepAxis> & axes)
+	{
+		std::vector<ReplayConfig> configs(1, base);
+		for (auto axis = axes.begin(); axis != axes.end(); axis++)
+		{
+			if (axis->values.empty())
+			{
+				throw std::invalid_argument("Sweep parameter " + axis->name + " has no values");
+			}
+			std::vector<ReplayConfig> expanded;
+			expanded.reserve(configs.size() * axis->values.size());
+			for (auto iter = configs.begin(); iter != configs.end(); iter++)
+			{
+				for (auto value = axis->values.begin(); value != axis->values.end(); value++)
+				{
+					ReplayConfig config = *iter;
+					set_parameter(config, axis->name, *value);
+					expanded.push_back(config);
+				}
+			}
+			configs = expanded;
+		}
+		return configs;
+	}
+
+	std::vector<SweepResult> sweep(const Dataset & data, const std::vector<ReplayConfig> & configs,\
+								   const unsigned int & threads, const unsigned int & seed)
+	{
+		std::vector<SweepResult> results(configs.size());
+
+		unsigned int num_threads = threads;
+		if (num_threads == 0)
+		{
+			num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+		}
+		num_threads = std::min<unsigned long int>(num_threads, configs.size());
+
+		// Workers claim configurations one at a time, so a slow configuration does not hold up a
+		// statically assigned share of the others. Each writes only its own results slot.
+		std::atomic<unsigned long int> next(0);
+		auto worker = [&]()
+		{
+			for (unsigned long int i = next++; i < configs.size(); i = next++)
+			{
+				seed_random(seed);
+				ReplayResult replayed = replay(data, configs.at(i));
+				SweepResult & result = results.at(i);
+				result.config = configs.at(i);
+				result.pose_rmse = replayed.pose_rmse;
+				result.landmark_rmse = replayed.landmark_rmse;
+				result.landmarks_mapped = replayed.landmarks_mapped;
+				result.wall_time = replayed.wall_time;
+			}
+		};
+
+		std::vector<std::thread> pool;
+		pool.reserve(num_threads);
+		for (unsigned int t = 0; t < num_threads; t++)
+		{
+			pool.push_back(std::thread(worker));
+		}
+		for (auto iter = pool.begin(); iter != pool.end(); iter++)
+		{
+			iter->join();
+		}
+
+		return results;
+	}
+
+	void rank_results(std::vector<SweepResult> & results, const double & landmark_weight)
+	{
+		for (auto iter = results.begin(); iter != results.end(); iter++)
+		{
+			if (iter->landmarks_mapped == 0)
+			{
+				iter->score = std::numeric_limits<double>::infinity();
+			} else {
+				iter->score = iter->pose_rmse + landmark_weight * iter->landmark_rmse;
+			}
+		}
+		std::stable_sort(results.begin(), results.end(),\
+						 [](const SweepResult & a, const SweepResult & b) { return a.score < b.score; });
+	}
+}
@@ -0,0 +1,105 @@
+#include "nuslam/trace.hpp"
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+
+namespace nuslam
+{
+	// TraceEvent
+	TraceEvent::TraceEvent()
+	{
+		source_stamp = 0.0;
+		time = 0.0;
+	}
+
+	TraceEvent::TraceEvent(const double & source_stamp_, const std::string & hop_, const double & time_)
+	{
+		source_stamp = source_stamp_;
+		hop = hop_;
+		time = time_;
+	}
+
+	// TraceLog
+	TraceLog::TraceLog()
+	{
+		active = false;
+		capacity = 0;
+		next = 0;
+	}
+
+	void TraceLog::start(const unsigned long int & capacity_)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (capacity_ == 0)
+		{
+			throw std::invalid_argument("TraceLog capacity must be positive.");
+		}
+		capacity = capacity_;
+		ring.clear();
+		ring.reserve(capacity);
+		next = 0;
+		active = true;
+	}
+
+	bool TraceLog::enabled() const
+	{
+		return active;
+	}
+
+	void TraceLog::record(const double & source_stamp, const std::string & hop, const double & time)
+	{
+		if (!active)
+		{
+			return;
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+
+		if (ring.size() < capacity)
+		{
+			ring.push_back(TraceEvent(source_stamp, hop, time));
+		} else {
+			ring.at(next) = TraceEvent(source_stamp, hop, time);
+		}
+		next = (next + 1) % capacity;
+
+		LatencyHistogram *& age = ages[hop];
+		if (age == nullptr)
+		{
+			age = &latency_registry().histogram("trace." + hop);
+		}
+		// Clocks may disagree slightly across machines; clamp instead of wrapping around
+		double age_ns = (time - source_stamp) * 1e9;
+		age->record(age_ns > 0.0 ? static_cast<std::uint64_t>(age_ns) : 0);
+	}
+
+	std::vector<TraceEvent> TraceLog::events() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (ring.size() < capacity)
+		{
+			return ring;
+		}
+		// Full: the oldest event is the one about to be overwritten
+		std::vector<TraceEvent> ordered(ring.begin() + next, ring.end());
+		ordered.insert(ordered.end(), ring.begin(), ring.begin() + next);
+		return ordered;
+	}
+
+	void TraceLog::dump(const std::string & filename) const
+	{
+		std::vector<TraceEvent> recorded = events();
+		std::ofstream out(filename, std::ios::trunc);
+		out << "source_stamp,hop,time,age_ms\n";
+		out << std::fixed << std::setprecision(6);
+		for (auto iter = recorded.begin(); iter != recorded.end(); iter++)
+		{
+			out << iter->source_stamp << "," << iter->hop << "," << iter->time << ","\
+				<< (iter->time - iter->source_stamp) * 1e3 << "\n";
+		}
+		out.close();
+		if (!out)
+		{
+			throw std::runtime_error("Unable to write trace file " + filename);
+		}
+	}
+}
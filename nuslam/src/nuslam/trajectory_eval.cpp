@@ -0,0 +1,247 @@
+#include "nuslam/trajectory_eval.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iterator>  // to use std::prev
+#include <stdexcept>
+
+namespace nuslam
+{
+	using rigid2d::Transform2DS;
+	using rigid2d::Vector2D;
+
+	// Errors are recorded in the histogram in units of 1e-9
+	static constexpr double HIST_SCALE = 1e9;
+
+	// Pose as a transform from its frame to the robot
+	static Transform2D to_transform(const Pose2D & pose)
+	{
+		return Transform2D(Vector2D(pose.x, pose.y), pose.theta);
+	}
+
+	// ErrorSummary
+	ErrorSummary::ErrorSummary()
+	{
+		count = 0;
+		rmse = 0.0;
+		mean = 0.0;
+		p50 = 0.0;
+		p90 = 0.0;
+		p99 = 0.0;
+		max = 0.0;
+	}
+
+	// ErrorStats
+	ErrorStats::ErrorStats()
+	{
+		reset();
+	}
+
+	void ErrorStats::record(const double & error)
+	{
+		double magnitude = std::fabs(error);
+		hist.record(static_cast<std::uint64_t>(magnitude * HIST_SCALE + 0.5));
+		n++;
+		sum += magnitude;
+		sum_sq += magnitude * magnitude;
+		max_error = std::max(max_error, magnitude);
+	}
+
+	unsigned long int ErrorStats::count() const
+	{
+		return n;
+	}
+
+	ErrorSummary ErrorStats::summary() const
+	{
+		ErrorSummary result;
+		if (n == 0)
+		{
+			return result;
+		}
+		result.count = n;
+		result.rmse = std::sqrt(sum_sq / n);
+		result.mean = sum / n;
+		result.p50 = hist.percentile(50.0) / HIST_SCALE;
+		result.p90 = hist.percentile(90.0) / HIST_SCALE;
+		result.p99 = hist.percentile(99.0) / HIST_SCALE;
+		result.max = max_error;
+		return result;
+	}
+
+	void ErrorStats::reset()
+	{
+		hist.reset();
+		n = 0;
+		sum = 0.0;
+		sum_sq = 0.0;
+		max_error = 0.0;
+	}
+
+	// AlignedPose
+	AlignedPose::AlignedPose()
+	{
+		stamp = 0.0;
+		estimate = Pose2D();
+		truth = Pose2D();
+	}
+
+	// TrajectoryErrorSummary
+	TrajectoryErrorSummary::TrajectoryErrorSummary()
+	{
+		ate_trans = ErrorSummary();
+		ate_rot = ErrorSummary();
+		rpe_trans = ErrorSummary();
+		rpe_rot = ErrorSummary();
+	}
+
+	// TrajectoryEvaluator
+	TrajectoryEvaluator::TrajectoryEvaluator() : TrajectoryEvaluator(1.0, 1.0, false)
+	{
+	}
+
+	TrajectoryEvaluator::TrajectoryEvaluator(const double & truth_window_, const double & rpe_delta_, const bool & align_first_)
+	{
+		if (!(truth_window_ > 0.0) || !(rpe_delta_ > 0.0))
+		{
+			throw std::invalid_argument("TrajectoryEvaluator windows must be positive.");
+		}
+		truth_window = truth_window_;
+		rpe_delta = rpe_delta_;
+		align_first = align_first_;
+		aligned = false;
+		evaluated = 0;
+	}
+
+	void TrajectoryEvaluator::add_truth(const double & stamp, const Pose2D & pose)
+	{
+		if (!truth.empty() && stamp <= truth.back().stamp)
+		{
+			return;
+		}
+		truth.push_back(PathSample(stamp, pose));
+
+		// Keep the newest sample at or before the window start, so the whole window can be interpolated
+		while (truth.size() >= 2 && truth.at(1).stamp <= stamp - truth_window)
+		{
+			truth.pop_front();
+		}
+
+		// Evaluate the estimates which ground truth now brackets
+		while (!pending.empty() && pending.front().stamp <= stamp)
+		{
+			if (pending.front().stamp >= truth.front().stamp)
+			{
+				evaluate(pending.front());
+			}
+			pending.pop_front();
+		}
+	}
+
+	void TrajectoryEvaluator::add_estimate(const double & stamp, const Pose2D & pose)
+	{
+		if (truth.empty() || stamp > truth.back().stamp)
+		{
+			// Wait for ground truth, for at most truth_window
+			pending.push_back(PathSample(stamp, pose));
+			while (pending.front().stamp < stamp - truth_window)
+			{
+				pending.pop_front();
+			}
+		} else if (stamp >= truth.front().stamp) {
+			evaluate(PathSample(stamp, pose));
+		}
+	}
+
+	unsigned long int TrajectoryEvaluator::count() const
+	{
+		return evaluated;
+	}
+
+	const AlignedPose & TrajectoryEvaluator::latest() const
+	{
+		if (recent.empty())
+		{
+			throw std::out_of_range("TrajectoryEvaluator has not evaluated any estimate.");
+		}
+		return recent.back();
+	}
+
+	TrajectoryErrorSummary TrajectoryEvaluator::summary() const
+	{
+		TrajectoryErrorSummary result;
+		result.ate_trans = ate_trans.summary();
+		result.ate_rot = ate_rot.summary();
+		result.rpe_trans = rpe_trans.summary();
+		result.rpe_rot = rpe_rot.summary();
+		return result;
+	}
+
+	void TrajectoryEvaluator::reset()
+	{
+		aligned = false;
+		T_truth_estimate = Transform2D();
+		truth.clear();
+		pending.clear();
+		recent.clear();
+		evaluated = 0;
+		ate_trans.reset();
+		ate_rot.reset();
+		rpe_trans.reset();
+		rpe_rot.reset();
+	}
+
+	void TrajectoryEvaluator::evaluate(const PathSample & estimate)
+	{
+		AlignedPose pair;
+		pair.stamp = estimate.stamp;
+
+		// Ground truth samples on either side of the stamp
+		auto after = std::upper_bound(truth.begin(), truth.end(), estimate.stamp,\
+									  [](const double & stamp, const PathSample & sample) { return stamp < sample.stamp; });
+		auto before = std::prev(after);
+		if (after == truth.end())
+		{
+			pair.truth = before->pose;
+		} else {
+			double s = (estimate.stamp - before->stamp) / (after->stamp - before->stamp);
+			pair.truth.x = before->pose.x + s * (after->pose.x - before->pose.x);
+			pair.truth.y = before->pose.y + s * (after->pose.y - before->pose.y);
+			pair.truth.theta = rigid2d::normalize_angle(before->pose.theta +\
+								s * rigid2d::normalize_angle(after->pose.theta - before->pose.theta));
+		}
+
+		// Express the estimate in the ground truth frame
+		pair.estimate = estimate.pose;
+		if (align_first)
+		{
+			if (!aligned)
+			{
+				T_truth_estimate = to_transform(pair.truth) * to_transform(estimate.pose).inv();
+				aligned = true;
+			}
+			Transform2DS disp = (T_truth_estimate * to_transform(estimate.pose)).displacement();
+			pair.estimate = Pose2D(disp.x, disp.y, disp.theta);
+		}
+
+		// Absolute trajectory error
+		ate_trans.record(std::hypot(pair.estimate.x - pair.truth.x, pair.estimate.y - pair.truth.y));
+		ate_rot.record(rigid2d::normalize_angle(pair.estimate.theta - pair.truth.theta));
+
+		// Relative pose error against the newest pose at least rpe_delta older
+		while (recent.size() >= 2 && recent.at(1).stamp <= pair.stamp - rpe_delta)
+		{
+			recent.pop_front();
+		}
+		if (!recent.empty() && recent.front().stamp <= pair.stamp - rpe_delta)
+		{
+			const AlignedPose & start = recent.front();
+			Transform2D truth_motion = to_transform(start.truth).inv() * to_transform(pair.truth);
+			Transform2D estimate_motion = to_transform(start.estimate).inv() * to_transform(pair.estimate);
+			Transform2DS disp = (truth_motion.inv() * estimate_motion).displacement();
+			rpe_trans.record(std::hypot(disp.x, disp.y));
+			rpe_rot.record(rigid2d::normalize_angle(disp.theta));
+		}
+		recent.push_back(pair);
+		evaluated++;
+	}
+}
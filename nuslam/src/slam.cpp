@@ -6,10 +6,8 @@
 ///   o_fid_ (string): child frame ID for the published tf transform
 ///   wbase_ (float): wheel base of modeled diff drive robot
 ///   wrad_ (float): wheel radius of modeled diff drive robot
-///   frequency (double): frequency of control loop.
-///   callback_flag (bool): specifies whether to send a new transform (only when new pose is read)
-///   odom_flag (bool): specifies whether a new joint position was recorded (used in EKF Prediction)
-///   landmark_flag (bool): specifies whether a new landmark position was recorded (used in EKF Update)
+///   odom_flag (std::atomic<bool>): specifies whether a new joint position was recorded (used in EKF Prediction)
+///   service_flag (std::atomic<bool>): specifies whether the EKF thread should apply a requested pose reset
 ///
 ///   pose (rigid2d::Pose2D): modeled diff drive robot pose based on read wheel encoder angles
 ///   wl_enc (float): left wheel encoder angles
@@ -19,70 +17,242 @@
 ///   NOTE: using Vb instead of EKF Vb for smoother visualization in RViz; no impact on EKFSLAM estimate
 ///   w_vel (rigid2d::WheelVelocities): wheel velocities used to calculate ddrive robot twist
 ///
-///   ekf_wl_enc (float): left wheel encoder angles used for EKFSLAM
-///   ekf_wr_enc (float): right wheel encoder angles used for EKFSLAM
+///   encoder_snapshot (nuslam::Snapshot<rigid2d::WheelVelocities>): latest wheel angles, handed from odometry to EKF thread
+///   ekf_pose_snapshot (nuslam::Snapshot<EKFEstimate>): latest EKF pose and the stamp of the LaserScan it
+///   incorporates, handed from EKF to odometry thread
+///   reset_snapshot (nuslam::Snapshot<rigid2d::Pose2D>): requested reset pose, handed from odometry to EKF thread
+///   ekf_queue (ros::CallbackQueue): callback queue for landmark measurements, serviced by its own thread
+///   map_file_ (string): path of the map file written by save_map and, if load_map_ is set, loaded at startup
+///   load_map_ (bool): whether to start from the map saved in map_file_ instead of an empty map
+///   localization_only_ (bool): whether to freeze the map (loaded from map_file_ or received on known_map)
+///   and only estimate the robot pose
+///   known_map_timeout_ (double): seconds to wait for the known_map message in localization-only mode
 ///   ekf_driver (rigid2d::DiffDrive): model of the diff drive robot used for EKFSLAM
 ///   ekf (nuslam::EKF): contains state vector for both robot and map state, as well as methods for computing estimates
-///   radii (std::vector<double>): radii of landmarks reported by EKF estimate
-///   x_pts (std::vector<double>): x coordinates of landmarks reported by EKF estimate
-///   y_pts (std::vector<double>): y coordinates of landmarks reported by EKF estimate
+///   belief_map (nuslam::TurtleMap): x,y coordinates and radii of landmarks reported by EKF estimate
+///   measurements (std::vector<nuslam::Point>): landmarks of the latest TurtleMap, reused across callbacks to keep its storage
+///   diagnostics_period_ (double): seconds between latency diagnostics, 0 to disable
+///   latency_file_ (string): if set, the latency histograms are written to this file on shutdown
+///   trace_ (bool): whether to record the hop times (landmarks_received, ekf_updated, tf_sent) of each scan
+///   trace (nuslam::TraceLog): hop times of the most recent scans, keyed by LaserScan stamp
+///   trace_file_ (string): if set and trace_ is enabled, the hop times are written to this file on shutdown
+///   scan_matching_ (bool): whether to correct the EKF pose by matching each LaserScan against an occupancy grid
+///   scan_map (nuslam::GridMap): occupancy grid built from the LaserScans at the corrected EKF pose
+///   scan_matcher (nuslam::ScanMatcher): correlative scan matcher, with lookup grids precomputed from scan_map
+///   scan_cloud (nuslam::ScanCloud): end points of the LaserScan beams, reused across scans
+///   match_map_period_ (int): number of scans between recomputations of the scan matcher lookup grids
+///   match_min_score_ (double): mean occupancy (0 to 1) below which a scan match is not applied
+///   match_noise_var (rigid2d::Pose2D): variance of the x, y and theta of a scan match
+///   roi_ (bool): whether to publish the predicted measurement of each mapped landmark, so that the landmark
+///   detector only processes the beams where landmarks are expected
+///   predictions (std::vector<nuslam::MeasurementPrediction>): predicted measurements, reused across updates
+///   predictions_msg (nuslam::LandmarkPredictions): predicted ranges and bearings with their standard deviations
 ///
 ///   odom_tf (geometry_msgs::TransformStamped): odometry frame transform used to update RViz sim
 ///   odom (nav_msgs::Odometry): odometry message containing pose and twist published to odom topic
 ///
 /// PUBLISHES:
-///   odom (nav_msgs::Odometry): publishes odometry message containing pose(x,y,z) and twist(lin,ang)
-///   landmarks (nuslam::TurtleMap): publishes TurtleMap message containing landmark coordinates (x,y) and radii
+///   odom (nav_msgs::Odometry): publishes odometry message containing pose(x,y,z) and twist(lin,ang),
+///   stamped with the JointState it was computed from
+///   landmarks (nuslam::TurtleMap): publishes TurtleMap message containing landmark coordinates (x,y) and radii,
+///   stamped with the LaserScan of the last incorporated measurements
+///   predictions (nuslam::LandmarkPredictions): expected range and bearing of each mapped landmark after each
+///   measurement update, stamped with the LaserScan of the incorporated measurements (roi_ true)
+///   /diagnostics (diagnostic_msgs::DiagnosticArray): p50/p90/p99/max latency of the odometry and landmark
+///   callbacks and of the EKF predict, association and measurement update
+///
+/// SERVICES:
+///   set_pose (rigid2d::SetPose): resets the robot's pose belief
+///   save_map (std_srvs::Trigger): saves the current map to map_file_
 ///
 /// SUBSCRIBES:
+///   known_map (nuslam::TurtleMap), landmark x,y coordinates in the map frame, received once at startup in
+///   localization-only mode if no map file is loaded. The map frame is the initial pose of the robot, so
+///   world-frame landmarks (e.g. ground truth) assume the robot spawns at the world origin
 ///   /joint_states (sensor_msgs::JointState), which records the ddrive robot's joint states
 ///   /landmarks_node/landmarks (nuslam::TurtleMap), stores lists of x,y coordinates and radii of detected landmarks
+///   /scan (sensor_msgs::LaserScan), matched against the occupancy grid to correct the EKF pose (scan_matching_ true)
+///
+/// THREADS:
+///   odometry: services the global callback queue (js_callback, set_poseCallback) and publishes odom and
+///   the map->odom transform on every joint state, using the latest EKF pose snapshot, so that odometry
+///   latency does not depend on the duration of the EKF update.
+///   ekf: services ekf_queue (landmark_callback, scan_callback, save_mapCallback), performs the EKF prediction,
+///   measurement and scan match updates and publishes the landmark map and predictions.
 ///
 /// FUNCTIONS:
 ///   js_callback (void): callback for /joint_states subscriber, which records the ddrive robot's joint states
+///   and publishes odometry
+///   apply_prediction (bool): applies a requested pose reset and the EKF prediction from the latest wheel angles
 ///   landmark_callback (void): callback for /landmarks_node/landmarks subscriber, used to perform EKFSLAM
+///   publish_predictions (void): publishes the predicted measurement of each mapped landmark
+///   scan_callback (void): callback for /scan subscriber, which corrects the EKF pose by scan matching
 ///   set_poseCallback (bool): callback for set_pose service, which resets the robot's pose in the tf tree
+///   save_mapCallback (bool): callback for save_map service, which saves the current map to map_file_
+///   publish_odometry (void): publishes the odom message and map->odom transform
+///   diagnostics_callback (void): timer callback which publishes the latency diagnostics
 
 #include <ros/ros.h>
+#include <ros/callback_queue.h>
+#include <ros/topic.h>
 #include<sensor_msgs/JointState.h>
+#include<sensor_msgs/LaserScan.h>
 #include<nav_msgs/Odometry.h>
 #include <tf2/LinearMath/Quaternion.h>
 #include <tf2_ros/transform_broadcaster.h>
 #include <tf2_geometry_msgs/tf2_geometry_msgs.h>
+#include <std_srvs/Trigger.h>
 #include "rigid2d/SetPose.h"
 
 #include<string>
+#include<vector>
+#include<atomic>
+#include<memory>
+#include<algorithm>
 
 #include "nuslam/landmarks.hpp"
 #include "nuslam/ekf.hpp"
+#include "nuslam/grid_map.hpp"
+#include "nuslam/scan_cloud.hpp"
+#include "nuslam/scan_matcher.hpp"
+#include "nuslam/snapshot.hpp"
+#include "nuslam/latency.hpp"
+#include "nuslam/latency_diagnostics.hpp"
+#include "nuslam/trace.hpp"
 #include "nuslam/TurtleMap.h"
+#include "nuslam/LandmarkPredictions.h"
 
 #include "rigid2d/rigid2d.hpp"
 #include "rigid2d/diff_drive.hpp"
 
+struct EKFEstimate
+// EKF pose and the stamp of the LaserScan whose landmarks it incorporates
+{
+  rigid2d::Pose2D pose;
+  ros::Time scan_stamp;
+};
+
 // GLOBAL VARS
+// Odometry thread
 float wl_enc = 0;
 float wr_enc = 0;
-float ekf_wl_enc = 0;
-float ekf_wr_enc = 0;
 rigid2d::Twist2D Vb;
 rigid2d::WheelVelocities w_vel;
-rigid2d::Pose2D reset_pose;
 rigid2d::DiffDrive driver;
+std::string o_fid_, b_fid_;
+ros::Publisher odom_pub;
+std::unique_ptr<tf2_ros::TransformBroadcaster> odom_broadcaster;
+// Shared between threads
+std::atomic<bool> odom_flag(false);
+std::atomic<bool> service_flag(false);
+nuslam::Snapshot<rigid2d::WheelVelocities> encoder_snapshot;
+nuslam::Snapshot<EKFEstimate> ekf_pose_snapshot;
+nuslam::Snapshot<rigid2d::Pose2D> reset_snapshot;
+// EKF thread
 rigid2d::DiffDrive ekf_driver;
-bool callback_flag = false;
-bool landmark_flag = false;
-bool odom_flag = false;
-bool service_flag = false;
 // EKF object
 nuslam::EKF ekf;
-std::vector<double> radii;
-std::vector<double> x_pts;
-std::vector<double> y_pts;
+nuslam::TurtleMap belief_map;
+std::vector<nuslam::Point> measurements;
+ros::Publisher lnd_pub;
+std::string map_file_ = "nuslam_map.bin";
+// Scan Matching
+bool scan_matching_ = false;
+nuslam::GridMap scan_map;
+nuslam::ScanMatcher scan_matcher;
+nuslam::ScanCloud scan_cloud;
+unsigned long int scans_since_map = 0;
+int match_map_period_ = 10;
+double match_min_score_ = 0.5;
+rigid2d::Pose2D match_noise_var(1e-4, 1e-4, 1e-4);
+// Region of Interest Predictions
+bool roi_ = false;
+std::vector<nuslam::MeasurementPrediction> predictions;
+nuslam::LandmarkPredictions predictions_msg;
+ros::Publisher predictions_pub;
+// Latency Instrumentation
+nuslam::LatencyHistogram & odometry_latency = nuslam::latency_registry().histogram("slam.odometry");
+nuslam::LatencyHistogram & landmark_latency = nuslam::latency_registry().histogram("slam.landmarks");
+nuslam::LatencyHistogram & scan_latency = nuslam::latency_registry().histogram("slam.scan_match");
+ros::Publisher diagnostics_pub;
+// Tracing
+nuslam::TraceLog trace;
+ros::Time last_traced_stamp; // odometry thread
+
+void publish_odometry(const ros::Time & current_time)
+{
+  /// \brief publish Tmo = map->odom and the SLAM odometry message using the
+  /// current odometry pose and the latest EKF pose snapshot
+  ///
+  /// \param current_time (ros::Time): stamp of the published messages
+
+  // SLAM Node publishes Tmo = map->odom
+  // To get this, we do Tmo = Tmb * Tob.inv
+  // Where Tmb = map->base and Tob = odom->base
+  rigid2d::Pose2D odom_pose = driver.get_pose();
+  const EKFEstimate & estimate = ekf_pose_snapshot.read();
+  rigid2d::Pose2D ekf_pose = estimate.pose;
+
+  // Construct Tmb
+  rigid2d::Vector2D Vmb = rigid2d::Vector2D(ekf_pose.x, ekf_pose.y);
+  rigid2d::Transform2D Tmb = rigid2d::Transform2D(Vmb, ekf_pose.theta);
+  // Construct Tob
+  rigid2d::Vector2D Vob = rigid2d::Vector2D(odom_pose.x, odom_pose.y);
+  rigid2d::Transform2D Tob = rigid2d::Transform2D(Vob, odom_pose.theta);
+  // Now find Tmo
+  rigid2d::Transform2D Tmo = Tmb * Tob.inv();
+  rigid2d::Transform2DS TmoS = Tmo.displacement();
+
+  geometry_msgs::TransformStamped odom_tf;
+  odom_tf.header.stamp = current_time;
+  ROS_DEBUG("body_frame_id %s", b_fid_.c_str());
+  ROS_DEBUG("odom_frame_id %s", o_fid_.c_str());
+  odom_tf.header.frame_id = o_fid_;
+  odom_tf.child_frame_id = b_fid_;
+  // Pose
+  odom_tf.transform.translation.x = TmoS.x;
+  odom_tf.transform.translation.y = TmoS.y;
+  odom_tf.transform.translation.z = 0;
+  // use tf2 to create transform
+  tf2::Quaternion q;
+  q.setRPY(0, 0, TmoS.theta);
+  geometry_msgs::Quaternion odom_quat = tf2::toMsg(q);
+  odom_tf.transform.rotation = odom_quat;
+  // Send the Transform
+  odom_broadcaster->sendTransform(odom_tf);
+  // First transform which includes this scan's measurements
+  if (estimate.scan_stamp != last_traced_stamp)
+  {
+    trace.record(estimate.scan_stamp.toSec(), "tf_sent", ros::Time::now().toSec());
+    last_traced_stamp = estimate.scan_stamp;
+  }
+
+  // Update and Publish Odom Msg
+  // Init Msg
+  nav_msgs::Odometry odom;
+  odom.header.stamp = current_time;
+  odom.header.frame_id = o_fid_;
+  // Pose
+  odom.pose.pose.position.x = ekf_pose.x;
+  odom.pose.pose.position.y = ekf_pose.y;
+  odom.pose.pose.position.z = 0.0;
+  tf2::Quaternion ekf_q;
+  ekf_q.setRPY(0, 0, TmoS.theta);
+  geometry_msgs::Quaternion ekf_quat = tf2::toMsg(ekf_q);
+  odom.pose.pose.orientation = ekf_quat;
+  // Twist
+  odom.child_frame_id = b_fid_;
+  odom.twist.twist.linear.x = Vb.v_x;
+  odom.twist.twist.linear.y = Vb.v_y;
+  odom.twist.twist.angular.z = Vb.w_z;
+  // Publish the Message
+  odom_pub.publish(odom);
+}
 
 void js_callback(const sensor_msgs::JointState::ConstPtr &js)
 {
-  /// \brief /joint_states subscriber callback. Records left and right wheel angles
+  /// \brief /joint_states subscriber callback. Records left and right wheel angles,
+  /// hands them to the EKF thread and publishes odometry. Runs on the odometry thread.
   ///
   /// \param js (sensor_msgs::JointState): the left and right wheel joint angles
   /// \returns pose (rigid2d::Pose2D): modeled diff drive robot pose based on read wheel encoder angles
@@ -92,12 +262,14 @@ void js_callback(const sensor_msgs::JointState::ConstPtr &js)
   * changing the message, in the case that another node is also listening to it.
   */
   //ConstPtr is a smart pointer which knows to de-allocate memory
+  nuslam::ScopedTimer timer(odometry_latency);
   wl_enc = js->position.at(0);
-  ekf_wl_enc = wl_enc;
   // wl_enc = rigid2d::normalize_encoders(js->position.at(0));
   wr_enc = js->position.at(1);
-  ekf_wr_enc = wr_enc;
   // wr_enc = rigid2d::normalize_encoders(js->position.at(1));
+  // Hand encoder angles to EKF thread
+  encoder_snapshot.write(rigid2d::WheelVelocities(wl_enc, wr_enc));
+  odom_flag = true;
 	w_vel = driver.updateOdometry(wl_enc, wr_enc);
 	// ROS_INFO("wheel vel")
   // Get Twist for EKF
@@ -105,65 +277,181 @@ void js_callback(const sensor_msgs::JointState::ConstPtr &js)
   // Print Wheel Angles
 	// std::cout << driver;
 
-  callback_flag = true;
-  odom_flag = true;
+  // Stamp odometry with the time the wheel angles were measured
+  publish_odometry(js->header.stamp.isZero() ? ros::Time::now() : js->header.stamp);
+}
+
+bool apply_prediction()
+{
+  /// \brief apply a pose reset requested through set_pose, then, if new wheel angles were
+  /// recorded, the EKF prediction. Runs on the EKF thread.
+  ///
+  /// \returns true if the EKF prediction was performed
+
+  // Apply pose reset requested through set_pose
+  if (service_flag.exchange(false))
+  {
+    rigid2d::Pose2D reset_pose = reset_snapshot.read();
+    ekf_driver.reset(reset_pose);
+    ekf.reset_pose(reset_pose);
+  }
+
+  if (!odom_flag.exchange(false))
+  {
+    return false;
+  }
+  const rigid2d::WheelVelocities & ekf_enc = encoder_snapshot.read();
+  // NOTE: these wheel_vels will be different than the ones calculated using driver, as the internal
+  // encoder measure will be different between both objects
+  rigid2d::WheelVelocities ekf_w_vel = ekf_driver.updateOdometry(ekf_enc.ul, ekf_enc.ur);
+  rigid2d::Twist2D ekf_Vb = ekf_driver.wheelsToTwist(ekf_w_vel);
+  // Prediction Update EKF
+  ekf.predict(ekf_Vb);
+  return true;
 }
 
-void landmark_callback(const nuslam::TurtleMap &map)
+void publish_predictions(const ros::Time & stamp)
+{
+  /// \brief publish the expected range and bearing of each mapped landmark, with their standard
+  /// deviations, from the current EKF belief. Runs on the EKF thread.
+  ///
+  /// \param stamp (ros::Time): stamp of the LaserScan whose measurements the belief incorporates
+  ekf.predict_measurements(predictions);
+
+  // Filled in place, so the message keeps its capacity from one update to the next
+  predictions_msg.ranges.clear();
+  predictions_msg.bearings.clear();
+  predictions_msg.range_sigmas.clear();
+  predictions_msg.bearing_sigmas.clear();
+  for (auto iter = predictions.begin(); iter != predictions.end(); iter++)
+  {
+    predictions_msg.ranges.push_back(iter->range_bear.range);
+    predictions_msg.bearings.push_back(iter->range_bear.bearing);
+    predictions_msg.range_sigmas.push_back(iter->sigma.range);
+    predictions_msg.bearing_sigmas.push_back(iter->sigma.bearing);
+  }
+  predictions_msg.header.stamp = stamp;
+  predictions_pub.publish(predictions_msg);
+}
+
+void landmark_callback(const nuslam::TurtleMap::ConstPtr &map)
 {
   /// \brief /landmarks_node/landmarks subscriber callback. Used to perform
-  /// EKFSLAM Measurement Update. Prediction Update also happens here.
-  /// Condition for both updates: both happen only if joint state callback and landmark
-  /// are triggered
+  /// EKFSLAM Measurement Update. Prediction Update also happens here, if new wheel angles
+  /// were recorded since the last prediction (which scan_callback may have applied), so the
+  /// measurements are always incorporated. Runs on the EKF thread.
   ///
   /// \param map (nuslam::TurtleMap): message containing landmark coordinates (x,y) and radii
+  nuslam::ScopedTimer timer(landmark_latency);
+  trace.record(map->header.stamp.toSec(), "landmarks_received", ros::Time::now().toSec());
 
-  std::vector<nuslam::Point> measurements;
+  measurements.clear();
   // Convert map to vector of Points
   // Map data has x,y relative to robot, so no change needed
-  for (long unsigned int i = 0; i < map.radii.size(); i++)
+  for (long unsigned int i = 0; i < map->radii.size(); i++)
   {
-    rigid2d::Vector2D map_pose = rigid2d::Vector2D(map.x_pts.at(i), map.y_pts.at(i));
+    rigid2d::Vector2D map_pose = rigid2d::Vector2D(map->x_pts.at(i), map->y_pts.at(i));
     nuslam::Point map_point = nuslam::Point(map_pose);
     measurements.push_back(map_point);
     // std::cout << "\nPOINT: (" << map_point.pose.x << "," << map_point.pose.y << ")" << std::endl;
   }
 
   // Perform prediction step of EKF here using twist
-  if (odom_flag)
-  {
-    // NOTE: these wheel_vels will be different than the ones calculated using driver, as the internal
-    // encoder measure will be different between both objects
-    rigid2d::WheelVelocities ekf_w_vel = ekf_driver.updateOdometry(ekf_wl_enc, ekf_wr_enc);
-    rigid2d::Twist2D ekf_Vb = ekf_driver.wheelsToTwist(ekf_w_vel);
-    // Prediction Update EKF
-    ekf.predict(ekf_Vb);
-    // Perform measurement update step of EKF here
-    ekf.msr_update(measurements);
-  }
+  apply_prediction();
+  // Perform measurement update step of EKF here
+  ekf.msr_update(measurements);
 
-  // Return Map
-  std::vector<nuslam::Point> map_state = ekf.return_map();
+  trace.record(map->header.stamp.toSec(), "ekf_updated", ros::Time::now().toSec());
+
+  // Hand EKF pose to odometry thread
+  EKFEstimate estimate;
+  estimate.pose = ekf.return_pose();
+  estimate.scan_stamp = map->header.stamp;
+  ekf_pose_snapshot.write(estimate);
+
+  // Return Map, read in place since the EKF is only modified on this thread
+  const std::vector<nuslam::Point> & map_state = ekf.return_map();
 
   // Now, return landmarks radii x, and y positions each in a separate vector
-  radii.clear();
-  x_pts.clear();
-  y_pts.clear();
+  belief_map.radii.clear();
+  belief_map.x_pts.clear();
+  belief_map.y_pts.clear();
   for (auto iter = map_state.begin(); iter != map_state.end(); iter++)
   {
-    radii.push_back(0.08);
+    belief_map.radii.push_back(0.08);
     // std::cout << "RADIUS: " << iter->return_radius() << std::endl;
-    x_pts.push_back(iter->pose.x);
-    y_pts.push_back(iter->pose.y);
+    belief_map.x_pts.push_back(iter->pose.x);
+    belief_map.y_pts.push_back(iter->pose.y);
   }
 
-  landmark_flag = true;
-  callback_flag = true;
-  odom_flag = false;
+  // Publish Map State
+  belief_map.header.stamp = map->header.stamp;
+  lnd_pub.publish(belief_map);
+
+  if (roi_)
+  {
+    publish_predictions(map->header.stamp);
+  }
+}
+
+void scan_callback(const sensor_msgs::LaserScan::ConstPtr &lsr)
+{
+  /// \brief /scan subscriber callback. Matches the scan against the occupancy grid built from previous
+  /// scans, starting from the predicted EKF pose, and incorporates the match as a pose measurement,
+  /// so the pose stays corrected where no landmark is visible. The scan is then added to the grid
+  /// at the corrected pose. Runs on the EKF thread.
+  ///
+  /// \param lsr (sensor_msgs::LaserScan): the scan, whose frame is assumed to coincide with the robot's
+  nuslam::ScopedTimer timer(scan_latency);
+  apply_prediction();
+
+  scan_cloud.clear();
+  scan_cloud.reserve(lsr->ranges.size());
+  for (unsigned long int i = 0; i < lsr->ranges.size(); i++)
+  {
+    if (lsr->ranges.at(i) >= lsr->range_min && lsr->ranges.at(i) <= lsr->range_max)
+    {
+      double bearing = lsr->angle_min + i * lsr->angle_increment;
+      scan_cloud.push_back(nuslam::Point(nuslam::RangeBear(lsr->ranges.at(i), bearing)));
+    }
+  }
+
+  if (scan_matcher.has_map())
+  {
+    nuslam::ScanMatch match = scan_matcher.match(ekf.return_pose(), scan_cloud);
+    if (match.score >= match_min_score_)
+    {
+      ekf.pose_update(match.pose, match_noise_var);
+    }
+  }
+
+  // Recomputing the lookup grids costs about one match, so it is only done every match_map_period_ scans
+  scan_map.insert_scan(ekf.return_pose(), scan_cloud);
+  scan_map.clear_dirty();
+  scans_since_map++;
+  if (!scan_matcher.has_map() || scans_since_map >= static_cast<unsigned long int>(match_map_period_))
+  {
+    scan_matcher.set_map(scan_map);
+    scans_since_map = 0;
+  }
+
+  // Hand EKF pose to odometry thread
+  EKFEstimate estimate;
+  estimate.pose = ekf.return_pose();
+  estimate.scan_stamp = lsr->header.stamp;
+  ekf_pose_snapshot.write(estimate);
+}
+
+void diagnostics_callback(const ros::TimerEvent &)
+{
+  /// \brief publishes p50/p90/p99/max latency of each stage since startup on /diagnostics.
+  /// Runs on the odometry thread; the histograms are read without blocking the EKF thread.
+  diagnostics_pub.publish(nuslam::latency_diagnostics("slam", ros::Time::now()));
 }
 
 bool set_poseCallback(rigid2d::SetPose::Request& req, rigid2d::SetPose::Response& res)
 /// \brief set_pose service callback. Sets the turtlebot's pose belief to desired value.
+/// Runs on the odometry thread; the EKF thread applies the reset on its next update.
 ///
 /// \param x (float32): desired x pose.
 /// \param y (float32): desired y pose.
@@ -171,26 +459,57 @@ bool set_poseCallback(rigid2d::SetPose::Request& req, rigid2d::SetPose::Response
 /// \returns result (bool): True or False.
 {
   // Update pose to match service request
+  rigid2d::Pose2D reset_pose;
   reset_pose.x = req.x;
   reset_pose.y = req.y;
   reset_pose.theta = req.theta;
 
-  // Set Result to true
-  res.result = true;
+  // Reset Driver Pose
+  driver.reset(reset_pose);
+  ROS_DEBUG("Reset Pose:");
+  ROS_DEBUG("pose x: %f", driver.get_pose().x);
+  ROS_DEBUG("pose y: %f", driver.get_pose().y);
+  ROS_DEBUG("pose theta: %f", driver.get_pose().theta);
 
+  // Hand reset to EKF thread
+  reset_snapshot.write(reset_pose);
   service_flag = true;
-  callback_flag = true;
+
+  // Set Result to true
+  res.result = true;
 
   return res.result;
 }
 
+bool save_mapCallback(std_srvs::Trigger::Request&, std_srvs::Trigger::Response& res)
+/// \brief save_map service callback. Saves the current map to map_file_. Runs on the EKF thread.
+///
+/// \returns success (bool): True or False.
+/// \returns message (string): path of the saved map, or the reason it could not be saved.
+{
+  try
+  {
+    ekf.save_map(map_file_);
+    res.success = true;
+    res.message = map_file_;
+    ROS_INFO("Saved map to %s", map_file_.c_str());
+  }
+  catch (const std::exception & e)
+  {
+    res.success = false;
+    res.message = e.what();
+    ROS_ERROR("%s", e.what());
+  }
+
+  return true;
+}
+
 int main(int argc, char** argv)
 /// The Main Function ///
 {
   // Vars
-  std::string o_fid_, b_fid_;
   std::string frame_id_ = "map";
-  float wbase_, wrad_, frequency;
+  float wbase_, wrad_;
   // NOTE: TUNABLE PARAMETERS
   double max_range_ = 1.0;
   double x_noise = 1e-6;
@@ -201,6 +520,9 @@ int main(int argc, char** argv)
   // NOTE: MOST IMPORTANT TUNABLE PARAMETERS - see ekf.hpp and ekf.cpp
   double mahalanobis_lower = 100.0;
   double mahalanobis_upper = 1e5;
+  bool load_map_ = false;
+  bool localization_only_ = false;
+  double known_map_timeout_ = 10.0;
 
   ros::init(argc, argv, "odometer_node"); // register the node on ROS
   ros::NodeHandle nh_("~"); // PRIVATE handle to ROS
@@ -220,137 +542,193 @@ int main(int argc, char** argv)
   nh.getParam("range_noise", range_noise);
   nh.getParam("bearing_noise", bearing_noise);
 
+  // Map Persistence
+  nh_.getParam("map_file", map_file_);
+  nh_.getParam("load_map", load_map_);
+  nh_.getParam("localization_only", localization_only_);
+  nh_.getParam("known_map_timeout", known_map_timeout_);
+
+  // Latency Instrumentation
+  double diagnostics_period_ = 1.0;
+  std::string latency_file_;
+  nh_.getParam("diagnostics_period", diagnostics_period_);
+  nh_.getParam("latency_file", latency_file_);
+  bool trace_ = false;
+  int trace_capacity_ = 10000;
+  std::string trace_file_;
+  nh_.getParam("trace", trace_);
+  nh_.getParam("trace_capacity", trace_capacity_);
+  nh_.getParam("trace_file", trace_file_);
+  if (trace_)
+  {
+    trace.start(std::max(trace_capacity_, 1));
+  }
+
+  // Scan Matching
+  double match_resolution_ = 0.05;
+  double match_linear_window_ = 0.2, match_angular_window_ = 0.2, match_angular_step_ = 0.01;
+  double match_x_noise_ = match_noise_var.x, match_y_noise_ = match_noise_var.y, match_theta_noise_ = match_noise_var.theta;
+  nh_.getParam("scan_matching", scan_matching_);
+  nh_.getParam("match_resolution", match_resolution_);
+  nh_.getParam("match_linear_window", match_linear_window_);
+  nh_.getParam("match_angular_window", match_angular_window_);
+  nh_.getParam("match_angular_step", match_angular_step_);
+  nh_.getParam("match_map_period", match_map_period_);
+  nh_.getParam("match_min_score", match_min_score_);
+  nh_.getParam("match_x_noise", match_x_noise_);
+  nh_.getParam("match_y_noise", match_y_noise_);
+  nh_.getParam("match_theta_noise", match_theta_noise_);
+  match_noise_var = rigid2d::Pose2D(match_x_noise_, match_y_noise_, match_theta_noise_);
+  if (scan_matching_)
+  {
+    try
+    {
+      scan_map = nuslam::GridMap(match_resolution_, 0.7, 0.4, 0.12, 0.97);
+      scan_matcher = nuslam::ScanMatcher(match_linear_window_, match_angular_window_, match_angular_step_);
+    } catch (const std::invalid_argument & e)
+    {
+      ROS_ERROR("%s Using the default scan matcher.", e.what());
+    }
+  }
+
+  // Region of Interest Predictions
+  nh_.getParam("roi", roi_);
+
   // For Landmark Pub
   nh_.getParam("landmark_frame_id", frame_id_);
+  belief_map.header.frame_id = frame_id_;
 
-  // Freq
-  frequency = 60.0;
   // Set Driver Wheel Base and Radius
   driver.set_static(wbase_, wrad_);
   ekf_driver.set_static(wbase_, wrad_);
 
-  // Init Service Server
-  ros::ServiceServer set_pose_server = nh.advertiseService("set_pose", set_poseCallback);
-  // Init Subscriber
-  ros::Subscriber js_sub = nh.subscribe("joint_states", 1, js_callback);
-  ros::Subscriber lnd_sub = nh.subscribe("landmarks_node/landmarks", 1, landmark_callback);
-  // Init Publisher
-  ros::Publisher odom_pub = nh_.advertise<nav_msgs::Odometry>("odom", 1);
-  ros::Publisher lnd_pub = nh_.advertise<nuslam::TurtleMap>("landmarks", 1);
-  // Init Transform Broadcaster
-  tf2_ros::TransformBroadcaster odom_broadcaster;
-
   // Initialize EKF class with robot state, vector of 12 landmarks at 0,0,0, and noise
   std::vector<nuslam::Point> map_state_(12, nuslam::Point());
   nuslam::Pose2D xyt_noise_var = nuslam::Pose2D(x_noise, y_noise, theta_noise);
   nuslam::RangeBear rb_noise_var_ = nuslam::RangeBear(range_noise, bearing_noise);
   ekf = nuslam::EKF(driver.get_pose(), map_state_, xyt_noise_var, rb_noise_var_, max_range_,\
                     mahalanobis_lower, mahalanobis_upper);
+  bool map_loaded = false;
+  if (load_map_)
+  {
+    try
+    {
+      auto map_file = std::make_shared<const nuslam::MapFile>(map_file_);
+      if (localization_only_)
+      {
+        // Only the landmark means are read, the covariance stays in the mapped file
+        ekf.load_frozen_map(map_file);
+      } else {
+        ekf.load_map(*map_file);
+      }
+      map_loaded = true;
+      ROS_INFO("Loaded map of %lu landmarks from %s", map_file->map_size(), map_file_.c_str());
+    }
+    catch (const std::exception & e)
+    {
+      ROS_WARN("%s. Starting with an empty map.", e.what());
+    }
+  }
+  if (localization_only_)
+  {
+    if (!map_loaded)
+    {
+      // Fall back on known landmarks, e.g. ground truth from the analysis node. These are in the world
+      // frame, which is only the map frame if the robot starts at the world origin.
+      nuslam::TurtleMap::ConstPtr known_map = ros::topic::waitForMessage<nuslam::TurtleMap>("known_map", nh, ros::Duration(known_map_timeout_));
+      if (known_map)
+      {
+        std::vector<nuslam::Point> landmarks;
+        for (long unsigned int i = 0; i < known_map->radii.size(); i++)
+        {
+          landmarks.push_back(nuslam::Point(rigid2d::Vector2D(known_map->x_pts.at(i), known_map->y_pts.at(i))));
+        }
+        ekf.set_map(landmarks);
+        map_loaded = true;
+        ROS_INFO("Received known map of %lu landmarks", landmarks.size());
+      }
+    }
 
-  // Init Time
-  ros::Time current_time;
-  current_time = ros::Time::now();
+    if (map_loaded)
+    {
+      ekf.freeze_map();
+      ROS_INFO("Localization-only mode: map is frozen");
+    } else {
+      ROS_WARN("No map available for localization-only mode. Running full SLAM.");
+    }
+  }
+  // Threads have not started yet, so main may act as the writer
+  EKFEstimate initial_estimate;
+  initial_estimate.pose = ekf.return_pose();
+  ekf_pose_snapshot.write(initial_estimate);
 
-  ros::Rate rate(frequency);
+  // Init Publisher
+  odom_pub = nh_.advertise<nav_msgs::Odometry>("odom", 1);
+  lnd_pub = nh_.advertise<nuslam::TurtleMap>("landmarks", 1);
+  if (roi_)
+  {
+    predictions_pub = nh_.advertise<nuslam::LandmarkPredictions>("predictions", 1);
+  }
+  // Init Transform Broadcaster
+  odom_broadcaster = std::make_unique<tf2_ros::TransformBroadcaster>();
 
-  // Main While
-  while (ros::ok())
+  // Init Service Server
+  ros::ServiceServer set_pose_server = nh.advertiseService("set_pose", set_poseCallback);
+  // Init Subscriber - odometry thread (global callback queue)
+  ros::Subscriber js_sub = nh.subscribe("joint_states", 1, js_callback);
+  // Init Subscriber - EKF thread (own callback queue)
+  ros::CallbackQueue ekf_queue;
+  ros::SubscribeOptions lnd_ops = ros::SubscribeOptions::create<nuslam::TurtleMap>(
+    "landmarks_node/landmarks", 1, landmark_callback, ros::VoidPtr(), &ekf_queue);
+  ros::Subscriber lnd_sub = nh.subscribe(lnd_ops);
+  ros::Subscriber scan_sub;
+  if (scan_matching_)
   {
-    // NOTE: All callbacks will be executed before rest of main
-    // so if both odom and landmark update are available, both will
-    // execute before rest of main loop. Order cannot be guaranteed however
-  	ros::spinOnce();
-  	current_time = ros::Time::now();
-
-  	// Update and Publish Odom Transform
-  	// Init Tf
-    if (service_flag == true)
-    {
-      // Reset Driver Pose
-      driver.reset(reset_pose);
-      ekf_driver.reset(reset_pose);
-      ekf.reset_pose(reset_pose);
-      ROS_DEBUG("Reset Pose:");
-      ROS_DEBUG("pose x: %f", driver.get_pose().x);
-      ROS_DEBUG("pose y: %f", driver.get_pose().y);
-      ROS_DEBUG("pose theta: %f", driver.get_pose().theta);
-      service_flag = false;
-    }
+    ros::SubscribeOptions scan_ops = ros::SubscribeOptions::create<sensor_msgs::LaserScan>(
+      "/scan", 1, scan_callback, ros::VoidPtr(), &ekf_queue);
+    scan_sub = nh.subscribe(scan_ops);
+  }
+  // Init Service Server - EKF thread, so the map is never saved mid-update
+  ros::AdvertiseServiceOptions save_ops = ros::AdvertiseServiceOptions::create<std_srvs::Trigger>(
+    "save_map", save_mapCallback, ros::VoidPtr(), &ekf_queue);
+  ros::ServiceServer save_map_server = nh_.advertiseService(save_ops);
+
+  // EKF Thread: a slow EKF update only delays the EKF thread
+  ros::AsyncSpinner ekf_spinner(1, &ekf_queue);
+  ekf_spinner.start();
+
+  // Latency Diagnostics - odometry thread
+  ros::Timer diagnostics_timer;
+  if (diagnostics_period_ > 0.0)
+  {
+    diagnostics_pub = nh.advertise<diagnostic_msgs::DiagnosticArray>("/diagnostics", 1);
+    diagnostics_timer = nh.createTimer(ros::Duration(diagnostics_period_), diagnostics_callback);
+  }
+
+  // Odometry Thread: publishes at encoder rate regardless of map size
+  ros::spin();
 
-    if (callback_flag)
+  ekf_spinner.stop();
+  if (!latency_file_.empty())
+  {
+    try
     {
-    // SLAM Node publishes Tmo = map->odom
-    // To get this, we do Tmo = Tmb * Tob.inv
-    // Where Tmb = map->base and Tob = odom->base
-    rigid2d::Pose2D odom_pose = driver.get_pose();
-    rigid2d::Pose2D ekf_pose = ekf.return_pose();
-
-    // Construct Tmb
-    rigid2d::Vector2D Vmb = rigid2d::Vector2D(ekf_pose.x, ekf_pose.y);
-    rigid2d::Transform2D Tmb = rigid2d::Transform2D(Vmb, ekf_pose.theta);
-    // Construct Tob
-    rigid2d::Vector2D Vob = rigid2d::Vector2D(odom_pose.x, odom_pose.y);
-    rigid2d::Transform2D Tob = rigid2d::Transform2D(Vob, odom_pose.theta);
-    // Now find Tmo
-    rigid2d::Transform2D Tmo = Tmb * Tob.inv();
-    rigid2d::Transform2DS TmoS = Tmo.displacement();
-
-    geometry_msgs::TransformStamped odom_tf;
-    odom_tf.header.stamp = current_time;
-    ROS_DEBUG("body_frame_id %s", b_fid_.c_str());
-    ROS_DEBUG("odom_frame_id %s", o_fid_.c_str());
-    odom_tf.header.frame_id = o_fid_;
-    odom_tf.child_frame_id = b_fid_;
-    // Pose
-    odom_tf.transform.translation.x = TmoS.x;
-    odom_tf.transform.translation.y = TmoS.y;
-    odom_tf.transform.translation.z = 0;
-    // use tf2 to create transform
-    tf2::Quaternion q;
-    q.setRPY(0, 0, TmoS.theta);
-    geometry_msgs::Quaternion odom_quat = tf2::toMsg(q);
-    odom_tf.transform.rotation = odom_quat;
-    // Send the Transform
-    odom_broadcaster.sendTransform(odom_tf);
-
-    // Update and Publish Odom Msg
-    // Init Msg
-    nav_msgs::Odometry odom;
-    odom.header.stamp = current_time;
-    odom.header.frame_id = o_fid_;
-    // Pose
-    odom.pose.pose.position.x = ekf_pose.x;
-    odom.pose.pose.position.y = ekf_pose.y;
-    odom.pose.pose.position.z = 0.0;
-    tf2::Quaternion ekf_q;
-    ekf_q.setRPY(0, 0, TmoS.theta);
-    geometry_msgs::Quaternion ekf_quat = tf2::toMsg(ekf_q);
-    odom.pose.pose.orientation = ekf_quat;
-    // Twist
-    odom.child_frame_id = b_fid_;
-    odom.twist.twist.linear.x = Vb.v_x;
-    odom.twist.twist.linear.y = Vb.v_y;
-    odom.twist.twist.angular.z = Vb.w_z;
-    // Publish the Message
-    odom_pub.publish(odom);
-    callback_flag = false;
-
-    // Publish Map State
-    if (landmark_flag)
+      nuslam::latency_registry().dump(latency_file_);
+    } catch (const std::exception & e)
     {
-      nuslam::TurtleMap belief_map;
-      belief_map.radii = radii;
-      belief_map.x_pts = x_pts;
-      belief_map.y_pts = y_pts;
-      belief_map.header.stamp = ros::Time::now();
-      belief_map.header.frame_id = frame_id_;
-      lnd_pub.publish(belief_map);
-      landmark_flag = false;
+      ROS_ERROR("%s", e.what());
     }
+  }
+  if (trace_ && !trace_file_.empty())
+  {
+    try
+    {
+      trace.dump(trace_file_);
+    } catch (const std::exception & e)
+    {
+      ROS_ERROR("%s", e.what());
     }
-
-    rate.sleep();
   }
 
   return 0;
-}
\ No newline at end of file
+}
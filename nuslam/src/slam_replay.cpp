@@ -0,0 +1,177 @@
+/// \file
+/// \brief Offline runner which replays a recorded bag through landmark detection and EKF SLAM
+/// as fast as possible, without a ROS master, and reports throughput, per-stage latency and
+/// error against ground truth
+///
+/// USAGE:
+///   rosrun nuslam slam_replay <bag> [--threshold 0.15] [--max_radius 0.1] [--deskew]
+///                                   [--max_range 1.0] [--map_size 12]
+///                                   [--mahalanobis_lower 100] [--mahalanobis_upper 1e5]
+///                                   [--wheel_base 0.16] [--wheel_radius 0.033]
+///                                   [--scan_x 0] [--scan_y 0] [--scan_theta 0]
+///                                   [--scan /scan] [--joint_states /joint_states]
+///                                   [--model_states /gazebo/model_states]
+///                                   [--left_wheel_joint left_wheel_axle] [--right_wheel_joint right_wheel_axle]
+///                                   [--robot_name diff_drive] [--landmark_name cylinder]
+///
+/// PARAMETERS:
+///   config (nuslam::ReplayConfig): landmark detection and EKF parameters, defaulting to those of landmarks_node and slam
+///   topics (nuslam::BagTopics): LaserScan, JointState and ModelStates (ground truth, if present) topics in the bag,
+///   the wheel joint names in JointState and the robot and landmark model names in ModelStates
+///
+/// FUNCTIONS:
+///   print_stage (void): prints the latency percentiles of one pipeline stage
+
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <string>
+#include "nuslam/replay.hpp"
+#include "nuslam/bag_dataset.hpp"
+
+// Global Vars
+nuslam::BagTopics topics;
+
+
+void print_stage(const nuslam::StageLatency & stage)
+{
+  /// \brief print the latency percentiles of one pipeline stage
+  ///
+  /// \param stage (nuslam::StageLatency): latency samples of the stage
+  std::printf("  %-8s n=%-7lu mean %8.1f  p50 %8.1f  p99 %8.1f  max %8.1f us\n", stage.name.c_str(),\
+              stage.samples.size(), stage.mean(), stage.percentile(50.0), stage.percentile(99.0),\
+              stage.percentile(100.0));
+}
+
+
+int main(int argc, char** argv)
+/// The Main Function ///
+{
+  if (argc < 2 || !std::strcmp(argv[1], "--help"))
+  {
+    std::fprintf(stderr, "usage: slam_replay <bag> [--threshold m] [--max_radius m] [--deskew] [--max_range m]\n"
+                         "                         [--map_size n] [--mahalanobis_lower d] [--mahalanobis_upper d]\n"
+                         "                         [--wheel_base m] [--wheel_radius m] [--scan_x m] [--scan_y m] [--scan_theta rad]\n"
+                         "                         [--scan topic] [--joint_states topic] [--model_states topic]\n"
+                         "                         [--left_wheel_joint name] [--right_wheel_joint name]\n"
+                         "                         [--robot_name name] [--landmark_name prefix]\n");
+    return 1;
+  }
+
+  std::string bag_file = argv[1];
+  nuslam::ReplayConfig config;
+
+  // Parse Options
+  for (int i = 2; i < argc; i++)
+  {
+    std::string opt = argv[i];
+    if (opt == "--deskew")
+    {
+      config.deskew = true;
+      continue;
+    }
+    if (i + 1 >= argc)
+    {
+      std::fprintf(stderr, "missing value for %s\n", opt.c_str());
+      return 1;
+    }
+    std::string value = argv[++i];
+    if (opt == "--threshold")
+    {
+      config.threshold = std::atof(value.c_str());
+    } else if (opt == "--max_radius")
+    {
+      config.max_radius = std::atof(value.c_str());
+    } else if (opt == "--max_range")
+    {
+      config.max_range = std::atof(value.c_str());
+    } else if (opt == "--map_size")
+    {
+      config.map_size = std::strtoul(value.c_str(), nullptr, 10);
+    } else if (opt == "--mahalanobis_lower")
+    {
+      config.mahalanobis_lower = std::atof(value.c_str());
+    } else if (opt == "--mahalanobis_upper")
+    {
+      config.mahalanobis_upper = std::atof(value.c_str());
+    } else if (opt == "--wheel_base")
+    {
+      config.wheel_base = std::atof(value.c_str());
+    } else if (opt == "--wheel_radius")
+    {
+      config.wheel_radius = std::atof(value.c_str());
+    } else if (opt == "--scan_x")
+    {
+      config.scan_pose.x = std::atof(value.c_str());
+    } else if (opt == "--scan_y")
+    {
+      config.scan_pose.y = std::atof(value.c_str());
+    } else if (opt == "--scan_theta")
+    {
+      config.scan_pose.theta = std::atof(value.c_str());
+    } else if (opt == "--scan")
+    {
+      topics.scan = value;
+    } else if (opt == "--joint_states")
+    {
+      topics.joint_states = value;
+    } else if (opt == "--model_states")
+    {
+      topics.model_states = value;
+    } else if (opt == "--left_wheel_joint")
+    {
+      topics.left_wheel_joint = value;
+    } else if (opt == "--right_wheel_joint")
+    {
+      topics.right_wheel_joint = value;
+    } else if (opt == "--robot_name")
+    {
+      topics.robot_name = value;
+    } else if (opt == "--landmark_name")
+    {
+      topics.landmark_name = value;
+    } else {
+      std::fprintf(stderr, "unknown option %s\n", opt.c_str());
+      return 1;
+    }
+  }
+
+  nuslam::Dataset data;
+  try
+  {
+    data = nuslam::read_bag(bag_file, topics);
+  } catch (const std::exception & e)
+  {
+    std::fprintf(stderr, "unable to read %s: %s\n", bag_file.c_str(), e.what());
+    return 1;
+  }
+  std::printf("read %lu scans, %lu joint states, %lu ground truth poses spanning %.1f s\n",\
+              data.scans.size(), data.joints.size(), data.ground_truth.size(), data.duration());
+
+  nuslam::ReplayResult result = nuslam::replay(data, config);
+
+  double duration = data.duration();
+  std::printf("replayed in %.3f s: %.1f scans/s, %.1fx real time\n", result.wall_time,\
+              result.wall_time > 0.0 ? data.scans.size() / result.wall_time : 0.0,\
+              result.wall_time > 0.0 ? duration / result.wall_time : 0.0);
+  print_stage(result.cluster);
+  print_stage(result.fit);
+  print_stage(result.predict);
+  print_stage(result.update);
+  std::printf("mapped %lu landmarks\n", result.landmarks_mapped);
+  if (!data.ground_truth.empty())
+  {
+    std::printf("pose RMSE %.4f m, landmark RMSE %.4f m (%lu true landmarks)\n",\
+                result.pose_rmse, result.landmark_rmse, result.true_map.size());
+    const nuslam::TrajectoryErrorSummary & error = result.trajectory_error;
+    std::printf("ATE %lu poses: RMSE %.4f m p50 %.4f p90 %.4f p99 %.4f max %.4f m, heading RMSE %.4f rad\n",\
+                error.ate_trans.count, error.ate_trans.rmse, error.ate_trans.p50, error.ate_trans.p90,\
+                error.ate_trans.p99, error.ate_trans.max, error.ate_rot.rmse);
+    std::printf("RPE/1s %lu pairs: RMSE %.4f m p99 %.4f m, heading RMSE %.4f rad p99 %.4f rad\n",\
+                error.rpe_trans.count, error.rpe_trans.rmse, error.rpe_trans.p99, error.rpe_rot.rmse, error.rpe_rot.p99);
+  }
+
+  return 0;
+}
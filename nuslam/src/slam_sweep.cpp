@@ -0,0 +1,207 @@
+/// \file
+/// \brief Offline parameter sweep which replays one recorded bag with every combination of the given
+/// landmark detection and EKF parameters, in parallel, and ranks them by error against ground truth
+///
+/// USAGE:
+///   rosrun nuslam slam_sweep <bag> --threshold 0.1,0.15,0.2 --x_noise 1e-6,1e-4 --theta_noise 1e-5,1e-3
+///                                  [--<parameter> v1,v2,...] [--deskew] [--threads 0] [--seed 1]
+///                                  [--top 10] [--landmark_weight 1.0] [--csv results.csv]
+///                                  [--scan /scan] [--joint_states /joint_states]
+///                                  [--model_states /gazebo/model_states]
+///
+/// PARAMETERS:
+///   axes (std::vector<nuslam::SweepAxis>): swept parameters, any of threshold, max_radius, max_range, x_noise,
+///   y_noise, theta_noise, range_noise, bearing_noise, mahalanobis_lower, mahalanobis_upper
+///   base (nuslam::ReplayConfig): values of the parameters which are not swept, defaulting to those of slam
+///   threads (unsigned int): number of replays to run in parallel, 0 for one per hardware thread
+///   seed (unsigned int): process noise seed shared by every replay
+///   top (unsigned long int): number of ranked configurations to print
+///   landmark_weight (double): weight of landmark RMSE relative to pose RMSE in the ranking score
+///   csv_file (string): if set, every result is also written to this file
+///   topics (nuslam::BagTopics): LaserScan, JointState and ModelStates topics in the bag
+///
+/// FUNCTIONS:
+///   parse_values (std::vector<double>): parses a comma-separated list of values
+
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "nuslam/replay.hpp"
+#include "nuslam/sweep.hpp"
+#include "nuslam/bag_dataset.hpp"
+
+// Global Vars
+nuslam::BagTopics topics;
+
+
+std::vector<double> parse_values(const std::string & list)
+{
+  /// \brief parse a comma-separated list of values
+  ///
+  /// \param list (string): e.g. "1e-6,1e-5,1e-4"
+  /// \returns values (std::vector<double>)
+  std::vector<double> values;
+  std::stringstream stream(list);
+  std::string item;
+  while (std::getline(stream, item, ','))
+  {
+    if (!item.empty())
+    {
+      values.push_back(std::atof(item.c_str()));
+    }
+  }
+  return values;
+}
+
+
+int main(int argc, char** argv)
+/// The Main Function ///
+{
+  if (argc < 2 || !std::strcmp(argv[1], "--help"))
+  {
+    std::fprintf(stderr, "usage: slam_sweep <bag> [--<parameter> v1,v2,...]... [--deskew] [--threads n] [--seed s]\n"
+                         "                        [--top k] [--landmark_weight w] [--csv file]\n"
+                         "                        [--scan topic] [--joint_states topic] [--model_states topic]\n"
+                         "parameters: threshold max_radius max_range x_noise y_noise theta_noise\n"
+                         "            range_noise bearing_noise mahalanobis_lower mahalanobis_upper\n");
+    return 1;
+  }
+
+  std::string bag_file = argv[1];
+  nuslam::ReplayConfig base;
+  std::vector<nuslam::SweepAxis> axes;
+  unsigned int threads = 0;
+  unsigned int seed = 1;
+  unsigned long int top = 10;
+  double landmark_weight = 1.0;
+  std::string csv_file;
+
+  // Parse Options
+  for (int i = 2; i < argc; i++)
+  {
+    std::string opt = argv[i];
+    if (opt == "--deskew")
+    {
+      base.deskew = true;
+      continue;
+    }
+    if (i + 1 >= argc || opt.compare(0, 2, "--") != 0)
+    {
+      std::fprintf(stderr, "missing value for %s\n", opt.c_str());
+      return 1;
+    }
+    std::string value = argv[++i];
+    if (opt == "--threads")
+    {
+      threads = std::strtoul(value.c_str(), nullptr, 10);
+    } else if (opt == "--seed")
+    {
+      seed = std::strtoul(value.c_str(), nullptr, 10);
+    } else if (opt == "--top")
+    {
+      top = std::strtoul(value.c_str(), nullptr, 10);
+    } else if (opt == "--landmark_weight")
+    {
+      landmark_weight = std::atof(value.c_str());
+    } else if (opt == "--csv")
+    {
+      csv_file = value;
+    } else if (opt == "--scan")
+    {
+      topics.scan = value;
+    } else if (opt == "--joint_states")
+    {
+      topics.joint_states = value;
+    } else if (opt == "--model_states")
+    {
+      topics.model_states = value;
+    } else {
+      axes.push_back(nuslam::SweepAxis(opt.substr(2), parse_values(value)));
+    }
+  }
+
+  std::vector<nuslam::ReplayConfig> configs;
+  try
+  {
+    configs = nuslam::expand_grid(base, axes);
+  } catch (const std::invalid_argument & e)
+  {
+    std::fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+
+  nuslam::Dataset data;
+  try
+  {
+    data = nuslam::read_bag(bag_file, topics);
+  } catch (const std::exception & e)
+  {
+    std::fprintf(stderr, "unable to read %s: %s\n", bag_file.c_str(), e.what());
+    return 1;
+  }
+  if (data.ground_truth.empty())
+  {
+    std::fprintf(stderr, "%s has no ground truth on %s\n", bag_file.c_str(), topics.model_states.c_str());
+    return 1;
+  }
+  std::printf("read %lu scans, %lu joint states, %lu ground truth poses spanning %.1f s\n",\
+              data.scans.size(), data.joints.size(), data.ground_truth.size(), data.duration());
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<nuslam::SweepResult> results = nuslam::sweep(data, configs, threads, seed);
+  double wall_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  nuslam::rank_results(results, landmark_weight);
+
+  double cpu_time = 0.0;
+  for (auto iter = results.begin(); iter != results.end(); iter++)
+  {
+    cpu_time += iter->wall_time;
+  }
+  std::printf("evaluated %lu configurations in %.2f s (%.2f s of replays, %.1fx parallel speed-up)\n",\
+              results.size(), wall_time, cpu_time, wall_time > 0.0 ? cpu_time / wall_time : 0.0);
+
+  // Ranked table, with one column per swept parameter
+  std::printf("%4s %10s %10s %10s %6s", "rank", "score", "pose_rmse", "lm_rmse", "mapped");
+  for (auto axis = axes.begin(); axis != axes.end(); axis++)
+  {
+    std::printf(" %18s", axis->name.c_str());
+  }
+  std::printf("\n");
+  for (unsigned long int r = 0; r < results.size() && r < top; r++)
+  {
+    const nuslam::SweepResult & result = results.at(r);
+    std::printf("%4lu %10.4f %10.4f %10.4f %6lu", r + 1, result.score, result.pose_rmse, result.landmark_rmse,\
+                result.landmarks_mapped);
+    for (auto axis = axes.begin(); axis != axes.end(); axis++)
+    {
+      std::printf(" %18g", nuslam::get_parameter(result.config, axis->name));
+    }
+    std::printf("\n");
+  }
+
+  if (!csv_file.empty())
+  {
+    std::ofstream csv(csv_file);
+    csv << "rank,score,pose_rmse,landmark_rmse,landmarks_mapped,threshold,max_radius,max_range,x_noise,y_noise,"
+           "theta_noise,range_noise,bearing_noise,mahalanobis_lower,mahalanobis_upper\n";
+    for (unsigned long int r = 0; r < results.size(); r++)
+    {
+      const nuslam::SweepResult & result = results.at(r);
+      const nuslam::ReplayConfig & c = result.config;
+      csv << r + 1 << "," << result.score << "," << result.pose_rmse << "," << result.landmark_rmse << ","\
+          << result.landmarks_mapped << "," << c.threshold << "," << c.max_radius << "," << c.max_range << ","\
+          << c.x_noise << "," << c.y_noise << "," << c.theta_noise << "," << c.range_noise << ","\
+          << c.bearing_noise << "," << c.mahalanobis_lower << "," << c.mahalanobis_upper << "\n";
+    }
+    std::printf("wrote %s\n", csv_file.c_str());
+  }
+
+  return 0;
+}
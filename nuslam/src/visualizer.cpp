@@ -1,24 +1,41 @@
 /// \file
 /// \brief Publishes aggregate robot paths based on pure odometry, ground truth (Gazebo data) or the SLAM estimate.
 ///  Also publishes tsim::PoseError message to display error in x,y,theta between odometry and ground truth, as
-///  well as SLAM and ground truth
+///  well as SLAM and ground truth, with ground truth interpolated at the time of each estimate, and the running
+///  absolute trajectory error (ATE) and relative pose error (RPE) of both estimates, each computed by a global
+///  nuslam::TrajectoryEvaluator (odom_eval, slam_eval)
 ///
 /// PARAMETERS:
 ///   gazebo_callback_flag (bool): specifies whether to publish robot path from gazebo based on callback trigger
 ///   odom_callback_flag (bool): specifies whether to publish robot path from odometry based on callback trigger
 ///   slam_callback_flag (bool): specifies whether to publish robot path from SLAM estimate based on callback trigger
-///   gazebo_poses (std::vector<geometry_msgs::PoseStamped>): vector containing PoseStamped messages for Path generation
-///   odom_poses (std::vector<geometry_msgs::PoseStamped>): vector containing PoseStamped messages for Path generation
-///   slam_poses (std::vector<geometry_msgs::PoseStamped>): vector containing PoseStamped messages for Path generation
+///   gazebo_history (nuslam::PathHistory): bounded, decimated pose history for gazebo Path generation
+///   odom_history (nuslam::PathHistory): bounded, decimated pose history for odometry Path generation
+///   slam_history (nuslam::PathHistory): bounded, decimated pose history for SLAM Path generation
 ///   frame_id_ (string): frame with respect to which path is published ("map" is the static frame in this implementation)
 ///   frequency (double): frequency of control loop.
+///   path_capacity (int): maximum number of poses kept per path, oldest poses are dropped first
+///   path_min_distance (double): distance (m) the robot must move before a new path pose is kept
+///   path_min_angle (double): heading change (rad) the robot must turn before a new path pose is kept
+///   path_rate (double): rate at which full Paths are published in "full" mode (0 publishes on every loop)
+///   path_mode (string): "full" publishes each bounded Path at path_rate; "incremental" publishes only the new
+///     segment of each path as a Marker whenever a pose is kept
+///   model_index (nuslam::ModelIndex): cached index of the robot in the ModelStates name list
+///   eval_window (double): seconds of ground truth kept to interpolate estimates
+///   rpe_delta (double): time (s) over which the relative pose error is computed
+///   eval_align (bool): if true, estimates are aligned to ground truth at their first pose, otherwise they are
+///     assumed to be in the ground truth frame
+///   diagnostics_period (double): seconds between trajectory error diagnostics, 0 to disable
+///   eval_file (string): if set, the trajectory error summaries are written to this file on shutdown
 ///
 /// PUBLISHES:
 ///   gazebo_path (nav_msgs::Path): publishes Path based on gazebo pose readings
 ///   odom_path (nav_msgs::Path): publishes Path based on odometry pose estimate
 ///   slam_path (nav_msgs::Path): publishes Path based on SLAM pose estimate
+///   path_markers (visualization_msgs::Marker): publishes new path segments in incremental mode
 ///   odom_err (tsim::PoseError): publishes error between odometry estimate and gazebo pose readings
 ///   slam_err (tsim::PoseError): publishes error between SLAM estimate and gazebo pose readings
+///   /diagnostics (diagnostic_msgs::DiagnosticArray): ATE and RPE count, RMSE, percentiles and max of odometry and SLAM
 ///
 /// SUBSCRIBES:
 ///   /gazebo/model_states (gazebo_msgs::ModelStates) to read robot Pose from gazebo estimate
@@ -26,9 +43,16 @@
 ///   /slam/odom (nav_msgs::Odometry) to read robot pose from SLAM estimate
 ///
 /// FUNCTIONS:
+///   yaw_of (double): extracts the heading from a Pose
+///   to_pose2d (rigid2d::Pose2D): converts a Pose to x, y, heading
+///   record_pose (bool): offers a pose to a path history and, in incremental mode, publishes the new path segment
+///   fill_path (void): copies a path history into a Path message
 ///   gazebo_callback (void): callback for /gazebo/model_states subscriber which appends the current pose to recorded pose history
 ///   odom_callback (void): callback for /odom subscriber which appends the current pose to recorded pose history
 ///   slam_callback (void): callback for /slam/odom subscriber which appends the current pose to recorded pose history
+///   pose_error (tsim::PoseError): returns the error of the latest time-aligned estimate
+///   diagnostics_callback (void): timer callback which publishes the trajectory error diagnostics
+///   write_summary (void): writes the trajectory error summaries to a text file
 
 
 
@@ -36,6 +60,8 @@
 #include <std_srvs/Empty.h>
 
 #include <math.h>
+#include <fstream>
+#include <memory>
 #include <string>
 #include <vector>
 #include <boost/iterator/zip_iterator.hpp>
@@ -44,6 +70,8 @@
 #include <geometry_msgs/PoseStamped.h>
 #include <nav_msgs/Path.h>
 #include <nav_msgs/Odometry.h>
+#include <visualization_msgs/Marker.h>
+#include <diagnostic_msgs/DiagnosticArray.h>
 
 #include <functional>  // To use std::bind
 #include <algorithm>  // to use std::find_if
@@ -52,40 +80,145 @@
 #include <tf2/LinearMath/Matrix3x3.h>
 
 #include "tsim/PoseError.h"
+#include "nuslam/model_index.hpp"
+#include "nuslam/path_history.hpp"
+#include "nuslam/trajectory_eval.hpp"
+#include "nuslam/trajectory_diagnostics.hpp"
 
 
 // Global Vars
 bool gazebo_callback_flag = false;
 bool odom_callback_flag = false;
 bool slam_callback_flag = false;
-std::vector<geometry_msgs::PoseStamped> gazebo_poses;
-std::vector<geometry_msgs::PoseStamped> odom_poses;
-std::vector<geometry_msgs::PoseStamped> slam_poses;
+// Estimates time-aligned with ground truth, used for the pose error and trajectory error
+std::unique_ptr<nuslam::TrajectoryEvaluator> odom_eval;
+std::unique_ptr<nuslam::TrajectoryEvaluator> slam_eval;
+ros::Publisher diagnostics_pub;
+// Cached index of the robot in the ModelStates name list
+nuslam::ModelIndex model_index;
+// Bounded, decimated pose history of each source, used for the paths
+nuslam::PathHistory gazebo_history;
+nuslam::PathHistory odom_history;
+nuslam::PathHistory slam_history;
+bool incremental = false;
+ros::Publisher path_marker_pub;
 std::string frame_id_ = "map";
 
 
+double yaw_of(const geometry_msgs::Pose &pose)
+{
+  /// \brief extract the heading from a Pose
+  /// \param geometry_msgs::Pose
+  /// \returns yaw (rad)
+  auto roll = 0.0, pitch = 0.0, yaw = 0.0;
+  tf2::Quaternion quat(pose.orientation.x,\
+                       pose.orientation.y,\
+                       pose.orientation.z,\
+                       pose.orientation.w);
+  tf2::Matrix3x3 mat(quat);
+  mat.getRPY(roll, pitch, yaw);
+  return yaw;
+}
+
+rigid2d::Pose2D to_pose2d(const geometry_msgs::Pose &pose)
+{
+  /// \brief convert a Pose to x, y, heading
+  /// \param geometry_msgs::Pose
+  /// \returns rigid2d::Pose2D
+  return rigid2d::Pose2D(pose.position.x, pose.position.y, yaw_of(pose));
+}
+
+bool record_pose(const rigid2d::Pose2D &pose2d, nuslam::PathHistory &history, const std::string &ns,\
+                 const float &r, const float &g, const float &b)
+{
+  /// \brief offer a pose to a path history and, in incremental mode, publish the new path segment
+  /// \param pose2d: current pose
+  /// \param history: path history of the source
+  /// \param ns: marker namespace of the source
+  /// \param r, g, b: marker colour of the source
+  /// \returns true if the pose was kept
+  const bool first = history.total() == 0;
+  rigid2d::Pose2D previous = first ? pose2d : history.back().pose;
+  if (!history.add(ros::Time::now().toSec(), pose2d))
+  {
+    return false;
+  }
+
+  if (incremental and !first)
+  {
+    // One LINE_LIST segment from the previous kept pose. Ids are recycled with the history slots,
+    // so RViz holds at most capacity segments per source.
+    visualization_msgs::Marker segment;
+    segment.header.frame_id = frame_id_;
+    segment.header.stamp = ros::Time::now();
+    segment.ns = ns;
+    segment.id = static_cast<int>((history.total() - 1) % history.capacity());
+    segment.type = visualization_msgs::Marker::LINE_LIST;
+    segment.action = visualization_msgs::Marker::ADD;
+    segment.pose.orientation.w = 1.0;
+    segment.scale.x = 0.01;
+    segment.color.r = r;
+    segment.color.g = g;
+    segment.color.b = b;
+    segment.color.a = 1.0;
+    segment.points.resize(2);
+    segment.points.at(0).x = previous.x;
+    segment.points.at(0).y = previous.y;
+    segment.points.at(1).x = pose2d.x;
+    segment.points.at(1).y = pose2d.y;
+    path_marker_pub.publish(segment);
+  }
+  return true;
+}
+
+void fill_path(const nuslam::PathHistory &history, nav_msgs::Path &path)
+{
+  /// \brief copy a path history, oldest pose first, into a Path, reusing its storage
+  /// \param history: path history of the source
+  /// \param path: Path whose poses are overwritten
+  path.poses.resize(history.size());
+  for (unsigned long int i = 0; i < history.size(); i++)
+  {
+    const nuslam::PathSample &sample = history.at(i);
+    geometry_msgs::PoseStamped &ps = path.poses.at(i);
+    ps.header.frame_id = frame_id_;
+    ps.header.stamp = ros::Time(sample.stamp);
+    ps.pose.position.x = sample.pose.x;
+    ps.pose.position.y = sample.pose.y;
+    tf2::Quaternion quat;
+    quat.setRPY(0.0, 0.0, sample.pose.theta);
+    ps.pose.orientation.x = quat.x();
+    ps.pose.orientation.y = quat.y();
+    ps.pose.orientation.z = quat.z();
+    ps.pose.orientation.w = quat.w();
+  }
+}
+
+
 void gazebo_callback(const gazebo_msgs::ModelStates &model)
 {
   /// \brief extract turtlebot pose from ModelStates
   /// \param gazebo_msgs::ModelStates, containing the pose of all
   /// models in the environment
 
-  // First, find current Diff Drive Robot Pose
-  std::string robot_name = "diff_drive";
-  auto dd_it = std::find(model.name.begin(), model.name.end(), robot_name);
-  auto dd_index = std::distance(model.name.begin(), dd_it);
-  geometry_msgs::Pose dd_pose = model.pose.at(dd_index);
-
-  geometry_msgs::PoseStamped ps;
-
-  ps.header.frame_id = frame_id_;
-  ps.header.stamp = ros::Time::now();
-  ps.pose = dd_pose;
+  // First, find current Diff Drive Robot Pose, only searching again when the model list changes
+  model_index.update(model.name);
+  if (!model_index.has_robot())
+  {
+    return;
+  }
+  rigid2d::Pose2D gazebo_pose = to_pose2d(model.pose.at(model_index.robot()));
 
-  // Append to poses vector to publish Path msg
-  gazebo_poses.push_back(ps);
+  // ModelStates has no header, so ground truth is stamped on receipt
+  double stamp = ros::Time::now().toSec();
+  odom_eval->add_truth(stamp, gazebo_pose);
+  slam_eval->add_truth(stamp, gazebo_pose);
 
-  gazebo_callback_flag = true;
+  // Append to path history if the robot has moved far enough
+  if (record_pose(gazebo_pose, gazebo_history, "gazebo", 0.0, 1.0, 0.0))
+  {
+    gazebo_callback_flag = true;
+  }
 }
 
 void odom_callback(const nav_msgs::Odometry &odom)
@@ -93,16 +226,14 @@ void odom_callback(const nav_msgs::Odometry &odom)
   /// \brief extract turtlebot pose from Odometry msg
   /// \param nav_msgs::Odometry, containing the robot pose
 
-  geometry_msgs::PoseStamped ps;
-
-  ps.header.frame_id = frame_id_;
-  ps.header.stamp = ros::Time::now();
-  ps.pose = odom.pose.pose;
-
-  // Append to poses vector to publish Path msg
-  odom_poses.push_back(ps);
+  rigid2d::Pose2D odom_pose = to_pose2d(odom.pose.pose);
+  odom_eval->add_estimate(odom.header.stamp.isZero() ? ros::Time::now().toSec() : odom.header.stamp.toSec(), odom_pose);
 
-  odom_callback_flag = true;
+  // Append to path history if the robot has moved far enough
+  if (record_pose(odom_pose, odom_history, "odom", 1.0, 0.0, 0.0))
+  {
+    odom_callback_flag = true;
+  }
 }
 
 void slam_callback(const nav_msgs::Odometry &slam)
@@ -110,16 +241,68 @@ void slam_callback(const nav_msgs::Odometry &slam)
   /// \brief extract turtlebot pose from Odometry msg
   /// \param nav_msgs::Odometry, containing the robot pose
 
-  geometry_msgs::PoseStamped ps;
+  rigid2d::Pose2D slam_pose = to_pose2d(slam.pose.pose);
+  slam_eval->add_estimate(slam.header.stamp.isZero() ? ros::Time::now().toSec() : slam.header.stamp.toSec(), slam_pose);
 
-  ps.header.frame_id = frame_id_;
-  ps.header.stamp = ros::Time::now();
-  ps.pose = slam.pose.pose;
+  // Append to path history if the robot has moved far enough
+  if (record_pose(slam_pose, slam_history, "slam", 0.0, 0.0, 1.0))
+  {
+    slam_callback_flag = true;
+  }
+}
+
+tsim::PoseError pose_error(const nuslam::TrajectoryEvaluator &evaluator)
+{
+  /// \brief return the error of the latest estimate against ground truth at the same time
+  /// \param evaluator: evaluator with at least one evaluated estimate
+  /// \returns tsim::PoseError
+  const nuslam::AlignedPose &latest = evaluator.latest();
+  tsim::PoseError err;
+  err.x_error = fabs(latest.truth.x - latest.estimate.x);
+  err.y_error = fabs(latest.truth.y - latest.estimate.y);
+  err.theta_error = fabs(rigid2d::normalize_angle(latest.truth.theta - latest.estimate.theta));
+  return err;
+}
 
-  // Append to poses vector to publish Path msg
-  slam_poses.push_back(ps);
+void diagnostics_callback(const ros::TimerEvent &)
+{
+  /// \brief publishes the ATE and RPE of odometry and SLAM since startup on /diagnostics
+  diagnostic_msgs::DiagnosticArray array;
+  array.header.stamp = ros::Time::now();
+  array.status.push_back(nuslam::trajectory_diagnostics("visualizer", "odom", odom_eval->summary()));
+  array.status.push_back(nuslam::trajectory_diagnostics("visualizer", "slam", slam_eval->summary()));
+  diagnostics_pub.publish(array);
+}
 
-  slam_callback_flag = true;
+void write_summary(const std::string &filename)
+{
+  /// \brief write the ATE and RPE of odometry and SLAM to a text file, one error per line
+  /// \param filename: path of the file, overwritten if it exists
+  /// \throws std::runtime_error if the file cannot be written
+  std::ofstream out(filename);
+  if (!out)
+  {
+    throw std::runtime_error("Unable to open " + filename + " for writing.");
+  }
+  out << "stream,error,count,rmse,mean,p50,p90,p99,max\n";
+  const std::vector<std::pair<std::string, nuslam::TrajectoryErrorSummary>> streams = {
+    {"odom", odom_eval->summary()}, {"slam", slam_eval->summary()}};
+  for (auto iter = streams.begin(); iter != streams.end(); iter++)
+  {
+    const std::vector<std::pair<std::string, const nuslam::ErrorSummary *>> errors = {
+      {"ate_m", &iter->second.ate_trans}, {"ate_rad", &iter->second.ate_rot},
+      {"rpe_m", &iter->second.rpe_trans}, {"rpe_rad", &iter->second.rpe_rot}};
+    for (auto error = errors.begin(); error != errors.end(); error++)
+    {
+      const nuslam::ErrorSummary &e = *error->second;
+      out << iter->first << "," << error->first << "," << e.count << "," << e.rmse << "," << e.mean << ","\
+          << e.p50 << "," << e.p90 << "," << e.p99 << "," << e.max << "\n";
+    }
+  }
+  if (!out)
+  {
+    throw std::runtime_error("Unable to write " + filename + ".");
+  }
 }
 
 
@@ -129,6 +312,16 @@ int main(int argc, char** argv)
   ROS_INFO("STARTING NODE: visualizer");
 
   double frequency = 60.0;
+  int path_capacity = 10000;
+  double path_min_distance = 0.01;
+  double path_min_angle = 0.05;
+  double path_rate = 2.0;
+  std::string path_mode = "full";
+  double eval_window = 1.0;
+  double rpe_delta = 1.0;
+  bool eval_align = false;
+  double diagnostics_period_ = 1.0;
+  std::string eval_file_;
 
   ros::init(argc, argv, "visualizer"); // register the node on ROS
   ros::NodeHandle nh; // get a handle to ROS
@@ -136,6 +329,34 @@ int main(int argc, char** argv)
   // Parameters
   nh_.getParam("frequency", frequency);
   nh_.getParam("path_frame_id", frame_id_);
+  nh_.getParam("path_capacity", path_capacity);
+  nh_.getParam("path_min_distance", path_min_distance);
+  nh_.getParam("path_min_angle", path_min_angle);
+  nh_.getParam("path_rate", path_rate);
+  nh_.getParam("path_mode", path_mode);
+  nh_.getParam("eval_window", eval_window);
+  nh_.getParam("rpe_delta", rpe_delta);
+  nh_.getParam("eval_align", eval_align);
+  nh_.getParam("diagnostics_period", diagnostics_period_);
+  nh_.getParam("eval_file", eval_file_);
+
+  if (path_capacity < 1)
+  {
+    ROS_WARN("path_capacity must be positive, using 1.");
+    path_capacity = 1;
+  }
+  gazebo_history = nuslam::PathHistory(path_capacity, path_min_distance, path_min_angle);
+  odom_history = nuslam::PathHistory(path_capacity, path_min_distance, path_min_angle);
+  slam_history = nuslam::PathHistory(path_capacity, path_min_distance, path_min_angle);
+  incremental = path_mode == "incremental";
+  if (!(eval_window > 0.0) or !(rpe_delta > 0.0))
+  {
+    ROS_WARN("eval_window and rpe_delta must be positive, using 1.0.");
+    eval_window = 1.0;
+    rpe_delta = 1.0;
+  }
+  odom_eval = std::make_unique<nuslam::TrajectoryEvaluator>(eval_window, rpe_delta, eval_align);
+  slam_eval = std::make_unique<nuslam::TrajectoryEvaluator>(eval_window, rpe_delta, eval_align);
 
   nav_msgs::Path path;
 
@@ -147,10 +368,20 @@ int main(int argc, char** argv)
   ros::Publisher gzb_path_pub = nh_.advertise<nav_msgs::Path>("gazebo_path", 1);
   ros::Publisher odom_path_pub = nh_.advertise<nav_msgs::Path>("odom_path", 1);
   ros::Publisher slam_path_pub = nh_.advertise<nav_msgs::Path>("slam_path", 1);
+  // Path segment Publisher, used in incremental mode. Queue holds a burst of segments.
+  path_marker_pub = nh_.advertise<visualization_msgs::Marker>("path_markers", 100);
   // Pose Error Publishers
   ros::Publisher odom_err_pub = nh_.advertise<tsim::PoseError>("odom_err", 1);
   ros::Publisher slam_err_pub = nh_.advertise<tsim::PoseError>("slam_err", 1);
 
+  // Trajectory Error Diagnostics
+  ros::Timer diagnostics_timer;
+  if (diagnostics_period_ > 0.0)
+  {
+    diagnostics_pub = nh.advertise<diagnostic_msgs::DiagnosticArray>("/diagnostics", 1);
+    diagnostics_timer = nh.createTimer(ros::Duration(diagnostics_period_), diagnostics_callback);
+  }
+
   // Init ModelState Subscriber - only calls back if gazebo launched - used to publish ground truth path
   ros::Subscriber gzb_sub = nh.subscribe("/gazebo/model_states", 1, gazebo_callback);
 
@@ -161,90 +392,68 @@ int main(int argc, char** argv)
   ros::Subscriber slam_sub = nh.subscribe("slam/odom", 1, slam_callback);
 
   ros::Rate rate(frequency);
+  // Full Paths are published at path_rate, not on every loop
+  ros::Duration path_period(path_rate > 0.0 ? 1.0 / path_rate : 0.0);
+  ros::Time last_path = ros::Time(0);
 
   // Main While
   while (ros::ok())
   {
   	ros::spinOnce();
 
-    if (gazebo_callback_flag)
+    if (!incremental and ros::Time::now() - last_path >= path_period)
     {
-      path.header.stamp = ros::Time::now();
-      // Populate using growing vector of poses
-      path.poses = gazebo_poses;
-      gzb_path_pub.publish(path);
-      gazebo_callback_flag = false;
+      last_path = ros::Time::now();
+      path.header.stamp = last_path;
+
+      if (gazebo_callback_flag)
+      {
+        fill_path(gazebo_history, path);
+        gzb_path_pub.publish(path);
+        gazebo_callback_flag = false;
+      }
+
+      if (odom_callback_flag)
+      {
+        fill_path(odom_history, path);
+        odom_path_pub.publish(path);
+        odom_callback_flag = false;
+      }
+
+      if (slam_callback_flag)
+      {
+        fill_path(slam_history, path);
+        slam_path_pub.publish(path);
+        slam_callback_flag = false;
+      }
     }
 
-    if (odom_callback_flag)
+    if (odom_eval->count() > 0 and slam_eval->count() > 0)
     {
-      path.header.stamp = ros::Time::now();
-      // Populate using growing vector of poses
-      path.poses = odom_poses;
-      odom_path_pub.publish(path);
-      odom_callback_flag = false;
+      // Publish pose error between odom-gazebo and slam-gazebo, at the time of the latest estimates
+      odom_err_pub.publish(pose_error(*odom_eval));
+      slam_err_pub.publish(pose_error(*slam_eval));
     }
 
-    if (slam_callback_flag)
-    {
-      path.header.stamp = ros::Time::now();
-      // Populate using growing vector of poses
-      path.poses = slam_poses;
-      slam_path_pub.publish(path);
-      slam_callback_flag = false;
-    }
+    rate.sleep();
+  }
 
-    if (gazebo_poses.size() > 0 and odom_poses.size() > 0 and slam_poses.size() > 0)
+  const nuslam::TrajectoryErrorSummary odom_error = odom_eval->summary();
+  const nuslam::TrajectoryErrorSummary slam_error = slam_eval->summary();
+  ROS_INFO("odom ATE RMSE %.4f m p99 %.4f m, RPE RMSE %.4f m", odom_error.ate_trans.rmse, odom_error.ate_trans.p99,\
+           odom_error.rpe_trans.rmse);
+  ROS_INFO("slam ATE RMSE %.4f m p99 %.4f m, RPE RMSE %.4f m", slam_error.ate_trans.rmse, slam_error.ate_trans.p99,\
+           slam_error.rpe_trans.rmse);
+  if (!eval_file_.empty())
+  {
+    try
+    {
+      write_summary(eval_file_);
+    } catch (const std::exception & e)
     {
-      // Current Gazebo Pose
-      geometry_msgs::Pose gazebo_pose = gazebo_poses.back().pose;
-      auto roll = 0.0, pitch = 0.0, gazebo_yaw = 0.0;
-      tf2::Quaternion quat(gazebo_pose.orientation.x,\
-                           gazebo_pose.orientation.y,\
-                           gazebo_pose.orientation.z,\
-                           gazebo_pose.orientation.w);
-      tf2::Matrix3x3 mat(quat);
-      mat.getRPY(roll, pitch, gazebo_yaw);    
-  
-
-      // Current Odom Pose
-      geometry_msgs::Pose odom_pose = odom_poses.back().pose;
-      auto odom_yaw = 0.0;
-      quat = tf2::Quaternion(odom_pose.orientation.x,\
-                             odom_pose.orientation.y,\
-                             odom_pose.orientation.z,\
-                             odom_pose.orientation.w);
-      mat = tf2::Matrix3x3(quat);
-      mat.getRPY(roll, pitch, odom_yaw);
-    
-
-      // Current SLAM Pose
-      geometry_msgs::Pose slam_pose = slam_poses.back().pose;
-      auto slam_yaw = 0.0;
-      quat = tf2::Quaternion(slam_pose.orientation.x,\
-                             slam_pose.orientation.y,\
-                             slam_pose.orientation.z,\
-                             slam_pose.orientation.w);
-      mat = tf2::Matrix3x3(quat);
-      mat.getRPY(roll, pitch, slam_yaw);
-
-      // Publish pose error between odom-gazebo
-      tsim::PoseError odom_err;
-      odom_err.x_error = fabs(gazebo_pose.position.x - odom_pose.position.x);
-      odom_err.y_error = fabs(gazebo_pose.position.y - odom_pose.position.y);
-      odom_err.theta_error = fabs(fabs(gazebo_yaw) - fabs(odom_yaw));
-      odom_err_pub.publish(odom_err);
-
-      // Publish pose error between slam-gazebo
-      tsim::PoseError slam_err;
-      slam_err.x_error = fabs(gazebo_pose.position.x - slam_pose.position.x);
-      slam_err.y_error = fabs(gazebo_pose.position.y - slam_pose.position.y);
-      slam_err.theta_error = fabs(fabs(gazebo_yaw) - fabs(slam_yaw));
-      slam_err_pub.publish(slam_err);
+      ROS_ERROR("%s", e.what());
     }
-
-    rate.sleep();
   }
 
   return 0;
-}
\ No newline at end of file
+}
@@ -1,6 +1,29 @@
 #include <gtest/gtest.h>
 #include "nuslam/landmarks.hpp"
+#include "nuslam/scan_cloud.hpp"
+#include "nuslam/arena.hpp"
 #include "nuslam/ekf.hpp"
+#include "nuslam/deskew.hpp"
+#include "nuslam/snapshot.hpp"
+#include "nuslam/replay.hpp"
+#include "nuslam/sweep.hpp"
+#include "nuslam/latency.hpp"
+#include "nuslam/trace.hpp"
+#include "nuslam/path_history.hpp"
+#include "nuslam/trajectory_eval.hpp"
+#include "nuslam/model_index.hpp"
+#include "nuslam/grid_map.hpp"
+#include "nuslam/scan_matcher.hpp"
+#include "nuslam/icp.hpp"
+#include "nuslam/cluster_tracker.hpp"
+#include <thread>
+#include <random>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <fstream>
+#include <stdlib.h>
+#include <unistd.h>
 #include "rigid2d/diff_drive.hpp"
 
 namespace nuslam
@@ -89,6 +112,435 @@ TEST(landmarks, CircleFitting)
 
 }
 
+TEST(landmarks, ScanCloud)
+{
+	double test_threshold = 1e-9;
+
+	// Clustering Test: {0-2, 9-10} wrap around into one cluster, {3-6} is kept and {7-8} is too small
+	std::vector<double> ranges = {1.0, 1.0, 1.0, 2.0, 2.0, 2.0, 2.0, 3.0, 3.0, 1.0, 1.0};
+	std::vector<Point> points;
+	ScanCloud scan;
+	for (unsigned long int i = 0; i < ranges.size(); i++)
+	{
+		points.push_back(Point(RangeBear(ranges.at(i), 0.1 * i)));
+		scan.push_back(points.back());
+	}
+	std::vector<Landmark> expected = cluster_points(points, 0.15);
+	ScanCloud clusters = cluster_scan(scan, 0.15);
+	ASSERT_EQ(clusters.num_clusters(), expected.size());
+	ASSERT_EQ(clusters.num_clusters(), 2u);
+	for (unsigned long int c = 0; c < expected.size(); c++)
+	{
+		ASSERT_EQ(clusters.offsets.at(c + 1) - clusters.offsets.at(c), expected.at(c).points.size());
+		for (unsigned long int i = 0; i < expected.at(c).points.size(); i++)
+		{
+			Point p = clusters.point(clusters.offsets.at(c) + i);
+			ASSERT_NEAR(p.pose.x, expected.at(c).points.at(i).pose.x, test_threshold);
+			ASSERT_NEAR(p.pose.y, expected.at(c).points.at(i).pose.y, test_threshold);
+			ASSERT_NEAR(p.range_bear.range, expected.at(c).points.at(i).range_bear.range, test_threshold);
+		}
+	}
+
+	// Fitting Test: cylinder of radius 0.05m at (1, 0.2) in front of a wall of radius 2m
+	points.clear();
+	scan.clear();
+	for (int i = 0; i < 360; i++)
+	{
+		double bearing = rigid2d::PI * i / 180.0;
+		double b = cos(bearing) * 1.0 + sin(bearing) * 0.2;
+		double disc = b * b - (1.04 - 0.0025);
+		double range = (disc >= 0 && b > 0) ? b - sqrt(disc) : 2.0;
+		points.push_back(Point(RangeBear(range, bearing)));
+		scan.push_back(points.back());
+	}
+	expected = cluster_points(points, 0.15);
+	fit_landmarks(expected, 0.1);
+	std::vector<Landmark> landmarks = fit_clusters(cluster_scan(scan, 0.15), 0.1);
+	ASSERT_EQ(landmarks.size(), 1u);
+	ASSERT_EQ(landmarks.size(), expected.size());
+	ASSERT_NEAR(landmarks.at(0).return_coords().pose.x, expected.at(0).return_coords().pose.x, 1e-6);
+	ASSERT_NEAR(landmarks.at(0).return_coords().pose.y, expected.at(0).return_coords().pose.y, 1e-6);
+	ASSERT_NEAR(landmarks.at(0).return_coords().pose.x, 1.0, 1e-3);
+	ASSERT_NEAR(landmarks.at(0).return_coords().pose.y, 0.2, 1e-3);
+	ASSERT_NEAR(landmarks.at(0).return_radius(), 0.05, 1e-3);
+
+	// The fit of every cluster is kept, including the discarded wall
+	clusters = cluster_scan(scan, 0.15);
+	std::pmr::vector<Landmark> kept;
+	std::pmr::vector<CircleFit> fits;
+	fit_clusters(clusters, 0.1, kept, fits);
+	ASSERT_EQ(kept.size(), 1u);
+	ASSERT_EQ(fits.size(), clusters.num_clusters());
+	ASSERT_GT(fits.size(), kept.size());
+	unsigned long int cylinder = fits.at(0).radius < fits.back().radius ? 0 : fits.size() - 1;
+	ASSERT_NEAR(fits.at(cylinder).radius, kept.at(0).return_radius(), test_threshold);
+}
+
+TEST(landmarks, ClusterWindows)
+{
+	// Cylinders of radius 0.05m at (1, 0.2) and (-0.5, -0.6) inside a wall of radius 2m
+	std::vector<Vector2D> cylinders = {Vector2D(1.0, 0.2), Vector2D(-0.5, -0.6)};
+	ScanCloud scan;
+	for (int i = 0; i < 360; i++)
+	{
+		double bearing = rigid2d::PI * i / 180.0;
+		double range = 2.0;
+		for (auto iter = cylinders.begin(); iter != cylinders.end(); iter++)
+		{
+			double b = cos(bearing) * iter->x + sin(bearing) * iter->y;
+			double disc = b * b - (iter->x * iter->x + iter->y * iter->y - 0.0025);
+			if (disc >= 0 && b > 0)
+			{
+				range = std::min(range, b - sqrt(disc));
+			}
+		}
+		scan.push_back(Point(RangeBear(range, bearing)));
+	}
+	ScanCloud full = cluster_scan(scan, 0.15);
+	std::vector<Landmark> expected = fit_clusters(full, 0.1);
+	ASSERT_EQ(expected.size(), 2u);
+
+	// A window around each cylinder gives the same landmarks, and no wall
+	std::vector<ScanWindow> windows;
+	for (auto iter = cylinders.begin(); iter != cylinders.end(); iter++)
+	{
+		// Predicted bearings are in (-PI, PI], the scan's in [0, 2PI)
+		windows.push_back(ScanWindow(cartesianToPolar(*iter), RangeBear(0.01, 0.01), 3.0, 0.1));
+	}
+	ScanCloud clusters;
+	cluster_windows(scan, 0.15, windows, clusters);
+	ASSERT_EQ(clusters.num_clusters(), 2u);
+	ASSERT_LT(clusters.size(), full.size() / 5);
+	std::vector<Landmark> landmarks = fit_clusters(clusters, 0.1);
+	ASSERT_EQ(landmarks.size(), 2u);
+	for (unsigned long int i = 0; i < landmarks.size(); i++)
+	{
+		unsigned long int j = std::fabs(landmarks.at(i).return_coords().pose.x - expected.at(0).return_coords().pose.x) < 1e-3 ? 0 : 1;
+		ASSERT_NEAR(landmarks.at(i).return_coords().pose.x, expected.at(j).return_coords().pose.x, 1e-9);
+		ASSERT_NEAR(landmarks.at(i).return_coords().pose.y, expected.at(j).return_coords().pose.y, 1e-9);
+		ASSERT_NEAR(landmarks.at(i).return_radius(), expected.at(j).return_radius(), 1e-9);
+	}
+
+	// Same clusters from only the Points whose bearing is inside a window, so the others need not be converted
+	std::vector<std::uint8_t> mask;
+	window_beams(windows, 0.0, rigid2d::PI / 180.0, scan.size(), mask);
+	ScanCloud restricted;
+	for (unsigned long int i = 0; i < scan.size(); i++)
+	{
+		bool covered = false;
+		for (auto iter = windows.begin(); iter != windows.end(); iter++)
+		{
+			covered = covered || iter->covers(scan.bearing.at(i));
+		}
+		ASSERT_EQ(mask.at(i) == 1, covered);
+		if (mask.at(i))
+		{
+			restricted.push_back(scan.point(i));
+		}
+	}
+	ASSERT_LT(restricted.size(), scan.size() / 5);
+	ScanCloud restricted_clusters;
+	cluster_windows(restricted, 0.15, windows, restricted_clusters);
+	ASSERT_EQ(restricted_clusters.offsets, clusters.offsets);
+	ASSERT_EQ(restricted_clusters.x, clusters.x);
+
+	// Overlapping windows do not duplicate a cluster, and a window across bearing 0 wraps around
+	windows.push_back(windows.front());
+	windows.push_back(ScanWindow(RangeBear(2.0, 0.0), RangeBear(0.0, 0.0), 3.0, 0.1));
+	cluster_windows(scan, 0.15, windows, clusters);
+	ASSERT_EQ(clusters.num_clusters(), 3u);
+	for (unsigned long int c = 0; c < clusters.num_clusters(); c++)
+	{
+		if (clusters.range.at(clusters.offsets.at(c)) > 1.9)
+		{
+			// Beams from 0 to 2 degrees, then those from 358 degrees, as in cluster_scan
+			ASSERT_EQ(clusters.offsets.at(c + 1) - clusters.offsets.at(c), 5u);
+			ASSERT_LT(clusters.bearing.at(clusters.offsets.at(c)), rigid2d::PI);
+			ASSERT_GT(clusters.bearing.at(clusters.offsets.at(c + 1) - 1), rigid2d::PI);
+		}
+	}
+
+	// A window whose range interval excludes the cylinder finds nothing
+	windows.assign(1, ScanWindow(RangeBear(1.5, cartesianToPolar(cylinders.front()).bearing), RangeBear(0.01, 0.01), 3.0, 0.1));
+	cluster_windows(scan, 0.15, windows, clusters);
+	ASSERT_EQ(clusters.num_clusters(), 0u);
+	windows.clear();
+	cluster_windows(scan, 0.15, windows, clusters);
+	ASSERT_EQ(clusters.num_clusters(), 0u);
+}
+
+TEST(landmarks, ScanPoints)
+{
+	// Cylinder of radius 0.05m at (0.8, 0.6) inside a wall of radius 2m, one beam per degree
+	Vector2D cylinder(0.8, 0.6);
+	const double increment = rigid2d::PI / 180.0;
+	std::vector<float> ranges;
+	for (int i = 0; i < 360; i++)
+	{
+		double bearing = i * increment;
+		double range = 2.0;
+		double b = cos(bearing) * cylinder.x + sin(bearing) * cylinder.y;
+		double disc = b * b - (cylinder.x * cylinder.x + cylinder.y * cylinder.y - 0.0025);
+		if (disc >= 0 && b > 0)
+		{
+			range = b - sqrt(disc);
+		}
+		ranges.push_back(range);
+	}
+	// Beams without a return ahead of the cylinder
+	for (int i = 0; i < 20; i++)
+	{
+		ranges.at(i) = std::numeric_limits<float>::infinity();
+	}
+	ranges.at(25) = std::numeric_limits<float>::quiet_NaN();
+
+	// Every Point keeps the bearing of its beam
+	ScanCloud cloud;
+	scan_points(ranges, 0.0, increment, 0.12, 3.5, nullptr, nullptr, cloud);
+	ASSERT_EQ(cloud.size(), 339u);
+	ASSERT_NEAR(cloud.bearing.at(0), 20 * increment, 1e-9);
+	ASSERT_NEAR(cloud.bearing.at(5), 26 * increment, 1e-9);
+
+	// The beams kept by the window of the cylinder are those that hit it
+	std::vector<ScanWindow> windows(1, ScanWindow(cartesianToPolar(cylinder), RangeBear(0.01, 0.01), 3.0, 0.1));
+	std::vector<std::uint8_t> mask;
+	window_beams(windows, 0.0, increment, ranges.size(), mask);
+	scan_points(ranges, 0.0, increment, 0.12, 3.5, &mask, nullptr, cloud);
+	ScanCloud clusters;
+	cluster_windows(cloud, 0.15, windows, clusters);
+	ASSERT_EQ(clusters.num_clusters(), 1u);
+	std::vector<Landmark> landmarks = fit_clusters(clusters, 0.1);
+	ASSERT_EQ(landmarks.size(), 1u);
+	ASSERT_NEAR(landmarks.at(0).return_coords().pose.x, cylinder.x, 0.01);
+	ASSERT_NEAR(landmarks.at(0).return_coords().pose.y, cylinder.y, 0.01);
+
+	mask.pop_back();
+	ASSERT_THROW(scan_points(ranges, 0.0, increment, 0.12, 3.5, &mask, nullptr, cloud), std::invalid_argument);
+}
+
+TEST(landmarks, ClusterTracker)
+{
+	// Cylinders of radius 0.05m at (1, 0.2) and (-0.5, -0.6) inside a wall of radius 2m, seen from a pose
+	std::vector<Vector2D> cylinders = {Vector2D(1.0, 0.2), Vector2D(-0.5, -0.6)};
+	auto scan_from = [&cylinders](const Transform2D & pose)
+	{
+		rigid2d::Transform2DS d = pose.displacement();
+		ScanCloud scan;
+		for (int i = 0; i < 360; i++)
+		{
+			double bearing = rigid2d::PI * i / 180.0;
+			double ux = cos(d.theta + bearing), uy = sin(d.theta + bearing);
+			double b = -(ux * d.x + uy * d.y);
+			double range = b + sqrt(b * b - (d.x * d.x + d.y * d.y - 4.0));
+			for (auto iter = cylinders.begin(); iter != cylinders.end(); iter++)
+			{
+				double cx = iter->x - d.x, cy = iter->y - d.y;
+				b = ux * cx + uy * cy;
+				double disc = b * b - (cx * cx + cy * cy - 0.0025);
+				if (disc >= 0 && b > 0)
+				{
+					range = std::min(range, b - sqrt(disc));
+				}
+			}
+			scan.push_back(Point(RangeBear(range, bearing)));
+		}
+		return cluster_scan(scan, 0.15);
+	};
+
+	ClusterTracker tracker;
+	std::pmr::vector<Landmark> landmarks;
+	std::pmr::vector<CircleFit> fits;
+	std::pmr::vector<Landmark> expected;
+	std::pmr::vector<CircleFit> expected_fits;
+
+	// The first scan has no tracks
+	Transform2D pose;
+	ScanCloud clusters = scan_from(pose);
+	tracker.fit_clusters(clusters, 0.1, landmarks, fits);
+	ASSERT_EQ(tracker.size(), clusters.num_clusters());
+	ASSERT_EQ(tracker.stats().fitted, clusters.num_clusters());
+	ASSERT_EQ(landmarks.size(), 2u);
+
+	// The same scan reuses every circle
+	tracker.predict(Transform2D());
+	tracker.fit_clusters(clusters, 0.1, landmarks, fits);
+	ASSERT_EQ(tracker.stats().reused, clusters.num_clusters());
+	fit_clusters(clusters, 0.1, expected, expected_fits);
+	ASSERT_EQ(fits.size(), expected_fits.size());
+	for (unsigned long int i = 0; i < fits.size(); i++)
+	{
+		ASSERT_NEAR(fits.at(i).centre.x, expected_fits.at(i).centre.x, 1e-12);
+		ASSERT_NEAR(fits.at(i).radius, expected_fits.at(i).radius, 1e-12);
+	}
+
+	// After a move further than the association distance, the cylinders are only associated with their
+	// tracks through the predicted motion. An odometry error of 1cm is corrected by the refinement.
+	Transform2D motion(Vector2D(0.2, 0.1), 0.1);
+	pose = pose * motion;
+	clusters = scan_from(pose);
+	tracker.predict(Transform2D(Vector2D(0.21, 0.09), 0.1));
+	tracker.fit_clusters(clusters, 0.1, landmarks, fits);
+	ASSERT_EQ(tracker.stats().refined, 2u);
+	ASSERT_EQ(tracker.stats().refined + tracker.stats().fitted, clusters.num_clusters());
+	fit_clusters(clusters, 0.1, expected, expected_fits);
+	ASSERT_EQ(landmarks.size(), 2u);
+	ASSERT_EQ(fits.size(), expected_fits.size());
+	for (unsigned long int i = 0; i < fits.size(); i++)
+	{
+		ASSERT_NEAR(fits.at(i).centre.x, expected_fits.at(i).centre.x, 1e-6);
+		ASSERT_NEAR(fits.at(i).centre.y, expected_fits.at(i).centre.y, 1e-6);
+		ASSERT_NEAR(fits.at(i).radius, expected_fits.at(i).radius, 1e-6);
+	}
+	for (unsigned long int i = 0; i < landmarks.size(); i++)
+	{
+		ASSERT_NEAR(landmarks.at(i).return_radius(), 0.05, 1e-6);
+	}
+
+	// Without the prediction, the same move loses the tracks
+	pose = pose * motion;
+	clusters = scan_from(pose);
+	tracker.fit_clusters(clusters, 0.1, landmarks, fits);
+	ASSERT_EQ(tracker.stats().refined + tracker.stats().reused, 0u);
+	ASSERT_EQ(landmarks.size(), 2u);
+
+	tracker.clear();
+	ASSERT_EQ(tracker.size(), 0u);
+	ASSERT_THROW(ClusterTracker(0.0, 3, 1e-3), std::invalid_argument);
+	ASSERT_THROW(ClusterTracker(0.1, 0, 1e-3), std::invalid_argument);
+	ASSERT_THROW(ClusterTracker(0.1, 3, -1.0), std::invalid_argument);
+}
+
+TEST(landmarks, ScanArena)
+{
+	ScanArena arena(1024);
+	ASSERT_EQ(arena.capacity(), 1024u);
+
+	// Fits in the block
+	{
+		std::pmr::vector<double> v(&arena);
+		v.reserve(64);
+		ASSERT_EQ(arena.overflows(), 0u);
+		ASSERT_GE(arena.used(), 64 * sizeof(double));
+		// Alignment is respected
+		void * p = arena.allocate(1, 64);
+		ASSERT_EQ(reinterpret_cast<std::uintptr_t>(p) % 64, 0u);
+	}
+
+	// Overflows to the heap, then grows on reset so the same scan fits
+	for (int scan = 0; scan < 3; scan++)
+	{
+		arena.reset();
+		ASSERT_EQ(arena.used(), 0u);
+		ScanCloud cloud(&arena);
+		for (int i = 0; i < 360; i++)
+		{
+			cloud.push_back(Point(RangeBear(1.0, 0.01 * i)));
+		}
+		ASSERT_EQ(cloud.size(), 360u);
+		ASSERT_NEAR(cloud.x.back(), cos(3.59), 1e-12);
+	}
+	std::size_t overflows = arena.overflows();
+	ASSERT_GT(overflows, 0u);
+	ASSERT_GT(arena.capacity(), 1024u);
+	arena.reset();
+	{
+		ScanCloud cloud(&arena);
+		for (int i = 0; i < 360; i++)
+		{
+			cloud.push_back(Point(RangeBear(1.0, 0.01 * i)));
+		}
+	}
+	ASSERT_EQ(arena.overflows(), overflows);
+}
+
+TEST(landmarks, Deskew)
+{
+	double test_threshold = 1e-4;
+
+	// No odometry: Points are left untouched
+	Deskew deskew;
+	deskew.start_scan(0.0, 0.01);
+	Point raw = deskew.correct_point(Point(rigid2d::Vector2D(1.0, 0.0)), 100);
+	ASSERT_NEAR(raw.pose.x, 1.0, test_threshold);
+	ASSERT_NEAR(raw.pose.y, 0.0, test_threshold);
+
+	// Translation Test: 1 m/s forward, beam captured 1s after the first beam
+	deskew.add_twist(0.0, rigid2d::Twist2D(0, 1, 0));
+	deskew.add_twist(2.0, rigid2d::Twist2D(0, 1, 0));
+	deskew.start_scan(0.0, 0.01);
+	Point first = deskew.correct_point(Point(rigid2d::Vector2D(1.0, 0.0)), 0);
+	ASSERT_NEAR(first.pose.x, 1.0, test_threshold);
+	ASSERT_NEAR(first.pose.y, 0.0, test_threshold);
+	Point trans = deskew.correct_point(Point(rigid2d::Vector2D(1.0, 0.0)), 100);
+	ASSERT_NEAR(trans.pose.x, 2.0, test_threshold);
+	ASSERT_NEAR(trans.pose.y, 0.0, test_threshold);
+	ASSERT_NEAR(trans.range_bear.range, 2.0, test_threshold);
+
+	// Rotation Test: PI/2 rad/s, beam captured 1s after the first beam
+	Deskew deskew_rot;
+	deskew_rot.add_twist(0.0, rigid2d::Twist2D(rigid2d::PI / 2.0, 0, 0));
+	deskew_rot.add_twist(2.0, rigid2d::Twist2D(rigid2d::PI / 2.0, 0, 0));
+	deskew_rot.start_scan(0.0, 0.01);
+	Point rot = deskew_rot.correct_point(Point(rigid2d::Vector2D(1.0, 0.0)), 100);
+	ASSERT_NEAR(rot.pose.x, 0.0, test_threshold);
+	ASSERT_NEAR(rot.pose.y, 1.0, test_threshold);
+
+	// Offset Sensor Test: same rotation, with the sensor 0.1m ahead of the rotation axis, which carries
+	// it to (-0.1, 0.1) and turns it PI/2 relative to where it was at the first beam
+	deskew_rot.set_sensor_pose(Transform2D(rigid2d::Vector2D(0.1, 0.0), 0.0));
+	deskew_rot.start_scan(0.0, 0.01);
+	Point offset = deskew_rot.correct_point(Point(rigid2d::Vector2D(1.0, 0.0)), 100);
+	ASSERT_NEAR(offset.pose.x, -0.1, test_threshold);
+	ASSERT_NEAR(offset.pose.y, 1.1, test_threshold);
+
+	// Interpolation Test
+	Deskew deskew_interp;
+	deskew_interp.add_twist(0.0, rigid2d::Twist2D(0, 0, 0));
+	deskew_interp.add_twist(1.0, rigid2d::Twist2D(1, 2, 0));
+	rigid2d::Twist2D tw = deskew_interp.interpolate_twist(0.25);
+	ASSERT_NEAR(tw.w_z, 0.25, test_threshold);
+	ASSERT_NEAR(tw.v_x, 0.5, test_threshold);
+	tw = deskew_interp.interpolate_twist(5.0);
+	ASSERT_NEAR(tw.v_x, 2.0, test_threshold);
+}
+
+TEST(slam, Snapshot)
+{
+	// Initial value returned until first write
+	Snapshot<rigid2d::Pose2D> snapshot(rigid2d::Pose2D(1, 2, 3));
+	ASSERT_FALSE(snapshot.updated());
+	ASSERT_NEAR(snapshot.read().x, 1, 1e-12);
+
+	// Only the latest write is returned
+	snapshot.write(rigid2d::Pose2D(4, 5, 6));
+	snapshot.write(rigid2d::Pose2D(7, 8, 9));
+	ASSERT_TRUE(snapshot.updated());
+	ASSERT_NEAR(snapshot.read().x, 7, 1e-12);
+	ASSERT_FALSE(snapshot.updated());
+	ASSERT_NEAR(snapshot.read().y, 8, 1e-12);
+
+	// Concurrent writer never hands the reader a torn or stale-then-older value
+	Snapshot<rigid2d::Pose2D> shared;
+	const int writes = 100000;
+	std::thread writer([&shared]()
+	{
+		for (int i = 1; i <= writes; i++)
+		{
+			shared.write(rigid2d::Pose2D(i, i, i));
+		}
+	});
+	double last = 0;
+	bool consistent = true;
+	while (consistent && last < writes)
+	{
+		rigid2d::Pose2D pose = shared.read();
+		consistent = pose.x == pose.y && pose.x == pose.theta && pose.x >= last;
+		last = pose.x;
+	}
+	writer.join();
+	ASSERT_TRUE(consistent);
+}
+
 TEST(slam, Prediction)
 {
 	rigid2d::DiffDrive driver;
@@ -209,6 +661,881 @@ TEST(slam, MeasurementUpdate)
 	}
 }
 
+TEST(slam, PoseUpdate)
+{
+	rigid2d::DiffDrive driver;
+	std::vector<nuslam::Point> map_state_(12, nuslam::Point());
+	nuslam::Pose2D xyt_noise_var = nuslam::Pose2D(1e-2, 1e-2, 1e-2);
+	nuslam::RangeBear rb_noise_var_ = nuslam::RangeBear(1e-10, 1e-10);
+	nuslam::EKF ekf = nuslam::EKF(driver.get_pose(), map_state_, xyt_noise_var, rb_noise_var_, 3.5, 5.0, 100.0);
+	seed_random(1);
+
+	// Grow the robot covariance, then measure the pose much more precisely than it is predicted
+	rigid2d::Twist2D Vb(0, 0, 0);
+	ekf.predict(Vb);
+	ekf.predict(Vb);
+	ekf.pose_update(rigid2d::Pose2D(0.3, -0.2, 0.1), rigid2d::Pose2D(1e-8, 1e-8, 1e-8));
+	rigid2d::Pose2D pose = ekf.return_pose();
+	ASSERT_NEAR(pose.theta, 0.1, 1e-4);
+	ASSERT_NEAR(pose.x, 0.3, 1e-4);
+	ASSERT_NEAR(pose.y, -0.2, 1e-4);
+
+	// A measurement of equal variance to the belief moves the pose halfway
+	ekf.predict(Vb);
+	ekf.pose_update(rigid2d::Pose2D(0.5, -0.2, 0.1), rigid2d::Pose2D(1e-2, 1e-2, 1e-2));
+	pose = ekf.return_pose();
+	ASSERT_GT(pose.x, 0.3);
+	ASSERT_LT(pose.x, 0.5);
+}
+
+TEST(slam, MeasurementJacobian)
+{
+	// Compare against central differences of range and bearing about the robot's (theta, x, y)
+	const rigid2d::Pose2D robot(0.3, -0.2, 0.4);
+	const Vector2D landmark(1.5, 2.0);
+	auto measure = [&landmark](const double & theta, const double & x, const double & y)
+	{
+		return Eigen::Vector2d(std::hypot(landmark.x - x, landmark.y - y),\
+							   rigid2d::normalize_angle(std::atan2(landmark.y - y, landmark.x - x) - theta));
+	};
+
+	const Eigen::Matrix<double, 2, 3> H = nuslam::msr_jacobian(landmark.x - robot.x, landmark.y - robot.y);
+	const double eps = 1e-6;
+	const Eigen::Vector2d d_theta = (measure(robot.theta + eps, robot.x, robot.y) - measure(robot.theta - eps, robot.x, robot.y)) / (2.0 * eps);
+	const Eigen::Vector2d d_x = (measure(robot.theta, robot.x + eps, robot.y) - measure(robot.theta, robot.x - eps, robot.y)) / (2.0 * eps);
+	const Eigen::Vector2d d_y = (measure(robot.theta, robot.x, robot.y + eps) - measure(robot.theta, robot.x, robot.y - eps)) / (2.0 * eps);
+	for (int r = 0; r < 2; r++)
+	{
+		ASSERT_NEAR(H(r, 0), d_theta(r), 1e-6);
+		ASSERT_NEAR(H(r, 1), d_x(r), 1e-6);
+		ASSERT_NEAR(H(r, 2), d_y(r), 1e-6);
+	}
+}
+
+TEST(slam, PredictMeasurements)
+{
+	std::vector<nuslam::Point> map_state_(4, nuslam::Point());
+	nuslam::Pose2D xyt_noise_var = nuslam::Pose2D(1e-3, 1e-3, 1e-3);
+	nuslam::RangeBear rb_noise_var_ = nuslam::RangeBear(1e-4, 1e-4);
+	nuslam::EKF ekf = nuslam::EKF(rigid2d::Pose2D(0.5, 1.0, -0.5), map_state_, xyt_noise_var, rb_noise_var_, 3.5, 5.0, 100.0);
+
+	// No landmark seen yet
+	std::vector<MeasurementPrediction> predictions;
+	ekf.predict_measurements(predictions);
+	ASSERT_TRUE(predictions.empty());
+
+	// Known landmarks, from a pose the robot is certain of
+	std::vector<Point> landmarks = {Point(Vector2D(1.0, 1.0)), Point(Vector2D(-1.0, 2.0))};
+	ekf.set_map(landmarks);
+	ekf.reset_pose(rigid2d::Pose2D(0.0, 0.0, rigid2d::PI / 2.0));
+	ekf.predict_measurements(predictions);
+	ASSERT_EQ(predictions.size(), 2u);
+	ASSERT_EQ(predictions.at(1).index, 1u);
+	ASSERT_NEAR(predictions.at(0).range_bear.range, std::sqrt(2.0), 1e-9);
+	ASSERT_NEAR(predictions.at(0).range_bear.bearing, -rigid2d::PI / 4.0, 1e-9);
+	ASSERT_NEAR(predictions.at(1).range_bear.range, std::sqrt(5.0), 1e-9);
+	ASSERT_NEAR(predictions.at(1).range_bear.bearing, std::atan2(2.0, -1.0) - rigid2d::PI / 2.0, 1e-9);
+	ASSERT_NEAR(predictions.at(0).sigma.range, 1e-2, 1e-9);
+	ASSERT_NEAR(predictions.at(0).sigma.bearing, 1e-2, 1e-9);
+
+	// Robot uncertainty widens the prediction, in bearing more so for the nearer landmark
+	ekf.predict(rigid2d::Twist2D(0, 0, 0));
+	ekf.predict_measurements(predictions);
+	ASSERT_GT(predictions.at(0).sigma.range, 1e-2);
+	ASSERT_GT(predictions.at(0).sigma.bearing, predictions.at(1).sigma.bearing);
+
+	// Same predictions with a frozen map, whose landmarks are certain
+	std::vector<MeasurementPrediction> frozen;
+	ekf.freeze_map();
+	ekf.predict_measurements(frozen);
+	ASSERT_EQ(frozen.size(), predictions.size());
+	for (unsigned long int i = 0; i < frozen.size(); i++)
+	{
+		ASSERT_NEAR(frozen.at(i).sigma.range, predictions.at(i).sigma.range, 1e-9);
+		ASSERT_NEAR(frozen.at(i).sigma.bearing, predictions.at(i).sigma.bearing, 1e-9);
+	}
+}
+
+// Create a uniquely named, empty file in the temporary directory
+static std::string temp_filename()
+{
+	char name[] = "/tmp/nuslam_test_XXXXXX";
+	int fd = mkstemp(name);
+	if (fd >= 0)
+	{
+		close(fd);
+	}
+	return name;
+}
+
+TEST(slam, MapFile)
+{
+	double max_range_ = 3.5;
+	double mahalanobis_lower = 15.0;
+	double mahalanobis_upper = 500.0;
+	std::vector<nuslam::Point> map_state_(3, nuslam::Point());
+	nuslam::Pose2D xyt_noise_var = nuslam::Pose2D(1e-10, 1e-10, 1e-10);
+	nuslam::RangeBear rb_noise_var_ = nuslam::RangeBear(1e-10, 1e-10);
+	nuslam::EKF ekf = nuslam::EKF(rigid2d::Pose2D(), map_state_, xyt_noise_var, rb_noise_var_, max_range_, mahalanobis_lower, mahalanobis_upper);
+
+	std::vector<nuslam::Point> measurements;
+	measurements.push_back(Point(rigid2d::Vector2D(1.0, 0.5)));
+	measurements.push_back(Point(rigid2d::Vector2D(-0.5, 1.0)));
+	ekf.predict(rigid2d::Twist2D(0, 0, 0));
+	ekf.msr_update(measurements);
+
+	std::string filename = temp_filename();
+	ekf.save_map(filename);
+
+	// Load into an EKF with a different number of landmark slots
+	std::vector<nuslam::Point> empty_map(12, nuslam::Point());
+	nuslam::EKF loaded = nuslam::EKF(rigid2d::Pose2D(), empty_map, xyt_noise_var, rb_noise_var_, max_range_, mahalanobis_lower, mahalanobis_upper);
+	{
+		MapFile map_file(filename);
+		ASSERT_TRUE(map_file.is_open());
+		ASSERT_EQ(map_file.map_size(), 3u);
+		ASSERT_EQ(map_file.seen(), 2u);
+		loaded.load_map(map_file);
+	}
+
+	std::vector<Point> saved_map = ekf.return_map();
+	std::vector<Point> loaded_map = loaded.return_map();
+	ASSERT_EQ(loaded_map.size(), saved_map.size());
+	for (unsigned long int i = 0; i < saved_map.size(); i++)
+	{
+		ASSERT_NEAR(loaded_map.at(i).pose.x, saved_map.at(i).pose.x, 1e-12);
+		ASSERT_NEAR(loaded_map.at(i).pose.y, saved_map.at(i).pose.y, 1e-12);
+		ASSERT_EQ(loaded_map.at(i).seen_count, saved_map.at(i).seen_count);
+	}
+	ASSERT_EQ(loaded_map.at(0).seen_count, 1);
+
+	// Loaded landmarks are re-observed rather than initialized again
+	loaded.predict(rigid2d::Twist2D(0, 0, 0));
+	loaded.msr_update(measurements);
+	ASSERT_EQ(loaded.return_map().at(0).seen_count, 2);
+	ASSERT_EQ(loaded.return_map().at(2).seen_count, 0);
+
+	// Loaded straight into localization-only mode, the map is the same, and the covariance saved
+	// with it is read from the file
+	nuslam::EKF frozen = nuslam::EKF(rigid2d::Pose2D(), empty_map, xyt_noise_var, rb_noise_var_, max_range_, mahalanobis_lower, mahalanobis_upper);
+	frozen.load_frozen_map(std::make_shared<const MapFile>(filename));
+	ASSERT_TRUE(frozen.map_frozen());
+	ASSERT_THROW(frozen.load_frozen_map(std::make_shared<const MapFile>(filename)), std::logic_error);
+	std::vector<Point> frozen_map = frozen.return_map();
+	ASSERT_EQ(frozen_map.size(), saved_map.size());
+	for (unsigned long int i = 0; i < saved_map.size(); i++)
+	{
+		ASSERT_DOUBLE_EQ(frozen_map.at(i).pose.x, saved_map.at(i).pose.x);
+		ASSERT_DOUBLE_EQ(frozen_map.at(i).pose.y, saved_map.at(i).pose.y);
+		ASSERT_EQ(frozen_map.at(i).seen_count, saved_map.at(i).seen_count);
+	}
+	frozen.predict(rigid2d::Twist2D(0, 0, 0));
+	frozen.msr_update(measurements);
+	ASSERT_EQ(frozen.return_map().at(0).seen_count, 2);
+
+	std::string resaved = temp_filename();
+	frozen.save_map(resaved);
+	{
+		MapFile original(filename);
+		MapFile copy(resaved);
+		const unsigned long int dim = 3 + 2 * original.map_size();
+		ASSERT_TRUE(copy.covariance().bottomRightCorner(dim - 3, dim - 3).isApprox(original.covariance().bottomRightCorner(dim - 3, dim - 3)));
+		ASSERT_EQ(copy.seen_count(0), 2);
+	}
+	std::remove(resaved.c_str());
+
+	// Corrupt files are rejected
+	std::FILE * f = std::fopen(filename.c_str(), "r+b");
+	std::fputc('X', f);
+	std::fclose(f);
+	ASSERT_THROW(MapFile corrupt(filename), std::runtime_error);
+	std::remove(filename.c_str());
+	ASSERT_THROW(MapFile missing(filename), std::runtime_error);
+}
+
+TEST(slam, LocalizationOnly)
+{
+	double max_range_ = 3.5;
+	double mahalanobis_lower = 15.0;
+	double mahalanobis_upper = 500.0;
+	std::vector<nuslam::Point> map_state_(12, nuslam::Point());
+	nuslam::Pose2D xyt_noise_var = nuslam::Pose2D(1e-4, 1e-4, 1e-5);
+	nuslam::RangeBear rb_noise_var_ = nuslam::RangeBear(1e-6, 1e-6);
+	nuslam::EKF ekf = nuslam::EKF(rigid2d::Pose2D(), map_state_, xyt_noise_var, rb_noise_var_, max_range_, mahalanobis_lower, mahalanobis_upper);
+
+	// Known landmarks in the map frame
+	std::vector<Point> known_map;
+	known_map.push_back(Point(rigid2d::Vector2D(1.0, 0.5)));
+	known_map.push_back(Point(rigid2d::Vector2D(-0.5, 1.0)));
+	known_map.push_back(Point(rigid2d::Vector2D(0.5, -1.0)));
+	ekf.set_map(known_map);
+	ASSERT_FALSE(ekf.map_frozen());
+	ekf.freeze_map();
+	ASSERT_TRUE(ekf.map_frozen());
+	ASSERT_THROW(ekf.set_map(known_map), std::logic_error);
+
+	// Grow pose uncertainty while the robot believes it is at the origin
+	for (int i = 0; i < 10; i++)
+	{
+		ekf.predict(rigid2d::Twist2D(0, 0, 0));
+	}
+	ekf.reset_pose(rigid2d::Pose2D());
+
+	// Robot is actually 0.05m ahead of its belief
+	rigid2d::Vector2D true_pose(0.05, 0.0);
+	std::vector<Point> measurements;
+	for (auto iter = known_map.begin(); iter != known_map.end(); iter++)
+	{
+		measurements.push_back(Point(rigid2d::Vector2D(iter->pose.x - true_pose.x, iter->pose.y - true_pose.y)));
+	}
+	// A landmark which is not in the map is never added
+	measurements.push_back(Point(rigid2d::Vector2D(-2.0, -2.0)));
+
+	for (int i = 0; i < 20; i++)
+	{
+		ekf.predict(rigid2d::Twist2D(0, 0, 0));
+		ekf.msr_update(measurements);
+	}
+
+	// Landmarks stay where they were
+	std::vector<Point> map = ekf.return_map();
+	ASSERT_EQ(map.size(), known_map.size());
+	for (unsigned long int i = 0; i < known_map.size(); i++)
+	{
+		ASSERT_DOUBLE_EQ(map.at(i).pose.x, known_map.at(i).pose.x);
+		ASSERT_DOUBLE_EQ(map.at(i).pose.y, known_map.at(i).pose.y);
+		ASSERT_GT(map.at(i).seen_count, 0);
+	}
+
+	// Robot pose is pulled towards the true pose
+	rigid2d::Pose2D pose = ekf.return_pose();
+	ASSERT_NEAR(pose.x, true_pose.x, 0.03);
+	ASSERT_NEAR(pose.y, true_pose.y, 0.03);
+
+	// Frozen map can still be saved and loaded
+	std::string filename = temp_filename();
+	ekf.save_map(filename);
+	{
+		MapFile map_file(filename);
+		ASSERT_EQ(map_file.map_size(), 3u);
+		ASSERT_EQ(map_file.seen(), 3u);
+		ASSERT_DOUBLE_EQ(map_file.state()(5), -0.5);
+	}
+	std::remove(filename.c_str());
+}
+
+
+// Robot standing still for 5s, scanning three cylinders, with ground truth
+static Dataset stationary_dataset()
+{
+	// Robot at (1, 2, pi/2) in the world frame, in a 3m square room with three cylinders of radius 0.05m
+	rigid2d::Pose2D world_pose(1.0, 2.0, rigid2d::PI / 2.0);
+	rigid2d::Transform2D T_world_robot(rigid2d::Vector2D(world_pose.x, world_pose.y), world_pose.theta);
+	std::vector<rigid2d::Vector2D> cylinders;
+	cylinders.push_back(rigid2d::Vector2D(0.7, 0.0));
+	cylinders.push_back(rigid2d::Vector2D(0.0, 0.6));
+	cylinders.push_back(rigid2d::Vector2D(-0.5, -0.5));
+	double radius = 0.05;
+
+	ScanRecord scan;
+	scan.angle_min = 0.0;
+	scan.angle_increment = 2.0 * rigid2d::PI / 360.0;
+	scan.angle_max = scan.angle_min + 359 * scan.angle_increment;
+	scan.range_min = 0.12;
+	scan.range_max = 3.5;
+	for (int i = 0; i < 360; i++)
+	{
+		double bearing = scan.angle_min + i * scan.angle_increment;
+		// Walls at x,y = +-1.5 in the robot frame, so that every beam returns
+		double range = std::min(1.5 / std::max(std::abs(cos(bearing)), 1e-9), 1.5 / std::max(std::abs(sin(bearing)), 1e-9));
+		for (auto iter = cylinders.begin(); iter != cylinders.end(); iter++)
+		{
+			double b = cos(bearing) * iter->x + sin(bearing) * iter->y;
+			double c = iter->x * iter->x + iter->y * iter->y - radius * radius;
+			double disc = b * b - c;
+			if (disc >= 0 && b - std::sqrt(disc) > 0)
+			{
+				range = std::min(range, b - std::sqrt(disc));
+			}
+		}
+		scan.ranges.push_back(range);
+	}
+
+	GroundTruthRecord truth;
+	truth.pose = world_pose;
+	for (auto iter = cylinders.begin(); iter != cylinders.end(); iter++)
+	{
+		truth.landmarks.push_back(T_world_robot(*iter));
+	}
+
+	Dataset data;
+	for (int k = 0; k < 50; k++)
+	{
+		double stamp = 0.1 * k;
+		data.joints.push_back(JointRecord(stamp, 0.0, 0.0));
+		scan.stamp = stamp + 0.05;
+		data.scans.push_back(scan);
+		truth.stamp = stamp;
+		data.ground_truth.push_back(truth);
+	}
+	return data;
+}
+
+TEST(replay, StationaryRobot)
+{
+	Dataset data = stationary_dataset();
+	ASSERT_NEAR(data.duration(), 4.95, 1e-9);
+
+	ReplayConfig config;
+	ReplayResult result = replay(data, config);
+
+	// Every scan follows a joint state, so each runs the EKF
+	ASSERT_EQ(result.trajectory.size(), 50u);
+	ASSERT_EQ(result.cluster.samples.size(), 50u);
+	ASSERT_EQ(result.update.samples.size(), 50u);
+	ASSERT_TRUE(result.trajectory.back().has_truth);
+	ASSERT_LE(result.update.percentile(50.0), result.update.percentile(100.0));
+
+	// Ground truth is expressed in the map frame, where the robot starts at the origin
+	ASSERT_NEAR(result.trajectory.back().truth.x, 0.0, 1e-9);
+	ASSERT_NEAR(result.trajectory.back().truth.theta, 0.0, 1e-9);
+	ASSERT_EQ(result.true_map.size(), 3u);
+	ASSERT_NEAR(result.true_map.at(0).x, 0.7, 1e-9);
+
+	// Data association may initialize a cylinder more than once, but every mapped landmark is on one
+	ASSERT_GE(result.landmarks_mapped, 3u);
+	ASSERT_LT(result.pose_rmse, 0.05);
+	ASSERT_LT(result.landmark_rmse, 0.1);
+	ASSERT_GT(result.wall_time, 0.0);
+}
+
+TEST(replay, SharedJointState)
+{
+	// Two scans per joint state, as when the lidar runs faster than the encoders
+	Dataset data = stationary_dataset();
+	std::vector<JointRecord> joints;
+	for (unsigned long int k = 0; k < data.joints.size(); k += 2)
+	{
+		joints.push_back(data.joints.at(k));
+	}
+	data.joints = joints;
+
+	ReplayConfig config;
+	ReplayResult result = replay(data, config);
+
+	// As in slam, every scan is incorporated and only new wheel angles run the prediction
+	ASSERT_EQ(result.trajectory.size(), 50u);
+	ASSERT_EQ(result.update.samples.size(), 50u);
+	ASSERT_EQ(result.predict.samples.size(), 25u);
+	ASSERT_GE(result.landmarks_mapped, 3u);
+	ASSERT_LT(result.pose_rmse, 0.05);
+}
+
+TEST(replay, Sweep)
+{
+	ReplayConfig base;
+	std::vector<SweepAxis> axes;
+	axes.push_back(SweepAxis("threshold", {0.1, 0.15}));
+	axes.push_back(SweepAxis("theta_noise", {1e-5, 1e-3, 1e-1}));
+	std::vector<ReplayConfig> configs = expand_grid(base, axes);
+	ASSERT_EQ(configs.size(), 6u);
+	// Last axis varies fastest
+	ASSERT_DOUBLE_EQ(configs.at(1).threshold, 0.1);
+	ASSERT_DOUBLE_EQ(configs.at(1).theta_noise, 1e-3);
+	ASSERT_DOUBLE_EQ(get_parameter(configs.at(5), "threshold"), 0.15);
+	ASSERT_DOUBLE_EQ(configs.at(5).x_noise, base.x_noise);
+	ASSERT_THROW(expand_grid(base, {SweepAxis("wheel_base", {0.1})}), std::invalid_argument);
+	ASSERT_THROW(expand_grid(base, {SweepAxis("threshold", {})}), std::invalid_argument);
+
+	// Results do not depend on the number of threads, since every replay uses the same seed
+	Dataset data = stationary_dataset();
+	std::vector<SweepResult> serial = sweep(data, configs, 1, 7);
+	std::vector<SweepResult> parallel = sweep(data, configs, 4, 7);
+	ASSERT_EQ(parallel.size(), configs.size());
+	for (unsigned long int i = 0; i < configs.size(); i++)
+	{
+		ASSERT_DOUBLE_EQ(parallel.at(i).config.theta_noise, configs.at(i).theta_noise);
+		ASSERT_DOUBLE_EQ(parallel.at(i).pose_rmse, serial.at(i).pose_rmse);
+		ASSERT_DOUBLE_EQ(parallel.at(i).landmark_rmse, serial.at(i).landmark_rmse);
+	}
+
+	rank_results(parallel, 1.0);
+	for (unsigned long int i = 1; i < parallel.size(); i++)
+	{
+		ASSERT_LE(parallel.at(i - 1).score, parallel.at(i).score);
+	}
+	ASSERT_GT(parallel.front().landmarks_mapped, 0u);
+	ASSERT_DOUBLE_EQ(parallel.front().score, parallel.front().pose_rmse + parallel.front().landmark_rmse);
+}
+
+TEST(latency, Histogram)
+{
+	// Buckets are contiguous and each value is within 1/32 of its bucket's upper bound
+	for (std::uint64_t ns = 0; ns < 100000; ns += 7)
+	{
+		unsigned int index = LatencyHistogram::bucket_index(ns);
+		ASSERT_LE(ns, LatencyHistogram::bucket_upper(index));
+		ASSERT_LE(LatencyHistogram::bucket_upper(index) - ns, ns / 32 + 1);
+		if (index > 0)
+		{
+			ASSERT_GT(ns, LatencyHistogram::bucket_upper(index - 1));
+		}
+	}
+	ASSERT_EQ(LatencyHistogram::bucket_index(1ull << 50), LatencyHistogram::BUCKETS - 1);
+
+	LatencyHistogram hist;
+	ASSERT_EQ(hist.percentile(50.0), 0u);
+	// 1us .. 1000us
+	for (std::uint64_t us = 1; us <= 1000; us++)
+	{
+		hist.record(us * 1000);
+	}
+	ASSERT_EQ(hist.count(), 1000u);
+	ASSERT_EQ(hist.max(), 1000000u);
+	ASSERT_NEAR(hist.mean(), 500500.0, 1e-6);
+	ASSERT_NEAR(hist.percentile(50.0), 500000.0, 500000.0 / 32);
+	ASSERT_NEAR(hist.percentile(99.0), 990000.0, 990000.0 / 32);
+	ASSERT_EQ(hist.percentile(100.0), 1000000u);
+	hist.reset();
+	ASSERT_EQ(hist.count(), 0u);
+
+	// Concurrent recording from several threads loses nothing
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; t++)
+	{
+		threads.push_back(std::thread([&hist]()
+		{
+			for (int i = 0; i < 10000; i++)
+			{
+				hist.record(i);
+			}
+		}));
+	}
+	for (auto iter = threads.begin(); iter != threads.end(); iter++)
+	{
+		iter->join();
+	}
+	ASSERT_EQ(hist.count(), 40000u);
+	ASSERT_EQ(hist.max(), 9999u);
+
+	// Registry hands out one histogram per stage and timers record into it
+	LatencyRegistry registry;
+	LatencyHistogram & stage = registry.histogram("test.stage");
+	ASSERT_EQ(&stage, &registry.histogram("test.stage"));
+	{
+		ScopedTimer timer(stage);
+	}
+	std::vector<LatencySummary> summary = registry.summary();
+	ASSERT_EQ(summary.size(), 1u);
+	ASSERT_EQ(summary.at(0).stage, "test.stage");
+	ASSERT_EQ(summary.at(0).count, 1u);
+
+	std::string filename = "/tmp/nuslam_test_latency.txt";
+	registry.dump(filename);
+	std::ifstream in(filename);
+	std::string line;
+	std::getline(in, line);
+	std::getline(in, line);
+	ASSERT_EQ(line.compare(0, 11, "test.stage "), 0);
+	std::remove(filename.c_str());
+}
+
+TEST(latency, Trace)
+{
+	TraceLog trace;
+	// Disabled: nothing is kept
+	trace.record(1.0, "test_hop", 1.5);
+	ASSERT_FALSE(trace.enabled());
+	ASSERT_TRUE(trace.events().empty());
+
+	trace.start(3);
+	ASSERT_TRUE(trace.enabled());
+	for (int k = 0; k < 5; k++)
+	{
+		trace.record(k, "test_hop", k + 0.002);
+	}
+	// Only the last 3 events are kept, oldest first
+	std::vector<TraceEvent> events = trace.events();
+	ASSERT_EQ(events.size(), 3u);
+	ASSERT_DOUBLE_EQ(events.at(0).source_stamp, 2.0);
+	ASSERT_DOUBLE_EQ(events.at(2).source_stamp, 4.0);
+	ASSERT_EQ(events.at(2).hop, "test_hop");
+
+	// Every event's age is in the hop's histogram
+	LatencyHistogram & age = latency_registry().histogram("trace.test_hop");
+	ASSERT_EQ(age.count(), 5u);
+	ASSERT_NEAR(age.percentile(50.0), 2e6, 2e6 / 32);
+
+	std::string filename = "/tmp/nuslam_test_trace.csv";
+	trace.dump(filename);
+	std::ifstream in(filename);
+	std::string line;
+	std::getline(in, line);
+	ASSERT_EQ(line, "source_stamp,hop,time,age_ms");
+	std::getline(in, line);
+	ASSERT_EQ(line.compare(0, 18, "2.000000,test_hop,"), 0);
+	std::remove(filename.c_str());
+}
+
+TEST(path, History)
+{
+	ASSERT_THROW(PathHistory(0, 0.0, 0.0), std::invalid_argument);
+
+	// Keep a pose every 0.1 m or 0.5 rad, at most 4 poses
+	PathHistory history(4, 0.1, 0.5);
+	ASSERT_THROW(history.back(), std::out_of_range);
+	ASSERT_TRUE(history.add(0.0, Pose2D(0.0, 0.0, 0.0)));
+	// Too close and not turned enough
+	ASSERT_FALSE(history.add(0.1, Pose2D(0.0, 0.05, 0.05)));
+	// Turned enough
+	ASSERT_TRUE(history.add(0.2, Pose2D(0.0, 0.05, -0.6)));
+	// Moved enough, poses are compared to the last kept pose
+	ASSERT_FALSE(history.add(0.3, Pose2D(0.0, 0.12, -0.6)));
+	ASSERT_TRUE(history.add(0.4, Pose2D(0.0, 0.16, -0.6)));
+	ASSERT_EQ(history.size(), 3u);
+	ASSERT_DOUBLE_EQ(history.back().stamp, 0.4);
+
+	// Once full, the oldest pose is overwritten
+	for (int i = 1; i <= 3; i++)
+	{
+		ASSERT_TRUE(history.add(0.4 + i, Pose2D(0.0, 0.16 + i, -0.6)));
+	}
+	ASSERT_EQ(history.size(), 4u);
+	ASSERT_EQ(history.total(), 6u);
+	ASSERT_DOUBLE_EQ(history.at(0).stamp, 0.4);
+	ASSERT_DOUBLE_EQ(history.at(3).stamp, 3.4);
+	ASSERT_DOUBLE_EQ(history.at(3).pose.y, 3.16);
+	ASSERT_THROW(history.at(4), std::out_of_range);
+
+	history.clear();
+	ASSERT_EQ(history.size(), 0u);
+	ASSERT_EQ(history.capacity(), 4u);
+
+	// With no decimation, every pose is kept
+	PathHistory every(10, 0.0, 0.0);
+	ASSERT_TRUE(every.add(0.0, Pose2D()));
+	ASSERT_TRUE(every.add(0.1, Pose2D()));
+	ASSERT_EQ(every.size(), 2u);
+
+	// Poses between samples are interpolated, across the +-pi seam, and clamped outside the history
+	every.clear();
+	ASSERT_THROW(every.interpolate(0.0), std::out_of_range);
+	every.add(1.0, Pose2D(0.0, 0.0, 3.0));
+	every.add(2.0, Pose2D(1.0, -2.0, -3.0));
+	every.add(3.0, Pose2D(1.0, -2.0, -3.0));
+	Pose2D mid = every.interpolate(1.25);
+	ASSERT_DOUBLE_EQ(mid.x, 0.25);
+	ASSERT_DOUBLE_EQ(mid.y, -0.5);
+	ASSERT_NEAR(mid.theta, 3.0 + 0.25 * (2.0 * rigid2d::PI - 6.0), 1e-12);
+	ASSERT_DOUBLE_EQ(every.interpolate(0.0).theta, 3.0);
+	ASSERT_DOUBLE_EQ(every.interpolate(2.5).x, 1.0);
+	ASSERT_DOUBLE_EQ(every.interpolate(5.0).y, -2.0);
+}
+
+TEST(path, TrajectoryError)
+{
+	ASSERT_THROW(TrajectoryEvaluator(0.0, 1.0, false), std::invalid_argument);
+
+	// Ground truth drives along x at 1 m/s, sampled at 10 Hz. The estimate lags 0.1 m behind and
+	// is stamped between ground truth samples, so it is only correct once interpolated.
+	TrajectoryEvaluator evaluator(1.0, 1.0, false);
+	ASSERT_THROW(evaluator.latest(), std::out_of_range);
+	for (int k = 0; k <= 50; k++)
+	{
+		double t = 0.1 * k;
+		evaluator.add_truth(t, Pose2D(t, 0.0, 0.0));
+		// Estimate arrives before the ground truth which brackets it
+		evaluator.add_estimate(t + 0.05, Pose2D(t + 0.05 - 0.1, 0.0, 0.0));
+	}
+	// The last estimate is still waiting for ground truth
+	ASSERT_EQ(evaluator.count(), 50u);
+	ASSERT_NEAR(evaluator.latest().truth.x, 4.95, 1e-9);
+
+	TrajectoryErrorSummary error = evaluator.summary();
+	ASSERT_EQ(error.ate_trans.count, 50u);
+	ASSERT_NEAR(error.ate_trans.rmse, 0.1, 1e-9);
+	ASSERT_NEAR(error.ate_trans.mean, 0.1, 1e-9);
+	ASSERT_NEAR(error.ate_trans.p50, 0.1, 0.1 / 32);
+	ASSERT_NEAR(error.ate_trans.max, 0.1, 1e-9);
+	ASSERT_NEAR(error.ate_rot.max, 0.0, 1e-9);
+	// A constant offset has no relative error; the first second has no pair
+	ASSERT_EQ(error.rpe_trans.count, 40u);
+	ASSERT_NEAR(error.rpe_trans.max, 0.0, 1e-9);
+
+	// Estimates which start at the origin are aligned with the first ground truth pose
+	TrajectoryEvaluator aligned(1.0, 0.5, true);
+	for (int k = 0; k <= 20; k++)
+	{
+		double t = 0.1 * k;
+		aligned.add_truth(t, Pose2D(1.0, 2.0 + t, rigid2d::PI / 2.0));
+		// Estimate overshoots by 10% in its own frame
+		aligned.add_estimate(t, Pose2D(1.1 * t, 0.0, 0.0));
+	}
+	error = aligned.summary();
+	ASSERT_EQ(error.ate_trans.count, 21u);
+	ASSERT_NEAR(aligned.latest().estimate.x, 1.0, 1e-9);
+	ASSERT_NEAR(aligned.latest().estimate.y, 4.2, 1e-9);
+	ASSERT_NEAR(aligned.latest().estimate.theta, rigid2d::PI / 2.0, 1e-9);
+	ASSERT_NEAR(error.ate_trans.max, 0.2, 1e-9);
+	// 0.05 m of drift over every 0.5 s
+	ASSERT_EQ(error.rpe_trans.count, 16u);
+	ASSERT_NEAR(error.rpe_trans.rmse, 0.05, 1e-9);
+}
+
+TEST(analysis, ModelIndex)
+{
+	ModelIndex index;
+	std::vector<std::string> names = {"ground_plane", "cylinder", "diff_drive", "cylinder_0", "wall"};
+	ASSERT_TRUE(index.update(names));
+	ASSERT_TRUE(index.has_robot());
+	ASSERT_EQ(index.robot(), 2u);
+	ASSERT_EQ(index.landmarks(), std::vector<unsigned long int>({1, 3}));
+
+	// Same list, nothing to rebuild
+	ASSERT_FALSE(index.update(names));
+	ASSERT_EQ(index.rebuilds(), 1u);
+
+	// A model is added
+	names.push_back("cylinder_1");
+	ASSERT_TRUE(index.update(names));
+	ASSERT_EQ(index.landmarks().size(), 3u);
+
+	// Same length, but the models moved
+	std::swap(names.at(0), names.at(2));
+	ASSERT_TRUE(index.update(names));
+	ASSERT_EQ(index.robot(), 0u);
+
+	// The robot is removed
+	names.erase(names.begin());
+	ASSERT_TRUE(index.update(names));
+	ASSERT_FALSE(index.has_robot());
+	ASSERT_EQ(index.rebuilds(), 4u);
+
+	// Same length, but a model which is not a landmark is replaced by one
+	names.back() = "wall";
+	ASSERT_TRUE(index.update(names));
+	ASSERT_EQ(index.landmarks(), std::vector<unsigned long int>({0, 2}));
+	names.back() = "cylinder_2";
+	ASSERT_TRUE(index.update(names));
+	ASSERT_EQ(index.landmarks(), std::vector<unsigned long int>({0, 2, 4}));
+	ASSERT_EQ(index.rebuilds(), 6u);
+
+	// Landmarks relative to a robot at (1, 2) facing +y
+	Transform2D T_robot_world = Transform2D(Vector2D(1.0, 2.0), rigid2d::PI / 2.0).inv();
+	std::vector<double> x_in = {1.0, 0.0}, y_in = {3.0, 2.0}, x_out, y_out;
+	transform_points(T_robot_world, x_in, y_in, x_out, y_out);
+	ASSERT_EQ(x_out.size(), 2u);
+	ASSERT_NEAR(x_out.at(0), 1.0, 1e-9);
+	ASSERT_NEAR(y_out.at(0), 0.0, 1e-9);
+	ASSERT_NEAR(x_out.at(1), 0.0, 1e-9);
+	ASSERT_NEAR(y_out.at(1), 1.0, 1e-9);
+	ASSERT_THROW(transform_points(T_robot_world, x_in, {1.0}, x_out, y_out), std::invalid_argument);
+}
+
+TEST(grid, GridMap)
+{
+	ASSERT_THROW(GridMap(0.0, 0.7, 0.4, 0.12, 0.97), std::invalid_argument);
+	ASSERT_THROW(GridMap(0.05, 0.4, 0.7, 0.12, 0.97), std::invalid_argument);
+
+	GridMap grid(0.1, 0.7, 0.4, 0.12, 0.97);
+	ASSERT_EQ(grid.num_tiles(), 0u);
+	ASSERT_EQ(grid.bounds().width, 0u);
+	ASSERT_EQ(grid.occupancy(Vector2D(0.05, 0.05)), -1);
+
+	// One beam along +x ending on an obstacle 1 m away
+	grid.insert_ray(Vector2D(0.05, 0.05), Vector2D(1.05, 0.05), true);
+	ASSERT_EQ(grid.num_tiles(), 1u);
+	ASSERT_LT(grid.occupancy(Vector2D(0.05, 0.05)), 50);
+	ASSERT_LT(grid.occupancy(Vector2D(0.55, 0.05)), 50);
+	ASSERT_EQ(grid.occupancy(Vector2D(1.05, 0.05)), 70);
+	ASSERT_EQ(grid.occupancy(Vector2D(1.15, 0.05)), -1);
+	ASSERT_EQ(grid.occupancy(Vector2D(0.55, 0.15)), -1);
+
+	// Repeated hits are clamped, so the cell can still be cleared
+	for (int i = 0; i < 50; i++)
+	{
+		grid.insert_ray(Vector2D(0.05, 0.05), Vector2D(1.05, 0.05), true);
+	}
+	ASSERT_EQ(grid.occupancy(Vector2D(1.05, 0.05)), 97);
+	grid.insert_ray(Vector2D(0.05, 0.05), Vector2D(2.05, 0.05), false);
+	ASSERT_LT(grid.occupancy(Vector2D(1.05, 0.05)), 97);
+	ASSERT_LT(grid.occupancy(Vector2D(2.05, 0.05)), 50);
+
+	// The grid grows towards negative coordinates. The ray updates the new tile and the one it
+	// starts in, so both are dirty
+	ASSERT_EQ(grid.dirty_tiles().size(), 1u);
+	grid.clear_dirty();
+	ASSERT_TRUE(grid.dirty_tiles().empty());
+	Pose2D sensor(0.05, 0.05, rigid2d::PI);
+	ScanCloud scan;
+	scan.push_back(Point(Vector2D(1.0, 0.0)));
+	grid.insert_scan(sensor, scan);
+	ASSERT_EQ(grid.num_tiles(), 2u);
+	ASSERT_EQ(grid.dirty_tiles().size(), 2u);
+	ASSERT_EQ(grid.occupancy(Vector2D(-0.95, 0.05)), 70);
+	GridBounds tile = grid.tile_bounds(grid.dirty_tiles().back());
+	ASSERT_EQ(tile.min_x, -GridMap::TILE_SIZE);
+	ASSERT_EQ(tile.min_y, 0);
+	std::vector<std::int8_t> tile_data;
+	grid.export_tile(grid.dirty_tiles().back(), tile_data);
+	ASSERT_EQ(tile_data.size(), GridMap::TILE_CELLS);
+	ASSERT_EQ(tile_data.at(GridMap::TILE_SIZE - 10), 70);
+
+	// The full grid covers both tiles and agrees with occupancy()
+	GridBounds bounds = grid.bounds();
+	ASSERT_EQ(bounds.min_x, -GridMap::TILE_SIZE);
+	ASSERT_EQ(bounds.min_y, 0);
+	ASSERT_EQ(bounds.width, 2u * GridMap::TILE_SIZE);
+	ASSERT_EQ(bounds.height, static_cast<std::uint32_t>(GridMap::TILE_SIZE));
+	std::vector<std::int8_t> data;
+	grid.export_grid(data);
+	ASSERT_EQ(data.size(), static_cast<unsigned long int>(bounds.width) * bounds.height);
+	for (std::int32_t cx = -12; cx < 25; cx++)
+	{
+		Vector2D p((cx + 0.5) * 0.1, 0.05);
+		ASSERT_EQ(data.at(cx - bounds.min_x), grid.occupancy(p));
+	}
+	ASSERT_EQ(data.at(bounds.width + 5), -1);
+}
+
+
+// End points of a scan from the origin of a 4 m x 3 m room whose corners are (-1.5, -1) and (2.5, 2)
+static ScanCloud room_scan(const Pose2D & sensor)
+{
+	ScanCloud scan;
+	for (int i = 0; i < 360; i++)
+	{
+		double bearing = i * rigid2d::PI / 180.0;
+		double heading = sensor.theta + bearing;
+		double c = std::cos(heading), s = std::sin(heading);
+		double range = 1e9;
+		if (c > 1e-9) range = std::min(range, (2.5 - sensor.x) / c);
+		if (c < -1e-9) range = std::min(range, (-1.5 - sensor.x) / c);
+		if (s > 1e-9) range = std::min(range, (2.0 - sensor.y) / s);
+		if (s < -1e-9) range = std::min(range, (-1.0 - sensor.y) / s);
+		scan.push_back(Point(RangeBear(range, bearing)));
+	}
+	return scan;
+}
+
+TEST(grid, ScanMatcher)
+{
+	ASSERT_THROW(ScanMatcher(0.2, 0.2, 0.0), std::invalid_argument);
+	ScanMatcher matcher;
+	ASSERT_FALSE(matcher.has_map());
+	ASSERT_THROW(matcher.match(Pose2D(), ScanCloud()), std::logic_error);
+
+	GridMap grid;
+	for (int i = 0; i < 3; i++)
+	{
+		grid.insert_scan(Pose2D(), room_scan(Pose2D()));
+	}
+	matcher.set_map(grid);
+	ASSERT_TRUE(matcher.has_map());
+
+	// Scan taken at (0.3, 0.2, 0.1) matched from a guess off by (-0.12, 0.09, -0.06)
+	Pose2D truth(0.3, 0.2, 0.1);
+	ScanCloud scan = room_scan(truth);
+	ScanMatch result = matcher.match(Pose2D(0.18, 0.29, 0.04), scan);
+	ASSERT_NEAR(result.pose.x, truth.x, grid.resolution());
+	ASSERT_NEAR(result.pose.y, truth.y, grid.resolution());
+	ASSERT_NEAR(result.pose.theta, truth.theta, 0.011);
+	ASSERT_GT(result.score, 0.5);
+	// Far fewer candidates than the 41 rotations x 9 x 9 translations of the exhaustive search
+	ASSERT_LT(result.evaluated, 41u * 81u / 2u);
+
+	// Branch and bound finds the same score as scoring every candidate at full resolution
+	double best = 0.0;
+	for (int r = -20; r <= 20; r++)
+	{
+		for (int ox = -4; ox <= 4; ox++)
+		{
+			for (int oy = -4; oy <= 4; oy++)
+			{
+				ScanMatcher single(0.0, 0.0, 1.0);
+				single.set_map(grid);
+				Pose2D pose(0.18 + ox * grid.resolution(), 0.29 + oy * grid.resolution(), 0.04 + r * 0.01);
+				best = std::max(best, single.match(pose, scan).score);
+			}
+		}
+	}
+	ASSERT_NEAR(result.score, best, 1e-9);
+
+	// An empty scan leaves the guess unchanged
+	result = matcher.match(truth, ScanCloud());
+	ASSERT_EQ(result.pose.x, truth.x);
+	ASSERT_EQ(result.score, 0.0);
+}
+
+TEST(icp, KDTree)
+{
+	std::mt19937 gen(3);
+	std::uniform_real_distribution<double> dist(-2.0, 2.0);
+	std::vector<double> x(500), y(500);
+	for (unsigned long int i = 0; i < x.size(); i++)
+	{
+		x.at(i) = dist(gen);
+		y.at(i) = dist(gen);
+	}
+	KDTree2D tree;
+	ASSERT_EQ(tree.nearest(0.0, 0.0, 1.0), KDTree2D::npos);
+	tree.build(x, y);
+	ASSERT_EQ(tree.size(), 500u);
+
+	// Same answer as a linear search, within and beyond max_distance
+	for (int q = 0; q < 200; q++)
+	{
+		double qx = dist(gen), qy = dist(gen);
+		std::uint32_t expected = KDTree2D::npos;
+		double best = 0.1;
+		for (unsigned long int i = 0; i < x.size(); i++)
+		{
+			double d = std::hypot(x.at(i) - qx, y.at(i) - qy);
+			if (d < best)
+			{
+				best = d;
+				expected = i;
+			}
+		}
+		ASSERT_EQ(tree.nearest(qx, qy, 0.1), expected);
+	}
+	ASSERT_THROW(tree.build(x, {1.0}), std::invalid_argument);
+}
+
+TEST(icp, Align)
+{
+	ASSERT_THROW(Icp(IcpMetric::PointToLine, 0, 0.2, 1e-4), std::invalid_argument);
+
+	// Scans of the room from the origin and from (0.1, -0.05, 0.08)
+	ScanCloud reference = room_scan(Pose2D());
+	Pose2D truth(0.1, -0.05, 0.08);
+	ScanCloud source = room_scan(truth);
+
+	Icp line;
+	line.set_reference(reference);
+	ASSERT_EQ(line.reference_size(), 360u);
+	IcpResult result = line.align(source, Pose2D());
+	ASSERT_TRUE(result.converged);
+	ASSERT_NEAR(result.pose.x, truth.x, 1e-3);
+	ASSERT_NEAR(result.pose.y, truth.y, 1e-3);
+	ASSERT_NEAR(result.pose.theta, truth.theta, 1e-3);
+	ASSERT_GT(result.correspondences, 300u);
+
+	// Point-to-point samples different points of the same walls, so it is less exact and slower
+	Icp point(IcpMetric::PointToPoint, 100, 0.2, 1e-5);
+	point.set_reference(reference);
+	IcpResult point_result = point.align(source, Pose2D());
+	ASSERT_NEAR(point_result.pose.x, truth.x, 0.02);
+	ASSERT_NEAR(point_result.pose.y, truth.y, 0.02);
+	ASSERT_NEAR(point_result.pose.theta, truth.theta, 0.02);
+	ASSERT_GT(point_result.iterations, result.iterations);
+
+	// Too few points leaves the guess unchanged
+	result = line.align(ScanCloud(), truth);
+	ASSERT_EQ(result.pose.x, truth.x);
+	ASSERT_EQ(result.correspondences, 0u);
+}
+
 }
 
 int main(int argc, char * argv[])
@@ -0,0 +1,96 @@
+#include <ros/ros.h>
+#include <sensor_msgs/JointState.h>
+#include <sensor_msgs/LaserScan.h>
+
+#include <cmath>
+
+#include "nuslam/TurtleMap.h"
+// Bring in gtest
+#include <gtest/gtest.h>
+
+// Global Vars
+bool map_flag = false;
+nuslam::TurtleMap belief_test;
+
+// /slam/landmarks callback
+void map_callback(const nuslam::TurtleMap &map)
+{
+  belief_test = map;
+  map_flag = true;
+}
+
+// Whether the belief contains a landmark near x, y
+bool has_landmark(const double &x, const double &y)
+{
+  for (unsigned long int i = 0; i < belief_test.x_pts.size(); i++)
+  {
+    if (std::hypot(belief_test.x_pts.at(i) - x, belief_test.y_pts.at(i) - y) < 0.05)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Testing that landmarks are incorporated after a scan has consumed the odometry
+TEST(Slam, ScanThenLandmarks)
+{
+	ros::NodeHandle nh;
+
+	// Init Subscriber
+	ros::Subscriber map_sub = nh.subscribe("/slam/landmarks", 1, map_callback);
+
+	ros::Publisher js_pub = nh.advertise<sensor_msgs::JointState>("/joint_states", 1, true);
+	ros::Publisher scan_pub = nh.advertise<sensor_msgs::LaserScan>("/scan", 1, true);
+	ros::Publisher lnd_pub = nh.advertise<nuslam::TurtleMap>("/landmarks_node/landmarks", 1, true);
+
+	// One joint state, so there is exactly one prediction to apply
+	sensor_msgs::JointState js;
+	js.name = {"left_wheel_axle", "right_wheel_axle"};
+	js.position = {0.0, 0.0};
+	js.header.stamp = ros::Time::now();
+	js_pub.publish(js);
+
+	// Scans of a wall 1m ahead, each applying the pending prediction before the landmarks arrive
+	sensor_msgs::LaserScan scan;
+	scan.angle_min = -0.5;
+	scan.angle_increment = 0.01;
+	scan.angle_max = scan.angle_min + 100 * scan.angle_increment;
+	scan.range_min = 0.12;
+	scan.range_max = 3.5;
+	for (int i = 0; i <= 100; i++)
+	{
+		scan.ranges.push_back(1.0 / std::cos(scan.angle_min + i * scan.angle_increment));
+	}
+
+	// One landmark 0.5m ahead of the robot
+	nuslam::TurtleMap landmarks;
+	landmarks.radii.push_back(0.05);
+	landmarks.x_pts.push_back(0.5);
+	landmarks.y_pts.push_back(0.0);
+
+	// Interleave scans and landmarks without new joint states in between
+	ros::Time timeout = ros::Time::now() + ros::Duration(10.0);
+	map_flag = false;
+	while (!(map_flag && has_landmark(0.5, 0.0)) && ros::Time::now() < timeout)
+	{
+		scan.header.stamp = ros::Time::now();
+		scan_pub.publish(scan);
+		ros::Duration(0.2).sleep();
+		ros::spinOnce();
+		landmarks.header.stamp = ros::Time::now();
+		lnd_pub.publish(landmarks);
+		ros::Duration(0.2).sleep();
+		ros::spinOnce();
+	}
+
+	ASSERT_TRUE(map_flag);
+	ASSERT_TRUE(has_landmark(0.5, 0.0));
+}
+
+int main(int argc, char * argv[])
+{
+    testing::InitGoogleTest(&argc, argv);
+    ros::init(argc, argv, "slam_test");
+    return RUN_ALL_TESTS();
+}
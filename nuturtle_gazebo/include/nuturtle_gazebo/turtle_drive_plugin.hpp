@@ -13,6 +13,11 @@
 #include "gazebo/util/system.hh"
 #include <ros/ros.h>
 #include <functional> 
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
 
 #include "nuturtlebot/WheelCommands.h"
 #include "nuturtlebot/SensorData.h"
@@ -28,6 +33,9 @@ namespace gazebo
         /// \brief empty constructor for plugin
         TurtleDrivePlugin();
 
+        /// \brief disconnects from world updates and stops the publishing thread, if any
+        ~TurtleDrivePlugin();
+
         /// \brief callback to convert wheel commands (+- 256) to velocities and applies them to gazebo model
         /// \param nuturtlebot::WheelCommands: integer value between +-256 to indicate wheel speed
         void wheel_cmdCallback(const nuturtlebot::WheelCommands &wc);
@@ -42,9 +50,15 @@ namespace gazebo
 
         /// \brief Plugin equivalent of ross:Spin() where model updates happen according to callbacks or otherwise
         /// in this case, sets the wheel joint velocities and torques (always max specified) according to wheel_cmdCallback
-        /// using physics::ModelPtr
+        /// using physics::ModelPtr. Runs on every physics step, so it does not allocate: all conversion
+        /// constants are computed in Load and the SensorData message is preallocated
         void OnUpdate();
 
+        /// \brief loop of the optional publishing thread. Publishes the most recent encoder reading
+        /// handed over by OnUpdate, so serialization never stalls the physics step. Readings produced
+        /// faster than they can be published are coalesced, and only the latest one is sent.
+        void PublishLoop();
+
         std::vector<event::ConnectionPtr> connections;
 
         physics::ModelPtr model;
@@ -61,9 +75,30 @@ namespace gazebo
         int sensor_frequency_, encoder_ticks_per_rev_, motor_pwr_max_;
         std::string wheel_cmd_topic_, sensor_data_topic_;
         double motor_rot_max_, motor_torque_max_, update_period_;
-        double desired_left_velocity, desired_right_velocity;
         common::Time last_update_time_;
-        bool wheel_cmd_flag_;
+
+        // Written by wheel_cmdCallback on the ROS spinner thread and taken by OnUpdate on the physics thread.
+        // Holds the left (high word) and right (low word) velocities as floats, so that both are exchanged in one
+        // lock-free atomic operation, or no_wheel_cmd_ if no command arrived since the last one was applied
+        static constexpr std::uint64_t no_wheel_cmd_ = ~std::uint64_t(0);
+        std::atomic<std::uint64_t> desired_velocities_;
+
+        // Precomputed in Load: joint angle (rad) to encoder ticks, and wheel command to velocity (rad/s)
+        double encoder_m_, encoder_b_;
+        double cmd_m_, cmd_b_;
+
+        // Preallocated encoder message filled by OnUpdate
+        nuturtlebot::SensorData sensor_data_;
+
+        // Optional publishing thread
+        bool publish_thread_;
+        std::thread publisher_;
+        std::mutex publish_mutex_;
+        std::condition_variable publish_cv_;
+        // Guarded by publish_mutex_
+        nuturtlebot::SensorData pending_data_;
+        bool pending_flag_;
+        bool running_;
 
   };
 }
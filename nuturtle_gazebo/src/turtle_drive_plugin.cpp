@@ -1,8 +1,29 @@
 #include "nuturtle_gazebo/turtle_drive_plugin.hpp"
+#include <cstring>
 
 
 gazebo::TurtleDrivePlugin::TurtleDrivePlugin()
 {
+  desired_velocities_ = no_wheel_cmd_;
+  publish_thread_ = false;
+  pending_flag_ = false;
+  running_ = false;
+}
+
+gazebo::TurtleDrivePlugin::~TurtleDrivePlugin()
+{
+  // Stop OnUpdate before tearing down the publishing thread it hands data to
+  connections.clear();
+
+  if (publisher_.joinable())
+  {
+    {
+      std::lock_guard<std::mutex> lock(publish_mutex_);
+      running_ = false;
+    }
+    publish_cv_.notify_one();
+    publisher_.join();
+  }
 }
 
 // Load Plugin
@@ -23,10 +44,8 @@ void gazebo::TurtleDrivePlugin::Load(physics::ModelPtr _model, sdf::ElementPtr _
   // Diff Drive Robot only has 2 joints
   joints.resize(2);
 
-  // Inititialize joint velocity variables and publish flag
-  desired_right_velocity = 0.0;
-  desired_left_velocity = 0.0;
-  wheel_cmd_flag_ = false;
+  // No joint velocity command yet
+  desired_velocities_ = no_wheel_cmd_;
 
   // Get Model object to manipulate model physics
   model = _model;
@@ -109,8 +128,23 @@ void gazebo::TurtleDrivePlugin::Load(physics::ModelPtr _model, sdf::ElementPtr _
       motor_torque_max_ = _sdf->GetElement("motor_torque_max")->Get<double>();
     }
 
+  // Publish SensorData from a separate thread instead of the physics step
+  publish_thread_ = false; // default off
+    if (_sdf->HasElement("publish_thread")) {
+      publish_thread_ = _sdf->GetElement("publish_thread")->Get<bool>();
+    }
+
+  // Precompute conversions used in OnUpdate and wheel_cmdCallback
+  // Joint angle 0-2pi to 0-encoder_ticks_per_rev
+  encoder_m_ = (encoder_ticks_per_rev_) / (2.0  * rigid2d::PI);
+  encoder_b_ = (encoder_ticks_per_rev_ - 2.0 * rigid2d::PI * encoder_m_);
+  // Wheel commands (+- 256) to velocities
+  cmd_m_ = (motor_rot_max_ * 2.0) / (motor_pwr_max_ * 2.0);
+  cmd_b_ = (motor_rot_max_ - motor_pwr_max_ * cmd_m_);
+
   // Now set up wheel joints using max torque attributes
   // Note this method only accepts doubles
+  // fmax never changes, so it is only set here
   joints[0]->SetParam("vel", 0, 0.0);
   joints[0]->SetParam("fmax", 0, motor_torque_max_);
   joints[1]->SetParam("vel", 0, 0.0);
@@ -147,6 +181,12 @@ void gazebo::TurtleDrivePlugin::Load(physics::ModelPtr _model, sdf::ElementPtr _
   }
   last_update_time_ = model->GetWorld()->SimTime();
 
+  if (publish_thread_)
+  {
+    running_ = true;
+    publisher_ = std::thread(&gazebo::TurtleDrivePlugin::PublishLoop, this);
+  }
+
   ROS_INFO("TurtleDrive Plugin Loaded!");
 }
 
@@ -160,63 +200,101 @@ void gazebo::TurtleDrivePlugin::OnUpdate()
   if (seconds_since_last_update >= update_period_)
   {
     // Set Last Update Time
-    last_update_time_ = model->GetWorld()->SimTime();
-
+    last_update_time_ = current_time;
 
     // Get Wheel Joint Positions and Publish
-    // First, convert from 0-2pi to 0-encoder_ticks_per_rev
-    double m = (encoder_ticks_per_rev_) / (2.0  * rigid2d::PI);
-    double b = (encoder_ticks_per_rev_ - 2.0 * rigid2d::PI * m);
-    nuturtlebot::SensorData sns;
-    sns.left_encoder = joints[0]->Position() * m + b;
-    sns.right_encoder = joints[1]->Position() * m + b;
-    SensorDataPub.publish(sns);
+    // Convert from 0-2pi to 0-encoder_ticks_per_rev
+    sensor_data_.left_encoder = joints[0]->Position() * encoder_m_ + encoder_b_;
+    sensor_data_.right_encoder = joints[1]->Position() * encoder_m_ + encoder_b_;
+
+    if (publish_thread_)
+    {
+      // Hand reading to publishing thread, overwriting any it has not sent yet
+      {
+        std::lock_guard<std::mutex> lock(publish_mutex_);
+        pending_data_.left_encoder = sensor_data_.left_encoder;
+        pending_data_.right_encoder = sensor_data_.right_encoder;
+        pending_flag_ = true;
+      }
+      publish_cv_.notify_one();
+    } else {
+      SensorDataPub.publish(sensor_data_);
+    }
 
     // If new wheel command received, set axle velocities
-    if (wheel_cmd_flag_)
+    std::uint64_t velocities = desired_velocities_.exchange(no_wheel_cmd_);
+    if (velocities != no_wheel_cmd_)
     {
-      joints[0]->SetParam("vel", 0, desired_left_velocity);
-      joints[0]->SetParam("fmax", 0, motor_torque_max_);
-      joints[1]->SetParam("vel", 0, desired_right_velocity);
-      joints[1]->SetParam("fmax", 0, motor_torque_max_);
-      // Reset Flag
-      wheel_cmd_flag_ = false;
+      std::uint32_t left_bits = velocities >> 32, right_bits = velocities & 0xFFFFFFFF;
+      float left_velocity, right_velocity;
+      std::memcpy(&left_velocity, &left_bits, sizeof(float));
+      std::memcpy(&right_velocity, &right_bits, sizeof(float));
+      // Joint motor target velocity, driven by at most fmax. SetVelocity would instead force the joint to
+      // this velocity with unlimited torque, so SetParam is used, only when a new command arrives.
+      joints[0]->SetParam("vel", 0, static_cast<double>(left_velocity));
+      joints[1]->SetParam("vel", 0, static_cast<double>(right_velocity));
     }
 
   }
   
 }
 
+// Publishing Thread
+void gazebo::TurtleDrivePlugin::PublishLoop()
+{
+  nuturtlebot::SensorData sns;
+
+  std::unique_lock<std::mutex> lock(publish_mutex_);
+  while (true)
+  {
+    publish_cv_.wait(lock, [this]{ return pending_flag_ || !running_; });
+    if (!running_)
+    {
+      break;
+    }
+
+    sns.left_encoder = pending_data_.left_encoder;
+    sns.right_encoder = pending_data_.right_encoder;
+    pending_flag_ = false;
+
+    // Publish without holding the lock so OnUpdate never waits on serialization
+    lock.unlock();
+    SensorDataPub.publish(sns);
+    lock.lock();
+  }
+}
+
 // Wheel Command Callback
 void gazebo::TurtleDrivePlugin::wheel_cmdCallback(const nuturtlebot::WheelCommands & wc)
 {
   // Convert wheel commands (+- 256) to velocities
-  double m = (motor_rot_max_ * 2.0) / (motor_pwr_max_ * 2.0);
-  double b = (motor_rot_max_ - motor_pwr_max_ * m);
-
-  desired_left_velocity =  wc.left_velocity * m + b;
-  desired_right_velocity = wc.right_velocity * m + b;
+  double left_velocity =  wc.left_velocity * cmd_m_ + cmd_b_;
+  double right_velocity = wc.right_velocity * cmd_m_ + cmd_b_;
 
   // Now cap wheel velocities if excessive
   // Cap High
-  if (desired_left_velocity > motor_rot_max_)
+  if (left_velocity > motor_rot_max_)
   {
-    desired_left_velocity = motor_rot_max_;
-  } else if (desired_left_velocity < - motor_rot_max_)
+    left_velocity = motor_rot_max_;
+  } else if (left_velocity < - motor_rot_max_)
   {
-    desired_left_velocity = - motor_rot_max_;
+    left_velocity = - motor_rot_max_;
   }
   // Cap Low
-  if (desired_right_velocity > motor_rot_max_)
+  if (right_velocity > motor_rot_max_)
   {
-    desired_right_velocity = motor_rot_max_;
-  } else if (desired_right_velocity < - motor_rot_max_)
+    right_velocity = motor_rot_max_;
+  } else if (right_velocity < - motor_rot_max_)
   {
-    desired_right_velocity = - motor_rot_max_;
+    right_velocity = - motor_rot_max_;
   }
 
-  // Flag to indicate we can publish new wheel commands
-  wheel_cmd_flag_ = true;
+  // Hand both velocities to OnUpdate as one word. Capped velocities are finite, so never equal no_wheel_cmd_
+  float left = left_velocity, right = right_velocity;
+  std::uint32_t left_bits, right_bits;
+  std::memcpy(&left_bits, &left, sizeof(float));
+  std::memcpy(&right_bits, &right, sizeof(float));
+  desired_velocities_ = (static_cast<std::uint64_t>(left_bits) << 32) | right_bits;
 }
 
 GZ_REGISTER_MODEL_PLUGIN(gazebo::TurtleDrivePlugin)
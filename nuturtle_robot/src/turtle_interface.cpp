@@ -2,17 +2,18 @@
 /// \brief This node executes low-level control for the turtlebot, engaging its motors depending on desired twist, and reading its wheel encoder values.
 ///
 /// PARAMETERS:
-/// w_vel (rigid2d::WheelVelocities): used to store wheel commands, ranging from -265 to +265 as converted from actual  wheel velocities.
-/// w_vel_measured (rigid2d::WheelVelocities): measured wheel velocity, computed by feeding updated wheel encoder values to DiffDrive::updateOdomtry()
-/// w_ang (rigid2d::WheelVelocities): used to store wheel angles after they are converted from wheel encoder values, where 0-4096 maps to 0-2.0*PI
 /// driver (rigid2d::DiffDrive): diff_drive object used to perform operations to set turtlebot3 commands and interpret its data.
-/// frequency (double): the loop rate
-/// vel_flag (bool): flag to indicate that vel_callback has been triggered, and that a wheel command should be published.
-/// sensor_flag (bool): flag to indicate that sensor_callback has been triggered, and that wheel joint states should be published
 /// max_lin_vel_ (float): the turtlebot's maximum linear velocity in m/s
 /// max_ang_vel_ (float): the turtlebot's maximum angular velocity in rad/s
 /// motor_rot_max_ (float): the turtlebot wheels' maximum rotational speed in rad/s
 /// encoder_ticks_per_rev_ (float): used to map between wheel encoder ticks and actual wheel rotation. Cast as float to use in division
+/// watchdog_rate_ (double): rate (Hz) at which the control thread re-sends the latest wheel command, 0 to disable
+/// cmd_timeout_ (double): seconds without cmd_vel after which the control thread sends zero wheel commands instead of
+/// re-sending the latest one, defaults to 0.5. The control thread only runs if it is positive
+/// rt_priority_ (int): SCHED_FIFO priority (1-99) of the control thread, 0 to keep the default scheduler
+/// command (std::atomic<uint64_t>): mailbox holding the latest left and right wheel commands and their sequence number,
+/// written by vel_callback and read by the control thread without locking
+/// js (sensor_msgs::JointState): joint state message, allocated once and refilled by sensor_callback
 ///
 /// o_fid_ (std::string): odometer frame ID
 /// b_fid_ (std::string): body frame ID
@@ -22,23 +23,41 @@
 /// wrad_ (float): wheel radius
 ///
 /// PUBLISHES:
-/// joint_states (sensor_msgs::JointState): the turtlebot3's wheel positions and velocities
-/// wheel_cmd (nuturtlebot::WheelCommands): the turtlebot3's wheel commands; integers corresponding to wheel velocities from -max to max in rad/s
+/// joint_states (sensor_msgs::JointState): the turtlebot3's wheel positions and velocities, published on every sensor_data message
+/// wheel_cmd (nuturtlebot::WheelCommands): the turtlebot3's wheel commands; integers corresponding to wheel velocities from -max to max in rad/s,
+/// published on every cmd_vel message and re-sent at watchdog_rate_
 ///
 /// SUBSCRIBES:
 /// cmd_vel (geometry_msgs::Twist): subscriber, which records the commanded twist
 /// sensor_data (nuturtlebot::SensorData): subscriber, which records wheel encoder values, among other turtlebot3 sensor data
 ///
+/// THREADS:
+/// main: services the callback queue, publishing wheel commands and joint states as soon as their inputs arrive
+/// control: wakes at absolute deadlines every 1/watchdog_rate_ seconds and re-sends the latest wheel command from the mailbox,
+/// or zero commands once it is older than cmd_timeout_
+///
 /// FUNCTIONS:
-/// vel_callback (void): callback for cmd_vel subscriber, which records the commanded twist and sets a flag to publish wheel commands
-/// sensor_callback (void): callback for sensor_data subscriber, which records the turtlebot3's wheel positions and sets a flag to publish joint states
+/// vel_callback (void): callback for cmd_vel subscriber, which converts the commanded twist to wheel commands and publishes them
+/// sensor_callback (void): callback for sensor_data subscriber, which converts wheel encoder values to joint states and publishes them
+/// control_loop (void): body of the control thread
+/// pack_command (uint64_t): packs left and right wheel commands and their sequence number into one mailbox word
+/// unpack_command (nuturtlebot::WheelCommands): unpacks the wheel commands of a mailbox word
+/// command_sequence (uint32_t): unpacks the sequence number of a mailbox word
 
 #include <ros/ros.h>
 #include <geometry_msgs/Twist.h>
 #include<sensor_msgs/JointState.h>
-#include<sensor_msgs/JointState.h>
 
 #include<string>
+#include<atomic>
+#include<thread>
+#include<chrono>
+#include<cstdint>
+#include<cstring>
+#include<cerrno>
+#include<cmath>
+#include<pthread.h>
+#include<sys/mman.h>
 
 #include "rigid2d/rigid2d.hpp"
 #include "rigid2d/diff_drive.hpp"
@@ -46,21 +65,58 @@
 #include "nuturtlebot/SensorData.h"
 
 // GLOBAL VARS
-rigid2d::WheelVelocities w_vel;
-rigid2d::WheelVelocities w_vel_measured;
-rigid2d::WheelVelocities w_ang;
 rigid2d::DiffDrive driver;
-double frequency = 60;
-bool vel_flag = false;
-bool sensor_flag = false;
 float max_lin_vel_ = 0;
 float max_ang_vel_ = 0;
 float motor_rot_max_ = 0;
 float encoder_ticks_per_rev_ = 0;
+ros::Publisher js_pub;
+ros::Publisher wvel_pub;
+sensor_msgs::JointState js;
+// Command mailbox, shared with the control thread. Sequence number 0 means no command yet
+std::atomic<std::uint64_t> command(0);
+std::uint32_t command_count = 0;
+std::atomic<bool> running(true);
+
+std::uint64_t pack_command(const nuturtlebot::WheelCommands & wc, const std::uint32_t & sequence)
+{
+  /// \brief packs the left (top 16 bits) and right (next 16 bits) wheel commands, which lie within
+  /// +-265, and their sequence number (low 32 bits), so that all three are exchanged in one lock-free
+  /// atomic store
+  ///
+  /// \param wc (nuturtlebot::WheelCommands): wheel commands
+  /// \param sequence (uint32_t): number of the command, never 0
+  /// \returns mailbox word
+  return (static_cast<std::uint64_t>(static_cast<std::uint16_t>(wc.left_velocity)) << 48) |
+         (static_cast<std::uint64_t>(static_cast<std::uint16_t>(wc.right_velocity)) << 32) |
+         sequence;
+}
+
+nuturtlebot::WheelCommands unpack_command(const std::uint64_t & word)
+{
+  /// \brief inverse of pack_command for the wheel commands
+  ///
+  /// \param word (uint64_t): mailbox word
+  /// \returns wheel commands
+  nuturtlebot::WheelCommands wc;
+  wc.left_velocity = static_cast<std::int16_t>(word >> 48);
+  wc.right_velocity = static_cast<std::int16_t>((word >> 32) & 0xFFFF);
+  return wc;
+}
+
+std::uint32_t command_sequence(const std::uint64_t & word)
+{
+  /// \brief inverse of pack_command for the sequence number
+  ///
+  /// \param word (uint64_t): mailbox word
+  /// \returns sequence number, 0 if no command was received
+  return static_cast<std::uint32_t>(word & 0xFFFFFFFF);
+}
 
 void vel_callback(const geometry_msgs::Twist &tw)
 {
-   /// \brief cmd_vel subscriber callback. Records commanded twist
+  /// \brief cmd_vel subscriber callback. Converts the commanded twist to wheel commands and
+  /// publishes them immediately, then leaves them in the mailbox for the control thread
   ///
   /// \param tw (geometry_msgs::Twist): the commanded linear and angular velocity
   /// \returns w_vel (rigid2d::WheelVelocities --> nuturtlebot:WheelCommands) to actuate turtlebot3
@@ -91,7 +147,7 @@ void vel_callback(const geometry_msgs::Twist &tw)
 
   rigid2d::Twist2D Vb(ang_vel, lin_vel, tw.linear.y);
   // Get Wheel Velocities
-  w_vel = driver.twistToWheels(Vb);
+  rigid2d::WheelVelocities w_vel = driver.twistToWheels(Vb);
 
   // Cap Wheel Velocities
   if (w_vel.ul > motor_rot_max_)
@@ -114,18 +170,30 @@ void vel_callback(const geometry_msgs::Twist &tw)
   float m = (265. - - 265.) / (motor_rot_max_ * 2.);
   float b = (265. - motor_rot_max_ * m);
 
-  w_vel.ul = w_vel.ul * m + b;
-  w_vel.ur = w_vel.ur * m + b;
+  nuturtlebot::WheelCommands wc;
+  wc.left_velocity = std::round(w_vel.ul * m + b);
+  wc.right_velocity = std::round(w_vel.ur * m + b);
 
-  vel_flag = true;
+  // Publish now rather than on the next loop iteration
+  wvel_pub.publish(wc);
+
+  // Hand over to the control thread, skipping sequence number 0 on wrap-around
+  command_count++;
+  if (command_count == 0)
+  {
+    command_count++;
+  }
+  command.store(pack_command(wc, command_count), std::memory_order_relaxed);
 }
 
 void sensor_callback(const nuturtlebot::SensorData &sns)
 {
-  /// \brief sensor_data subscriber callback. Records left and right wheel angles
+  /// \brief sensor_data subscriber callback. Records left and right wheel angles and publishes
+  /// them as joint states immediately
   ///
   /// \param sns (nuturtlebot::SensorData ): the left and right wheel joint encoder values
   /// w_ang and w_vel_measured (rigid2d::WheelVelocities): measured wheel angles and velocities respct.
+  rigid2d::WheelVelocities w_ang;
   w_ang.ul = sns.left_encoder;
   w_ang.ur = sns.right_encoder;
 
@@ -141,9 +209,70 @@ void sensor_callback(const nuturtlebot::SensorData &sns)
   w_ang.ur = rigid2d::normalize_angle(w_ang.ur);
 
   // Get wheel velocities based on encoder data
-  w_vel_measured = driver.updateOdometry(w_ang.ul, w_ang.ur);
+  rigid2d::WheelVelocities w_vel_measured = driver.updateOdometry(w_ang.ul, w_ang.ur);
+
+  // Names and vector sizes were set once in main; order is left wheel, right wheel
+  js.header.stamp = ros::Time::now();
+  js.position[0] = w_ang.ul;
+  js.velocity[0] = w_vel_measured.ul;
+  js.position[1] = w_ang.ur;
+  js.velocity[1] = w_vel_measured.ur;
 
-  sensor_flag = true;
+  js_pub.publish(js);
+}
+
+void control_loop(const double & watchdog_rate_, const double & cmd_timeout_)
+{
+  /// \brief re-sends the latest wheel command every 1/watchdog_rate_ seconds, so that a dropped
+  /// message is recovered within one period and the motor driver receives a steady heartbeat.
+  /// Deadlines are absolute, so the period does not drift with the time spent publishing.
+  /// Once no new cmd_vel arrived for cmd_timeout_, zero commands are sent instead. A new command
+  /// is noticed by its sequence number on the first wake-up after it, so commands are aged to
+  /// within one period.
+  ///
+  /// \param watchdog_rate_ (double): rate (Hz) of the control thread
+  /// \param cmd_timeout_ (double): seconds after which a command is considered stale
+  const auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+    std::chrono::duration<double>(1.0 / watchdog_rate_));
+  const auto timeout = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+    std::chrono::duration<double>(cmd_timeout_));
+  const nuturtlebot::WheelCommands stop;
+  std::uint32_t last_sequence = 0;
+  auto last_change = std::chrono::steady_clock::now();
+
+  auto deadline = std::chrono::steady_clock::now();
+  while (running.load(std::memory_order_relaxed))
+  {
+    deadline += period;
+    std::this_thread::sleep_until(deadline);
+
+    // Skip missed periods rather than bursting to catch up
+    auto now = std::chrono::steady_clock::now();
+    if (now > deadline + period)
+    {
+      deadline = now;
+    }
+
+    // Nothing is sent before the first cmd_vel
+    const std::uint64_t word = command.load(std::memory_order_relaxed);
+    const std::uint32_t sequence = command_sequence(word);
+    if (sequence == 0)
+    {
+      continue;
+    }
+    if (sequence != last_sequence)
+    {
+      last_sequence = sequence;
+      last_change = now;
+    }
+
+    if (now - last_change > timeout)
+    {
+      wvel_pub.publish(stop);
+    } else {
+      wvel_pub.publish(unpack_command(word));
+    }
+  }
 }
 
 int main(int argc, char** argv)
@@ -152,6 +281,9 @@ int main(int argc, char** argv)
   // Vars
   std::string o_fid_, b_fid_, wl_fid_, wr_fid_;
   float wbase_, wrad_;
+  double watchdog_rate_ = 10.0;
+  double cmd_timeout_ = 0.5;
+  int rt_priority_ = 0;
 
   ros::init(argc, argv, "turtle_interface"); // register the node on ROS
   ros::NodeHandle nh_("~"); // PRIVATE handle to ROS
@@ -160,6 +292,9 @@ int main(int argc, char** argv)
   // Private
   nh_.getParam("left_wheel_joint", wl_fid_);
   nh_.getParam("right_wheel_joint", wr_fid_);
+  nh_.getParam("watchdog_rate", watchdog_rate_);
+  nh_.getParam("cmd_timeout", cmd_timeout_);
+  nh_.getParam("rt_priority", rt_priority_);
   // Public
   nh.getParam("/wheel_base", wbase_);
   nh.getParam("/wheel_radius", wrad_);
@@ -170,64 +305,54 @@ int main(int argc, char** argv)
   // Set Driver Wheel Base and Radius
   driver.set_static(wbase_, wrad_);
 
+  // Preallocate the joint state message
+  // js stores vectors, so we push back the name corresp. to left wheel joint, then right wheel.
+  // Note order must be consistent between name and encoder values
+  js.name.push_back(wl_fid_);
+  js.name.push_back(wr_fid_);
+  js.position.resize(2);
+  js.velocity.resize(2);
+
+  // Init Publisher
+  js_pub = nh.advertise<sensor_msgs::JointState>("joint_states", 1);
+  wvel_pub = nh.advertise<nuturtlebot::WheelCommands>("wheel_cmd", 1);
   // Init Subscriber
   ros::Subscriber vel_sub = nh.subscribe("cmd_vel", 1, vel_callback);
   ros::Subscriber sensor_sub = nh.subscribe("sensor_data", 1, sensor_callback);
-  // Init Publisher
-  ros::Publisher js_pub = nh.advertise<sensor_msgs::JointState>("joint_states", 1);
-  ros::Publisher wvel_pub = nh.advertise<nuturtlebot::WheelCommands>("wheel_cmd", 1);
-
-  // Init Time
-  ros::Time current_time;
-  current_time = ros::Time::now();
 
-  ros::Rate rate(frequency);
-  // Main While
-  while (ros::ok())
+  // Control Thread
+  std::thread control_thread;
+  // Without a timeout the last command would be re-sent forever, e.g. after the teleop node dies
+  if (watchdog_rate_ > 0.0 && cmd_timeout_ <= 0.0)
   {
-  	ros::spinOnce();
-    current_time = ros::Time::now();
+    ROS_WARN("cmd_timeout must be positive for the control thread to run. Wheel commands will not be re-sent.");
+  } else if (watchdog_rate_ > 0.0) {
+    control_thread = std::thread(control_loop, watchdog_rate_, cmd_timeout_);
 
-    if (sensor_flag == true)
+    if (rt_priority_ > 0)
     {
-      sensor_msgs::JointState js;
-
-      js.header.stamp = current_time;
-
-      // js stores vectors, so we push back the name corresp. to left wheel joint
-      js.name.push_back(wl_fid_);
-      // then we insert the left wheel encoder value
-      js.position.push_back(w_ang.ul);
-      js.velocity.push_back(w_vel_measured.ul);
-
-      // repeat with right wheel. Note order must be consistent between name pushback and
-      // encoder value pushback
-      js.name.push_back(wr_fid_);
-      js.position.push_back(w_ang.ur);
-      js.velocity.push_back(w_vel_measured.ur);
-
-      // now publish
-      // std::cout << w_ang.ul << std::endl;
-      // std::cout << w_ang.ur << std::endl;
-      js_pub.publish(js);
-
-      sensor_flag = false;
+      // Keep pages resident so the control thread never waits on a page fault
+      if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+      {
+        ROS_WARN("mlockall failed: %s", std::strerror(errno));
+      }
+      sched_param param;
+      param.sched_priority = rt_priority_;
+      int err = pthread_setschedparam(control_thread.native_handle(), SCHED_FIFO, &param);
+      if (err != 0)
+      {
+        ROS_WARN("Unable to set SCHED_FIFO priority %d on the control thread: %s", rt_priority_, std::strerror(err));
+      }
     }
+  }
 
-    if (vel_flag == true)
-    {
-      nuturtlebot::WheelCommands wc;
-
-      wc.left_velocity = std::round(w_vel.ul);
-      wc.right_velocity = std::round(w_vel.ur);
-
-      wvel_pub.publish(wc);
-
-      vel_flag = false;
-    }
-    rate.sleep();
+  ros::spin();
 
+  running.store(false, std::memory_order_relaxed);
+  if (control_thread.joinable())
+  {
+    control_thread.join();
   }
 
   return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,83 @@
+#include <ros/ros.h>
+#include <geometry_msgs/Twist.h>
+
+#include<vector>
+
+#include "nuturtlebot/WheelCommands.h"
+// Bring in gtest
+#include <gtest/gtest.h>
+
+// Global Vars
+std::vector<nuturtlebot::WheelCommands> wcmds;
+std::vector<ros::WallTime> wcmd_times;
+
+// /wheel_cmd callback
+void wcmd_callback(const nuturtlebot::WheelCommands &wcmd)
+{
+  wcmds.push_back(wcmd);
+  wcmd_times.push_back(ros::WallTime::now());
+}
+
+// Testing a single cmd_vel --> wheel cmds re-sent at watchdog_rate, then zero after cmd_timeout
+TEST(TurtleInterface, WatchdogResendAndTimeout)
+{
+	ros::NodeHandle nh;
+
+	// Init Subscriber
+	ros::Subscriber wcmd_sub = nh.subscribe("/wheel_cmd", 100, wcmd_callback);
+
+	// TEST - cmd_vel publisher
+	ros::Publisher cmdv_pub = nh.advertise<geometry_msgs::Twist>("/cmd_vel", 1);
+	geometry_msgs::Twist test_twist;
+
+	test_twist.linear.x = 0.1; // 0.1 m/s linear velocity to publish
+
+	// Publish until the first wheel command arrives, then stop publishing
+	const ros::WallTime give_up = ros::WallTime::now() + ros::WallDuration(10.0);
+	while(wcmds.empty() && ros::WallTime::now() < give_up)
+	{
+		cmdv_pub.publish(test_twist);
+		ros::WallDuration(0.05).sleep();
+		ros::spinOnce();
+	}
+	ASSERT_FALSE(wcmds.empty());
+	const ros::WallTime first = wcmd_times.front();
+
+	// Collect wheel commands for well past cmd_timeout
+	while(ros::WallTime::now() < first + ros::WallDuration(1.2))
+	{
+		ros::WallDuration(0.01).sleep();
+		ros::spinOnce();
+	}
+
+	// At 20 Hz, the command is re-sent about 8 times before the 0.5 s timeout
+	int resent = 0;
+	for (unsigned int i = 0; i < wcmds.size(); i++)
+	{
+		if (wcmd_times.at(i) - first < ros::WallDuration(0.4) && wcmds.at(i).left_velocity == 126)
+		{
+			resent++;
+		}
+	}
+	ASSERT_GE(resent, 5);
+
+	// After the timeout, only zero commands are sent
+	int stopped = 0;
+	for (unsigned int i = 0; i < wcmds.size(); i++)
+	{
+		if (wcmd_times.at(i) - first > ros::WallDuration(0.8))
+		{
+			ASSERT_EQ(wcmds.at(i).left_velocity, 0);
+			ASSERT_EQ(wcmds.at(i).right_velocity, 0);
+			stopped++;
+		}
+	}
+	ASSERT_GE(stopped, 5);
+}
+
+int main(int argc, char * argv[])
+{
+    testing::InitGoogleTest(&argc, argv);
+    ros::init(argc, argv, "watchdog_test");
+    return RUN_ALL_TESTS();
+}
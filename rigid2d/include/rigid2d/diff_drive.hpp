@@ -97,10 +97,10 @@ namespace rigid2d
         void feedforward(rigid2d::Twist2D Vb);
 
         /// \brief get the current pose of the robot
-        rigid2d::Pose2D get_pose();
+        const rigid2d::Pose2D & get_pose() const;
 
         /// \brief get the current wheel angles (overloading WheelVelocities struct)
-        rigid2d::WheelVelocities get_ang();
+        rigid2d::WheelVelocities get_ang() const;
 
         /// \brief set DiffDrive instance's static parameters such as wheel base and radius
         void set_static(double wheel_base_, double wheel_radius_);
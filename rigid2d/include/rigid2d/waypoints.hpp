@@ -17,18 +17,18 @@ namespace rigid2d
 
         /// \brief create a Waypoints instance by specifying the
         /// waypoints to visit in a vector
-        /// \param std::vector<rigid2d::Vector2D> - the waypoints to visit
-        Waypoints(const std::vector<Vector2D> & waypoints_);
+        /// \param std::vector<rigid2d::Vector2D> - the waypoints to visit, moved into the instance
+        Waypoints(std::vector<Vector2D> waypoints_);
 
         /// \brief create a Waypoints instance by specifying the
         /// waypoints to visit in a vector, the proportional controller
         /// gains, the maximum twist thresholds and the pose threshold
-        /// \param std::vector<rigid2d::Vector2D> - the waypoints to visit
+        /// \param std::vector<rigid2d::Vector2D> - the waypoints to visit, moved into the instance
         /// \param (double) P_h - proportional control for heading
         /// \param (double) P_h - proportional control for cartesian position
         /// \param (double) w_z_max - maximum angular velocity
         /// \param (double) v_x_max - maximum linear velocity
-        Waypoints(const std::vector<Vector2D> & waypoints_, const double & P_h_, const double & P_l_,\
+        Waypoints(std::vector<Vector2D> waypoints_, const double & P_h_, const double & P_l_,\
                   const double & w_z_max_, const double & v_x_max_, const double & threshold_);
 
         /// \brief computes the required Twist2D to reach the next waypoint,
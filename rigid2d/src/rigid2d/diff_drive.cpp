@@ -33,10 +33,12 @@ WheelVelocities::WheelVelocities(double ul_, double ur_)
 
 DiffDrive::DiffDrive()
 {
-	rigid2d::Pose2D pose();
+	pose = rigid2d::Pose2D();
 	wheel_base = 1.0;
 	wheel_radius = 0.02;
-	rigid2d::WheelVelocities wheel_vel();
+	wheel_vel = rigid2d::WheelVelocities();
+	wl_ang = 0.0;
+	wr_ang = 0.0;
 }
 
 DiffDrive::DiffDrive(rigid2d::Pose2D pose_, double wheel_base_, double wheel_radius_)
@@ -44,7 +46,9 @@ DiffDrive::DiffDrive(rigid2d::Pose2D pose_, double wheel_base_, double wheel_rad
 	pose = pose_;
 	wheel_base = wheel_base_;
 	wheel_radius = wheel_radius_;
-	rigid2d::WheelVelocities wheel_vel();
+	wheel_vel = rigid2d::WheelVelocities();
+	wl_ang = 0.0;
+	wr_ang = 0.0;
 }
 
 
@@ -130,12 +134,12 @@ void DiffDrive::feedforward(rigid2d::Twist2D Vb)
 
 }
 
-rigid2d::Pose2D DiffDrive::get_pose()
+const rigid2d::Pose2D & DiffDrive::get_pose() const
 {
 	return pose;
 }
 
-rigid2d::WheelVelocities DiffDrive::get_ang()
+rigid2d::WheelVelocities DiffDrive::get_ang() const
 {
 	rigid2d::WheelVelocities w_ang(wl_ang, wr_ang);
 	return w_ang;
@@ -1,5 +1,5 @@
 #include "rigid2d/waypoints.hpp"
-#include <ros/ros.h>
+#include <utility>
 
 namespace rigid2d
 {
@@ -28,9 +28,9 @@ namespace rigid2d
 		threshold = 0.05;
 	}
 
-	Waypoints::Waypoints(const std::vector<Vector2D> & waypoints_)
+	Waypoints::Waypoints(std::vector<Vector2D> waypoints_)
 	{
-		waypoints = waypoints_;
+		waypoints = std::move(waypoints_);
 		done = 0;
 		lin_ang = 0;
 		P_h = 20;
@@ -40,13 +40,13 @@ namespace rigid2d
 		threshold = 0.05;
 	}
 
-	Waypoints::Waypoints(const std::vector<Vector2D> & waypoints_,\
+	Waypoints::Waypoints(std::vector<Vector2D> waypoints_,\
 						 const double & P_h_, const double & P_l_,\
 	                     const double & w_z_max_,\
 	                     const double & v_x_max_,\
 	                     const double & threshold_)
 	{
-		waypoints = waypoints_;
+		waypoints = std::move(waypoints_);
 		done = 0;
 		lin_ang = 0;
 		P_h = P_h_;